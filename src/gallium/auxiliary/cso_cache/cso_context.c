@@ -107,6 +107,14 @@ struct cso_context {
    void *tessctrl_shader, *tessctrl_shader_saved;
    void *tesseval_shader, *tesseval_shader_saved;
    void *velements, *velements_saved;
+
+   /** The CSOs behind blend, depth_stencil and rasterizer, so setting the
+    * bound state again skips hashing and lookup.  These, and the saved
+    * ones, are never evicted from the cache.
+    */
+   struct cso_blend *blend_cso, *blend_cso_saved;
+   struct cso_depth_stencil_alpha *depth_stencil_cso, *depth_stencil_cso_saved;
+   struct cso_rasterizer *rasterizer_cso, *rasterizer_cso_saved;
    struct pipe_query *render_condition, *render_condition_saved;
    uint render_condition_mode, render_condition_mode_saved;
    boolean render_condition_cond, render_condition_cond_saved;
@@ -124,7 +132,7 @@ static boolean delete_blend_state(struct cso_context *ctx, void *state)
 {
    struct cso_blend *cso = (struct cso_blend *)state;
 
-   if (ctx->blend == cso->data)
+   if (ctx->blend == cso->data || cso == ctx->blend_cso_saved)
       return FALSE;
 
    if (cso->delete_state)
@@ -138,7 +146,7 @@ static boolean delete_depth_stencil_state(struct cso_context *ctx, void *state)
    struct cso_depth_stencil_alpha *cso =
       (struct cso_depth_stencil_alpha *)state;
 
-   if (ctx->depth_stencil == cso->data)
+   if (ctx->depth_stencil == cso->data || cso == ctx->depth_stencil_cso_saved)
       return FALSE;
 
    if (cso->delete_state)
@@ -161,7 +169,7 @@ static boolean delete_rasterizer_state(struct cso_context *ctx, void *state)
 {
    struct cso_rasterizer *cso = (struct cso_rasterizer *)state;
 
-   if (ctx->rasterizer == cso->data)
+   if (ctx->rasterizer == cso->data || cso == ctx->rasterizer_cso_saved)
       return FALSE;
    if (cso->delete_state)
       cso->delete_state(cso->context, cso->data);
@@ -386,17 +394,22 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
 {
    unsigned key_size, hash_key;
    struct cso_hash_iter iter;
-   void *handle;
+   struct cso_blend *cso;
 
    key_size = templ->independent_blend_enable ?
       sizeof(struct pipe_blend_state) :
       (char *)&(templ->rt[1]) - (char *)templ;
+
+   if (ctx->blend_cso &&
+       memcmp(&ctx->blend_cso->state, templ, key_size) == 0)
+      return PIPE_OK;
+
    hash_key = cso_construct_key((void*)templ, key_size);
    iter = cso_find_state_template(ctx->cache, hash_key, CSO_BLEND,
                                   (void*)templ, key_size);
 
    if (cso_hash_iter_is_null(iter)) {
-      struct cso_blend *cso = MALLOC(sizeof(struct cso_blend));
+      cso = MALLOC(sizeof(struct cso_blend));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -411,16 +424,15 @@ enum pipe_error cso_set_blend(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
    }
    else {
-      handle = ((struct cso_blend *)cso_hash_iter_data(iter))->data;
+      cso = (struct cso_blend *)cso_hash_iter_data(iter);
    }
 
-   if (ctx->blend != handle) {
-      ctx->blend = handle;
-      ctx->pipe->bind_blend_state(ctx->pipe, handle);
+   ctx->blend_cso = cso;
+   if (ctx->blend != cso->data) {
+      ctx->blend = cso->data;
+      ctx->pipe->bind_blend_state(ctx->pipe, cso->data);
    }
    return PIPE_OK;
 }
@@ -429,6 +441,7 @@ void cso_save_blend(struct cso_context *ctx)
 {
    assert(!ctx->blend_saved);
    ctx->blend_saved = ctx->blend;
+   ctx->blend_cso_saved = ctx->blend_cso;
 }
 
 void cso_restore_blend(struct cso_context *ctx)
@@ -437,7 +450,9 @@ void cso_restore_blend(struct cso_context *ctx)
       ctx->blend = ctx->blend_saved;
       ctx->pipe->bind_blend_state(ctx->pipe, ctx->blend_saved);
    }
+   ctx->blend_cso = ctx->blend_cso_saved;
    ctx->blend_saved = NULL;
+   ctx->blend_cso_saved = NULL;
 }
 
 
@@ -447,16 +462,21 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
                             const struct pipe_depth_stencil_alpha_state *templ)
 {
    unsigned key_size = sizeof(struct pipe_depth_stencil_alpha_state);
-   unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_DEPTH_STENCIL_ALPHA,
-                                                       (void*)templ, key_size);
-   void *handle;
+   unsigned hash_key;
+   struct cso_hash_iter iter;
+   struct cso_depth_stencil_alpha *cso;
+
+   if (ctx->depth_stencil_cso &&
+       memcmp(&ctx->depth_stencil_cso->state, templ, key_size) == 0)
+      return PIPE_OK;
+
+   hash_key = cso_construct_key((void*)templ, key_size);
+   iter = cso_find_state_template(ctx->cache, hash_key,
+                                  CSO_DEPTH_STENCIL_ALPHA,
+                                  (void*)templ, key_size);
 
    if (cso_hash_iter_is_null(iter)) {
-      struct cso_depth_stencil_alpha *cso =
-         MALLOC(sizeof(struct cso_depth_stencil_alpha));
+      cso = MALLOC(sizeof(struct cso_depth_stencil_alpha));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -473,17 +493,15 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
    }
    else {
-      handle = ((struct cso_depth_stencil_alpha *)
-                cso_hash_iter_data(iter))->data;
+      cso = (struct cso_depth_stencil_alpha *)cso_hash_iter_data(iter);
    }
 
-   if (ctx->depth_stencil != handle) {
-      ctx->depth_stencil = handle;
-      ctx->pipe->bind_depth_stencil_alpha_state(ctx->pipe, handle);
+   ctx->depth_stencil_cso = cso;
+   if (ctx->depth_stencil != cso->data) {
+      ctx->depth_stencil = cso->data;
+      ctx->pipe->bind_depth_stencil_alpha_state(ctx->pipe, cso->data);
    }
    return PIPE_OK;
 }
@@ -492,6 +510,7 @@ void cso_save_depth_stencil_alpha(struct cso_context *ctx)
 {
    assert(!ctx->depth_stencil_saved);
    ctx->depth_stencil_saved = ctx->depth_stencil;
+   ctx->depth_stencil_cso_saved = ctx->depth_stencil_cso;
 }
 
 void cso_restore_depth_stencil_alpha(struct cso_context *ctx)
@@ -501,7 +520,9 @@ void cso_restore_depth_stencil_alpha(struct cso_context *ctx)
       ctx->pipe->bind_depth_stencil_alpha_state(ctx->pipe,
                                                 ctx->depth_stencil_saved);
    }
+   ctx->depth_stencil_cso = ctx->depth_stencil_cso_saved;
    ctx->depth_stencil_saved = NULL;
+   ctx->depth_stencil_cso_saved = NULL;
 }
 
 
@@ -510,15 +531,20 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
                                    const struct pipe_rasterizer_state *templ)
 {
    unsigned key_size = sizeof(struct pipe_rasterizer_state);
-   unsigned hash_key = cso_construct_key((void*)templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(ctx->cache,
-                                                       hash_key,
-                                                       CSO_RASTERIZER,
-                                                       (void*)templ, key_size);
-   void *handle = NULL;
+   unsigned hash_key;
+   struct cso_hash_iter iter;
+   struct cso_rasterizer *cso;
+
+   if (ctx->rasterizer_cso &&
+       memcmp(&ctx->rasterizer_cso->state, templ, key_size) == 0)
+      return PIPE_OK;
+
+   hash_key = cso_construct_key((void*)templ, key_size);
+   iter = cso_find_state_template(ctx->cache, hash_key, CSO_RASTERIZER,
+                                  (void*)templ, key_size);
 
    if (cso_hash_iter_is_null(iter)) {
-      struct cso_rasterizer *cso = MALLOC(sizeof(struct cso_rasterizer));
+      cso = MALLOC(sizeof(struct cso_rasterizer));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -533,16 +559,15 @@ enum pipe_error cso_set_rasterizer(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
    }
    else {
-      handle = ((struct cso_rasterizer *)cso_hash_iter_data(iter))->data;
+      cso = (struct cso_rasterizer *)cso_hash_iter_data(iter);
    }
 
-   if (ctx->rasterizer != handle) {
-      ctx->rasterizer = handle;
-      ctx->pipe->bind_rasterizer_state(ctx->pipe, handle);
+   ctx->rasterizer_cso = cso;
+   if (ctx->rasterizer != cso->data) {
+      ctx->rasterizer = cso->data;
+      ctx->pipe->bind_rasterizer_state(ctx->pipe, cso->data);
    }
    return PIPE_OK;
 }
@@ -551,6 +576,7 @@ void cso_save_rasterizer(struct cso_context *ctx)
 {
    assert(!ctx->rasterizer_saved);
    ctx->rasterizer_saved = ctx->rasterizer;
+   ctx->rasterizer_cso_saved = ctx->rasterizer_cso;
 }
 
 void cso_restore_rasterizer(struct cso_context *ctx)
@@ -559,7 +585,9 @@ void cso_restore_rasterizer(struct cso_context *ctx)
       ctx->rasterizer = ctx->rasterizer_saved;
       ctx->pipe->bind_rasterizer_state(ctx->pipe, ctx->rasterizer_saved);
    }
+   ctx->rasterizer_cso = ctx->rasterizer_cso_saved;
    ctx->rasterizer_saved = NULL;
+   ctx->rasterizer_cso_saved = NULL;
 }
 
 
@@ -30,412 +30,320 @@
   *   Zack Rusin <zackr@vmware.com>
   */
 
+/*
+ * Open addressing with linear probing.  Each slot stores the key with the
+ * value, so probing never touches the values, and there's no allocation
+ * per entry.  Removed entries leave a tombstone, unless the probe sequence
+ * ends right after them, so that iterators stay valid across
+ * cso_hash_erase(); tombstones are purged when the table is rehashed.
+ */
+
 #include "util/u_debug.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 
 #include "cso_hash.h"
 
-#ifndef MAX
-#define MAX(a, b) ((a > b) ? (a) : (b))
-#endif
 
-static const int MinNumBits = 4;
+#define MIN_NUM_BITS 4
 
-static const unsigned char prime_deltas[] = {
-   0,  0,  1,  3,  1,  5,  3,  3,  1,  9,  7,  5,  3,  9, 25,  3,
-   1, 21,  3, 21,  7, 15,  9,  5,  3, 29, 15,  0,  0,  0,  0,  0
+enum cso_slot_state {
+   SLOT_EMPTY = 0,
+   SLOT_USED,
+   SLOT_DELETED
 };
 
-static int primeForNumBits(int numBits)
-{
-   return (1 << numBits) + prime_deltas[numBits];
-}
-
-/*
-    Returns the smallest integer n such that
-    primeForNumBits(n) >= hint.
-*/
-static int countBits(int hint)
-{
-   int numBits = 0;
-   int bits = hint;
-
-   while (bits > 1) {
-      bits >>= 1;
-      numBits++;
-   }
-
-   if (numBits >= (int)sizeof(prime_deltas)) {
-      numBits = sizeof(prime_deltas) - 1;
-   } else if (primeForNumBits(numBits) < hint) {
-      ++numBits;
-   }
-   return numBits;
-}
-
-struct cso_node {
-   struct cso_node *next;
+struct cso_slot {
    unsigned key;
+   unsigned state;   /**< enum cso_slot_state */
    void *value;
 };
 
-struct cso_hash_data {
-   struct cso_node *fakeNext;
-   struct cso_node **buckets;
+struct cso_hash {
+   struct cso_slot *slots;
+   int num_bits;
+   int num_slots;   /**< 1 << num_bits, or 0 before the first insert */
    int size;
-   int nodeSize;
-   short userNumBits;
-   short numBits;
-   int numBuckets;
+   int num_deleted;
 };
 
-struct cso_hash {
-   union {
-      struct cso_hash_data *d;
-      struct cso_node      *e;
-   } data;
-};
 
-static void *cso_data_allocate_node(struct cso_hash_data *hash)
+/**
+ * Spread the keys over the table: callers often pass keys which only
+ * differ in a few bits, e.g. layer/level pairs.
+ */
+static inline int
+home_slot(const struct cso_hash *hash, unsigned key)
 {
-   return MALLOC(hash->nodeSize);
+   return (int) ((key * 2654435769u) >> (32 - hash->num_bits));
 }
 
-static void cso_free_node(struct cso_node *node)
+static inline int
+next_slot(const struct cso_hash *hash, int pos)
 {
-   FREE(node);
+   return (pos + 1) & (hash->num_slots - 1);
 }
 
-static struct cso_node *
-cso_hash_create_node(struct cso_hash *hash,
-                      unsigned akey, void *avalue,
-                      struct cso_node **anextNode)
+
+static boolean
+cso_hash_rehash(struct cso_hash *hash, int num_bits)
 {
-   struct cso_node *node = cso_data_allocate_node(hash->data.d);
+   struct cso_slot *old_slots = hash->slots;
+   int old_num_slots = hash->num_slots;
+   int i;
+
+   hash->slots = CALLOC(1 << num_bits, sizeof(struct cso_slot));
+   if (!hash->slots) {
+      hash->slots = old_slots;
+      return FALSE;
+   }
 
-   if (!node)
-      return NULL;
+   hash->num_bits = num_bits;
+   hash->num_slots = 1 << num_bits;
+   hash->num_deleted = 0;
 
-   node->key = akey;
-   node->value = avalue;
+   for (i = 0; i < old_num_slots; i++) {
+      if (old_slots[i].state == SLOT_USED) {
+         int pos = home_slot(hash, old_slots[i].key);
+         while (hash->slots[pos].state != SLOT_EMPTY)
+            pos = next_slot(hash, pos);
+         hash->slots[pos] = old_slots[i];
+      }
+   }
 
-   node->next = (struct cso_node*)(*anextNode);
-   *anextNode = node;
-   ++hash->data.d->size;
-   return node;
+   FREE(old_slots);
+   return TRUE;
 }
 
-static void cso_data_rehash(struct cso_hash_data *hash, int hint)
+
+/**
+ * Keep at least half of the slots empty, so probe sequences stay short.
+ * Purges the tombstones if that's enough, otherwise grows the table.
+ */
+static void
+cso_hash_might_grow(struct cso_hash *hash)
 {
-   if (hint < 0) {
-      hint = countBits(-hint);
-      if (hint < MinNumBits)
-         hint = MinNumBits;
-      hash->userNumBits = (short)hint;
-      while (primeForNumBits(hint) < (hash->size >> 1))
-         ++hint;
-   } else if (hint < MinNumBits) {
-      hint = MinNumBits;
-   }
+   int num_bits;
 
-   if (hash->numBits != hint) {
-      struct cso_node *e = (struct cso_node *)(hash);
-      struct cso_node **oldBuckets = hash->buckets;
-      int oldNumBuckets = hash->numBuckets;
-      int  i = 0;
-
-      hash->numBits = (short)hint;
-      hash->numBuckets = primeForNumBits(hint);
-      hash->buckets = MALLOC(sizeof(struct cso_node*) * hash->numBuckets);
-      for (i = 0; i < hash->numBuckets; ++i)
-         hash->buckets[i] = e;
-
-      for (i = 0; i < oldNumBuckets; ++i) {
-         struct cso_node *firstNode = oldBuckets[i];
-         while (firstNode != e) {
-            unsigned h = firstNode->key;
-            struct cso_node *lastNode = firstNode;
-            struct cso_node *afterLastNode;
-            struct cso_node **beforeFirstNode;
-            
-            while (lastNode->next != e && lastNode->next->key == h)
-               lastNode = lastNode->next;
-
-            afterLastNode = lastNode->next;
-            beforeFirstNode = &hash->buckets[h % hash->numBuckets];
-            while (*beforeFirstNode != e)
-               beforeFirstNode = &(*beforeFirstNode)->next;
-            lastNode->next = *beforeFirstNode;
-            *beforeFirstNode = firstNode;
-            firstNode = afterLastNode;
-         }
-      }
-      FREE(oldBuckets);
-   }
+   if ((hash->size + hash->num_deleted + 1) * 2 <= hash->num_slots)
+      return;
+
+   num_bits = MAX2(hash->num_bits, MIN_NUM_BITS);
+   while ((hash->size + 1) * 4 > (1 << num_bits))
+      num_bits++;
+
+   cso_hash_rehash(hash, num_bits);
 }
 
-static void cso_data_might_grow(struct cso_hash_data *hash)
+
+static void
+cso_hash_has_shrunk(struct cso_hash *hash)
 {
-   if (hash->size >= hash->numBuckets)
-      cso_data_rehash(hash, hash->numBits + 1);
+   if (hash->num_bits > MIN_NUM_BITS &&
+       hash->size <= (hash->num_slots >> 3))
+      cso_hash_rehash(hash, hash->num_bits - 1);
 }
 
-static void cso_data_has_shrunk(struct cso_hash_data *hash)
+
+static void
+cso_hash_remove_slot(struct cso_hash *hash, int pos)
 {
-   if (hash->size <= (hash->numBuckets >> 3) &&
-       hash->numBits > hash->userNumBits) {
-      int max = MAX(hash->numBits-2, hash->userNumBits);
-      cso_data_rehash(hash,  max);
+   struct cso_slot *slot = &hash->slots[pos];
+
+   /* no probe sequence continues past an empty slot */
+   if (hash->slots[next_slot(hash, pos)].state == SLOT_EMPTY) {
+      slot->state = SLOT_EMPTY;
+   }
+   else {
+      slot->state = SLOT_DELETED;
+      hash->num_deleted++;
    }
+   slot->value = NULL;
+   hash->size--;
 }
 
-static struct cso_node *cso_data_first_node(struct cso_hash_data *hash)
+
+/**
+ * Find the next used slot with the given key, starting at pos.
+ */
+static int
+cso_hash_probe(const struct cso_hash *hash, int pos, unsigned key)
 {
-   struct cso_node *e = (struct cso_node *)(hash);
-   struct cso_node **bucket = hash->buckets;
-   int n = hash->numBuckets;
-   while (n--) {
-      if (*bucket != e)
-         return *bucket;
-      ++bucket;
+   for (;;) {
+      const struct cso_slot *slot = &hash->slots[pos];
+
+      if (slot->state == SLOT_EMPTY)
+         return -1;
+      if (slot->state == SLOT_USED && slot->key == key)
+         return pos;
+      pos = next_slot(hash, pos);
    }
-   return e;
 }
 
-static struct cso_node **cso_hash_find_node(struct cso_hash *hash, unsigned akey)
+
+/**
+ * Find the first used slot at or after pos, in table order.
+ */
+static int
+cso_hash_scan(const struct cso_hash *hash, int pos)
 {
-   struct cso_node **node;
-
-   if (hash->data.d->numBuckets) {
-      node = (struct cso_node **)(&hash->data.d->buckets[akey % hash->data.d->numBuckets]);
-      assert(*node == hash->data.e || (*node)->next);
-      while (*node != hash->data.e && (*node)->key != akey)
-         node = &(*node)->next;
-   } else {
-      node = (struct cso_node **)((const struct cso_node * const *)(&hash->data.e));
+   for (; pos < hash->num_slots; pos++) {
+      if (hash->slots[pos].state == SLOT_USED)
+         return pos;
    }
-   return node;
+   return -1;
+}
+
+
+static inline struct cso_hash_iter
+make_iter(struct cso_hash *hash, int pos, boolean same_key)
+{
+   struct cso_hash_iter iter;
+   iter.hash = hash;
+   iter.pos = pos;
+   iter.same_key = same_key;
+   return iter;
 }
 
+
 struct cso_hash_iter cso_hash_insert(struct cso_hash *hash,
                                        unsigned key, void *data)
 {
-   cso_data_might_grow(hash->data.d);
-
-   {
-      struct cso_node **nextNode = cso_hash_find_node(hash, key);
-      struct cso_node *node = cso_hash_create_node(hash, key, data, nextNode);
-      if (!node) {
-         struct cso_hash_iter null_iter = {hash, 0};
-         return null_iter;
-      }
+   struct cso_slot *slot;
+   int pos;
 
-      {
-         struct cso_hash_iter iter = {hash, node};
-         return iter;
-      }
-   }
+   cso_hash_might_grow(hash);
+
+   /* the table may be full if growing failed */
+   if (hash->size + hash->num_deleted >= hash->num_slots - 1)
+      return make_iter(hash, -1, FALSE);
+
+   pos = home_slot(hash, key);
+   while (hash->slots[pos].state == SLOT_USED)
+      pos = next_slot(hash, pos);
+
+   slot = &hash->slots[pos];
+   if (slot->state == SLOT_DELETED)
+      hash->num_deleted--;
+   slot->key = key;
+   slot->state = SLOT_USED;
+   slot->value = data;
+   hash->size++;
+
+   return make_iter(hash, pos, TRUE);
 }
 
 struct cso_hash * cso_hash_create(void)
 {
-   struct cso_hash *hash = MALLOC_STRUCT(cso_hash);
-   if (!hash)
-      return NULL;
-
-   hash->data.d = MALLOC_STRUCT(cso_hash_data);
-   if (!hash->data.d) {
-      FREE(hash);
-      return NULL;
-   }
-
-   hash->data.d->fakeNext = 0;
-   hash->data.d->buckets = 0;
-   hash->data.d->size = 0;
-   hash->data.d->nodeSize = sizeof(struct cso_node);
-   hash->data.d->userNumBits = (short)MinNumBits;
-   hash->data.d->numBits = 0;
-   hash->data.d->numBuckets = 0;
-
-   return hash;
+   return CALLOC_STRUCT(cso_hash);
 }
 
 void cso_hash_delete(struct cso_hash *hash)
 {
-   struct cso_node *e_for_x = (struct cso_node *)(hash->data.d);
-   struct cso_node **bucket = (struct cso_node **)(hash->data.d->buckets);
-   int n = hash->data.d->numBuckets;
-   while (n--) {
-      struct cso_node *cur = *bucket++;
-      while (cur != e_for_x) {
-         struct cso_node *next = cur->next;
-         cso_free_node(cur);
-         cur = next;
-      }
-   }
-   FREE(hash->data.d->buckets);
-   FREE(hash->data.d);
+   FREE(hash->slots);
    FREE(hash);
 }
 
 struct cso_hash_iter cso_hash_find(struct cso_hash *hash,
                                      unsigned key)
 {
-   struct cso_node **nextNode = cso_hash_find_node(hash, key);
-   struct cso_hash_iter iter = {hash, *nextNode};
-   return iter;
+   if (!hash->size)
+      return make_iter(hash, -1, TRUE);
+
+   return make_iter(hash, cso_hash_probe(hash, home_slot(hash, key), key),
+                    TRUE);
 }
 
 unsigned cso_hash_iter_key(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.hash->data.e == iter.node)
+   if (iter.pos < 0)
       return 0;
-   return iter.node->key;
+   return iter.hash->slots[iter.pos].key;
 }
 
 void * cso_hash_iter_data(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.hash->data.e == iter.node)
+   if (iter.pos < 0)
       return 0;
-   return iter.node->value;
+   return iter.hash->slots[iter.pos].value;
 }
 
-static struct cso_node *cso_hash_data_next(struct cso_node *node)
+struct cso_hash_iter cso_hash_iter_next(struct cso_hash_iter iter)
 {
-   union {
-      struct cso_node *next;
-      struct cso_node *e;
-      struct cso_hash_data *d;
-   } a;
-   int start;
-   struct cso_node **bucket;
-   int n;
-
-   a.next = node->next;
-   if (!a.next) {
+   struct cso_hash *hash = iter.hash;
+   int pos;
+
+   if (iter.pos < 0) {
       debug_printf("iterating beyond the last element\n");
-      return 0;
-   }
-   if (a.next->next)
-      return a.next;
-
-   start = (node->key % a.d->numBuckets) + 1;
-   bucket = a.d->buckets + start;
-   n = a.d->numBuckets - start;
-   while (n--) {
-      if (*bucket != a.e)
-         return *bucket;
-      ++bucket;
+      return iter;
    }
-   return a.e;
-}
 
-
-static struct cso_node *cso_hash_data_prev(struct cso_node *node)
-{
-   union {
-      struct cso_node *e;
-      struct cso_hash_data *d;
-   } a;
-   int start;
-   struct cso_node *sentinel;
-   struct cso_node **bucket;
-
-   a.e = node;
-   while (a.e->next)
-      a.e = a.e->next;
-
-   if (node == a.e)
-      start = a.d->numBuckets - 1;
+   if (iter.same_key)
+      pos = cso_hash_probe(hash, next_slot(hash, iter.pos),
+                           hash->slots[iter.pos].key);
    else
-      start = node->key % a.d->numBuckets;
-
-   sentinel = node;
-   bucket = a.d->buckets + start;
-   while (start >= 0) {
-      if (*bucket != sentinel) {
-         struct cso_node *prev = *bucket;
-         while (prev->next != sentinel)
-            prev = prev->next;
-         return prev;
-      }
-
-      sentinel = a.e;
-      --bucket;
-      --start;
-   }
-   debug_printf("iterating backward beyond first element\n");
-   return a.e;
-}
+      pos = cso_hash_scan(hash, iter.pos + 1);
 
-struct cso_hash_iter cso_hash_iter_next(struct cso_hash_iter iter)
-{
-   struct cso_hash_iter next = {iter.hash, cso_hash_data_next(iter.node)};
-   return next;
+   return make_iter(hash, pos, iter.same_key);
 }
 
 int cso_hash_iter_is_null(struct cso_hash_iter iter)
 {
-   if (!iter.node || iter.node == iter.hash->data.e)
-      return 1;
-   return 0;
+   return iter.pos < 0;
 }
 
 void * cso_hash_take(struct cso_hash *hash,
                       unsigned akey)
 {
-   struct cso_node **node = cso_hash_find_node(hash, akey);
-   if (*node != hash->data.e) {
-      void *t = (*node)->value;
-      struct cso_node *next = (*node)->next;
-      cso_free_node(*node);
-      *node = next;
-      --hash->data.d->size;
-      cso_data_has_shrunk(hash->data.d);
-      return t;
-   }
-   return 0;
+   struct cso_hash_iter iter = cso_hash_find(hash, akey);
+   void *value;
+
+   if (iter.pos < 0)
+      return 0;
+
+   value = hash->slots[iter.pos].value;
+   cso_hash_remove_slot(hash, iter.pos);
+   cso_hash_has_shrunk(hash);
+   return value;
 }
 
 struct cso_hash_iter cso_hash_iter_prev(struct cso_hash_iter iter)
 {
-   struct cso_hash_iter prev = {iter.hash,
-                                 cso_hash_data_prev(iter.node)};
-   return prev;
+   struct cso_hash *hash = iter.hash;
+   int pos = iter.pos < 0 ? hash->num_slots : iter.pos;
+
+   while (--pos >= 0) {
+      if (hash->slots[pos].state == SLOT_USED)
+         return make_iter(hash, pos, FALSE);
+   }
+
+   debug_printf("iterating backward beyond first element\n");
+   return make_iter(hash, -1, FALSE);
 }
 
 struct cso_hash_iter cso_hash_first_node(struct cso_hash *hash)
 {
-   struct cso_hash_iter iter = {hash, cso_data_first_node(hash->data.d)};
-   return iter;
+   return make_iter(hash, cso_hash_scan(hash, 0), FALSE);
 }
 
 int cso_hash_size(struct cso_hash *hash)
 {
-   return hash->data.d->size;
+   return hash->size;
 }
 
 struct cso_hash_iter cso_hash_erase(struct cso_hash *hash, struct cso_hash_iter iter)
 {
-   struct cso_hash_iter ret = iter;
-   struct cso_node *node = iter.node;
-   struct cso_node **node_ptr;
+   struct cso_hash_iter next;
 
-   if (node == hash->data.e)
+   if (iter.pos < 0)
       return iter;
 
-   ret = cso_hash_iter_next(ret);
-   node_ptr = (struct cso_node**)(&hash->data.d->buckets[node->key % hash->data.d->numBuckets]);
-   while (*node_ptr != node)
-      node_ptr = &(*node_ptr)->next;
-   *node_ptr = node->next;
-   cso_free_node(node);
-   --hash->data.d->size;
-   return ret;
+   next = cso_hash_iter_next(iter);
+   cso_hash_remove_slot(hash, iter.pos);
+   return next;
 }
 
 boolean cso_hash_contains(struct cso_hash *hash, unsigned key)
 {
-   struct cso_node **node = cso_hash_find_node(hash, key);
-   return (*node != hash->data.e);
+   return !cso_hash_iter_is_null(cso_hash_find(hash, key));
 }
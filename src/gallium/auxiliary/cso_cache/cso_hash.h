@@ -30,13 +30,13 @@
  * Hash table implementation.
  * 
  * This file provides a hash implementation that is capable of dealing
- * with collisions. It stores colliding entries in linked list. All
+ * with collisions. Several entries may be stored with the same key. All
  * functions operating on the hash return an iterator. The iterator
- * itself points to the collision list. If there wasn't any collision
- * the list will have just one entry, otherwise client code should
- * iterate over the entries to find the exact entry among ones that
- * had the same key (e.g. memcmp could be used on the data to check
- * that)
+ * returned by cso_hash_find() walks the entries with that key only;
+ * client code should iterate over them to find the exact entry among
+ * ones that had the same key (e.g. memcmp could be used on the data to
+ * check that). The iterator returned by cso_hash_first_node() walks all
+ * the entries.
  * 
  * @author Zack Rusin <zackr@vmware.com>
  */
@@ -52,12 +52,12 @@ extern "C" {
 
 
 struct cso_hash;
-struct cso_node;
 
 
 struct cso_hash_iter {
    struct cso_hash *hash;
-   struct cso_node  *node;
+   int pos;             /**< slot index, negative for the null iterator */
+   boolean same_key;    /**< only visit entries with this entry's key */
 };
 
 
@@ -70,8 +70,7 @@ int              cso_hash_size(struct cso_hash *hash);
 
 /**
  * Adds a data with the given key to the hash. If entry with the given
- * key is already in the hash, this current entry is instered before it
- * in the collision list.
+ * key is already in the hash, both are kept.
  * Function returns iterator pointing to the inserted item in the hash.
  */
 struct cso_hash_iter cso_hash_insert(struct cso_hash *hash, unsigned key,
@@ -92,7 +91,7 @@ void  *cso_hash_take(struct cso_hash *hash, unsigned key);
 struct cso_hash_iter cso_hash_first_node(struct cso_hash *hash);
 
 /**
- * Return an iterator pointing to the first entry in the collision list.
+ * Return an iterator pointing to the first entry with the given key.
  */
 struct cso_hash_iter cso_hash_find(struct cso_hash *hash, unsigned key);
 
@@ -112,7 +111,7 @@ struct cso_hash_iter cso_hash_iter_prev(struct cso_hash_iter iter);
 
 
 /**
- * Convenience routine to iterate over the collision list while doing a memory
+ * Convenience routine to iterate over the entries with the key while doing a memory
  * comparison to see which entry in the list is a direct copy of our template
  * and returns that entry.
  */
@@ -1111,3 +1111,33 @@ draw_will_inject_frontface(const struct draw_context *draw)
            (rast->fill_front != PIPE_POLYGON_MODE_FILL ||
             rast->fill_back != PIPE_POLYGON_MODE_FILL));
 }
+
+
+/**
+ * Return the number of indices consumed and vertices shaded, which tells
+ * how well the draw module reuses post-transform vertices.
+ */
+void
+draw_get_vertex_stats(const struct draw_context *draw,
+                      struct draw_vertex_stats *stats)
+{
+   stats->indices = draw->pt.vertex_stats.indices;
+   stats->shaded = draw->pt.vertex_stats.shaded;
+}
+
+
+/**
+ * Accumulate the JIT variant cache statistics of the vertex and geometry
+ * shader stages into stats.
+ */
+void
+draw_get_variant_cache_stats(const struct draw_context *draw,
+                             struct lp_variant_cache_stats *stats)
+{
+#ifdef HAVE_LLVM
+   if (draw->llvm) {
+      lp_variant_cache_add_stats(&draw->llvm->vs_variant_cache, stats);
+      lp_variant_cache_add_stats(&draw->llvm->gs_variant_cache, stats);
+   }
+#endif
+}
@@ -296,4 +296,23 @@ draw_get_shader_param_no_llvm(unsigned shader, enum pipe_shader_cap param);
 boolean
 draw_get_option_use_llvm(void);
 
+struct lp_variant_cache_stats;
+
+void
+draw_get_variant_cache_stats(const struct draw_context *draw,
+                             struct lp_variant_cache_stats *stats);
+
+/**
+ * Number of vertex indices consumed and of vertices actually run through
+ * the vertex shader since the context was created.
+ */
+struct draw_vertex_stats {
+   uint64_t indices;
+   uint64_t shaded;
+};
+
+void
+draw_get_vertex_stats(const struct draw_context *draw,
+                      struct draw_vertex_stats *stats);
+
 #endif /* DRAW_CONTEXT_H */
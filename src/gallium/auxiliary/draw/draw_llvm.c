@@ -50,6 +50,7 @@
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
 
 #include "util/u_math.h"
 #include "util/u_pointer.h"
@@ -505,11 +506,12 @@ draw_llvm_create(struct draw_context *draw, LLVMContextRef context)
    if (!llvm->context)
       goto fail;
 
-   llvm->nr_variants = 0;
-   make_empty_list(&llvm->vs_variants_list);
-
-   llvm->nr_gs_variants = 0;
-   make_empty_list(&llvm->gs_variants_list);
+   lp_variant_cache_init(&llvm->vs_variant_cache,
+                         DRAW_MAX_SHADER_VARIANTS,
+                         DRAW_MAX_SHADER_CODE_SIZE);
+   lp_variant_cache_init(&llvm->gs_variant_cache,
+                         DRAW_MAX_SHADER_VARIANTS,
+                         DRAW_MAX_SHADER_CODE_SIZE);
 
    return llvm;
 
@@ -545,6 +547,7 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    struct draw_llvm_variant *variant;
    struct llvm_vertex_shader *shader =
       llvm_vertex_shader(llvm->draw->vs.vertex_shader);
+   const struct tgsi_token *tokens = llvm->draw->vs.vertex_shader->state.tokens;
    LLVMTypeRef vertex_header;
    char module_name[64];
 
@@ -566,6 +569,11 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
+   gallivm_add_cache_key(variant->gallivm, key, shader->variant_key_size);
+   gallivm_add_cache_key(variant->gallivm, tokens,
+                         tgsi_num_tokens(tokens) * sizeof *tokens);
+   gallivm_add_cache_key(variant->gallivm, &num_inputs, sizeof num_inputs);
+
    if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
       tgsi_dump(llvm->draw->vs.vertex_shader->state.tokens, 0);
       draw_llvm_dump_variant_key(&variant->key);
@@ -588,10 +596,8 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    gallivm_free_ir(variant->gallivm);
 
-   variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    /*variant->no = */shader->variants_created++;
-   variant->list_item_global.base = variant;
 
    return variant;
 }
@@ -2006,8 +2012,7 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
 
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
-   remove_from_list(&variant->list_item_global);
-   llvm->nr_variants--;
+   lp_variant_cache_remove(&llvm->vs_variant_cache, &variant->cache_entry);
    FREE(variant);
 }
 
@@ -2218,6 +2223,7 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    struct draw_gs_llvm_variant *variant;
    struct llvm_geometry_shader *shader =
       llvm_geometry_shader(llvm->draw->gs.geometry_shader);
+   const struct tgsi_token *tokens = llvm->draw->gs.geometry_shader->state.tokens;
    LLVMTypeRef vertex_header;
    char module_name[64];
 
@@ -2239,6 +2245,11 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
+   gallivm_add_cache_key(variant->gallivm, key, shader->variant_key_size);
+   gallivm_add_cache_key(variant->gallivm, tokens,
+                         tgsi_num_tokens(tokens) * sizeof *tokens);
+   gallivm_add_cache_key(variant->gallivm, &num_outputs, sizeof num_outputs);
+
    vertex_header = create_jit_vertex_header(variant->gallivm, num_outputs);
 
    variant->vertex_header_ptr_type = LLVMPointerType(vertex_header, 0);
@@ -2252,10 +2263,8 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
 
    gallivm_free_ir(variant->gallivm);
 
-   variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    /*variant->no = */shader->variants_created++;
-   variant->list_item_global.base = variant;
 
    return variant;
 }
@@ -2269,8 +2278,7 @@ draw_gs_llvm_destroy_variant(struct draw_gs_llvm_variant *variant)
 
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
-   remove_from_list(&variant->list_item_global);
-   llvm->nr_gs_variants--;
+   lp_variant_cache_remove(&llvm->gs_variant_cache, &variant->cache_entry);
    FREE(variant);
 }
 
@@ -35,6 +35,7 @@
 
 #include "gallivm/lp_bld_sample.h"
 #include "gallivm/lp_bld_limits.h"
+#include "gallivm/lp_bld_variant_cache.h"
 
 #include "pipe/p_context.h"
 #include "util/simple_list.h"
@@ -407,7 +408,7 @@ struct draw_llvm_variant
    struct llvm_vertex_shader *shader;
 
    struct draw_llvm *llvm;
-   struct draw_llvm_variant_list_item list_item_global;
+   struct lp_variant_cache_entry cache_entry;
    struct draw_llvm_variant_list_item list_item_local;
 
    /* key is variable-sized, must be last */
@@ -433,7 +434,7 @@ struct draw_gs_llvm_variant
    struct llvm_geometry_shader *shader;
 
    struct draw_llvm *llvm;
-   struct draw_gs_llvm_variant_list_item list_item_global;
+   struct lp_variant_cache_entry cache_entry;
    struct draw_gs_llvm_variant_list_item list_item_local;
 
    /* key is variable-sized, must be last */
@@ -468,11 +469,8 @@ struct draw_llvm {
    struct draw_jit_context jit_context;
    struct draw_gs_jit_context gs_jit_context;
 
-   struct draw_llvm_variant_list_item vs_variants_list;
-   int nr_variants;
-
-   struct draw_gs_llvm_variant_list_item gs_variants_list;
-   int nr_gs_variants;
+   struct lp_variant_cache vs_variant_cache;
+   struct lp_variant_cache gs_variant_cache;
 };
 
 
@@ -32,9 +32,11 @@
  */
 
 
+#include "util/u_cpu_detect.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 
+#include "pipe/p_config.h"
 #include "pipe/p_shader_tokens.h"
 
 #include "draw_vs.h"
@@ -42,6 +44,10 @@
 #include "draw_fs.h"
 #include "draw_gs.h"
 
+#if defined(PIPE_ARCH_SSE)
+#include <xmmintrin.h>
+#endif
+
 
 /** Set to 1 to enable printing of coords before/after clipping */
 #define DEBUG_CLIP 0
@@ -66,6 +72,9 @@ struct clip_stage {
    boolean noperspective_attribs[PIPE_MAX_SHADER_OUTPUTS];
 
    float (*plane)[4];
+
+   /* Classify and interpolate four floats at a time */
+   boolean use_sse;
 };
 
 
@@ -123,6 +132,24 @@ static void copy_flat( struct draw_stage *stage,
    }
 }
 
+#if defined(PIPE_ARCH_SSE)
+
+/* Same as interp_attr(), with the same rounding.
+ */
+static inline void interp_attr_sse( float dst[4],
+                                    __m128 t,
+                                    const float in[4],
+                                    const float out[4] )
+{
+   const __m128 o = _mm_loadu_ps(out);
+   const __m128 i = _mm_loadu_ps(in);
+
+   _mm_storeu_ps(dst, _mm_add_ps(o, _mm_mul_ps(t, _mm_sub_ps(i, o))));
+}
+
+#endif
+
+
 /* Interpolate between two vertices to produce a third.  
  */
 static void interp( const struct clip_stage *clip,
@@ -195,6 +222,22 @@ static void interp( const struct clip_stage *clip,
 
    /* Other attributes
     */
+#if defined(PIPE_ARCH_SSE)
+   if (clip->use_sse) {
+      const __m128 vt = _mm_set1_ps(t);
+      const __m128 vt_nopersp = _mm_set1_ps(t_nopersp);
+
+      for (j = 0; j < nr_attrs; j++) {
+         if (j != pos_attr && j != clip_attr) {
+            interp_attr_sse(dst->data[j],
+                            clip->noperspective_attribs[j] ? vt_nopersp : vt,
+                            in->data[j], out->data[j]);
+         }
+      }
+      return;
+   }
+#endif
+
    for (j = 0; j < nr_attrs; j++) {
       if (j != pos_attr && j != clip_attr) {
          if (clip->noperspective_attribs[j])
@@ -355,6 +398,57 @@ static inline float getclipdist(const struct clip_stage *clipper,
    return dp;
 }
 
+/*
+ * Compute the clip distances of n vertices for one plane.  The dot
+ * products are done four vertices at a time (transposed to x/y/z/w
+ * vectors), summing in the same order as dot4() so the results match.
+ */
+static void
+getclipdists(const struct clip_stage *clipper,
+             struct vertex_header **verts,
+             unsigned n,
+             int plane_idx,
+             float *dist)
+{
+   const float *plane = clipper->plane[plane_idx];
+   unsigned i = 0;
+
+#if defined(PIPE_ARCH_SSE)
+   if (clipper->use_sse) {
+      const __m128 px = _mm_set1_ps(plane[0]);
+      const __m128 py = _mm_set1_ps(plane[1]);
+      const __m128 pz = _mm_set1_ps(plane[2]);
+      const __m128 pw = _mm_set1_ps(plane[3]);
+
+      for (; i + 4 <= n; i += 4) {
+         __m128 x = _mm_loadu_ps(verts[i + 0]->clip);
+         __m128 y = _mm_loadu_ps(verts[i + 1]->clip);
+         __m128 z = _mm_loadu_ps(verts[i + 2]->clip);
+         __m128 w = _mm_loadu_ps(verts[i + 3]->clip);
+         __m128 dp;
+
+         _MM_TRANSPOSE4_PS(x, y, z, w);
+
+         dp = _mm_add_ps(_mm_mul_ps(x, px), _mm_mul_ps(y, py));
+         dp = _mm_add_ps(dp, _mm_mul_ps(z, pz));
+         dp = _mm_add_ps(dp, _mm_mul_ps(w, pw));
+         _mm_storeu_ps(dist + i, dp);
+      }
+   }
+#endif
+
+   for (; i < n; i++)
+      dist[i] = dot4(verts[i]->clip, plane);
+
+   /* shader-provided clip distances */
+   if (plane_idx >= 6) {
+      for (i = 0; i < n; i++) {
+         if (verts[i]->have_clipdist)
+            dist[i] = getclipdist(clipper, verts[i], plane_idx);
+      }
+   }
+}
+
 /* Clip a triangle against the viewport and user clip planes.
  */
 static void
@@ -374,6 +468,7 @@ do_clip_tri( struct draw_stage *stage,
    boolean bEdges[MAX_CLIPPED_VERTICES];
    boolean *inEdges = aEdges;
    boolean *outEdges = bEdges;
+   float dist[MAX_CLIPPED_VERTICES + 1];
    int viewport_index = 0;
 
    inlist[0] = header->v[0];
@@ -412,26 +507,28 @@ do_clip_tri( struct draw_stage *stage,
       float dp_prev;
       unsigned outcount = 0;
 
-      dp_prev = getclipdist(clipper, vert_prev, plane_idx);
       clipmask &= ~(1<<plane_idx);
 
-      if (util_is_inf_or_nan(dp_prev))
-         return; //discard nan
-
       assert(n < MAX_CLIPPED_VERTICES);
       if (n >= MAX_CLIPPED_VERTICES)
          return;
       inlist[n] = inlist[0]; /* prevent rotation of vertices */
       inEdges[n] = inEdges[0];
 
+      /* classify all the vertices up front */
+      getclipdists(clipper, inlist, n, plane_idx, dist);
+      for (i = 0; i < n; i++) {
+         if (util_is_inf_or_nan(dist[i]))
+            return; //discard nan
+      }
+      dist[n] = dist[0];
+      dp_prev = dist[0];
+
       for (i = 1; i <= n; i++) {
 	 struct vertex_header *vert = inlist[i];
          boolean *edge = &inEdges[i];
 
-         float dp = getclipdist(clipper, vert, plane_idx);
-
-         if (util_is_inf_or_nan(dp))
-            return; //discard nan
+         float dp = dist[i];
 
 	 if (dp_prev >= 0.0f) {
             assert(outcount < MAX_CLIPPED_VERTICES);
@@ -882,6 +979,10 @@ struct draw_stage *draw_clip_stage( struct draw_context *draw )
 
    clipper->plane = draw->plane;
 
+#if defined(PIPE_ARCH_SSE)
+   clipper->use_sse = util_cpu_caps.has_sse;
+#endif
+
    if (!draw_alloc_temp_verts( &clipper->stage, MAX_CLIPPED_VERTICES+1 ))
       goto fail;
 
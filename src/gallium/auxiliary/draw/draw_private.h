@@ -104,6 +104,9 @@ struct vertex_header {
 /* maximum number of shader variants we can cache */
 #define DRAW_MAX_SHADER_VARIANTS 128
 
+/* maximum amount of JIT code, in bytes, kept per shader stage */
+#define DRAW_MAX_SHADER_CODE_SIZE (16*1024*1024)
+
 /**
  * Private context for the drawing module.
  */
@@ -170,6 +173,15 @@ struct draw_context
          struct draw_pt_front_end *vsplit;
       } front;
 
+      /** post-transform vertex cache, NULL if disabled */
+      struct pt_vcache *vcache;
+
+      /** indices consumed and vertices shaded, see draw_get_vertex_stats() */
+      struct {
+         uint64_t indices;
+         uint64_t shaded;
+      } vertex_stats;
+
       struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
       unsigned nr_vertex_buffers;
 
@@ -146,8 +146,16 @@ draw_pt_arrays(struct draw_context *draw,
       draw->pt.rebind_parameters = FALSE;
    }
 
+   /* vertices shaded for an earlier draw may be stale */
+   if (draw->pt.vcache)
+      draw_pt_vcache_invalidate( draw->pt.vcache );
+
    frontend->run( frontend, start, count );
 
+   /* vertex buffers, instance id etc. may change after we return */
+   if (middle->sync)
+      middle->sync( middle );
+
    return TRUE;
 }
 
@@ -179,6 +187,8 @@ boolean draw_pt_init( struct draw_context *draw )
    if (!draw->pt.front.vsplit)
       return FALSE;
 
+   draw->pt.vcache = draw_pt_vcache_create(draw);
+
    draw->pt.middle.fetch_emit = draw_pt_fetch_emit( draw );
    if (!draw->pt.middle.fetch_emit)
       return FALSE;
@@ -226,6 +236,11 @@ void draw_pt_destroy( struct draw_context *draw )
       draw->pt.front.vsplit->destroy( draw->pt.front.vsplit );
       draw->pt.front.vsplit = NULL;
    }
+
+   if (draw->pt.vcache) {
+      draw_pt_vcache_destroy( draw->pt.vcache );
+      draw->pt.vcache = NULL;
+   }
 }
 
 
@@ -124,6 +124,12 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)( struct draw_pt_middle_end * );
 
+   /* Optional: wait until all vertices passed to run*() have been
+    * emitted.  Middle ends which defer work must do so before
+    * draw_pt_arrays() returns.
+    */
+   void (*sync)( struct draw_pt_middle_end * );
+
    void (*finish)( struct draw_pt_middle_end * );
    void (*destroy)( struct draw_pt_middle_end * );
 };
@@ -242,6 +248,33 @@ struct pt_post_vs *draw_pt_post_vs_create( struct draw_context *draw );
 void draw_pt_post_vs_destroy( struct pt_post_vs *pvs );
 
 
+/*******************************************************************************
+ * Post-transform vertex cache (optional, see draw_pt_vcache.c)
+ */
+struct pt_vcache;
+
+unsigned draw_pt_vcache_lookup( struct pt_vcache *vcache,
+                                unsigned vertex_size,
+                                const unsigned *fetch_elts,
+                                unsigned count,
+                                struct vertex_header *verts,
+                                unsigned *miss_elts,
+                                unsigned *miss_pos,
+                                unsigned *clipmask );
+
+void draw_pt_vcache_insert( struct pt_vcache *vcache,
+                            unsigned vertex_size,
+                            const unsigned *elts,
+                            const struct vertex_header *verts,
+                            unsigned count );
+
+void draw_pt_vcache_invalidate( struct pt_vcache *vcache );
+
+struct pt_vcache *draw_pt_vcache_create( struct draw_context *draw );
+
+void draw_pt_vcache_destroy( struct pt_vcache *vcache );
+
+
 /*******************************************************************************
  * Utils: 
  */
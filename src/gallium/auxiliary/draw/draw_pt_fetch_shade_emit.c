@@ -279,6 +279,9 @@ fse_run(struct draw_pt_middle_end *middle,
                           fetch_count,
                           hw_verts );
 
+   draw->pt.vertex_stats.indices += draw_count;
+   draw->pt.vertex_stats.shaded += fetch_count;
+
    if (0) {
       unsigned i;
       for (i = 0; i < fetch_count; i++) {
@@ -338,6 +341,9 @@ fse_run_linear_elts(struct draw_pt_middle_end *middle,
                             start, count,
                             hw_verts );
 
+   draw->pt.vertex_stats.indices += draw_count;
+   draw->pt.vertex_stats.shaded += count;
+
    draw->render->draw_elements( draw->render,
                                 draw_elts,
                                 draw_count );
@@ -226,6 +226,87 @@ draw_vertex_shader_run(struct draw_vertex_shader *vshader,
 }
 
 
+/**
+ * Fetch and shade through the post-transform vertex cache: only the
+ * vertices which aren't cached yet are fetched and shaded.
+ * \return FALSE if out of memory
+ */
+static boolean
+fetch_shade_cached(struct fetch_pipeline_middle_end *fpme,
+                   const struct draw_fetch_info *fetch_info,
+                   struct draw_vertex_info *vs_vert_info)
+{
+   struct draw_context *draw = fpme->draw;
+   struct pt_vcache *vcache = draw->pt.vcache;
+   const unsigned vertex_size = fpme->vertex_size;
+   struct draw_fetch_info miss_fetch_info;
+   struct draw_vertex_info fetched_vert_info;
+   struct draw_vertex_info shaded_vert_info;
+   unsigned *miss_elts, *miss_pos;
+   unsigned clipmask;
+   unsigned misses, i;
+
+   miss_elts = MALLOC(2 * fetch_info->count * sizeof(unsigned));
+   vs_vert_info->count = fetch_info->count;
+   vs_vert_info->vertex_size = vertex_size;
+   vs_vert_info->stride = vertex_size;
+   vs_vert_info->verts =
+      (struct vertex_header *)MALLOC(vertex_size *
+                                     align(fetch_info->count, 4));
+   if (!miss_elts || !vs_vert_info->verts) {
+      FREE(miss_elts);
+      FREE(vs_vert_info->verts);
+      return FALSE;
+   }
+   miss_pos = miss_elts + fetch_info->count;
+
+   misses = draw_pt_vcache_lookup(vcache, vertex_size,
+                                  fetch_info->elts, fetch_info->count,
+                                  vs_vert_info->verts,
+                                  miss_elts, miss_pos, &clipmask);
+
+   if (misses) {
+      fetched_vert_info.count = misses;
+      fetched_vert_info.vertex_size = vertex_size;
+      fetched_vert_info.stride = vertex_size;
+      fetched_vert_info.verts =
+         (struct vertex_header *)MALLOC(vertex_size * align(misses, 4));
+      if (!fetched_vert_info.verts) {
+         FREE(miss_elts);
+         FREE(vs_vert_info->verts);
+         return FALSE;
+      }
+
+      miss_fetch_info = *fetch_info;
+      miss_fetch_info.elts = miss_elts;
+      miss_fetch_info.count = misses;
+      fetch( fpme->fetch, &miss_fetch_info, (char *)fetched_vert_info.verts );
+
+      draw_vertex_shader_run(draw->vs.vertex_shader,
+                             draw->pt.user.vs_constants,
+                             draw->pt.user.vs_constants_size,
+                             &fetched_vert_info,
+                             &shaded_vert_info);
+      FREE(fetched_vert_info.verts);
+
+      for (i = 0; i < misses; i++) {
+         memcpy((char *)vs_vert_info->verts + miss_pos[i] * vertex_size,
+                (const char *)shaded_vert_info.verts + i * vertex_size,
+                vertex_size);
+      }
+
+      draw_pt_vcache_insert(vcache, vertex_size, miss_elts,
+                            shaded_vert_info.verts, misses);
+      FREE(shaded_vert_info.verts);
+   }
+
+   draw->pt.vertex_stats.shaded += misses;
+
+   FREE(miss_elts);
+   return TRUE;
+}
+
+
 static void
 fetch_pipeline_generic(struct draw_pt_middle_end *middle,
                        const struct draw_fetch_info *fetch_info,
@@ -246,46 +327,56 @@ fetch_pipeline_generic(struct draw_pt_middle_end *middle,
    boolean free_prim_info = FALSE;
    unsigned opt = fpme->opt;
 
-   fetched_vert_info.count = fetch_info->count;
-   fetched_vert_info.vertex_size = fpme->vertex_size;
-   fetched_vert_info.stride = fpme->vertex_size;
-   fetched_vert_info.verts =
-      (struct vertex_header *)MALLOC(fpme->vertex_size *
-                                     align(fetch_info->count,  4));
-   if (!fetched_vert_info.verts) {
-      assert(0);
-      return;
-   }
    if (draw->collect_statistics) {
       draw->statistics.ia_vertices += prim_info->count;
       draw->statistics.ia_primitives +=
          u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
       draw->statistics.vs_invocations += fetch_info->count;
    }
+   draw->pt.vertex_stats.indices += prim_info->count;
 
-   /* Fetch into our vertex buffer.
-    */
-   fetch( fpme->fetch, fetch_info, (char *)fetched_vert_info.verts );
+   if (draw->pt.vcache && !fetch_info->linear && (fpme->opt & PT_SHADE) &&
+       fetch_shade_cached(fpme, fetch_info, &vs_vert_info)) {
+      vert_info = &vs_vert_info;
+   }
+   else {
+      fetched_vert_info.count = fetch_info->count;
+      fetched_vert_info.vertex_size = fpme->vertex_size;
+      fetched_vert_info.stride = fpme->vertex_size;
+      fetched_vert_info.verts =
+         (struct vertex_header *)MALLOC(fpme->vertex_size *
+                                        align(fetch_info->count,  4));
+      if (!fetched_vert_info.verts) {
+         assert(0);
+         return;
+      }
 
-   /* Finished with fetch:
-    */
-   fetch_info = NULL;
-   vert_info = &fetched_vert_info;
+      /* Fetch into our vertex buffer.
+       */
+      fetch( fpme->fetch, fetch_info, (char *)fetched_vert_info.verts );
 
-   /* Run the shader, note that this overwrites the data[] parts of
-    * the pipeline verts.
-    */
-   if (fpme->opt & PT_SHADE) {
-      draw_vertex_shader_run(vshader,
-                             draw->pt.user.vs_constants,
-                             draw->pt.user.vs_constants_size,
-                             vert_info,
-                             &vs_vert_info);
+      vert_info = &fetched_vert_info;
 
-      FREE(vert_info->verts);
-      vert_info = &vs_vert_info;
+      /* Run the shader, note that this overwrites the data[] parts of
+       * the pipeline verts.
+       */
+      if (fpme->opt & PT_SHADE) {
+         draw_vertex_shader_run(vshader,
+                                draw->pt.user.vs_constants,
+                                draw->pt.user.vs_constants_size,
+                                vert_info,
+                                &vs_vert_info);
+
+         FREE(vert_info->verts);
+         vert_info = &vs_vert_info;
+         draw->pt.vertex_stats.shaded += fetch_info->count;
+      }
    }
 
+   /* Finished with fetch:
+    */
+   fetch_info = NULL;
+
    if ((fpme->opt & PT_SHADE) && gshader) {
       draw_geometry_shader_run(gshader,
                                draw->pt.user.gs_constants,
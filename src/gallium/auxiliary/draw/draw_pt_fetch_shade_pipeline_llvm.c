@@ -25,9 +25,13 @@
  *
  **************************************************************************/
 
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "os/os_thread.h"
+#include "os/os_time.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_vbuf.h"
@@ -39,6 +43,39 @@
 #include "gallivm/lp_bld_init.h"
 
 
+/** Upper limit for DRAW_NUM_THREADS */
+#define LLVM_MAX_THREADS 8
+
+/** Number of segments which may be in flight at once */
+#define LLVM_MAX_SEGMENTS 16
+
+
+enum llvm_segment_state {
+   LLVM_SEGMENT_QUEUED,
+   LLVM_SEGMENT_RUNNING,
+   LLVM_SEGMENT_DONE
+};
+
+
+/**
+ * A segment (one middle end run) whose fetch and vertex shading may be
+ * done by a worker thread.  The element lists are copies, as the front
+ * end reuses its buffers for the next segment.
+ */
+struct llvm_segment {
+   struct draw_llvm_variant *variant;
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   unsigned primitive_length;
+   unsigned *fetch_elts;
+   ushort *draw_elts;
+
+   struct draw_vertex_info vert_info;
+   unsigned clipped;
+   int state;  /**< enum llvm_segment_state */
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -56,6 +93,21 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /*
+    * Segments are shaded by the worker threads in any order but retired
+    * (clipped, emitted, ...) by the application thread in the order they
+    * were queued.  segments[first..last) are in flight, segments[next..last)
+    * haven't been picked up for shading yet.
+    */
+   unsigned num_threads;
+   pipe_thread threads[LLVM_MAX_THREADS];
+   pipe_mutex mutex;
+   pipe_condvar change;  /**< segment queued, segment shaded or shutdown */
+   boolean exit;
+
+   struct llvm_segment segments[LLVM_MAX_SEGMENTS];
+   unsigned first, next, last;
 };
 
 
@@ -67,6 +119,20 @@ llvm_middle_end(struct draw_pt_middle_end *middle)
 }
 
 
+static void
+evict_vs_variant(void *variant, void *data)
+{
+   draw_llvm_destroy_variant((struct draw_llvm_variant *) variant);
+}
+
+
+static void
+evict_gs_variant(void *variant, void *data)
+{
+   draw_gs_llvm_destroy_variant((struct draw_gs_llvm_variant *) variant);
+}
+
+
 static void
 llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
 {
@@ -77,7 +143,6 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
    struct draw_gs_llvm_variant_list_item *li;
    struct llvm_geometry_shader *shader = llvm_geometry_shader(gs);
    char store[DRAW_GS_LLVM_MAX_VARIANT_KEY_SIZE];
-   unsigned i;
 
    key = draw_gs_llvm_make_variant_key(fpme->llvm, store);
 
@@ -92,39 +157,36 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
    }
 
    if (variant) {
-      /* found the variant, move to head of global list (for LRU) */
-      move_to_head(&fpme->llvm->gs_variants_list,
-                   &variant->list_item_global);
+      /* found the variant, mark it as recently used */
+      lp_variant_cache_hit(&fpme->llvm->gs_variant_cache,
+                           &variant->cache_entry);
    }
    else {
       /* Need to create new variant */
+      int64_t t0, t1;
 
-      /* First check if we've created too many variants.  If so, free
-       * 25% of the LRU to avoid using too much memory.
+      /* First check if we've created too many variants.  If so, evict
+       * the ones which are cheapest to rebuild to avoid using too much
+       * memory.
        */
-      if (fpme->llvm->nr_gs_variants >= DRAW_MAX_SHADER_VARIANTS) {
+      if (lp_variant_cache_full(&fpme->llvm->gs_variant_cache)) {
          /*
           * XXX: should we flush here ?
           */
-         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 4; i++) {
-            struct draw_gs_llvm_variant_list_item *item;
-            if (is_empty_list(&fpme->llvm->gs_variants_list)) {
-               break;
-            }
-            item = last_elem(&fpme->llvm->gs_variants_list);
-            assert(item);
-            assert(item->base);
-            draw_gs_llvm_destroy_variant(item->base);
-         }
+         lp_variant_cache_evict(&fpme->llvm->gs_variant_cache,
+                                evict_gs_variant, NULL);
       }
 
+      t0 = os_time_get();
       variant = draw_gs_llvm_create_variant(fpme->llvm, gs->info.num_outputs, key);
+      t1 = os_time_get();
 
       if (variant) {
          insert_at_head(&shader->variants, &variant->list_item_local);
-         insert_at_head(&fpme->llvm->gs_variants_list,
-                        &variant->list_item_global);
-         fpme->llvm->nr_gs_variants++;
+         lp_variant_cache_insert(&fpme->llvm->gs_variant_cache,
+                                 &variant->cache_entry, variant,
+                                 gallivm_code_size(variant->gallivm),
+                                 t1 - t0);
          shader->variants_cached++;
       }
    }
@@ -201,7 +263,6 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
       struct draw_llvm_variant_list_item *li;
       struct llvm_vertex_shader *shader = llvm_vertex_shader(vs);
       char store[DRAW_LLVM_MAX_VARIANT_KEY_SIZE];
-      unsigned i;
 
       key = draw_llvm_make_variant_key(fpme->llvm, store);
 
@@ -216,39 +277,36 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
       }
 
       if (variant) {
-         /* found the variant, move to head of global list (for LRU) */
-         move_to_head(&fpme->llvm->vs_variants_list,
-                      &variant->list_item_global);
+         /* found the variant, mark it as recently used */
+         lp_variant_cache_hit(&fpme->llvm->vs_variant_cache,
+                              &variant->cache_entry);
       }
       else {
          /* Need to create new variant */
+         int64_t t0, t1;
 
-         /* First check if we've created too many variants.  If so, free
-          * 25% of the LRU to avoid using too much memory.
+         /* First check if we've created too many variants.  If so, evict
+          * the ones which are cheapest to rebuild to avoid using too much
+          * memory.
           */
-         if (fpme->llvm->nr_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         if (lp_variant_cache_full(&fpme->llvm->vs_variant_cache)) {
             /*
              * XXX: should we flush here ?
              */
-            for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 4; i++) {
-               struct draw_llvm_variant_list_item *item;
-               if (is_empty_list(&fpme->llvm->vs_variants_list)) {
-                  break;
-               }
-               item = last_elem(&fpme->llvm->vs_variants_list);
-               assert(item);
-               assert(item->base);
-               draw_llvm_destroy_variant(item->base);
-            }
+            lp_variant_cache_evict(&fpme->llvm->vs_variant_cache,
+                                   evict_vs_variant, NULL);
          }
 
+         t0 = os_time_get();
          variant = draw_llvm_create_variant(fpme->llvm, nr, key);
+         t1 = os_time_get();
 
          if (variant) {
             insert_at_head(&shader->variants, &variant->list_item_local);
-            insert_at_head(&fpme->llvm->vs_variants_list,
-                           &variant->list_item_global);
-            fpme->llvm->nr_variants++;
+            lp_variant_cache_insert(&fpme->llvm->vs_variant_cache,
+                                    &variant->cache_entry, variant,
+                                    gallivm_code_size(variant->gallivm),
+                                    t1 - t0);
             shader->variants_cached++;
          }
       }
@@ -336,16 +394,58 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Fetch and shade the vertices.  May be called from a worker thread, so
+ * this must only read state which stays constant during draw_pt_arrays().
+ * \return  non-zero if any vertex needs clipping
+ */
+static unsigned
+llvm_fetch_shade(struct llvm_middle_end *fpme,
+                 struct draw_llvm_variant *variant,
+                 const struct draw_fetch_info *fetch_info,
+                 struct vertex_header *verts)
+{
+   struct draw_context *draw = fpme->draw;
+
+   if (fetch_info->linear)
+      return variant->jit_func( &fpme->llvm->jit_context,
+                                verts,
+                                draw->pt.user.vbuffer,
+                                fetch_info->start,
+                                fetch_info->count,
+                                fpme->vertex_size,
+                                draw->pt.vertex_buffer,
+                                draw->instance_id,
+                                draw->start_index,
+                                draw->start_instance);
+   else
+      return variant->jit_func_elts( &fpme->llvm->jit_context,
+                                     verts,
+                                     draw->pt.user.vbuffer,
+                                     fetch_info->elts,
+                                     draw->pt.user.eltMax,
+                                     fetch_info->count,
+                                     fpme->vertex_size,
+                                     draw->pt.vertex_buffer,
+                                     draw->instance_id,
+                                     draw->pt.user.eltBias,
+                                     draw->start_instance);
+}
+
+
+/**
+ * Run the rest of the pipeline (GS, stream output, clipping, emit) on
+ * shaded vertices.  Frees llvm_vert_info->verts.
+ */
 static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+llvm_pipeline_finish(struct llvm_middle_end *fpme,
+                     struct draw_vertex_info *llvm_vert_info,
+                     const struct draw_prim_info *in_prim_info,
+                     unsigned clipped)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
    struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
    struct draw_vertex_info gs_vert_info;
    struct draw_vertex_info *vert_info;
    struct draw_prim_info ia_prim_info;
@@ -353,54 +453,8 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
    const struct draw_prim_info *prim_info = in_prim_info;
    boolean free_prim_info = FALSE;
    unsigned opt = fpme->opt;
-   unsigned clipped = 0;
-
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
-      MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
-      assert(0);
-      return;
-   }
-
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
 
-   if (fetch_info->linear)
-      clipped = fpme->current_variant->jit_func( &fpme->llvm->jit_context,
-                                       llvm_vert_info.verts,
-                                       draw->pt.user.vbuffer,
-                                       fetch_info->start,
-                                       fetch_info->count,
-                                       fpme->vertex_size,
-                                       draw->pt.vertex_buffer,
-                                       draw->instance_id,
-                                       draw->start_index,
-                                       draw->start_instance);
-   else
-      clipped = fpme->current_variant->jit_func_elts( &fpme->llvm->jit_context,
-                                            llvm_vert_info.verts,
-                                            draw->pt.user.vbuffer,
-                                            fetch_info->elts,
-                                            draw->pt.user.eltMax,
-                                            fetch_info->count,
-                                            fpme->vertex_size,
-                                            draw->pt.vertex_buffer,
-                                            draw->instance_id,
-                                            draw->pt.user.eltBias,
-                                            draw->start_instance);
-
-   /* Finished with fetch and vs:
-    */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
+   vert_info = llvm_vert_info;
 
    if ((opt & PT_SHADE) && gshader) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
@@ -473,6 +527,279 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+/**
+ * Fetch and shade through the post-transform vertex cache: only the
+ * vertices which aren't cached yet are shaded.
+ * \param clipped  returns non-zero if any vertex needs clipping
+ * \return FALSE if out of memory
+ */
+static boolean
+llvm_fetch_shade_cached(struct llvm_middle_end *fpme,
+                        const struct draw_fetch_info *fetch_info,
+                        struct vertex_header *verts,
+                        unsigned *clipped)
+{
+   struct draw_context *draw = fpme->draw;
+   struct pt_vcache *vcache = draw->pt.vcache;
+   const unsigned vertex_size = fpme->vertex_size;
+   struct draw_fetch_info miss_fetch_info;
+   struct vertex_header *shaded;
+   unsigned *miss_elts, *miss_pos;
+   unsigned misses, i;
+
+   miss_elts = MALLOC(2 * fetch_info->count * sizeof(unsigned));
+   if (!miss_elts)
+      return FALSE;
+   miss_pos = miss_elts + fetch_info->count;
+
+   misses = draw_pt_vcache_lookup(vcache, vertex_size,
+                                  fetch_info->elts, fetch_info->count,
+                                  verts, miss_elts, miss_pos, clipped);
+
+   if (misses) {
+      shaded = (struct vertex_header *)
+         MALLOC(vertex_size * align(misses, lp_native_vector_width / 32));
+      if (!shaded) {
+         FREE(miss_elts);
+         return FALSE;
+      }
+
+      miss_fetch_info = *fetch_info;
+      miss_fetch_info.elts = miss_elts;
+      miss_fetch_info.count = misses;
+      *clipped |= llvm_fetch_shade(fpme, fpme->current_variant,
+                                   &miss_fetch_info, shaded);
+
+      for (i = 0; i < misses; i++) {
+         memcpy((char *)verts + miss_pos[i] * vertex_size,
+                (const char *)shaded + i * vertex_size,
+                vertex_size);
+      }
+
+      draw_pt_vcache_insert(vcache, vertex_size, miss_elts, shaded, misses);
+      FREE(shaded);
+   }
+
+   draw->pt.vertex_stats.shaded += misses;
+
+   FREE(miss_elts);
+   return TRUE;
+}
+
+
+static void
+llvm_shade_segment(struct llvm_middle_end *fpme,
+                   struct llvm_segment *seg)
+{
+   seg->clipped = llvm_fetch_shade(fpme, seg->variant, &seg->fetch_info,
+                                   seg->vert_info.verts);
+}
+
+
+static PIPE_THREAD_ROUTINE( llvm_shade_thread, init_data )
+{
+   struct llvm_middle_end *fpme = (struct llvm_middle_end *) init_data;
+
+   /* same as the application thread in draw_vbo() */
+   util_fpstate_set_denorms_to_zero(util_fpstate_get());
+
+   pipe_mutex_lock(fpme->mutex);
+
+   for (;;) {
+      struct llvm_segment *seg;
+
+      while (fpme->next == fpme->last && !fpme->exit)
+         pipe_condvar_wait(fpme->change, fpme->mutex);
+
+      if (fpme->exit)
+         break;
+
+      seg = &fpme->segments[fpme->next++ % LLVM_MAX_SEGMENTS];
+      seg->state = LLVM_SEGMENT_RUNNING;
+      pipe_mutex_unlock(fpme->mutex);
+
+      llvm_shade_segment(fpme, seg);
+
+      pipe_mutex_lock(fpme->mutex);
+      seg->state = LLVM_SEGMENT_DONE;
+      pipe_condvar_broadcast(fpme->change);
+   }
+
+   pipe_mutex_unlock(fpme->mutex);
+   return 0;
+}
+
+
+/**
+ * Wait for the oldest segment to be shaded, shading it here if no thread
+ * picked it up yet, and run the rest of the pipeline on it.
+ */
+static void
+llvm_retire_segment(struct llvm_middle_end *fpme)
+{
+   struct llvm_segment *seg = &fpme->segments[fpme->first % LLVM_MAX_SEGMENTS];
+
+   assert(fpme->first != fpme->last);
+
+   pipe_mutex_lock(fpme->mutex);
+   if (fpme->next == fpme->first) {
+      fpme->next++;
+      seg->state = LLVM_SEGMENT_RUNNING;
+      pipe_mutex_unlock(fpme->mutex);
+
+      llvm_shade_segment(fpme, seg);
+
+      pipe_mutex_lock(fpme->mutex);
+      seg->state = LLVM_SEGMENT_DONE;
+   }
+   while (seg->state != LLVM_SEGMENT_DONE)
+      pipe_condvar_wait(fpme->change, fpme->mutex);
+   pipe_mutex_unlock(fpme->mutex);
+
+   fpme->first++;
+
+   llvm_pipeline_finish(fpme, &seg->vert_info, &seg->prim_info, seg->clipped);
+
+   FREE(seg->fetch_elts);
+   FREE(seg->draw_elts);
+}
+
+
+/**
+ * Retire all segments in flight.  Must be called before any state the
+ * shading depends on may change, i.e. before draw_pt_arrays() returns.
+ */
+static void
+llvm_middle_end_sync(struct draw_pt_middle_end *middle)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   while (fpme->first != fpme->last)
+      llvm_retire_segment(fpme);
+}
+
+
+/**
+ * Queue a segment for shading by the worker threads.  Takes ownership of
+ * llvm_vert_info->verts.
+ * \return FALSE if out of memory
+ */
+static boolean
+llvm_queue_segment(struct llvm_middle_end *fpme,
+                   const struct draw_fetch_info *fetch_info,
+                   const struct draw_prim_info *prim_info,
+                   const struct draw_vertex_info *llvm_vert_info)
+{
+   struct llvm_segment *seg;
+
+   assert(prim_info->primitive_count == 1);
+
+   if (fpme->last - fpme->first == LLVM_MAX_SEGMENTS)
+      llvm_retire_segment(fpme);
+
+   seg = &fpme->segments[fpme->last % LLVM_MAX_SEGMENTS];
+   seg->fetch_elts = NULL;
+   seg->draw_elts = NULL;
+
+   if (!fetch_info->linear) {
+      seg->fetch_elts = MALLOC(fetch_info->count * sizeof(unsigned));
+      if (!seg->fetch_elts)
+         return FALSE;
+      memcpy(seg->fetch_elts, fetch_info->elts,
+             fetch_info->count * sizeof(unsigned));
+   }
+
+   if (!prim_info->linear) {
+      seg->draw_elts = MALLOC(prim_info->count * sizeof(ushort));
+      if (!seg->draw_elts) {
+         FREE(seg->fetch_elts);
+         return FALSE;
+      }
+      memcpy(seg->draw_elts, prim_info->elts,
+             prim_info->count * sizeof(ushort));
+   }
+
+   seg->variant = fpme->current_variant;
+   seg->fetch_info = *fetch_info;
+   seg->fetch_info.elts = seg->fetch_elts;
+   seg->prim_info = *prim_info;
+   seg->prim_info.elts = seg->draw_elts;
+   seg->primitive_length = prim_info->primitive_lengths[0];
+   seg->prim_info.primitive_lengths = &seg->primitive_length;
+   seg->vert_info = *llvm_vert_info;
+   seg->state = LLVM_SEGMENT_QUEUED;
+
+   pipe_mutex_lock(fpme->mutex);
+   fpme->last++;
+   /* A lone segment is left for llvm_middle_end_sync() to shade, which
+    * saves a thread wake-up for small draws.
+    */
+   if (fpme->last - fpme->first > 1)
+      pipe_condvar_broadcast(fpme->change);
+   pipe_mutex_unlock(fpme->mutex);
+
+   return TRUE;
+}
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct draw_vertex_info llvm_vert_info;
+   boolean use_vcache;
+   unsigned clipped;
+
+   llvm_vert_info.count = fetch_info->count;
+   llvm_vert_info.vertex_size = fpme->vertex_size;
+   llvm_vert_info.stride = fpme->vertex_size;
+   llvm_vert_info.verts = (struct vertex_header *)
+      MALLOC(fpme->vertex_size *
+             align(fetch_info->count, lp_native_vector_width / 32));
+   if (!llvm_vert_info.verts) {
+      assert(0);
+      return;
+   }
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      draw->statistics.vs_invocations += fetch_info->count;
+   }
+   draw->pt.vertex_stats.indices += prim_info->count;
+
+   /* The vertex cache is filled in order, so cached segments are shaded
+    * here rather than by the worker threads.
+    */
+   use_vcache = draw->pt.vcache && !fetch_info->linear;
+
+   if (fpme->num_threads && !use_vcache &&
+       llvm_queue_segment(fpme, fetch_info, prim_info, &llvm_vert_info)) {
+      draw->pt.vertex_stats.shaded += fetch_info->count;
+      return;
+   }
+
+   /* Segments must be retired in order. */
+   llvm_middle_end_sync(middle);
+
+   if (!use_vcache ||
+       !llvm_fetch_shade_cached(fpme, fetch_info, llvm_vert_info.verts,
+                                &clipped)) {
+      clipped = llvm_fetch_shade(fpme, fpme->current_variant, fetch_info,
+                                 llvm_vert_info.verts);
+      draw->pt.vertex_stats.shaded += fetch_info->count;
+   }
+
+   /* Finished with fetch and vs:
+    */
+   llvm_pipeline_finish(fpme, &llvm_vert_info, prim_info, clipped);
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
@@ -576,7 +903,7 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   llvm_middle_end_sync(middle);
 }
 
 
@@ -585,6 +912,23 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
 
+   if (fpme->num_threads) {
+      unsigned i;
+
+      llvm_middle_end_sync(middle);
+
+      pipe_mutex_lock(fpme->mutex);
+      fpme->exit = TRUE;
+      pipe_condvar_broadcast(fpme->change);
+      pipe_mutex_unlock(fpme->mutex);
+
+      for (i = 0; i < fpme->num_threads; i++)
+         pipe_thread_wait(fpme->threads[i]);
+
+      pipe_condvar_destroy(fpme->change);
+      pipe_mutex_destroy(fpme->mutex);
+   }
+
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
 
@@ -605,6 +949,7 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned num_threads, i;
 
    if (!draw->llvm)
       return NULL;
@@ -619,6 +964,7 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
    fpme->base.finish          = llvm_middle_end_finish;
+   fpme->base.sync            = llvm_middle_end_sync;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
    fpme->draw = draw;
@@ -645,6 +991,29 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   util_cpu_detect();
+   num_threads = debug_get_num_option("DRAW_NUM_THREADS",
+                                      util_cpu_caps.nr_cpus > 1 ?
+                                      MIN2(util_cpu_caps.nr_cpus - 1, 4) : 0);
+   num_threads = MIN2(num_threads, LLVM_MAX_THREADS);
+
+   if (num_threads) {
+      pipe_mutex_init(fpme->mutex);
+      pipe_condvar_init(fpme->change);
+
+      for (i = 0; i < num_threads; i++) {
+         fpme->threads[i] = pipe_thread_create(llvm_shade_thread, fpme);
+         if (!fpme->threads[i])
+            break;
+         fpme->num_threads++;
+      }
+
+      if (!fpme->num_threads) {
+         pipe_condvar_destroy(fpme->change);
+         pipe_mutex_destroy(fpme->mutex);
+      }
+   }
+
    return &fpme->base;
 
  fail:
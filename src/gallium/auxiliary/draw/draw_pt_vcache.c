@@ -0,0 +1,263 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Post-transform vertex cache.
+ *
+ * The vsplit front end only dedups fetch elements within a segment, so
+ * indexed meshes whose vertices are referenced again after more than a
+ * segment's worth of indices get shaded several times.  This cache keeps
+ * shaded vertices, keyed by fetch element, across the segments of a
+ * draw.  It is set-associative with round-robin replacement in each set.
+ *
+ * The cached vertices are only valid until the end of the draw (or
+ * instance), as any state they depend on may change afterwards.
+ */
+
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "draw/draw_context.h"
+#include "draw/draw_private.h"
+#include "draw/draw_pt.h"
+
+
+#define VCACHE_WAYS     4
+#define VCACHE_MAX_SIZE (64 * 1024)
+
+
+struct pt_vcache {
+   unsigned num_sets;
+   unsigned vertex_size;
+
+   /* Entries whose generation doesn't match are empty. */
+   unsigned generation;
+
+   unsigned *elts;          /**< num_sets * VCACHE_WAYS fetch elements */
+   unsigned *generations;   /**< num_sets * VCACHE_WAYS */
+   ubyte *next_way;         /**< num_sets, way to replace next */
+   char *verts;             /**< num_sets * VCACHE_WAYS vertices */
+};
+
+
+static inline unsigned
+vcache_set(const struct pt_vcache *vcache, unsigned elt)
+{
+   return (elt & (vcache->num_sets - 1)) * VCACHE_WAYS;
+}
+
+
+static inline struct vertex_header *
+vcache_vert(const struct pt_vcache *vcache, unsigned entry)
+{
+   return (struct vertex_header *)(vcache->verts +
+                                   entry * vcache->vertex_size);
+}
+
+
+/**
+ * (Re)allocate the vertex storage if the vertex size changed.
+ */
+static boolean
+vcache_prepare(struct pt_vcache *vcache, unsigned vertex_size)
+{
+   if (vcache->vertex_size == vertex_size)
+      return vcache->verts != NULL;
+
+   FREE(vcache->verts);
+   vcache->verts = MALLOC(vcache->num_sets * VCACHE_WAYS * vertex_size);
+   vcache->vertex_size = vertex_size;
+   draw_pt_vcache_invalidate(vcache);
+
+   return vcache->verts != NULL;
+}
+
+
+/**
+ * Copy the cached vertices for fetch_elts[0..count) to their place in
+ * verts.  The fetch elements which missed are returned in miss_elts and
+ * their positions in miss_pos: the caller shades these and passes them
+ * to draw_pt_vcache_insert().
+ * \param clipmask  returns the union of the cached vertices' clipmasks
+ * \return number of misses, or count if the cache can't be used
+ */
+unsigned
+draw_pt_vcache_lookup(struct pt_vcache *vcache,
+                      unsigned vertex_size,
+                      const unsigned *fetch_elts,
+                      unsigned count,
+                      struct vertex_header *verts,
+                      unsigned *miss_elts,
+                      unsigned *miss_pos,
+                      unsigned *clipmask)
+{
+   unsigned misses = 0;
+   unsigned i, j;
+
+   *clipmask = 0;
+
+   if (!vcache_prepare(vcache, vertex_size)) {
+      for (i = 0; i < count; i++) {
+         miss_elts[i] = fetch_elts[i];
+         miss_pos[i] = i;
+      }
+      return count;
+   }
+
+   for (i = 0; i < count; i++) {
+      const unsigned elt = fetch_elts[i];
+      const unsigned set = vcache_set(vcache, elt);
+
+      for (j = set; j < set + VCACHE_WAYS; j++) {
+         if (vcache->elts[j] == elt &&
+             vcache->generations[j] == vcache->generation)
+            break;
+      }
+
+      if (j < set + VCACHE_WAYS) {
+         const struct vertex_header *src = vcache_vert(vcache, j);
+
+         memcpy((char *)verts + i * vertex_size, src, vertex_size);
+         *clipmask |= src->clipmask;
+      }
+      else {
+         miss_elts[misses] = elt;
+         miss_pos[misses] = i;
+         misses++;
+      }
+   }
+
+   return misses;
+}
+
+
+/**
+ * Add count shaded vertices, stored consecutively in verts, for the
+ * fetch elements in elts.
+ */
+void
+draw_pt_vcache_insert(struct pt_vcache *vcache,
+                      unsigned vertex_size,
+                      const unsigned *elts,
+                      const struct vertex_header *verts,
+                      unsigned count)
+{
+   unsigned i;
+
+   if (!vcache_prepare(vcache, vertex_size))
+      return;
+
+   for (i = 0; i < count; i++) {
+      const unsigned elt = elts[i];
+      const unsigned set = vcache_set(vcache, elt);
+      unsigned j;
+
+      /* the front end may repeat a fetch element within a segment */
+      for (j = set; j < set + VCACHE_WAYS; j++) {
+         if (vcache->elts[j] == elt &&
+             vcache->generations[j] == vcache->generation)
+            break;
+      }
+
+      if (j == set + VCACHE_WAYS) {
+         unsigned set_idx = set / VCACHE_WAYS;
+
+         j = set + vcache->next_way[set_idx];
+         vcache->next_way[set_idx] = (vcache->next_way[set_idx] + 1) %
+                                     VCACHE_WAYS;
+      }
+
+      vcache->elts[j] = elt;
+      vcache->generations[j] = vcache->generation;
+      memcpy(vcache_vert(vcache, j),
+             (const char *)verts + i * vertex_size, vertex_size);
+   }
+}
+
+
+/**
+ * Drop all cached vertices.  Called at the start of every draw.
+ */
+void
+draw_pt_vcache_invalidate(struct pt_vcache *vcache)
+{
+   vcache->generation++;
+
+   if (vcache->generation == 0) {
+      /* wrapped around, make sure no stale entry matches */
+      memset(vcache->generations, 0xff,
+             vcache->num_sets * VCACHE_WAYS * sizeof(unsigned));
+      vcache->generation = 1;
+   }
+}
+
+
+/**
+ * Create the cache if enabled with DRAW_VERTEX_CACHE=<vertices>.
+ * \return NULL if disabled or out of memory
+ */
+struct pt_vcache *
+draw_pt_vcache_create(struct draw_context *draw)
+{
+   struct pt_vcache *vcache;
+   unsigned size;
+
+   size = debug_get_num_option("DRAW_VERTEX_CACHE", 0);
+   if (!size)
+      return NULL;
+
+   size = util_next_power_of_two(MAX2(size, VCACHE_WAYS));
+   size = MIN2(size, VCACHE_MAX_SIZE);
+
+   vcache = CALLOC_STRUCT(pt_vcache);
+   if (!vcache)
+      return NULL;
+
+   vcache->num_sets = size / VCACHE_WAYS;
+   vcache->elts = MALLOC(size * sizeof(unsigned));
+   vcache->generations = CALLOC(size, sizeof(unsigned));
+   vcache->next_way = CALLOC(vcache->num_sets, sizeof(ubyte));
+   if (!vcache->elts || !vcache->generations || !vcache->next_way) {
+      draw_pt_vcache_destroy(vcache);
+      return NULL;
+   }
+
+   vcache->generation = 1;
+
+   return vcache;
+}
+
+
+void
+draw_pt_vcache_destroy(struct pt_vcache *vcache)
+{
+   FREE(vcache->elts);
+   FREE(vcache->generations);
+   FREE(vcache->next_way);
+   FREE(vcache->verts);
+   FREE(vcache);
+}
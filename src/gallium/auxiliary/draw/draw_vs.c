@@ -47,6 +47,7 @@
 #include "tgsi/tgsi_exec.h"
 
 DEBUG_GET_ONCE_BOOL_OPTION(gallium_dump_vs, "GALLIUM_DUMP_VS", FALSE)
+DEBUG_GET_ONCE_NUM_OPTION(draw_vs_lanes, "DRAW_VS_LANES", TGSI_EXEC_MAX_LANES)
 
 
 struct draw_vertex_shader *
@@ -157,6 +158,12 @@ draw_vs_init( struct draw_context *draw )
       draw->vs.tgsi.machine = tgsi_exec_machine_create();
       if (!draw->vs.tgsi.machine)
          return FALSE;
+
+      /* Run simple shaders on several quads per dispatch.  A failure just
+       * leaves the machine on the quad path.
+       */
+      tgsi_exec_machine_set_lanes(draw->vs.tgsi.machine,
+                                  debug_get_option_draw_vs_lanes());
    }
 
    draw->vs.emit_cache = translate_cache_create();
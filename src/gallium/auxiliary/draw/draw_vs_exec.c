@@ -77,39 +77,65 @@ vs_exec_prepare( struct draw_vertex_shader *shader,
 
 
 
-/* Simplified vertex shader interface for the pt paths.  Given the
- * complexity of code-generating all the above operations together,
- * it's time to try doing all the other stuff separately.
+/**
+ * The interpreter's input, output and system value registers, seen as
+ * arrays of \c width elements per channel: TGSI_QUAD_SIZE for the quad
+ * interpreter, TGSI_EXEC_MAX_LANES for the wide one.
+ */
+struct vs_exec_regs {
+   float *inputs;
+   float *outputs;
+   int *system_values;
+   unsigned width;
+};
+
+
+/* Run the interpreter on one quad of vertices.
  */
 static void
-vs_exec_run_linear( struct draw_vertex_shader *shader,
-		    const float (*input)[4],
-		    float (*output)[4],
-                    const void *constants[PIPE_MAX_CONSTANT_BUFFERS],
-                    const unsigned const_size[PIPE_MAX_CONSTANT_BUFFERS],
-		    unsigned count,
-		    unsigned input_stride,
-		    unsigned output_stride )
+vs_exec_run_quad( struct tgsi_exec_machine *machine,
+                  unsigned count )
 {
-   struct exec_vertex_shader *evs = exec_vertex_shader(shader);
-   struct tgsi_exec_machine *machine = evs->machine;
+   tgsi_set_exec_mask(machine,
+                      1,
+                      count > 1,
+                      count > 2,
+                      count > 3);
+
+   tgsi_exec_machine_run( machine );
+}
+
+
+/* Swizzle up to "lanes" vertices at a time into the registers, run them
+ * and unswizzle the results.
+ */
+static void
+vs_exec_run_lanes( struct draw_vertex_shader *shader,
+                   const struct vs_exec_regs *regs,
+                   unsigned lanes,
+                   void (*run)( struct tgsi_exec_machine *machine,
+                                unsigned count ),
+                   const float (*input)[4],
+                   float (*output)[4],
+                   unsigned count,
+                   unsigned input_stride,
+                   unsigned output_stride )
+{
+   struct tgsi_exec_machine *machine = exec_vertex_shader(shader)->machine;
+   const unsigned width = regs->width;
    unsigned int i, j;
-   unsigned slot;
+   unsigned slot, chan;
    boolean clamp_vertex_color = shader->draw->rasterizer->clamp_vertex_color;
 
-   debug_assert(!shader->draw->llvm);
-   tgsi_exec_set_constant_buffers(machine, PIPE_MAX_CONSTANT_BUFFERS,
-                                  constants, const_size);
-
    if (shader->info.uses_instanceid) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_INSTANCEID];
-      assert(i < Elements(machine->SystemValue));
-      for (j = 0; j < TGSI_QUAD_SIZE; j++)
-         machine->SystemValue[i].i[j] = shader->draw->instance_id;
+      assert(i < TGSI_MAX_MISC_INPUTS);
+      for (j = 0; j < width; j++)
+         regs->system_values[i * width + j] = shader->draw->instance_id;
    }
 
-   for (i = 0; i < count; i += MAX_TGSI_VERTICES) {
-      unsigned int max_vertices = MIN2(MAX_TGSI_VERTICES, count - i);
+   for (i = 0; i < count; i += lanes) {
+      unsigned int max_vertices = MIN2(lanes, count - i);
 
       /* Swizzle inputs.  
        */
@@ -127,66 +153,57 @@ vs_exec_run_linear( struct draw_vertex_shader *shader,
 
          if (shader->info.uses_vertexid) {
             unsigned vid = machine->SysSemanticToIndex[TGSI_SEMANTIC_VERTEXID];
-            assert(vid < Elements(machine->SystemValue));
-            machine->SystemValue[vid].i[j] = i + j;
+            assert(vid < TGSI_MAX_MISC_INPUTS);
+            regs->system_values[vid * width + j] = i + j;
             /* XXX this should include base vertex. Where to get it??? */
          }
          if (shader->info.uses_basevertex) {
             unsigned vid = machine->SysSemanticToIndex[TGSI_SEMANTIC_BASEVERTEX];
-            assert(vid < Elements(machine->SystemValue));
-            machine->SystemValue[vid].i[j] = 0;
+            assert(vid < TGSI_MAX_MISC_INPUTS);
+            regs->system_values[vid * width + j] = 0;
             /* XXX Where to get it??? */
          }
          if (shader->info.uses_vertexid_nobase) {
             unsigned vid = machine->SysSemanticToIndex[TGSI_SEMANTIC_VERTEXID_NOBASE];
-            assert(vid < Elements(machine->SystemValue));
-            machine->SystemValue[vid].i[j] = i + j;
+            assert(vid < TGSI_MAX_MISC_INPUTS);
+            regs->system_values[vid * width + j] = i + j;
          }
 
          for (slot = 0; slot < shader->info.num_inputs; slot++) {
+            float *in = &regs->inputs[slot * TGSI_NUM_CHANNELS * width + j];
 #if 0
             assert(!util_is_inf_or_nan(input[slot][0]));
             assert(!util_is_inf_or_nan(input[slot][1]));
             assert(!util_is_inf_or_nan(input[slot][2]));
             assert(!util_is_inf_or_nan(input[slot][3]));
 #endif
-            machine->Inputs[slot].xyzw[0].f[j] = input[slot][0];
-            machine->Inputs[slot].xyzw[1].f[j] = input[slot][1];
-            machine->Inputs[slot].xyzw[2].f[j] = input[slot][2];
-            machine->Inputs[slot].xyzw[3].f[j] = input[slot][3];
+            for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+               in[chan * width] = input[slot][chan];
          }
 
          input = (const float (*)[4])((const char *)input + input_stride);
       } 
 
-      tgsi_set_exec_mask(machine,
-                         1,
-                         max_vertices > 1,
-                         max_vertices > 2,
-                         max_vertices > 3);
-
       /* run interpreter */
-      tgsi_exec_machine_run( machine );
+      run( machine, max_vertices );
 
       /* Unswizzle all output results.  
        */
       for (j = 0; j < max_vertices; j++) {
          for (slot = 0; slot < shader->info.num_outputs; slot++) {
             unsigned name = shader->info.output_semantic_name[slot];
+            const float *out =
+               &regs->outputs[slot * TGSI_NUM_CHANNELS * width + j];
             if(clamp_vertex_color &&
                   (name == TGSI_SEMANTIC_COLOR || name == TGSI_SEMANTIC_BCOLOR))
             {
-               output[slot][0] = CLAMP(machine->Outputs[slot].xyzw[0].f[j], 0.0f, 1.0f);
-               output[slot][1] = CLAMP(machine->Outputs[slot].xyzw[1].f[j], 0.0f, 1.0f);
-               output[slot][2] = CLAMP(machine->Outputs[slot].xyzw[2].f[j], 0.0f, 1.0f);
-               output[slot][3] = CLAMP(machine->Outputs[slot].xyzw[3].f[j], 0.0f, 1.0f);
+               for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+                  output[slot][chan] = CLAMP(out[chan * width], 0.0f, 1.0f);
             }
             else
             {
-               output[slot][0] = machine->Outputs[slot].xyzw[0].f[j];
-               output[slot][1] = machine->Outputs[slot].xyzw[1].f[j];
-               output[slot][2] = machine->Outputs[slot].xyzw[2].f[j];
-               output[slot][3] = machine->Outputs[slot].xyzw[3].f[j];
+               for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+                  output[slot][chan] = out[chan * width];
             }
          }
 
@@ -209,6 +226,54 @@ vs_exec_run_linear( struct draw_vertex_shader *shader,
 }
 
 
+/* Simplified vertex shader interface for the pt paths.  Given the
+ * complexity of code-generating all the above operations together,
+ * it's time to try doing all the other stuff separately.
+ *
+ * Shaders the wide interpreter can run go through it machine->Lanes
+ * vertices at a time, the others through the quad interpreter.
+ */
+static void
+vs_exec_run_linear( struct draw_vertex_shader *shader,
+		    const float (*input)[4],
+		    float (*output)[4],
+                    const void *constants[PIPE_MAX_CONSTANT_BUFFERS],
+                    const unsigned const_size[PIPE_MAX_CONSTANT_BUFFERS],
+		    unsigned count,
+		    unsigned input_stride,
+		    unsigned output_stride )
+{
+   struct exec_vertex_shader *evs = exec_vertex_shader(shader);
+   struct tgsi_exec_machine *machine = evs->machine;
+   struct vs_exec_regs regs;
+
+   debug_assert(!shader->draw->llvm);
+   tgsi_exec_set_constant_buffers(machine, PIPE_MAX_CONSTANT_BUFFERS,
+                                  constants, const_size);
+
+   if (tgsi_exec_machine_is_wide(machine)) {
+      regs.inputs = machine->WideInputs[0].xyzw[0].f;
+      regs.outputs = machine->WideOutputs[0].xyzw[0].f;
+      regs.system_values = machine->WideSystemValue[0].i;
+      regs.width = TGSI_EXEC_MAX_LANES;
+
+      vs_exec_run_lanes(shader, &regs, machine->Lanes,
+                        tgsi_exec_machine_run_wide, input, output, count,
+                        input_stride, output_stride);
+   }
+   else {
+      regs.inputs = machine->Inputs[0].xyzw[0].f;
+      regs.outputs = machine->Outputs[0].xyzw[0].f;
+      regs.system_values = machine->SystemValue[0].i;
+      regs.width = TGSI_QUAD_SIZE;
+
+      vs_exec_run_lanes(shader, &regs, MAX_TGSI_VERTICES,
+                        vs_exec_run_quad, input, output, count,
+                        input_stride, output_stride);
+   }
+}
+
+
 
 
 static void
@@ -0,0 +1,221 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "pipe/p_config.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(PIPE_OS_UNIX)
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#if defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#endif
+
+#include "util/mesa-sha1.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
+#include "util/u_string.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_type.h"
+#include "lp_bld_cache.h"
+
+
+static struct lp_disk_cache_stats disk_cache_stats;
+
+
+/**
+ * Return the cache directory, or NULL if the disk cache is disabled.
+ */
+static const char *
+get_cache_dir(void)
+{
+#if defined(PIPE_OS_UNIX)
+   static boolean first = TRUE;
+   static const char *dir;
+
+   if (first) {
+      first = FALSE;
+      dir = debug_get_option("GALLIVM_CACHE_DIR", NULL);
+      /* Failure (most likely EEXIST) shows up on first store anyway. */
+      if (dir)
+         mkdir(dir, 0755);
+   }
+   return dir;
+#else
+   return NULL;
+#endif
+}
+
+
+/**
+ * Hash everything which may change the generated code without changing
+ * the IR: the build itself, the LLVM version and the host CPU.
+ */
+static void
+hash_build_and_host(struct mesa_sha1 *key)
+{
+   struct util_cpu_caps caps = util_cpu_caps;
+   unsigned version = HAVE_LLVM;
+   unsigned pointer_size = sizeof(void *);
+   unsigned debug = gallivm_debug;
+
+#ifdef PACKAGE_VERSION
+   _mesa_sha1_update(key, PACKAGE_VERSION, sizeof PACKAGE_VERSION);
+#endif
+
+#if defined(HAVE_DLADDR) && defined(PIPE_OS_UNIX)
+   {
+      /* Changes in the code generators don't bump any version, so use
+       * the timestamp of the library we were loaded from.
+       */
+      Dl_info info;
+      struct stat st;
+
+      if (dladdr((void *) hash_build_and_host, &info) &&
+          info.dli_fname && stat(info.dli_fname, &st) == 0) {
+         _mesa_sha1_update(key, &st.st_mtime, sizeof st.st_mtime);
+         _mesa_sha1_update(key, &st.st_size, sizeof st.st_size);
+      }
+   }
+#endif
+
+   _mesa_sha1_update(key, &version, sizeof version);
+   _mesa_sha1_update(key, &pointer_size, sizeof pointer_size);
+
+   /* The number of CPUs doesn't affect code generation. */
+   caps.nr_cpus = 0;
+   _mesa_sha1_update(key, &caps, sizeof caps);
+   _mesa_sha1_update(key, &lp_native_vector_width,
+                     sizeof lp_native_vector_width);
+   _mesa_sha1_update(key, &debug, sizeof debug);
+}
+
+
+/**
+ * Start a new cache key.  Returns NULL if the disk cache is disabled.
+ */
+struct mesa_sha1 *
+lp_disk_cache_key_create(void)
+{
+   struct mesa_sha1 *key;
+
+   if (!get_cache_dir())
+      return NULL;
+
+   key = _mesa_sha1_init();
+   if (key)
+      hash_build_and_host(key);
+   return key;
+}
+
+
+/**
+ * Finalize (and free) the key, and build the path of its cache file.
+ */
+boolean
+lp_disk_cache_key_path(struct mesa_sha1 *key, char *path, size_t size)
+{
+   unsigned char sha1[20];
+   char sha1_str[41];
+   int len;
+
+   if (!_mesa_sha1_final(key, sha1))
+      return FALSE;
+
+   _mesa_sha1_format(sha1_str, sha1);
+   len = util_snprintf(path, size, "%s/%s.o", get_cache_dir(), sha1_str);
+   return len > 0 && (size_t) len < size;
+}
+
+
+/**
+ * Write a freshly compiled object to the cache.
+ *
+ * The object is written to a temporary file and renamed into place, so
+ * concurrent processes never see a partially written file.
+ */
+void
+lp_disk_cache_store(const char *path, const void *data, size_t size)
+{
+#if defined(PIPE_OS_UNIX)
+   char tmp_path[PATH_MAX];
+   FILE *fp;
+   boolean ok;
+
+   p_atomic_inc(&disk_cache_stats.misses);
+
+   util_snprintf(tmp_path, sizeof tmp_path, "%s.%u.tmp", path,
+                 (unsigned) getpid());
+
+   fp = fopen(tmp_path, "wb");
+   if (!fp)
+      return;
+
+   ok = fwrite(data, 1, size, fp) == size;
+   ok = fclose(fp) == 0 && ok;
+
+   if (!ok || rename(tmp_path, path) != 0) {
+      if (gallivm_debug & GALLIVM_DEBUG_PERF)
+         debug_printf("gallivm: failed to write %s\n", path);
+      unlink(tmp_path);
+   }
+#else
+   (void) path;
+   (void) data;
+   (void) size;
+#endif
+}
+
+
+void
+lp_disk_cache_note_hit(void)
+{
+   p_atomic_inc(&disk_cache_stats.hits);
+}
+
+
+void
+lp_disk_cache_note_uncacheable(void)
+{
+   p_atomic_inc(&disk_cache_stats.uncacheable);
+}
+
+
+void
+lp_disk_cache_get_stats(struct lp_disk_cache_stats *stats)
+{
+   stats->hits = p_atomic_read(&disk_cache_stats.hits);
+   stats->misses = p_atomic_read(&disk_cache_stats.misses);
+   stats->uncacheable = p_atomic_read(&disk_cache_stats.uncacheable);
+}
@@ -0,0 +1,87 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Persistent on-disk cache of JIT-compiled object code.
+ *
+ * Enabled by pointing GALLIVM_CACHE_DIR at a writable directory.  Each
+ * cached module lives in its own file, named after the SHA-1 of the
+ * caller-supplied key (shader tokens plus variant key) salted with the
+ * build and the host CPU capabilities.
+ */
+
+
+#ifndef LP_BLD_CACHE_H
+#define LP_BLD_CACHE_H
+
+
+#include "pipe/p_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct mesa_sha1;
+
+
+struct lp_disk_cache_stats
+{
+   unsigned hits;
+   unsigned misses;
+   unsigned uncacheable;
+};
+
+
+struct mesa_sha1 *
+lp_disk_cache_key_create(void);
+
+boolean
+lp_disk_cache_key_path(struct mesa_sha1 *key, char *path, size_t size);
+
+void
+lp_disk_cache_store(const char *path, const void *data, size_t size);
+
+void
+lp_disk_cache_note_hit(void);
+
+void
+lp_disk_cache_note_uncacheable(void);
+
+void
+lp_disk_cache_get_stats(struct lp_disk_cache_stats *stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* !LP_BLD_CACHE_H */
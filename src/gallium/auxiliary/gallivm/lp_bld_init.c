@@ -26,14 +26,19 @@
  **************************************************************************/
 
 
+#include <limits.h>
+
 #include "pipe/p_config.h"
 #include "pipe/p_compiler.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
+#include "util/u_string.h"
+#include "util/mesa-sha1.h"
 #include "os/os_time.h"
 #include "lp_bld.h"
+#include "lp_bld_cache.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_misc.h"
 #include "lp_bld_init.h"
@@ -99,8 +104,7 @@ enum LLVM_CodeGenOpt_Level {
 
 
 /**
- * Create the LLVM (optimization) pass manager and install
- * relevant optimization passes.
+ * Create the LLVM (optimization) pass manager.
  * \return  TRUE for success, FALSE for failure
  */
 static boolean
@@ -112,11 +116,6 @@ create_pass_manager(struct gallivm_state *gallivm)
    gallivm->passmgr = LLVMCreateFunctionPassManagerForModule(gallivm->module);
    if (!gallivm->passmgr)
       return FALSE;
-   /*
-    * TODO: some per module pass manager with IPO passes might be helpful -
-    * the generated texture functions may benefit from inlining if they are
-    * simple, or constant propagation into them, etc.
-    */
 
    // Old versions of LLVM get the DataLayout from the pass manager.
    LLVMAddTargetData(gallivm->target, gallivm->passmgr);
@@ -145,7 +144,25 @@ create_pass_manager(struct gallivm_state *gallivm)
    LLVMSetDataLayout(gallivm->module, "");
 #endif
 
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   return TRUE;
+}
+
+
+/**
+ * Install the IR optimization passes.  Deferred until compilation so
+ * that gallivm->fast_compile can be set after creation.
+ */
+static void
+add_optimization_passes(struct gallivm_state *gallivm)
+{
+   /*
+    * TODO: some per module pass manager with IPO passes might be helpful -
+    * the generated texture functions may benefit from inlining if they are
+    * simple, or constant propagation into them, etc.
+    */
+
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0 &&
+       !gallivm->fast_compile) {
       /* These are the passes currently listed in llvm-c/Transforms/Scalar.h,
        * but there are more on SVN.
        * TODO: Add more passes.
@@ -165,8 +182,6 @@ create_pass_manager(struct gallivm_state *gallivm)
        */
       LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
    }
-
-   return TRUE;
 }
 
 
@@ -188,6 +203,16 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   /* Must outlive the engine, which may still load objects from it. */
+   if (gallivm->object_cache) {
+      lp_free_object_cache(gallivm->object_cache);
+   }
+
+   if (gallivm->cache_key) {
+      unsigned char sha1[20];
+      _mesa_sha1_final(gallivm->cache_key, sha1);
+   }
+
 #if !USE_MCJIT
    /* Don't free the TargetData, it's owned by the exec engine */
 #else
@@ -207,6 +232,8 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->object_cache = NULL;
+   gallivm->cache_key = NULL;
 }
 
 
@@ -233,7 +260,8 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) ||
+          gallivm->fast_compile) {
          optlevel = None;
       }
       else {
@@ -244,6 +272,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
                                                     &gallivm->code,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
+                                                    gallivm->object_cache,
                                                     (unsigned) optlevel,
                                                     USE_MCJIT,
                                                     &error);
@@ -484,6 +513,9 @@ gallivm_create(const char *name, LLVMContextRef context)
          FREE(gallivm);
          gallivm = NULL;
       }
+      else {
+         gallivm->refcount = 1;
+      }
    }
 
    return gallivm;
@@ -491,11 +523,28 @@ gallivm_create(const char *name, LLVMContextRef context)
 
 
 /**
- * Destroy a gallivm_state object.
+ * Add an owner to a gallivm_state object, e.g. when several variants
+ * build their functions into one module.  Each owner calls
+ * gallivm_destroy().  Not thread safe.
+ */
+void
+gallivm_reference(struct gallivm_state *gallivm)
+{
+   assert(gallivm->refcount);
+   gallivm->refcount++;
+}
+
+
+/**
+ * Destroy a gallivm_state object, once its last owner is done with it.
  */
 void
 gallivm_destroy(struct gallivm_state *gallivm)
 {
+   assert(gallivm->refcount);
+   if (--gallivm->refcount)
+      return;
+
    gallivm_free_ir(gallivm);
    gallivm_free_code(gallivm);
    FREE(gallivm);
@@ -527,15 +576,82 @@ gallivm_verify_function(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Feed data identifying the module contents into the on-disk cache key.
+ *
+ * The data must determine the generated IR completely, e.g. the shader
+ * tokens plus the variant key.  Modules without any key data are never
+ * cached.
+ */
+void
+gallivm_add_cache_key(struct gallivm_state *gallivm,
+                      const void *data, size_t size)
+{
+   assert(!gallivm->compiled);
+
+   if (!gallivm->cache_key) {
+      gallivm->cache_key = lp_disk_cache_key_create();
+      if (!gallivm->cache_key)
+         return;
+   }
+
+   _mesa_sha1_update(gallivm->cache_key, data, (int) size);
+}
+
+
+/**
+ * Attach the on-disk object cache to the module, if it is cacheable.
+ * \return  TRUE if a previously compiled object was found
+ */
+static boolean
+open_object_cache(struct gallivm_state *gallivm)
+{
+   struct mesa_sha1 *key = gallivm->cache_key;
+   char path[PATH_MAX];
+   LLVMValueRef func;
+   unsigned i = 0;
+
+   gallivm->cache_key = NULL;
+
+   if (gallivm->uncacheable) {
+      unsigned char sha1[20];
+      _mesa_sha1_final(key, sha1);
+      lp_disk_cache_note_uncacheable();
+      return FALSE;
+   }
+
+   if (!lp_disk_cache_key_path(key, path, sizeof path))
+      return FALSE;
+
+   /* Symbol names embed per-process counters, so give the functions
+    * names which only depend on the module contents.
+    */
+   for (func = LLVMGetFirstFunction(gallivm->module); func;
+        func = LLVMGetNextFunction(func)) {
+      if (!LLVMIsDeclaration(func)) {
+         char name[32];
+         util_snprintf(name, sizeof name, "gallivm_cached_fn%u", i++);
+         LLVMSetValueName(func, name);
+      }
+   }
+
+   gallivm->object_cache = lp_create_object_cache(path);
+   return gallivm->object_cache &&
+          lp_object_cache_has_object(gallivm->object_cache);
+}
+
+
 /**
  * Compile a module.
- * This does IR optimization on all functions in the module.
+ * This does IR optimization on all functions in the module, unless the
+ * object code is found in the on-disk cache.
  */
 void
 gallivm_compile_module(struct gallivm_state *gallivm)
 {
    LLVMValueRef func;
    int64_t time_begin = 0;
+   boolean cached = FALSE;
 
    assert(!gallivm->compiled);
 
@@ -547,9 +663,16 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
+#if USE_MCJIT
+   /* Fast compiles are stopgaps, not worth keeping around. */
+   if (gallivm->cache_key && !gallivm->fast_compile)
+      cached = open_object_cache(gallivm);
+#endif
+
    /* Run optimization passes */
+   add_optimization_passes(gallivm);
    LLVMInitializeFunctionPassManager(gallivm->passmgr);
-   func = LLVMGetFirstFunction(gallivm->module);
+   func = cached ? NULL : LLVMGetFirstFunction(gallivm->module);
    while (func) {
       if (0) {
          debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
@@ -572,8 +695,9 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
       int64_t time_end = os_time_get();
       int time_msec = (int)(time_end - time_begin) / 1000;
-      debug_printf("optimizing module %s took %d msec\n",
-                   lp_get_module_id(gallivm->module), time_msec);
+      debug_printf("optimizing module %s took %d msec%s\n",
+                   lp_get_module_id(gallivm->module), time_msec,
+                   cached ? " (disk cache hit)" : "");
    }
 
    /* Dump byte code to a file */
@@ -643,3 +767,13 @@ gallivm_jit_function(struct gallivm_state *gallivm,
 
    return jit_func;
 }
+
+
+/**
+ * Bytes of machine code and data generated for the module.
+ */
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm)
+{
+   return lp_generated_code_size(gallivm->code);
+}
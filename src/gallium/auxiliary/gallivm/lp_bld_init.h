@@ -36,6 +36,10 @@
 #include <llvm-c/ExecutionEngine.h>
 
 
+struct mesa_sha1;
+struct lp_object_cache;
+
+
 struct gallivm_state
 {
    LLVMModuleRef module;
@@ -47,6 +51,18 @@ struct gallivm_state
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
    unsigned compiled;
+
+   /** Owners sharing the module and its code, see gallivm_reference() */
+   unsigned refcount;
+
+   /** Trade code quality for compile speed (no IR passes, -O0 codegen) */
+   boolean fast_compile;
+
+   /** On-disk cache key; NULL if the module is not to be cached */
+   struct mesa_sha1 *cache_key;
+   /** Module embeds process-specific addresses */
+   boolean uncacheable;
+   struct lp_object_cache *object_cache;
 };
 
 
@@ -57,6 +73,9 @@ lp_build_init(void);
 struct gallivm_state *
 gallivm_create(const char *name, LLVMContextRef context);
 
+void
+gallivm_reference(struct gallivm_state *gallivm);
+
 void
 gallivm_destroy(struct gallivm_state *gallivm);
 
@@ -67,6 +86,10 @@ void
 gallivm_verify_function(struct gallivm_state *gallivm,
                         LLVMValueRef func);
 
+void
+gallivm_add_cache_key(struct gallivm_state *gallivm,
+                      const void *data, size_t size);
+
 void
 gallivm_compile_module(struct gallivm_state *gallivm);
 
@@ -74,6 +97,9 @@ func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func);
 
+size_t
+gallivm_code_size(const struct gallivm_state *gallivm);
+
 void
 lp_set_load_alignment(LLVMValueRef Inst,
                        unsigned Align);
@@ -71,6 +71,11 @@
 #include <llvm/Support/PrettyStackTrace.h>
 
 #include <llvm/Support/TargetSelect.h>
+#if HAVE_LLVM >= 0x0306
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#endif
 
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
@@ -87,6 +92,7 @@
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
 
+#include "lp_bld_cache.h"
 #include "lp_bld_misc.h"
 
 namespace {
@@ -191,6 +197,9 @@ class DelegatingJITMemoryManager : public BaseMemoryManager {
    protected:
       virtual BaseMemoryManager *mgr() const = 0;
 
+      /** Called for every chunk of code or data handed out. */
+      virtual void noteAllocation(uintptr_t Size) {}
+
    public:
 #if HAVE_LLVM < 0x0306
       /*
@@ -228,6 +237,7 @@ class DelegatingJITMemoryManager : public BaseMemoryManager {
       virtual void endFunctionBody(const llvm::Function *F,
                                    uint8_t *FunctionStart,
                                    uint8_t *FunctionEnd) {
+         noteAllocation(FunctionEnd - FunctionStart);
          mgr()->endFunctionBody(F, FunctionStart, FunctionEnd);
       }
       virtual uint8_t *allocateSpace(intptr_t Size, unsigned Alignment) {
@@ -286,6 +296,7 @@ class DelegatingJITMemoryManager : public BaseMemoryManager {
                                            unsigned Alignment,
                                            unsigned SectionID,
                                            llvm::StringRef SectionName) {
+         noteAllocation(Size);
          return mgr()->allocateCodeSection(Size, Alignment, SectionID,
                                            SectionName);
       }
@@ -293,6 +304,7 @@ class DelegatingJITMemoryManager : public BaseMemoryManager {
       virtual uint8_t *allocateCodeSection(uintptr_t Size,
                                            unsigned Alignment,
                                            unsigned SectionID) {
+         noteAllocation(Size);
          return mgr()->allocateCodeSection(Size, Alignment, SectionID);
       }
 #endif
@@ -303,6 +315,7 @@ class DelegatingJITMemoryManager : public BaseMemoryManager {
                                            llvm::StringRef SectionName,
 #endif
                                            bool IsReadOnly) {
+         noteAllocation(Size);
          return mgr()->allocateDataSection(Size, Alignment, SectionID,
 #if HAVE_LLVM >= 0x0304
                                            SectionName,
@@ -356,9 +369,11 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
       typedef std::vector<void *> Vec;
       Vec FunctionBody, ExceptionTable;
       BaseMemoryManager *TheMM;
+      size_t Size;
 
       GeneratedCode(BaseMemoryManager *MM) {
          TheMM = MM;
+         Size = 0;
       }
 
       ~GeneratedCode() {
@@ -386,6 +401,10 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
       return TheMM;
    }
 
+   void noteAllocation(uintptr_t Size) {
+      code->Size += Size;
+   }
+
    public:
 
       ShaderMemoryManager(BaseMemoryManager* MM) {
@@ -408,6 +427,10 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
          delete (GeneratedCode *) code;
       }
 
+      static size_t getGeneratedCodeSize(const struct lp_generated_code *code) {
+         return ((const GeneratedCode *) code)->Size;
+      }
+
 #if HAVE_LLVM < 0x0304
       virtual void deallocateExceptionTable(void *ET) {
          // remember for later deallocation
@@ -422,6 +445,95 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 };
 
 
+#if HAVE_LLVM >= 0x0306
+
+/**
+ * MCJIT object cache backed by a single file of the on-disk shader cache.
+ *
+ * MCJIT asks getObject() before generating code for a module; if the
+ * file holds a valid object it is memory-mapped and loaded as is,
+ * otherwise the freshly generated object is handed to
+ * notifyObjectCompiled() and written out.
+ */
+class ShaderObjectCache : public llvm::ObjectCache {
+   public:
+      ShaderObjectCache(const char *path) : Path(path) {
+         llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > buf =
+            llvm::MemoryBuffer::getFile(Path, -1, false);
+         if (buf && isObject((*buf)->getBuffer()))
+            Object = std::move(*buf);
+      }
+
+      bool hasObject() const {
+         return Object != nullptr;
+      }
+
+      virtual void notifyObjectCompiled(const llvm::Module *M,
+                                        llvm::MemoryBufferRef Obj) {
+         lp_disk_cache_store(Path.c_str(), Obj.getBufferStart(),
+                             Obj.getBufferSize());
+      }
+
+      virtual std::unique_ptr<llvm::MemoryBuffer>
+      getObject(const llvm::Module *M) {
+         if (Object)
+            lp_disk_cache_note_hit();
+         return std::move(Object);
+      }
+
+   private:
+      static bool isObject(llvm::StringRef data) {
+         using llvm::sys::fs::file_magic;
+         switch (llvm::sys::fs::identify_magic(data)) {
+         case file_magic::elf_relocatable:
+         case file_magic::macho_object:
+         case file_magic::coff_object:
+            return true;
+         default:
+            return false;
+         }
+      }
+
+      std::string Path;
+      std::unique_ptr<llvm::MemoryBuffer> Object;
+};
+
+#endif /* HAVE_LLVM >= 0x0306 */
+
+
+extern "C"
+struct lp_object_cache *
+lp_create_object_cache(const char *path)
+{
+#if HAVE_LLVM >= 0x0306
+   return reinterpret_cast<struct lp_object_cache *>(
+      new ShaderObjectCache(path));
+#else
+   return NULL;
+#endif
+}
+
+extern "C"
+boolean
+lp_object_cache_has_object(const struct lp_object_cache *cache)
+{
+#if HAVE_LLVM >= 0x0306
+   return reinterpret_cast<const ShaderObjectCache *>(cache)->hasObject();
+#else
+   return FALSE;
+#endif
+}
+
+extern "C"
+void
+lp_free_object_cache(struct lp_object_cache *cache)
+{
+#if HAVE_LLVM >= 0x0306
+   delete reinterpret_cast<ShaderObjectCache *>(cache);
+#endif
+}
+
+
 /**
  * Same as LLVMCreateJITCompilerForModule, but:
  * - allows using MCJIT and enabling AVX feature where available.
@@ -438,6 +550,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         lp_generated_code **OutCode,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef CMM,
+                                        struct lp_object_cache *Cache,
                                         unsigned OptLevel,
                                         int useMCJIT,
                                         char **OutError)
@@ -596,6 +709,11 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 
    JIT = builder.create();
    if (JIT) {
+#if HAVE_LLVM >= 0x0306
+      /* MCJIT only generates code on first use, so it's not too late. */
+      if (Cache)
+         JIT->setObjectCache(reinterpret_cast<ShaderObjectCache *>(Cache));
+#endif
       *OutJIT = wrap(JIT);
       return 0;
    }
@@ -614,6 +732,13 @@ lp_free_generated_code(struct lp_generated_code *code)
    ShaderMemoryManager::freeGeneratedCode(code);
 }
 
+extern "C"
+size_t
+lp_generated_code_size(const struct lp_generated_code *code)
+{
+   return code ? ShaderMemoryManager::getGeneratedCodeSize(code) : 0;
+}
+
 extern "C"
 LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager()
@@ -40,6 +40,7 @@ extern "C" {
 
 
 struct lp_generated_code;
+struct lp_object_cache;
 
 extern void
 gallivm_init_llvm_targets(void);
@@ -57,6 +58,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         struct lp_generated_code **OutCode,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef MM,
+                                        struct lp_object_cache *Cache,
                                         unsigned OptLevel,
                                         int useMCJIT,
                                         char **OutError);
@@ -64,12 +66,24 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 extern void
 lp_free_generated_code(struct lp_generated_code *code);
 
+extern size_t
+lp_generated_code_size(const struct lp_generated_code *code);
+
 extern LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager();
 
 extern void
 lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr);
 
+extern struct lp_object_cache *
+lp_create_object_cache(const char *path);
+
+extern boolean
+lp_object_cache_has_object(const struct lp_object_cache *cache);
+
+extern void
+lp_free_object_cache(struct lp_object_cache *cache);
+
 #ifdef __cplusplus
 }
 #endif
@@ -394,7 +394,7 @@ lp_build_context_init(struct lp_build_context *bld,
 /**
  * Count the number of instructions in a function.
  */
-static unsigned
+unsigned
 lp_build_count_instructions(LLVMValueRef function)
 {
    unsigned num_instrs = 0;
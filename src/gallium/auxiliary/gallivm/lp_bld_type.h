@@ -446,6 +446,10 @@ lp_build_context_init(struct lp_build_context *bld,
                       struct lp_type type);
 
 
+unsigned
+lp_build_count_instructions(LLVMValueRef function);
+
+
 unsigned
 lp_build_count_ir_module(LLVMModuleRef module);
 
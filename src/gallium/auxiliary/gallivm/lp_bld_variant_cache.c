@@ -0,0 +1,188 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/simple_list.h"
+#include "lp_bld_variant_cache.h"
+
+
+static double
+entry_priority(const struct lp_variant_cache *cache,
+               const struct lp_variant_cache_entry *entry)
+{
+   return cache->clock +
+          (double) MAX2(entry->cost, 1) / (double) MAX2(entry->code_size, 1);
+}
+
+
+void
+lp_variant_cache_init(struct lp_variant_cache *cache,
+                      unsigned max_variants,
+                      size_t max_code_size)
+{
+   memset(cache, 0, sizeof *cache);
+   make_empty_list(&cache->entries);
+   cache->max_variants = MAX2(max_variants, 1);
+   cache->max_code_size = max_code_size;
+}
+
+
+/**
+ * Add a freshly compiled variant.
+ */
+void
+lp_variant_cache_insert(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        void *variant,
+                        size_t code_size,
+                        int64_t cost)
+{
+   entry->variant = variant;
+   entry->code_size = code_size;
+   entry->cost = cost;
+   entry->priority = entry_priority(cache, entry);
+   insert_at_head(&cache->entries, entry);
+
+   cache->num_variants++;
+   cache->code_size += code_size;
+   cache->misses++;
+}
+
+
+/**
+ * Account for code replaced after insertion, e.g. by a recompile.
+ */
+void
+lp_variant_cache_update(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        size_t code_size,
+                        int64_t cost)
+{
+   cache->code_size -= entry->code_size;
+   cache->code_size += code_size;
+   entry->code_size = code_size;
+   entry->cost = cost;
+   entry->priority = entry_priority(cache, entry);
+}
+
+
+void
+lp_variant_cache_hit(struct lp_variant_cache *cache,
+                     struct lp_variant_cache_entry *entry)
+{
+   move_to_head(&cache->entries, entry);
+   entry->priority = entry_priority(cache, entry);
+   cache->hits++;
+}
+
+
+/**
+ * Remove a variant which is being destroyed, whether evicted or not.
+ */
+void
+lp_variant_cache_remove(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry)
+{
+   assert(cache->num_variants);
+   assert(cache->code_size >= entry->code_size);
+
+   remove_from_list(entry);
+   cache->num_variants--;
+   cache->code_size -= entry->code_size;
+}
+
+
+/**
+ * Whether a variant must be evicted before inserting another one.
+ */
+boolean
+lp_variant_cache_full(const struct lp_variant_cache *cache)
+{
+   return cache->num_variants >= cache->max_variants ||
+          cache->code_size >= cache->max_code_size;
+}
+
+
+/**
+ * Evict variants until the cache is comfortably within budget.
+ *
+ * Leaving some headroom means callers which must synchronize before
+ * destroying variants don't have to do so on every miss.  The evict
+ * callback must destroy the variant, removing it from the cache.
+ *
+ * \return  the number of variants evicted
+ */
+unsigned
+lp_variant_cache_evict(struct lp_variant_cache *cache,
+                       lp_variant_cache_evict_func evict,
+                       void *data)
+{
+   unsigned max_variants =
+      cache->max_variants - MAX2(cache->max_variants / 8, 1);
+   size_t max_code_size = cache->max_code_size - cache->max_code_size / 8;
+   unsigned count = 0;
+
+   while (cache->num_variants > max_variants ||
+          (cache->num_variants && cache->code_size > max_code_size)) {
+      struct lp_variant_cache_entry *entry, *victim = NULL;
+      unsigned num_variants = cache->num_variants;
+
+      /* Oldest first, so that ties go to the least recently used. */
+      for (entry = last_elem(&cache->entries);
+           !at_end(&cache->entries, entry);
+           entry = entry->prev) {
+         if (!victim || entry->priority < victim->priority)
+            victim = entry;
+      }
+
+      cache->clock = victim->priority;
+      cache->evictions++;
+      count++;
+
+      evict(victim->variant, data);
+
+      assert(cache->num_variants < num_variants);
+      if (cache->num_variants >= num_variants)
+         break;
+   }
+
+   return count;
+}
+
+
+void
+lp_variant_cache_add_stats(const struct lp_variant_cache *cache,
+                           struct lp_variant_cache_stats *stats)
+{
+   stats->num_variants += cache->num_variants;
+   stats->code_size += cache->code_size;
+   stats->hits += cache->hits;
+   stats->misses += cache->misses;
+   stats->evictions += cache->evictions;
+}
@@ -0,0 +1,142 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Replacement policy for caches of JIT-compiled shader variants.
+ *
+ * Variants are kept within both a count and a JIT code size budget.
+ * Victims are chosen with the GreedyDual-Size algorithm: every entry is
+ * given a priority of clock + cost/size when inserted or used, where cost
+ * is the time it took to compile.  The entry of lowest priority is
+ * evicted and the clock advanced to its priority, so entries age the
+ * longer they stay unused.  With uniform costs this degenerates to LRU.
+ */
+
+#ifndef LP_BLD_VARIANT_CACHE_H
+#define LP_BLD_VARIANT_CACHE_H
+
+
+#include "pipe/p_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Embedded in each cached variant.
+ */
+struct lp_variant_cache_entry
+{
+   struct lp_variant_cache_entry *next, *prev;   /**< most recent first */
+   void *variant;
+   size_t code_size;
+   int64_t cost;   /**< compile time, in usecs */
+   double priority;
+};
+
+
+struct lp_variant_cache
+{
+   struct lp_variant_cache_entry entries;   /**< list head */
+
+   unsigned max_variants;
+   size_t max_code_size;
+
+   unsigned num_variants;
+   size_t code_size;
+   double clock;
+
+   /* Statistics */
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+};
+
+
+struct lp_variant_cache_stats
+{
+   unsigned num_variants;
+   uint64_t code_size;
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+};
+
+
+typedef void
+(*lp_variant_cache_evict_func)(void *variant, void *data);
+
+
+void
+lp_variant_cache_init(struct lp_variant_cache *cache,
+                      unsigned max_variants,
+                      size_t max_code_size);
+
+void
+lp_variant_cache_insert(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        void *variant,
+                        size_t code_size,
+                        int64_t cost);
+
+void
+lp_variant_cache_update(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry,
+                        size_t code_size,
+                        int64_t cost);
+
+void
+lp_variant_cache_hit(struct lp_variant_cache *cache,
+                     struct lp_variant_cache_entry *entry);
+
+void
+lp_variant_cache_remove(struct lp_variant_cache *cache,
+                        struct lp_variant_cache_entry *entry);
+
+boolean
+lp_variant_cache_full(const struct lp_variant_cache *cache);
+
+unsigned
+lp_variant_cache_evict(struct lp_variant_cache *cache,
+                       lp_variant_cache_evict_func evict,
+                       void *data);
+
+void
+lp_variant_cache_add_stats(const struct lp_variant_cache *cache,
+                           struct lp_variant_cache_stats *stats);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* !LP_BLD_VARIANT_CACHE_H */
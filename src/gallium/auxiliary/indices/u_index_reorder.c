@@ -0,0 +1,243 @@
+/*
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * on the rights to use, copy, modify, merge, publish, distribute, sub
+ * license, and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.  IN NO EVENT SHALL
+ * VMWARE AND/OR THEIR SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Triangle list reordering for post-transform vertex cache locality.
+ *
+ * This is the "Tipsify" algorithm from Sander, Nehab and Barczak, "Fast
+ * Triangle Reordering for Vertex Locality and Reduced Overdraw": fan out
+ * from one vertex at a time, emitting all its remaining triangles, and
+ * pick the next fanning vertex among the recently referenced ones which
+ * will still be in a FIFO cache of the given size.
+ */
+
+#include "u_indices.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+static inline unsigned
+get_index(const void *in, unsigned index_size, unsigned i)
+{
+   switch (index_size) {
+   case 1:
+      return ((const ubyte *) in)[i];
+   case 2:
+      return ((const ushort *) in)[i];
+   default:
+      return ((const uint *) in)[i];
+   }
+}
+
+
+static inline void
+put_index(void *out, unsigned index_size, unsigned i, unsigned index)
+{
+   switch (index_size) {
+   case 1:
+      ((ubyte *) out)[i] = (ubyte) index;
+      break;
+   case 2:
+      ((ushort *) out)[i] = (ushort) index;
+      break;
+   default:
+      ((uint *) out)[i] = index;
+      break;
+   }
+}
+
+
+struct tipsify {
+   unsigned num_verts;
+   unsigned cache_size;
+   unsigned time;
+
+   unsigned *live;        /**< per vertex, triangles not emitted yet */
+   unsigned *cache_time;  /**< per vertex, time it entered the cache */
+   unsigned *adj_start;   /**< per vertex, start of its triangles in adj */
+   unsigned *adj;         /**< triangles adjacent to each vertex */
+
+   unsigned *dead_end;    /**< stack of recently referenced vertices */
+   unsigned num_dead_end;
+
+   unsigned cursor;       /**< next vertex to try when stuck */
+};
+
+
+/**
+ * Choose the next vertex to fan out from.
+ * \param cand  vertices of the triangles just emitted
+ * \return the vertex, or ~0 when all triangles have been emitted
+ */
+static unsigned
+tipsify_next_vertex(struct tipsify *t, const unsigned *cand,
+                    unsigned num_cand)
+{
+   unsigned best = ~0u;
+   int best_priority = -1;
+   unsigned i;
+
+   for (i = 0; i < num_cand; i++) {
+      const unsigned v = cand[i];
+      int priority = 0;
+
+      if (!t->live[v])
+         continue;
+
+      /* only consider vertices which will stay in the cache while fanning */
+      if (t->time - t->cache_time[v] + 2 * t->live[v] <= t->cache_size)
+         priority = t->time - t->cache_time[v];
+
+      if (priority > best_priority) {
+         best = v;
+         best_priority = priority;
+      }
+   }
+
+   if (best != ~0u)
+      return best;
+
+   while (t->num_dead_end) {
+      const unsigned v = t->dead_end[--t->num_dead_end];
+      if (t->live[v])
+         return v;
+   }
+
+   while (t->cursor < t->num_verts) {
+      if (t->live[t->cursor])
+         return t->cursor;
+      t->cursor++;
+   }
+
+   return ~0u;
+}
+
+
+/**
+ * Reorder the triangles of a PIPE_PRIM_TRIANGLES index list so that the
+ * vertices they share are referenced close together.  The triangles
+ * themselves, including their winding, are preserved; any trailing
+ * indices which don't make up a triangle are copied unchanged.
+ *
+ * \param in          the input index buffer
+ * \param index_size  size of in and out indices in bytes (1, 2 or 4)
+ * \param nr          number of indices
+ * \param cache_size  size of the FIFO vertex cache to optimize for
+ * \param out         output buffer of nr indices, must not alias in
+ * \return FALSE if out of memory, in which case out is undefined
+ */
+boolean
+u_index_reorder_triangles(const void *in,
+                          unsigned index_size,
+                          unsigned nr,
+                          unsigned cache_size,
+                          void *out)
+{
+   const unsigned num_tris = nr / 3;
+   struct tipsify t;
+   boolean *emitted = NULL;
+   unsigned *cand = NULL;
+   unsigned num_out = 0;
+   unsigned max_index = 0;
+   unsigned v, i, j;
+   boolean ret = FALSE;
+
+   memset(&t, 0, sizeof t);
+
+   for (i = 0; i < num_tris * 3; i++)
+      max_index = MAX2(max_index, get_index(in, index_size, i));
+
+   t.num_verts = max_index + 1;
+   t.cache_size = cache_size;
+   t.time = cache_size + 1;
+
+   t.live = CALLOC(t.num_verts, sizeof(unsigned));
+   t.cache_time = CALLOC(t.num_verts, sizeof(unsigned));
+   t.adj_start = CALLOC(t.num_verts + 1, sizeof(unsigned));
+   t.adj = MALLOC(num_tris * 3 * sizeof(unsigned));
+   t.dead_end = MALLOC(num_tris * 3 * sizeof(unsigned));
+   emitted = CALLOC(num_tris, sizeof(boolean));
+   cand = MALLOC(num_tris * 3 * sizeof(unsigned));
+   if (!t.live || !t.cache_time || !t.adj_start ||
+       (num_tris && (!t.adj || !t.dead_end || !emitted || !cand)))
+      goto out;
+
+   /* vertex to triangle adjacency, as a prefix sum of the live counts */
+   for (i = 0; i < num_tris * 3; i++)
+      t.live[get_index(in, index_size, i)]++;
+
+   for (v = 0; v < t.num_verts; v++)
+      t.adj_start[v + 1] = t.adj_start[v] + t.live[v];
+
+   for (i = 0; i < num_tris * 3; i++) {
+      v = get_index(in, index_size, i);
+      t.adj[t.adj_start[v] + t.cache_time[v]++] = i / 3;
+   }
+   memset(t.cache_time, 0, t.num_verts * sizeof(unsigned));
+
+   v = num_tris ? 0 : ~0u;
+   while (v != ~0u) {
+      unsigned num_cand = 0;
+
+      for (i = t.adj_start[v]; i < t.adj_start[v + 1]; i++) {
+         const unsigned tri = t.adj[i];
+
+         if (emitted[tri])
+            continue;
+
+         for (j = 0; j < 3; j++) {
+            const unsigned w = get_index(in, index_size, tri * 3 + j);
+
+            put_index(out, index_size, num_out++, w);
+            t.dead_end[t.num_dead_end++] = w;
+            cand[num_cand++] = w;
+            t.live[w]--;
+
+            if (t.time - t.cache_time[w] > t.cache_size)
+               t.cache_time[w] = t.time++;
+         }
+
+         emitted[tri] = TRUE;
+      }
+
+      v = tipsify_next_vertex(&t, cand, num_cand);
+   }
+
+   assert(num_out == num_tris * 3);
+
+   for (i = num_out; i < nr; i++)
+      put_index(out, index_size, i, get_index(in, index_size, i));
+
+   ret = TRUE;
+
+out:
+   FREE(t.live);
+   FREE(t.cache_time);
+   FREE(t.adj_start);
+   FREE(t.adj);
+   FREE(t.dead_end);
+   FREE(emitted);
+   FREE(cand);
+   return ret;
+}
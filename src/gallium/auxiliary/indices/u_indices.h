@@ -131,4 +131,12 @@ u_unfilled_generator(unsigned prim,
                      unsigned *out_nr,
                      u_generate_func *out_generate);
 
+
+boolean
+u_index_reorder_triangles(const void *in,
+                          unsigned index_size,
+                          unsigned nr,
+                          unsigned cache_size,
+                          void *out);
+
 #endif
@@ -843,6 +843,19 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+static void
+wide_bind_shader(struct tgsi_exec_machine *mach);
+
+static void
+wide_unbind_shader(struct tgsi_exec_machine *mach);
+
+static void
+ops_bind_shader(struct tgsi_exec_machine *mach);
+
+static void
+ops_unbind_shader(struct tgsi_exec_machine *mach);
+
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -881,6 +894,8 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      ops_unbind_shader(mach);
+      wide_unbind_shader(mach);
       return;
    }
 
@@ -1020,6 +1035,9 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   ops_bind_shader(mach);
+   wide_bind_shader(mach);
 }
 
 
@@ -1086,6 +1104,11 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
       align_free(mach->Inputs);
       align_free(mach->Outputs);
 
+      ops_unbind_shader(mach);
+      wide_unbind_shader(mach);
+      align_free(mach->WideInputs);
+      align_free(mach->WideOutputs);
+
       align_free(mach);
    }
 }
@@ -5130,6 +5153,44 @@ exec_instruction(
 }
 
 
+/*
+ * Pre-decoded instructions, see ops_bind_shader().
+ */
+
+struct tgsi_exec_op;
+
+typedef void (* tgsi_exec_op_func)(struct tgsi_exec_machine *mach,
+                                   const struct tgsi_exec_op *op,
+                                   int *pc);
+
+struct tgsi_exec_op_src
+{
+   /** Source channels after swizzling, NULL for constants */
+   const union tgsi_exec_channel *chan[TGSI_NUM_CHANNELS];
+   /** Constant buffer offsets after swizzling */
+   int pos[TGSI_NUM_CHANNELS];
+   ubyte constbuf;
+   ubyte absolute;
+   ubyte negate;
+};
+
+struct tgsi_exec_op
+{
+   tgsi_exec_op_func func;
+   const struct tgsi_full_instruction *inst;
+   union {
+      micro_unary_op unary;
+      micro_binary_op binary;
+      micro_trinary_op trinary;
+   } micro;
+   enum tgsi_exec_datatype src_datatype;
+   struct tgsi_exec_vector *dst;  /**< NULL if writemask is zero */
+   ubyte writemask;
+   ubyte saturate;
+   struct tgsi_exec_op_src src[3];
+};
+
+
 /**
  * Run TGSI interpreter.
  * \return bitmask of "alive" quad components
@@ -5194,7 +5255,14 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach )
 #endif
 
          assert(pc < (int) mach->NumInstructions);
-         exec_instruction(mach, mach->Instructions + pc, &pc);
+         if (mach->Ops) {
+            const struct tgsi_exec_op *op = &mach->Ops[pc];
+
+            op->func(mach, op, &pc);
+         }
+         else {
+            exec_instruction(mach, mach->Instructions + pc, &pc);
+         }
 
 #if DEBUG_EXECUTION
          for (i = 0; i < TGSI_EXEC_NUM_TEMPS + TGSI_EXEC_NUM_TEMP_EXTRAS; i++) {
@@ -5260,3 +5328,1734 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach )
 
    return ~mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 }
+
+
+/*
+ * Wide execution mode.
+ *
+ * tgsi_exec_machine_run() pays for instruction dispatch and operand decoding
+ * once per quad, which dominates when vertex shaders are run over long
+ * vertex arrays.  The wide mode runs up to TGSI_EXEC_MAX_LANES elements per
+ * dispatch instead: every instruction is decoded once at bind time, its
+ * source channels are gathered for all quads, the same micro ops as above
+ * are applied quad by quad and the results are stored under a per-lane
+ * mask.  The results are thus bit-identical to those of the quad path.
+ *
+ * Only vertex shaders without loops, subroutines, texturing, predicates,
+ * doubles or indirect addressing (other than of constants) are handled;
+ * IF/UIF/ELSE/ENDIF only update the lane mask, as in the quad path.
+ * Everything else keeps using tgsi_exec_machine_run().
+ */
+
+enum tgsi_exec_wide_kind {
+   WIDE_NOP,
+   WIDE_MOV,
+   WIDE_ADD,
+   WIDE_MUL,
+   WIDE_MAD,
+   WIDE_SCALAR_UNARY,
+   WIDE_SCALAR_BINARY,
+   WIDE_VECTOR_UNARY,
+   WIDE_VECTOR_BINARY,
+   WIDE_VECTOR_TRINARY,
+   WIDE_DP2,
+   WIDE_DP3,
+   WIDE_DP4,
+   WIDE_DPH,
+   WIDE_XPD,
+   WIDE_DST,
+   WIDE_LIT,
+   WIDE_EXP,
+   WIDE_LOG,
+   WIDE_IF,
+   WIDE_UIF,
+   WIDE_ELSE,
+   WIDE_ENDIF
+};
+
+struct tgsi_exec_wide_inst
+{
+   const struct tgsi_full_instruction *inst;
+   enum tgsi_exec_wide_kind kind;
+   enum tgsi_exec_datatype dst_datatype;
+   enum tgsi_exec_datatype src_datatype;
+   union {
+      micro_unary_op unary;
+      micro_binary_op binary;
+      micro_trinary_op trinary;
+   } op;
+};
+
+static void
+wide_op(struct tgsi_exec_wide_inst *wi,
+        enum tgsi_exec_wide_kind kind,
+        enum tgsi_exec_datatype dst_datatype,
+        enum tgsi_exec_datatype src_datatype)
+{
+   wi->kind = kind;
+   wi->dst_datatype = dst_datatype;
+   wi->src_datatype = src_datatype;
+}
+
+static void
+wide_unary(struct tgsi_exec_wide_inst *wi,
+           enum tgsi_exec_wide_kind kind,
+           micro_unary_op op,
+           enum tgsi_exec_datatype dst_datatype,
+           enum tgsi_exec_datatype src_datatype)
+{
+   wide_op(wi, kind, dst_datatype, src_datatype);
+   wi->op.unary = op;
+}
+
+static void
+wide_binary(struct tgsi_exec_wide_inst *wi,
+            enum tgsi_exec_wide_kind kind,
+            micro_binary_op op,
+            enum tgsi_exec_datatype dst_datatype,
+            enum tgsi_exec_datatype src_datatype)
+{
+   wide_op(wi, kind, dst_datatype, src_datatype);
+   wi->op.binary = op;
+}
+
+static void
+wide_trinary(struct tgsi_exec_wide_inst *wi,
+             micro_trinary_op op,
+             enum tgsi_exec_datatype dst_datatype,
+             enum tgsi_exec_datatype src_datatype)
+{
+   wide_op(wi, WIDE_VECTOR_TRINARY, dst_datatype, src_datatype);
+   wi->op.trinary = op;
+}
+
+/**
+ * Translate an opcode to its wide handler, mirroring exec_instruction().
+ * \return FALSE if the opcode is only supported by the quad path
+ */
+static boolean
+wide_decode_opcode(struct tgsi_exec_wide_inst *wi, unsigned opcode)
+{
+   const enum tgsi_exec_datatype f = TGSI_EXEC_DATA_FLOAT;
+   const enum tgsi_exec_datatype i = TGSI_EXEC_DATA_INT;
+   const enum tgsi_exec_datatype u = TGSI_EXEC_DATA_UINT;
+
+   switch (opcode) {
+   case TGSI_OPCODE_NOP:
+      wide_op(wi, WIDE_NOP, f, f);
+      break;
+   case TGSI_OPCODE_MOV:
+      wide_unary(wi, WIDE_MOV, micro_mov, u, f);
+      break;
+   case TGSI_OPCODE_ADD:
+      wide_binary(wi, WIDE_ADD, micro_add, f, f);
+      break;
+   case TGSI_OPCODE_MUL:
+      wide_binary(wi, WIDE_MUL, micro_mul, f, f);
+      break;
+   case TGSI_OPCODE_MAD:
+      wide_op(wi, WIDE_MAD, f, f);
+      wi->op.trinary = micro_mad;
+      break;
+   case TGSI_OPCODE_DP2:
+      wide_op(wi, WIDE_DP2, f, f);
+      break;
+   case TGSI_OPCODE_DP3:
+      wide_op(wi, WIDE_DP3, f, f);
+      break;
+   case TGSI_OPCODE_DP4:
+      wide_op(wi, WIDE_DP4, f, f);
+      break;
+   case TGSI_OPCODE_DPH:
+      wide_op(wi, WIDE_DPH, f, f);
+      break;
+   case TGSI_OPCODE_XPD:
+      wide_op(wi, WIDE_XPD, f, f);
+      break;
+   case TGSI_OPCODE_DST:
+      wide_op(wi, WIDE_DST, f, f);
+      break;
+   case TGSI_OPCODE_LIT:
+      wide_op(wi, WIDE_LIT, f, f);
+      break;
+   case TGSI_OPCODE_EXP:
+      wide_op(wi, WIDE_EXP, f, f);
+      break;
+   case TGSI_OPCODE_LOG:
+      wide_op(wi, WIDE_LOG, f, f);
+      break;
+   case TGSI_OPCODE_IF:
+      wide_op(wi, WIDE_IF, f, f);
+      break;
+   case TGSI_OPCODE_UIF:
+      wide_op(wi, WIDE_UIF, i, i);
+      break;
+   case TGSI_OPCODE_ELSE:
+      wide_op(wi, WIDE_ELSE, f, f);
+      break;
+   case TGSI_OPCODE_ENDIF:
+      wide_op(wi, WIDE_ENDIF, f, f);
+      break;
+
+   case TGSI_OPCODE_RCP:
+      wide_unary(wi, WIDE_SCALAR_UNARY, micro_rcp, f, f);
+      break;
+   case TGSI_OPCODE_RSQ:
+      wide_unary(wi, WIDE_SCALAR_UNARY, micro_rsq, f, f);
+      break;
+   case TGSI_OPCODE_SQRT:
+      wide_unary(wi, WIDE_SCALAR_UNARY, micro_sqrt, f, f);
+      break;
+   case TGSI_OPCODE_EX2:
+      wide_unary(wi, WIDE_SCALAR_UNARY, micro_exp2, f, f);
+      break;
+   case TGSI_OPCODE_LG2:
+      wide_unary(wi, WIDE_SCALAR_UNARY, micro_lg2, f, f);
+      break;
+   case TGSI_OPCODE_SIN:
+      wide_unary(wi, WIDE_SCALAR_UNARY, micro_sin, f, f);
+      break;
+   case TGSI_OPCODE_COS:
+      wide_unary(wi, WIDE_SCALAR_UNARY, micro_cos, f, f);
+      break;
+   case TGSI_OPCODE_POW:
+      wide_binary(wi, WIDE_SCALAR_BINARY, micro_pow, f, f);
+      break;
+
+   case TGSI_OPCODE_ARL:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_arl, i, f);
+      break;
+   case TGSI_OPCODE_ARR:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_arr, i, f);
+      break;
+   case TGSI_OPCODE_UARL:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_uarl, i, u);
+      break;
+   case TGSI_OPCODE_FRC:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_frc, f, f);
+      break;
+   case TGSI_OPCODE_FLR:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_flr, f, f);
+      break;
+   case TGSI_OPCODE_ROUND:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_rnd, f, f);
+      break;
+   case TGSI_OPCODE_CEIL:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_ceil, f, f);
+      break;
+   case TGSI_OPCODE_TRUNC:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_trunc, f, f);
+      break;
+   case TGSI_OPCODE_ABS:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_abs, f, f);
+      break;
+   case TGSI_OPCODE_SSG:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_sgn, f, f);
+      break;
+   case TGSI_OPCODE_I2F:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_i2f, f, i);
+      break;
+   case TGSI_OPCODE_U2F:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_u2f, f, u);
+      break;
+   case TGSI_OPCODE_F2I:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_f2i, i, f);
+      break;
+   case TGSI_OPCODE_F2U:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_f2u, u, f);
+      break;
+   case TGSI_OPCODE_NOT:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_not, u, u);
+      break;
+   case TGSI_OPCODE_INEG:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_ineg, i, i);
+      break;
+   case TGSI_OPCODE_IABS:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_iabs, i, i);
+      break;
+   case TGSI_OPCODE_ISSG:
+      wide_unary(wi, WIDE_VECTOR_UNARY, micro_isgn, i, i);
+      break;
+
+   case TGSI_OPCODE_SUB:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_sub, f, f);
+      break;
+   case TGSI_OPCODE_DIV:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_div, f, f);
+      break;
+   case TGSI_OPCODE_MIN:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_min, f, f);
+      break;
+   case TGSI_OPCODE_MAX:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_max, f, f);
+      break;
+   case TGSI_OPCODE_SLT:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_slt, f, f);
+      break;
+   case TGSI_OPCODE_SGE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_sge, f, f);
+      break;
+   case TGSI_OPCODE_SEQ:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_seq, f, f);
+      break;
+   case TGSI_OPCODE_SGT:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_sgt, f, f);
+      break;
+   case TGSI_OPCODE_SLE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_sle, f, f);
+      break;
+   case TGSI_OPCODE_SNE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_sne, f, f);
+      break;
+   case TGSI_OPCODE_FSEQ:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_fseq, u, f);
+      break;
+   case TGSI_OPCODE_FSGE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_fsge, u, f);
+      break;
+   case TGSI_OPCODE_FSLT:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_fslt, u, f);
+      break;
+   case TGSI_OPCODE_FSNE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_fsne, u, f);
+      break;
+   case TGSI_OPCODE_SHL:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_shl, u, u);
+      break;
+   case TGSI_OPCODE_AND:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_and, u, u);
+      break;
+   case TGSI_OPCODE_OR:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_or, u, u);
+      break;
+   case TGSI_OPCODE_XOR:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_xor, u, u);
+      break;
+   case TGSI_OPCODE_MOD:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_mod, i, i);
+      break;
+   case TGSI_OPCODE_IDIV:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_idiv, i, i);
+      break;
+   case TGSI_OPCODE_IMAX:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_imax, i, i);
+      break;
+   case TGSI_OPCODE_IMIN:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_imin, i, i);
+      break;
+   case TGSI_OPCODE_ISGE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_isge, i, i);
+      break;
+   case TGSI_OPCODE_ISHR:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_ishr, i, i);
+      break;
+   case TGSI_OPCODE_ISLT:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_islt, i, i);
+      break;
+   case TGSI_OPCODE_UADD:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_uadd, i, i);
+      break;
+   case TGSI_OPCODE_UDIV:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_udiv, u, u);
+      break;
+   case TGSI_OPCODE_UMAX:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_umax, u, u);
+      break;
+   case TGSI_OPCODE_UMIN:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_umin, u, u);
+      break;
+   case TGSI_OPCODE_UMOD:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_umod, u, u);
+      break;
+   case TGSI_OPCODE_UMUL:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_umul, u, u);
+      break;
+   case TGSI_OPCODE_IMUL_HI:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_imul_hi, i, i);
+      break;
+   case TGSI_OPCODE_UMUL_HI:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_umul_hi, u, u);
+      break;
+   case TGSI_OPCODE_USEQ:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_useq, u, u);
+      break;
+   case TGSI_OPCODE_USGE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_usge, u, u);
+      break;
+   case TGSI_OPCODE_USHR:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_ushr, u, u);
+      break;
+   case TGSI_OPCODE_USLT:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_uslt, u, u);
+      break;
+   case TGSI_OPCODE_USNE:
+      wide_binary(wi, WIDE_VECTOR_BINARY, micro_usne, u, u);
+      break;
+
+   case TGSI_OPCODE_LRP:
+      wide_trinary(wi, micro_lrp, f, f);
+      break;
+   case TGSI_OPCODE_CMP:
+      wide_trinary(wi, micro_cmp, f, f);
+      break;
+   case TGSI_OPCODE_CLAMP:
+      wide_trinary(wi, micro_clamp, f, f);
+      break;
+   case TGSI_OPCODE_UMAD:
+      wide_trinary(wi, micro_umad, u, u);
+      break;
+   case TGSI_OPCODE_UCMP:
+      wide_trinary(wi, micro_ucmp, u, u);
+      break;
+   case TGSI_OPCODE_IBFE:
+      wide_trinary(wi, micro_ibfe, i, i);
+      break;
+   case TGSI_OPCODE_UBFE:
+      wide_trinary(wi, micro_ubfe, u, u);
+      break;
+
+   default:
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+static boolean
+wide_src_supported(const struct tgsi_full_src_register *reg, uint *num_temps)
+{
+   const int index = reg->Register.Index;
+
+   if (index < 0)
+      return FALSE;
+
+   if (reg->Register.Dimension &&
+       (reg->Register.File != TGSI_FILE_CONSTANT ||
+        reg->Dimension.Indirect ||
+        reg->Dimension.Index >= PIPE_MAX_CONSTANT_BUFFERS))
+      return FALSE;
+
+   if (reg->Register.Indirect &&
+       (reg->Register.File != TGSI_FILE_CONSTANT ||
+        reg->Indirect.File != TGSI_FILE_ADDRESS ||
+        reg->Indirect.Index >= TGSI_EXEC_NUM_ADDRS))
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_CONSTANT:
+      return TRUE;
+   case TGSI_FILE_INPUT:
+      return index < PIPE_MAX_SHADER_INPUTS;
+   case TGSI_FILE_OUTPUT:
+      return index < PIPE_MAX_SHADER_OUTPUTS;
+   case TGSI_FILE_TEMPORARY:
+      *num_temps = MAX2(*num_temps, (uint) index + 1);
+      return index < TGSI_EXEC_NUM_TEMPS;
+   case TGSI_FILE_IMMEDIATE:
+      return index < TGSI_EXEC_NUM_IMMEDIATES;
+   case TGSI_FILE_SYSTEM_VALUE:
+      return index < TGSI_MAX_MISC_INPUTS;
+   case TGSI_FILE_ADDRESS:
+      return index < TGSI_EXEC_NUM_ADDRS;
+   default:
+      return FALSE;
+   }
+}
+
+static boolean
+wide_dst_supported(const struct tgsi_full_dst_register *reg, uint *num_temps)
+{
+   const int index = reg->Register.Index;
+
+   if (index < 0 || reg->Register.Indirect || reg->Register.Dimension)
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_NULL:
+      return TRUE;
+   case TGSI_FILE_OUTPUT:
+      return index < PIPE_MAX_SHADER_OUTPUTS;
+   case TGSI_FILE_TEMPORARY:
+      *num_temps = MAX2(*num_temps, (uint) index + 1);
+      return index < TGSI_EXEC_NUM_TEMPS;
+   case TGSI_FILE_ADDRESS:
+      return index < TGSI_EXEC_NUM_ADDRS;
+   default:
+      return FALSE;
+   }
+}
+
+static void
+wide_unbind_shader(struct tgsi_exec_machine *mach)
+{
+   FREE(mach->WideInstructions);
+   mach->WideInstructions = NULL;
+   mach->NumWideInstructions = 0;
+
+   align_free(mach->WideTemps);
+   mach->WideTemps = NULL;
+}
+
+/**
+ * Decode the bound shader for tgsi_exec_machine_run_wide(), if it's simple
+ * enough.
+ */
+static void
+wide_bind_shader(struct tgsi_exec_machine *mach)
+{
+   struct tgsi_exec_wide_inst *insts;
+   uint num_insts = 0, num_temps = 0;
+   int depth = 0;
+   uint i, j;
+
+   wide_unbind_shader(mach);
+
+   if (!mach->Lanes ||
+       mach->Processor != TGSI_PROCESSOR_VERTEX ||
+       !mach->NumInstructions)
+      return;
+
+   insts = MALLOC(mach->NumInstructions * sizeof(*insts));
+   if (!insts)
+      return;
+
+   for (i = 0; i < mach->NumInstructions; i++) {
+      const struct tgsi_full_instruction *inst = &mach->Instructions[i];
+      struct tgsi_exec_wide_inst *wi = &insts[num_insts];
+
+      /* Whatever follows END is only reachable through CAL. */
+      if (inst->Instruction.Opcode == TGSI_OPCODE_END)
+         break;
+
+      if (inst->Instruction.Predicate ||
+          inst->Instruction.NumDstRegs > 1 ||
+          !wide_decode_opcode(wi, inst->Instruction.Opcode))
+         goto fail;
+
+      for (j = 0; j < inst->Instruction.NumDstRegs; j++) {
+         if (!wide_dst_supported(&inst->Dst[j], &num_temps))
+            goto fail;
+      }
+      for (j = 0; j < inst->Instruction.NumSrcRegs; j++) {
+         if (!wide_src_supported(&inst->Src[j], &num_temps))
+            goto fail;
+      }
+
+      switch (wi->kind) {
+      case WIDE_IF:
+      case WIDE_UIF:
+         if (++depth > TGSI_EXEC_MAX_COND_NESTING)
+            goto fail;
+         break;
+      case WIDE_ELSE:
+         if (depth < 1)
+            goto fail;
+         break;
+      case WIDE_ENDIF:
+         if (--depth < 0)
+            goto fail;
+         break;
+      default:
+         break;
+      }
+
+      wi->inst = inst;
+      num_insts++;
+   }
+
+   if (depth != 0)
+      goto fail;
+
+   mach->WideTemps = align_malloc(MAX2(num_temps, 1) *
+                                  sizeof(struct tgsi_exec_wide_vector), 16);
+   if (!mach->WideTemps)
+      goto fail;
+
+   mach->WideInstructions = insts;
+   mach->NumWideInstructions = num_insts;
+   return;
+
+fail:
+   FREE(insts);
+}
+
+/**
+ * Allow running up to \p lanes elements per tgsi_exec_machine_run_wide().
+ * Takes effect at the next tgsi_exec_machine_bind_shader(); 0 disables the
+ * wide mode.
+ * \return FALSE if \p lanes isn't a multiple of TGSI_QUAD_SIZE up to
+ *         TGSI_EXEC_MAX_LANES, or out of memory
+ */
+boolean
+tgsi_exec_machine_set_lanes(struct tgsi_exec_machine *mach, unsigned lanes)
+{
+   if (lanes > TGSI_EXEC_MAX_LANES || lanes % TGSI_QUAD_SIZE)
+      return FALSE;
+
+   if (lanes && !mach->WideInputs) {
+      mach->WideInputs = align_malloc(sizeof(struct tgsi_exec_wide_vector) *
+                                      PIPE_MAX_SHADER_INPUTS, 16);
+      mach->WideOutputs = align_malloc(sizeof(struct tgsi_exec_wide_vector) *
+                                       PIPE_MAX_SHADER_OUTPUTS, 16);
+      if (!mach->WideInputs || !mach->WideOutputs) {
+         align_free(mach->WideInputs);
+         align_free(mach->WideOutputs);
+         mach->WideInputs = NULL;
+         mach->WideOutputs = NULL;
+         return FALSE;
+      }
+   }
+
+   mach->Lanes = lanes;
+   return TRUE;
+}
+
+static void
+wide_fetch_constant(const struct tgsi_exec_machine *mach,
+                    union tgsi_exec_wide_channel *chan,
+                    const struct tgsi_full_src_register *reg,
+                    uint swizzle,
+                    uint num_lanes)
+{
+   const uint constbuf = reg->Register.Dimension ? reg->Dimension.Index : 0;
+   const uint *buf = (const uint *) mach->Consts[constbuf];
+   const int size = (int) mach->ConstsSize[constbuf];
+   uint i;
+
+   assert(buf);
+
+   if (!reg->Register.Indirect) {
+      const int pos = reg->Register.Index * 4 + swizzle;
+      const uint value = pos < size ? buf[pos] : 0;
+
+      for (i = 0; i < num_lanes; i++)
+         chan->u[i] = value;
+   }
+   else {
+      const union tgsi_exec_wide_channel *addr =
+         &mach->WideAddrs[reg->Indirect.Index].xyzw[reg->Indirect.Swizzle];
+
+      for (i = 0; i < num_lanes; i++) {
+         /* disabled lanes use index zero, see fetch_source_d() */
+         const int index = (mach->WideExecMask & (1 << i)) ?
+            reg->Register.Index + addr->i[i] : 0;
+         const int pos = index * 4 + swizzle;
+
+         chan->u[i] = index >= 0 && pos < size ? buf[pos] : 0;
+      }
+   }
+}
+
+static void
+wide_fetch(const struct tgsi_exec_machine *mach,
+           union tgsi_exec_wide_channel *chan,
+           const struct tgsi_full_src_register *reg,
+           uint chan_index,
+           enum tgsi_exec_datatype src_datatype,
+           uint num_quads)
+{
+   const uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan_index);
+   const int index = reg->Register.Index;
+   const union tgsi_exec_wide_channel *src = NULL;
+   uint i;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_INPUT:
+      src = &mach->WideInputs[index].xyzw[swizzle];
+      break;
+   case TGSI_FILE_OUTPUT:
+      src = &mach->WideOutputs[index].xyzw[swizzle];
+      break;
+   case TGSI_FILE_TEMPORARY:
+      src = &mach->WideTemps[index].xyzw[swizzle];
+      break;
+   case TGSI_FILE_ADDRESS:
+      src = &mach->WideAddrs[index].xyzw[swizzle];
+      break;
+   case TGSI_FILE_SYSTEM_VALUE:
+      /* no swizzling, as in fetch_src_file_channel() */
+      src = &mach->WideSystemValue[index];
+      break;
+   case TGSI_FILE_IMMEDIATE:
+      for (i = 0; i < num_quads * TGSI_QUAD_SIZE; i++)
+         chan->f[i] = mach->Imms[index][swizzle];
+      break;
+   case TGSI_FILE_CONSTANT:
+      wide_fetch_constant(mach, chan, reg, swizzle,
+                          num_quads * TGSI_QUAD_SIZE);
+      break;
+   default:
+      assert(0);
+      memset(chan, 0, sizeof(*chan));
+   }
+
+   if (src)
+      memcpy(chan, src, num_quads * sizeof(union tgsi_exec_channel));
+
+   if (reg->Register.Absolute) {
+      for (i = 0; i < num_quads; i++) {
+         if (src_datatype == TGSI_EXEC_DATA_FLOAT)
+            micro_abs(&chan->quad[i], &chan->quad[i]);
+         else
+            micro_iabs(&chan->quad[i], &chan->quad[i]);
+      }
+   }
+
+   if (reg->Register.Negate) {
+      for (i = 0; i < num_quads; i++) {
+         if (src_datatype == TGSI_EXEC_DATA_FLOAT)
+            micro_neg(&chan->quad[i], &chan->quad[i]);
+         else
+            micro_ineg(&chan->quad[i], &chan->quad[i]);
+      }
+   }
+}
+
+static void
+wide_store(struct tgsi_exec_machine *mach,
+           const union tgsi_exec_wide_channel *chan,
+           const struct tgsi_full_instruction *inst,
+           uint chan_index,
+           uint num_quads)
+{
+   const struct tgsi_full_dst_register *reg = &inst->Dst[0];
+   const uint num_lanes = num_quads * TGSI_QUAD_SIZE;
+   const uint execmask = mach->WideExecMask;
+   union tgsi_exec_wide_channel *dst;
+   uint i;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_NULL:
+      return;
+   case TGSI_FILE_OUTPUT:
+      dst = &mach->WideOutputs[reg->Register.Index].xyzw[chan_index];
+      break;
+   case TGSI_FILE_TEMPORARY:
+      dst = &mach->WideTemps[reg->Register.Index].xyzw[chan_index];
+      break;
+   case TGSI_FILE_ADDRESS:
+      dst = &mach->WideAddrs[reg->Register.Index].xyzw[chan_index];
+      break;
+   default:
+      assert(0);
+      return;
+   }
+
+   if (!inst->Instruction.Saturate) {
+      if (execmask == (1u << num_lanes) - 1) {
+         memcpy(dst, chan, num_quads * sizeof(union tgsi_exec_channel));
+      }
+      else {
+         for (i = 0; i < num_lanes; i++)
+            if (execmask & (1 << i))
+               dst->i[i] = chan->i[i];
+      }
+   }
+   else {
+      for (i = 0; i < num_lanes; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+   }
+}
+
+/** Store \p chan to all enabled channels of the destination */
+static void
+wide_store_all(struct tgsi_exec_machine *mach,
+               const union tgsi_exec_wide_channel *chan,
+               const struct tgsi_full_instruction *inst,
+               uint num_quads)
+{
+   uint chan_index;
+
+   for (chan_index = 0; chan_index < TGSI_NUM_CHANNELS; chan_index++) {
+      if (inst->Dst[0].Register.WriteMask & (1 << chan_index))
+         wide_store(mach, chan, inst, chan_index, num_quads);
+   }
+}
+
+/** Store the enabled channels of \p vec */
+static void
+wide_store_vector(struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_wide_vector *vec,
+                  const struct tgsi_full_instruction *inst,
+                  uint num_quads)
+{
+   uint chan_index;
+
+   for (chan_index = 0; chan_index < TGSI_NUM_CHANNELS; chan_index++) {
+      if (inst->Dst[0].Register.WriteMask & (1 << chan_index))
+         wide_store(mach, &vec->xyzw[chan_index], inst, chan_index, num_quads);
+   }
+}
+
+/*
+ * The helpers below are inlined into tgsi_exec_machine_run_wide() so that
+ * calls with a constant micro op, like those for MOV/ADD/MUL/MAD, turn into
+ * straight loops over the quads.
+ */
+
+static inline void
+wide_scalar_unary(struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_wide_inst *wi,
+                  micro_unary_op op,
+                  uint num_quads)
+{
+   union tgsi_exec_wide_channel src, dst;
+   uint q;
+
+   wide_fetch(mach, &src, &wi->inst->Src[0], TGSI_CHAN_X, wi->src_datatype,
+              num_quads);
+   for (q = 0; q < num_quads; q++)
+      op(&dst.quad[q], &src.quad[q]);
+   wide_store_all(mach, &dst, wi->inst, num_quads);
+}
+
+static inline void
+wide_scalar_binary(struct tgsi_exec_machine *mach,
+                   const struct tgsi_exec_wide_inst *wi,
+                   micro_binary_op op,
+                   uint num_quads)
+{
+   union tgsi_exec_wide_channel src[2], dst;
+   uint q;
+
+   wide_fetch(mach, &src[0], &wi->inst->Src[0], TGSI_CHAN_X, wi->src_datatype,
+              num_quads);
+   wide_fetch(mach, &src[1], &wi->inst->Src[1], TGSI_CHAN_X, wi->src_datatype,
+              num_quads);
+   for (q = 0; q < num_quads; q++)
+      op(&dst.quad[q], &src[0].quad[q], &src[1].quad[q]);
+   wide_store_all(mach, &dst, wi->inst, num_quads);
+}
+
+static inline void
+wide_vector_unary(struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_wide_inst *wi,
+                  micro_unary_op op,
+                  uint num_quads)
+{
+   const struct tgsi_full_instruction *inst = wi->inst;
+   struct tgsi_exec_wide_vector dst;
+   uint chan, q;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
+         union tgsi_exec_wide_channel src;
+
+         wide_fetch(mach, &src, &inst->Src[0], chan, wi->src_datatype,
+                    num_quads);
+         for (q = 0; q < num_quads; q++)
+            op(&dst.xyzw[chan].quad[q], &src.quad[q]);
+      }
+   }
+   wide_store_vector(mach, &dst, inst, num_quads);
+}
+
+static inline void
+wide_vector_binary(struct tgsi_exec_machine *mach,
+                   const struct tgsi_exec_wide_inst *wi,
+                   micro_binary_op op,
+                   uint num_quads)
+{
+   const struct tgsi_full_instruction *inst = wi->inst;
+   struct tgsi_exec_wide_vector dst;
+   uint chan, q;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
+         union tgsi_exec_wide_channel src[2];
+
+         wide_fetch(mach, &src[0], &inst->Src[0], chan, wi->src_datatype,
+                    num_quads);
+         wide_fetch(mach, &src[1], &inst->Src[1], chan, wi->src_datatype,
+                    num_quads);
+         for (q = 0; q < num_quads; q++)
+            op(&dst.xyzw[chan].quad[q], &src[0].quad[q], &src[1].quad[q]);
+      }
+   }
+   wide_store_vector(mach, &dst, inst, num_quads);
+}
+
+static inline void
+wide_vector_trinary(struct tgsi_exec_machine *mach,
+                    const struct tgsi_exec_wide_inst *wi,
+                    micro_trinary_op op,
+                    uint num_quads)
+{
+   const struct tgsi_full_instruction *inst = wi->inst;
+   struct tgsi_exec_wide_vector dst;
+   uint chan, q;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
+         union tgsi_exec_wide_channel src[3];
+
+         wide_fetch(mach, &src[0], &inst->Src[0], chan, wi->src_datatype,
+                    num_quads);
+         wide_fetch(mach, &src[1], &inst->Src[1], chan, wi->src_datatype,
+                    num_quads);
+         wide_fetch(mach, &src[2], &inst->Src[2], chan, wi->src_datatype,
+                    num_quads);
+         for (q = 0; q < num_quads; q++)
+            op(&dst.xyzw[chan].quad[q],
+               &src[0].quad[q], &src[1].quad[q], &src[2].quad[q]);
+      }
+   }
+   wide_store_vector(mach, &dst, inst, num_quads);
+}
+
+/**
+ * DP2, DP3, DP4 and (with \p homogeneous) DPH, with the same order of
+ * operations as exec_dp4() and friends.
+ */
+static inline void
+wide_dp(struct tgsi_exec_machine *mach,
+        const struct tgsi_exec_wide_inst *wi,
+        uint num_chans,
+        boolean homogeneous,
+        uint num_quads)
+{
+   const struct tgsi_full_instruction *inst = wi->inst;
+   union tgsi_exec_wide_channel arg[2], dst;
+   uint chan, q;
+
+   wide_fetch(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT,
+              num_quads);
+   wide_fetch(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT,
+              num_quads);
+   for (q = 0; q < num_quads; q++)
+      micro_mul(&dst.quad[q], &arg[0].quad[q], &arg[1].quad[q]);
+
+   for (chan = TGSI_CHAN_Y; chan < num_chans; chan++) {
+      wide_fetch(mach, &arg[0], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT,
+                 num_quads);
+      wide_fetch(mach, &arg[1], &inst->Src[1], chan, TGSI_EXEC_DATA_FLOAT,
+                 num_quads);
+      for (q = 0; q < num_quads; q++)
+         micro_mad(&dst.quad[q], &arg[0].quad[q], &arg[1].quad[q],
+                   &dst.quad[q]);
+   }
+
+   if (homogeneous) {
+      wide_fetch(mach, &arg[1], &inst->Src[1], TGSI_CHAN_W,
+                 TGSI_EXEC_DATA_FLOAT, num_quads);
+      for (q = 0; q < num_quads; q++)
+         micro_add(&dst.quad[q], &dst.quad[q], &arg[1].quad[q]);
+   }
+
+   wide_store_all(mach, &dst, inst, num_quads);
+}
+
+/**
+ * Fetch the X, Y, Z and W channels of a source operand.
+ */
+static void
+wide_fetch_vector(const struct tgsi_exec_machine *mach,
+                  struct tgsi_exec_wide_vector *vec,
+                  const struct tgsi_full_src_register *reg,
+                  uint num_quads)
+{
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      wide_fetch(mach, &vec->xyzw[chan], reg, chan, TGSI_EXEC_DATA_FLOAT,
+                 num_quads);
+}
+
+/**
+ * XPD, DST, LIT, EXP and LOG: the results are computed per quad exactly as
+ * in exec_xpd() and friends, then stored.
+ */
+static void
+wide_special(struct tgsi_exec_machine *mach,
+             const struct tgsi_exec_wide_inst *wi,
+             uint num_quads)
+{
+   const struct tgsi_full_instruction *inst = wi->inst;
+   struct tgsi_exec_wide_vector a, b, d;
+   uint q;
+
+   wide_fetch_vector(mach, &a, &inst->Src[0], num_quads);
+   if (wi->kind == WIDE_XPD || wi->kind == WIDE_DST)
+      wide_fetch_vector(mach, &b, &inst->Src[1], num_quads);
+
+   for (q = 0; q < num_quads; q++) {
+      union tgsi_exec_channel *dx = &d.xyzw[TGSI_CHAN_X].quad[q];
+      union tgsi_exec_channel *dy = &d.xyzw[TGSI_CHAN_Y].quad[q];
+      union tgsi_exec_channel *dz = &d.xyzw[TGSI_CHAN_Z].quad[q];
+      union tgsi_exec_channel *dw = &d.xyzw[TGSI_CHAN_W].quad[q];
+      const union tgsi_exec_channel *ax = &a.xyzw[TGSI_CHAN_X].quad[q];
+      const union tgsi_exec_channel *ay = &a.xyzw[TGSI_CHAN_Y].quad[q];
+      const union tgsi_exec_channel *az = &a.xyzw[TGSI_CHAN_Z].quad[q];
+      const union tgsi_exec_channel *aw = &a.xyzw[TGSI_CHAN_W].quad[q];
+      union tgsi_exec_channel r[3];
+
+      switch (wi->kind) {
+      case WIDE_XPD:
+         {
+            const union tgsi_exec_channel *bx = &b.xyzw[TGSI_CHAN_X].quad[q];
+            const union tgsi_exec_channel *by = &b.xyzw[TGSI_CHAN_Y].quad[q];
+            const union tgsi_exec_channel *bz = &b.xyzw[TGSI_CHAN_Z].quad[q];
+
+            micro_mul(&r[0], ay, bz);
+            micro_mul(&r[1], az, by);
+            micro_sub(dx, &r[0], &r[1]);
+            micro_mul(&r[0], az, bx);
+            micro_mul(&r[1], bz, ax);
+            micro_sub(dy, &r[0], &r[1]);
+            micro_mul(&r[0], ax, by);
+            micro_mul(&r[1], ay, bx);
+            micro_sub(dz, &r[0], &r[1]);
+            *dw = OneVec;
+         }
+         break;
+
+      case WIDE_DST:
+         *dx = OneVec;
+         micro_mul(dy, ay, &b.xyzw[TGSI_CHAN_Y].quad[q]);
+         *dz = *az;
+         *dw = b.xyzw[TGSI_CHAN_W].quad[q];
+         break;
+
+      case WIDE_LIT:
+         micro_max(&r[1], ay, &ZeroVec);
+         micro_min(&r[2], aw, &P128Vec);
+         micro_max(&r[2], &r[2], &M128Vec);
+         micro_pow(&r[1], &r[1], &r[2]);
+         micro_lt(dz, &ZeroVec, ax, &r[1], &ZeroVec);
+         micro_max(dy, ax, &ZeroVec);
+         *dx = OneVec;
+         *dw = OneVec;
+         break;
+
+      case WIDE_EXP:
+         micro_flr(&r[1], ax);
+         micro_exp2(dx, &r[1]);
+         micro_sub(dy, ax, &r[1]);
+         micro_exp2(dz, ax);
+         *dw = OneVec;
+         break;
+
+      case WIDE_LOG:
+         micro_abs(&r[2], ax);
+         micro_lg2(dz, &r[2]);
+         micro_flr(dx, dz);
+         micro_exp2(&r[0], dx);
+         micro_div(dy, &r[2], &r[0]);
+         *dw = OneVec;
+         break;
+
+      default:
+         assert(0);
+      }
+   }
+
+   wide_store_vector(mach, &d, inst, num_quads);
+}
+
+/**
+ * Run the bound shader on the first \p count elements of the wide inputs.
+ * Only valid if tgsi_exec_machine_is_wide(); \p count must not exceed the
+ * lane count set with tgsi_exec_machine_set_lanes().
+ */
+void
+tgsi_exec_machine_run_wide(struct tgsi_exec_machine *mach, unsigned count)
+{
+   const uint num_quads = (count + TGSI_QUAD_SIZE - 1) / TGSI_QUAD_SIZE;
+   uint cond_stack[TGSI_EXEC_MAX_COND_NESTING];
+   int cond_stack_top = 0;
+   uint i, j;
+
+   assert(tgsi_exec_machine_is_wide(mach));
+   assert(count > 0 && count <= mach->Lanes);
+
+   /* Like tgsi_exec_machine_run(), whole quads are enabled. */
+   mach->WideExecMask = (1u << (num_quads * TGSI_QUAD_SIZE)) - 1;
+
+   for (i = 0; i < mach->NumWideInstructions; i++) {
+      const struct tgsi_exec_wide_inst *wi = &mach->WideInstructions[i];
+
+      switch (wi->kind) {
+      case WIDE_NOP:
+         break;
+      case WIDE_MOV:
+         wide_vector_unary(mach, wi, micro_mov, num_quads);
+         break;
+      case WIDE_ADD:
+         wide_vector_binary(mach, wi, micro_add, num_quads);
+         break;
+      case WIDE_MUL:
+         wide_vector_binary(mach, wi, micro_mul, num_quads);
+         break;
+      case WIDE_MAD:
+         wide_vector_trinary(mach, wi, micro_mad, num_quads);
+         break;
+      case WIDE_SCALAR_UNARY:
+         wide_scalar_unary(mach, wi, wi->op.unary, num_quads);
+         break;
+      case WIDE_SCALAR_BINARY:
+         wide_scalar_binary(mach, wi, wi->op.binary, num_quads);
+         break;
+      case WIDE_VECTOR_UNARY:
+         wide_vector_unary(mach, wi, wi->op.unary, num_quads);
+         break;
+      case WIDE_VECTOR_BINARY:
+         wide_vector_binary(mach, wi, wi->op.binary, num_quads);
+         break;
+      case WIDE_VECTOR_TRINARY:
+         wide_vector_trinary(mach, wi, wi->op.trinary, num_quads);
+         break;
+      case WIDE_DP2:
+         wide_dp(mach, wi, 2, FALSE, num_quads);
+         break;
+      case WIDE_DP3:
+         wide_dp(mach, wi, 3, FALSE, num_quads);
+         break;
+      case WIDE_DP4:
+         wide_dp(mach, wi, 4, FALSE, num_quads);
+         break;
+      case WIDE_DPH:
+         wide_dp(mach, wi, 3, TRUE, num_quads);
+         break;
+      case WIDE_XPD:
+      case WIDE_DST:
+      case WIDE_LIT:
+      case WIDE_EXP:
+      case WIDE_LOG:
+         wide_special(mach, wi, num_quads);
+         break;
+
+      case WIDE_IF:
+      case WIDE_UIF:
+         {
+            union tgsi_exec_wide_channel cond;
+
+            cond_stack[cond_stack_top++] = mach->WideExecMask;
+            wide_fetch(mach, &cond, &wi->inst->Src[0], TGSI_CHAN_X,
+                       wi->src_datatype, num_quads);
+            for (j = 0; j < num_quads * TGSI_QUAD_SIZE; j++) {
+               if (wi->kind == WIDE_IF ? !cond.f[j] : !cond.u[j])
+                  mach->WideExecMask &= ~(1 << j);
+            }
+         }
+         break;
+      case WIDE_ELSE:
+         mach->WideExecMask = ~mach->WideExecMask &
+                              cond_stack[cond_stack_top - 1];
+         break;
+      case WIDE_ENDIF:
+         mach->WideExecMask = cond_stack[--cond_stack_top];
+         break;
+      }
+   }
+
+   assert(cond_stack_top == 0);
+}
+
+
+/*
+ * Pre-decoded instructions.
+ *
+ * exec_instruction() goes through the opcode switch and decodes every
+ * operand in fetch_source() and store_dest() each time an instruction is
+ * run.  ops_bind_shader() does that work once instead: each instruction
+ * becomes a tgsi_exec_op holding the handler to call, the address of every
+ * source channel after swizzling and the destination register.  Immediates
+ * are replicated across the quad so they can be read like any register;
+ * constants are still looked up at run time, as the buffers may change
+ * between runs.
+ *
+ * Instructions with indirect or 2D addressing, predicates, geometry shader
+ * outputs or opcodes without a dedicated handler get exec_op_generic(),
+ * which calls exec_instruction().  Handlers perform the same micro ops in
+ * the same order as exec_instruction(), so the results are unchanged.
+ */
+
+static inline const union tgsi_exec_channel *
+exec_op_fetch(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_op *op,
+              uint src_index,
+              uint chan_index,
+              union tgsi_exec_channel *tmp)
+{
+   const struct tgsi_exec_op_src *src = &op->src[src_index];
+   const union tgsi_exec_channel *chan = src->chan[chan_index];
+
+   if (!chan) {
+      const uint *buf = (const uint *) mach->Consts[src->constbuf];
+      const int pos = src->pos[chan_index];
+      uint value = 0;
+
+      /* An unbound buffer has no size, so only in-range reads need it. */
+      if (pos < (int) mach->ConstsSize[src->constbuf]) {
+         assert(buf);
+         value = buf[pos];
+      }
+
+      tmp->u[0] = tmp->u[1] = tmp->u[2] = tmp->u[3] = value;
+      chan = tmp;
+   }
+
+   if (src->absolute) {
+      if (op->src_datatype == TGSI_EXEC_DATA_FLOAT)
+         micro_abs(tmp, chan);
+      else
+         micro_iabs(tmp, chan);
+      chan = tmp;
+   }
+
+   if (src->negate) {
+      if (op->src_datatype == TGSI_EXEC_DATA_FLOAT)
+         micro_neg(tmp, chan);
+      else
+         micro_ineg(tmp, chan);
+      chan = tmp;
+   }
+
+   return chan;
+}
+
+static inline void
+exec_op_store(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_op *op,
+              const union tgsi_exec_channel *chan,
+              uint chan_index)
+{
+   union tgsi_exec_channel *dst = &op->dst->xyzw[chan_index];
+   const uint execmask = mach->ExecMask;
+   uint i;
+
+   if (!op->saturate) {
+      if (execmask == 0xf) {
+         *dst = *chan;
+      }
+      else {
+         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+            if (execmask & (1 << i))
+               dst->i[i] = chan->i[i];
+      }
+   }
+   else {
+      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+   }
+}
+
+/** Store \p chan to all enabled channels of the destination */
+static inline void
+exec_op_store_all(const struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_op *op,
+                  const union tgsi_exec_channel *chan)
+{
+   uint chan_index;
+
+   for (chan_index = 0; chan_index < TGSI_NUM_CHANNELS; chan_index++) {
+      if (op->writemask & (1 << chan_index))
+         exec_op_store(mach, op, chan, chan_index);
+   }
+}
+
+/** Store the enabled channels of \p vec */
+static inline void
+exec_op_store_vector(const struct tgsi_exec_machine *mach,
+                     const struct tgsi_exec_op *op,
+                     const struct tgsi_exec_vector *vec)
+{
+   uint chan_index;
+
+   for (chan_index = 0; chan_index < TGSI_NUM_CHANNELS; chan_index++) {
+      if (op->writemask & (1 << chan_index))
+         exec_op_store(mach, op, &vec->xyzw[chan_index], chan_index);
+   }
+}
+
+static void
+exec_op_generic(struct tgsi_exec_machine *mach,
+                const struct tgsi_exec_op *op,
+                int *pc)
+{
+   exec_instruction(mach, op->inst, pc);
+}
+
+static inline void
+exec_op_vector_unary_inline(struct tgsi_exec_machine *mach,
+                            const struct tgsi_exec_op *op,
+                            micro_unary_op micro)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         union tgsi_exec_channel tmp;
+
+         micro(&dst.xyzw[chan], exec_op_fetch(mach, op, 0, chan, &tmp));
+      }
+   }
+   exec_op_store_vector(mach, op, &dst);
+}
+
+static inline void
+exec_op_vector_binary_inline(struct tgsi_exec_machine *mach,
+                             const struct tgsi_exec_op *op,
+                             micro_binary_op micro)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         union tgsi_exec_channel tmp[2];
+
+         micro(&dst.xyzw[chan],
+               exec_op_fetch(mach, op, 0, chan, &tmp[0]),
+               exec_op_fetch(mach, op, 1, chan, &tmp[1]));
+      }
+   }
+   exec_op_store_vector(mach, op, &dst);
+}
+
+static inline void
+exec_op_vector_trinary_inline(struct tgsi_exec_machine *mach,
+                              const struct tgsi_exec_op *op,
+                              micro_trinary_op micro)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->writemask & (1 << chan)) {
+         union tgsi_exec_channel tmp[3];
+
+         micro(&dst.xyzw[chan],
+               exec_op_fetch(mach, op, 0, chan, &tmp[0]),
+               exec_op_fetch(mach, op, 1, chan, &tmp[1]),
+               exec_op_fetch(mach, op, 2, chan, &tmp[2]));
+      }
+   }
+   exec_op_store_vector(mach, op, &dst);
+}
+
+/*
+ * The most common opcodes get handlers of their own, so that the micro op
+ * is inlined.
+ */
+
+static void
+exec_op_mov(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_vector_unary_inline(mach, op, micro_mov);
+}
+
+static void
+exec_op_add(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_vector_binary_inline(mach, op, micro_add);
+}
+
+static void
+exec_op_mul(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_vector_binary_inline(mach, op, micro_mul);
+}
+
+static void
+exec_op_mad(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_vector_trinary_inline(mach, op, micro_mad);
+}
+
+static void
+exec_op_vector_unary(struct tgsi_exec_machine *mach,
+                     const struct tgsi_exec_op *op,
+                     int *pc)
+{
+   (*pc)++;
+   exec_op_vector_unary_inline(mach, op, op->micro.unary);
+}
+
+static void
+exec_op_vector_binary(struct tgsi_exec_machine *mach,
+                      const struct tgsi_exec_op *op,
+                      int *pc)
+{
+   (*pc)++;
+   exec_op_vector_binary_inline(mach, op, op->micro.binary);
+}
+
+static void
+exec_op_vector_trinary(struct tgsi_exec_machine *mach,
+                       const struct tgsi_exec_op *op,
+                       int *pc)
+{
+   (*pc)++;
+   exec_op_vector_trinary_inline(mach, op, op->micro.trinary);
+}
+
+static void
+exec_op_scalar_unary(struct tgsi_exec_machine *mach,
+                     const struct tgsi_exec_op *op,
+                     int *pc)
+{
+   union tgsi_exec_channel tmp, dst;
+
+   (*pc)++;
+   op->micro.unary(&dst, exec_op_fetch(mach, op, 0, TGSI_CHAN_X, &tmp));
+   exec_op_store_all(mach, op, &dst);
+}
+
+static void
+exec_op_scalar_binary(struct tgsi_exec_machine *mach,
+                      const struct tgsi_exec_op *op,
+                      int *pc)
+{
+   union tgsi_exec_channel tmp[2], dst;
+
+   (*pc)++;
+   op->micro.binary(&dst,
+                    exec_op_fetch(mach, op, 0, TGSI_CHAN_X, &tmp[0]),
+                    exec_op_fetch(mach, op, 1, TGSI_CHAN_X, &tmp[1]));
+   exec_op_store_all(mach, op, &dst);
+}
+
+/**
+ * DP2, DP3, DP4 and (with \p homogeneous) DPH, with the same order of
+ * operations as exec_dp4() and friends.
+ */
+static inline void
+exec_op_dp_inline(struct tgsi_exec_machine *mach,
+                  const struct tgsi_exec_op *op,
+                  uint num_chans,
+                  boolean homogeneous)
+{
+   union tgsi_exec_channel tmp[2], dst;
+   uint chan;
+
+   micro_mul(&dst,
+             exec_op_fetch(mach, op, 0, TGSI_CHAN_X, &tmp[0]),
+             exec_op_fetch(mach, op, 1, TGSI_CHAN_X, &tmp[1]));
+
+   for (chan = TGSI_CHAN_Y; chan < num_chans; chan++) {
+      micro_mad(&dst,
+                exec_op_fetch(mach, op, 0, chan, &tmp[0]),
+                exec_op_fetch(mach, op, 1, chan, &tmp[1]),
+                &dst);
+   }
+
+   if (homogeneous)
+      micro_add(&dst, &dst, exec_op_fetch(mach, op, 1, TGSI_CHAN_W, &tmp[1]));
+
+   exec_op_store_all(mach, op, &dst);
+}
+
+static void
+exec_op_dp2(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_dp_inline(mach, op, 2, FALSE);
+}
+
+static void
+exec_op_dp3(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_dp_inline(mach, op, 3, FALSE);
+}
+
+static void
+exec_op_dp4(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_dp_inline(mach, op, 4, FALSE);
+}
+
+static void
+exec_op_dph(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op,
+            int *pc)
+{
+   (*pc)++;
+   exec_op_dp_inline(mach, op, 3, TRUE);
+}
+
+/**
+ * Resolve a source register to the addresses of its swizzled channels.
+ * \return FALSE if it has to go through fetch_source()
+ */
+static boolean
+ops_resolve_src(const struct tgsi_exec_machine *mach,
+                struct tgsi_exec_op_src *src,
+                const struct tgsi_full_src_register *reg)
+{
+   const int index = reg->Register.Index;
+   uint chan;
+
+   if (index < 0 || reg->Register.Indirect)
+      return FALSE;
+
+   if (reg->Register.Dimension) {
+      if (reg->Register.File != TGSI_FILE_CONSTANT ||
+          reg->Dimension.Indirect ||
+          reg->Dimension.Index >= PIPE_MAX_CONSTANT_BUFFERS)
+         return FALSE;
+      src->constbuf = reg->Dimension.Index;
+   }
+   else {
+      src->constbuf = 0;
+   }
+
+   src->absolute = reg->Register.Absolute;
+   src->negate = reg->Register.Negate;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      const uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan);
+
+      src->pos[chan] = 0;
+
+      switch (reg->Register.File) {
+      case TGSI_FILE_CONSTANT:
+         src->chan[chan] = NULL;
+         src->pos[chan] = index * 4 + swizzle;
+         break;
+      case TGSI_FILE_INPUT:
+         if (mach->Processor == TGSI_PROCESSOR_GEOMETRY ||
+             index >= PIPE_MAX_SHADER_INPUTS)
+            return FALSE;
+         src->chan[chan] = &mach->Inputs[index].xyzw[swizzle];
+         break;
+      case TGSI_FILE_OUTPUT:
+         if (index >= PIPE_MAX_SHADER_OUTPUTS)
+            return FALSE;
+         src->chan[chan] = &mach->Outputs[index].xyzw[swizzle];
+         break;
+      case TGSI_FILE_TEMPORARY:
+         if (index >= TGSI_EXEC_NUM_TEMPS)
+            return FALSE;
+         src->chan[chan] = &mach->Temps[index].xyzw[swizzle];
+         break;
+      case TGSI_FILE_IMMEDIATE:
+         if (index >= (int) mach->ImmLimit)
+            return FALSE;
+         src->chan[chan] = &mach->ImmVectors[index].xyzw[swizzle];
+         break;
+      case TGSI_FILE_SYSTEM_VALUE:
+         /* no swizzling, as in fetch_src_file_channel() */
+         if (index >= TGSI_MAX_MISC_INPUTS)
+            return FALSE;
+         src->chan[chan] = &mach->SystemValue[index];
+         break;
+      case TGSI_FILE_ADDRESS:
+         if (index >= TGSI_EXEC_NUM_ADDRS)
+            return FALSE;
+         src->chan[chan] = &mach->Addrs[index].xyzw[swizzle];
+         break;
+      default:
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+/**
+ * Resolve the destination register of \p op.
+ * \return FALSE if it has to go through store_dest()
+ */
+static boolean
+ops_resolve_dst(struct tgsi_exec_machine *mach,
+                struct tgsi_exec_op *op,
+                const struct tgsi_full_dst_register *reg)
+{
+   const int index = reg->Register.Index;
+
+   if (index < 0 || reg->Register.Indirect || reg->Register.Dimension)
+      return FALSE;
+
+   op->writemask = reg->Register.WriteMask;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_NULL:
+      op->dst = NULL;
+      op->writemask = 0;
+      return TRUE;
+   case TGSI_FILE_OUTPUT:
+      /* geometry shaders offset outputs by the emitted vertices */
+      if (mach->Processor == TGSI_PROCESSOR_GEOMETRY ||
+          index >= PIPE_MAX_SHADER_OUTPUTS)
+         return FALSE;
+      op->dst = &mach->Outputs[index];
+      return TRUE;
+   case TGSI_FILE_TEMPORARY:
+      if (index >= TGSI_EXEC_NUM_TEMPS)
+         return FALSE;
+      op->dst = &mach->Temps[index];
+      return TRUE;
+   case TGSI_FILE_ADDRESS:
+      if (index >= TGSI_EXEC_NUM_ADDRS)
+         return FALSE;
+      op->dst = &mach->Addrs[index];
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+/**
+ * Pick the handler for an instruction.
+ * \return FALSE if it has to go through exec_instruction()
+ */
+static boolean
+ops_decode(struct tgsi_exec_machine *mach,
+           struct tgsi_exec_op *op,
+           const struct tgsi_full_instruction *inst)
+{
+   struct tgsi_exec_wide_inst wi;
+   uint i;
+
+   if (inst->Instruction.Predicate ||
+       inst->Instruction.NumDstRegs != 1 ||
+       inst->Instruction.NumSrcRegs > Elements(op->src) ||
+       !wide_decode_opcode(&wi, inst->Instruction.Opcode))
+      return FALSE;
+
+   switch (wi.kind) {
+   case WIDE_MOV:
+      op->func = exec_op_mov;
+      break;
+   case WIDE_ADD:
+      op->func = exec_op_add;
+      break;
+   case WIDE_MUL:
+      op->func = exec_op_mul;
+      break;
+   case WIDE_MAD:
+      op->func = exec_op_mad;
+      break;
+   case WIDE_SCALAR_UNARY:
+      op->func = exec_op_scalar_unary;
+      break;
+   case WIDE_SCALAR_BINARY:
+      op->func = exec_op_scalar_binary;
+      break;
+   case WIDE_VECTOR_UNARY:
+      op->func = exec_op_vector_unary;
+      break;
+   case WIDE_VECTOR_BINARY:
+      op->func = exec_op_vector_binary;
+      break;
+   case WIDE_VECTOR_TRINARY:
+      op->func = exec_op_vector_trinary;
+      break;
+   case WIDE_DP2:
+      op->func = exec_op_dp2;
+      break;
+   case WIDE_DP3:
+      op->func = exec_op_dp3;
+      break;
+   case WIDE_DP4:
+      op->func = exec_op_dp4;
+      break;
+   case WIDE_DPH:
+      op->func = exec_op_dph;
+      break;
+   default:
+      return FALSE;
+   }
+
+   memcpy(&op->micro, &wi.op, sizeof(op->micro));
+   op->src_datatype = wi.src_datatype;
+   op->saturate = inst->Instruction.Saturate;
+
+   if (!ops_resolve_dst(mach, op, &inst->Dst[0]))
+      return FALSE;
+
+   for (i = 0; i < inst->Instruction.NumSrcRegs; i++) {
+      if (!ops_resolve_src(mach, &op->src[i], &inst->Src[i]))
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+static void
+ops_unbind_shader(struct tgsi_exec_machine *mach)
+{
+   FREE(mach->Ops);
+   mach->Ops = NULL;
+
+   align_free(mach->ImmVectors);
+   mach->ImmVectors = NULL;
+}
+
+/**
+ * Pre-decode the instructions of the bound shader for
+ * tgsi_exec_machine_run().  On failure, mach->Ops is left NULL and
+ * exec_instruction() is used throughout.
+ */
+static void
+ops_bind_shader(struct tgsi_exec_machine *mach)
+{
+   uint i, chan;
+
+   ops_unbind_shader(mach);
+
+   if (!mach->NumInstructions)
+      return;
+
+   mach->ImmVectors = align_malloc(MAX2(mach->ImmLimit, 1) *
+                                   sizeof(struct tgsi_exec_vector), 16);
+   mach->Ops = MALLOC(mach->NumInstructions * sizeof(struct tgsi_exec_op));
+   if (!mach->ImmVectors || !mach->Ops) {
+      ops_unbind_shader(mach);
+      return;
+   }
+
+   for (i = 0; i < mach->ImmLimit; i++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         union tgsi_exec_channel *imm = &mach->ImmVectors[i].xyzw[chan];
+
+         imm->f[0] = imm->f[1] = imm->f[2] = imm->f[3] = mach->Imms[i][chan];
+      }
+   }
+
+   for (i = 0; i < mach->NumInstructions; i++) {
+      const struct tgsi_full_instruction *inst = &mach->Instructions[i];
+      struct tgsi_exec_op *op = &mach->Ops[i];
+
+      memset(op, 0, sizeof(*op));
+      if (!ops_decode(mach, op, inst))
+         op->func = exec_op_generic;
+      op->inst = inst;
+   }
+}
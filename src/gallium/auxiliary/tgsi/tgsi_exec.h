@@ -77,6 +77,29 @@ struct tgsi_exec_vector
    union tgsi_exec_channel xyzw[TGSI_NUM_CHANNELS];
 };
 
+/**
+ * Maximum number of elements processed by one tgsi_exec_machine_run_wide().
+ */
+#define TGSI_EXEC_MAX_LANES 16
+#define TGSI_EXEC_MAX_QUADS (TGSI_EXEC_MAX_LANES / TGSI_QUAD_SIZE)
+
+/**
+  * A channel of up to TGSI_EXEC_MAX_LANES elements, laid out as consecutive
+  * quads so that the per-quad micro ops can be applied to it.
+  */
+union tgsi_exec_wide_channel
+{
+   union tgsi_exec_channel quad[TGSI_EXEC_MAX_QUADS];
+   float    f[TGSI_EXEC_MAX_LANES];
+   int      i[TGSI_EXEC_MAX_LANES];
+   unsigned u[TGSI_EXEC_MAX_LANES];
+};
+
+struct tgsi_exec_wide_vector
+{
+   union tgsi_exec_wide_channel xyzw[TGSI_NUM_CHANNELS];
+};
+
 /**
  * For fragment programs, information for computing fragment input
  * values from plane equation of the triangle/line.
@@ -205,6 +228,7 @@ struct tgsi_sampler
 #define TGSI_EXEC_NUM_TEMP_R        4
 
 #define TGSI_EXEC_TEMP_ADDR         (TGSI_EXEC_NUM_TEMPS + 8)
+#define TGSI_EXEC_NUM_ADDRS         2
 
 /* predicate register */
 #define TGSI_EXEC_TEMP_P0           (TGSI_EXEC_NUM_TEMPS + 9)
@@ -270,6 +294,9 @@ enum tgsi_break_type {
 #define TGSI_EXEC_MAX_BREAK_STACK (TGSI_EXEC_MAX_LOOP_NESTING + TGSI_EXEC_MAX_SWITCH_NESTING)
 
 
+struct tgsi_exec_op;
+struct tgsi_exec_wide_inst;
+
 /**
  * Run-time virtual machine state for executing TGSI shader.
  */
@@ -362,6 +389,11 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Instructions pre-decoded for tgsi_exec_machine_run() */
+   struct tgsi_exec_op *Ops;
+   /** Immediates replicated across the quad, for the pre-decoded sources */
+   struct tgsi_exec_vector *ImmVectors;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
@@ -369,6 +401,19 @@ struct tgsi_exec_machine
       SamplerViews[PIPE_MAX_SHADER_SAMPLER_VIEWS];
 
    boolean UsedGeometryShader;
+
+   /* Wide execution mode, see tgsi_exec_machine_set_lanes(). */
+   unsigned                      Lanes;     /**< 0 if wide mode is disabled */
+   struct tgsi_exec_wide_vector  *WideInputs;
+   struct tgsi_exec_wide_vector  *WideOutputs;
+   union tgsi_exec_wide_channel  WideSystemValue[TGSI_MAX_MISC_INPUTS];
+
+   /** Decoded instructions, NULL if the bound shader can't run wide */
+   struct tgsi_exec_wide_inst    *WideInstructions;
+   uint                          NumWideInstructions;
+   struct tgsi_exec_wide_vector  *WideTemps;
+   struct tgsi_exec_wide_vector  WideAddrs[TGSI_EXEC_NUM_ADDRS];
+   uint                          WideExecMask;
 };
 
 struct tgsi_exec_machine *
@@ -389,6 +434,23 @@ tgsi_exec_machine_run(
    struct tgsi_exec_machine *mach );
 
 
+boolean
+tgsi_exec_machine_set_lanes(struct tgsi_exec_machine *mach, unsigned lanes);
+
+void
+tgsi_exec_machine_run_wide(struct tgsi_exec_machine *mach, unsigned count);
+
+
+/**
+ * Whether the bound shader can be run with tgsi_exec_machine_run_wide().
+ */
+static inline boolean
+tgsi_exec_machine_is_wide(const struct tgsi_exec_machine *mach)
+{
+   return mach->WideInstructions != NULL;
+}
+
+
 void
 tgsi_exec_machine_free_data(struct tgsi_exec_machine *mach);
 
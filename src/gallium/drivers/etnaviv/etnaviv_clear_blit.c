@@ -386,9 +386,11 @@ static bool etna_try_rs_blit(struct pipe_context *pctx,
       etna_set_state_reloc(ctx->stream, VIVS_TS_COLOR_SURFACE_BASE, &reloc);
 
       etna_set_state(ctx->stream, VIVS_TS_COLOR_CLEAR_VALUE, src->levels[blit_info->src.level].clear_value);
+      etna_shadow_invalidate(&ctx->gpu3d, VIVS_TS_COLOR_CLEAR_VALUE);
    } else {
       etna_set_state(ctx->stream, VIVS_TS_MEM_CONFIG, ts_mem_config);
    }
+   etna_shadow_invalidate(&ctx->gpu3d, VIVS_TS_MEM_CONFIG);
    ctx->dirty |= ETNA_DIRTY_TS;
 
    /* If the width is not aligned to the RS width, but is within our
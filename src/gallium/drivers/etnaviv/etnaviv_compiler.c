@@ -62,6 +62,8 @@
 #include "pipe/p_shader_tokens.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/ralloc.h"
+#include "util/register_allocate.h"
 
 #include <stdio.h>
 #include <sys/types.h>
@@ -159,6 +161,16 @@ struct etna_compile_data
     /* Next free native register, for register allocation */
     uint32_t next_free_native;
 
+    /* Register allocation nodes: declarations coalesced into one native register
+     * share a node, represented by the root declaration in ra_parent. ra_first and
+     * ra_last hold the live interval of the whole node, ra_node its index in the
+     * interference graph.
+     */
+    int ra_parent[ETNA_MAX_DECL];
+    int ra_first[ETNA_MAX_DECL];
+    int ra_last[ETNA_MAX_DECL];
+    int ra_node[ETNA_MAX_DECL];
+
     /* Temporary register for use within translated TGSI instruction,
      * only allocated when needed.
      */
@@ -186,125 +198,156 @@ struct etna_compile_data
 };
 
 /** Register allocation **/
-enum reg_sort_order
-{
-    FIRST_USE_ASC,
-    FIRST_USE_DESC,
-    LAST_USE_ASC,
-    LAST_USE_DESC
-};
 
-/* Augmented register description for sorting */
-struct sort_rec
+/* Allocate a new, unused, native temp register */
+static struct etna_native_reg alloc_new_native_reg(struct etna_compile_data *cd)
 {
-    struct etna_reg_desc *ptr;
-    int key;
-};
+    assert(cd->next_free_native < ETNA_MAX_TEMPS);
+    int rv = cd->next_free_native;
+    cd->next_free_native++;
+    return (struct etna_native_reg){ .valid=1, .rgroup=INST_RGROUP_TEMP, .id=rv };
+}
 
-static int sort_rec_compar(const struct sort_rec *a, const struct sort_rec *b)
+/* Inputs, outputs and temporaries all live in the native temporary register file */
+static bool is_native_temp_candidate(const struct etna_reg_desc *reg)
 {
-    if(a->key < b->key) return -1;
-    if(a->key > b->key) return 1;
-    return 0;
+    return reg->active && (reg->file == TGSI_FILE_TEMPORARY ||
+                           reg->file == TGSI_FILE_INPUT ||
+                           reg->file == TGSI_FILE_OUTPUT);
 }
 
-/* create an index on a register set based on certain criteria. */
-static int sort_registers(
-        struct sort_rec *sorted,
-        struct etna_reg_desc *regs,
-        int count,
-        enum reg_sort_order so)
+/* Live interval of a register, in instruction ids.
+ * Inputs are loaded before the shader starts (even if they are never read),
+ * outputs are read after it ends. As there are no backward branches, a linear
+ * interval is a conservative approximation of the real live range.
+ */
+static void get_live_interval(const struct etna_reg_desc *reg, int *first, int *last)
 {
-    /* pre-populate keys from active registers */
-    int ptr = 0;
-    for(int idx=0; idx<count; ++idx)
+    if(reg->file == TGSI_FILE_INPUT)
     {
-        /* only interested in active registers now; will only assign inactive ones if no
-         * space in active ones */
-        if(regs[idx].active)
-        {
-            sorted[ptr].ptr = &regs[idx];
-            switch(so)
-            {
-            case FIRST_USE_ASC:  sorted[ptr].key = regs[idx].first_use; break;
-            case LAST_USE_ASC:   sorted[ptr].key = regs[idx].last_use; break;
-            case FIRST_USE_DESC: sorted[ptr].key = -regs[idx].first_use; break;
-            case LAST_USE_DESC:  sorted[ptr].key = -regs[idx].last_use; break;
-            }
-            ptr++;
-        }
+        *first = -2;
+        *last = MAX2(reg->last_use, -1);
+    } else {
+        *first = reg->first_use;
+        *last = (reg->file == TGSI_FILE_OUTPUT) ? ETNA_MAX_TOKENS : reg->last_use;
     }
-    /* sort index by key */
-    qsort(sorted, ptr, sizeof(struct sort_rec), (int (*) (const void *, const void *))sort_rec_compar);
-    return ptr;
 }
 
-/* Allocate a new, unused, native temp register */
-static struct etna_native_reg alloc_new_native_reg(struct etna_compile_data *cd)
+/* Two registers can share a native register if one is last read by the
+ * instruction that first writes the other. This is safe as the code generator
+ * reads all sources of a TGSI instruction before it writes the destination.
+ */
+static bool intervals_overlap(int first_a, int last_a, int first_b, int last_b)
 {
-    assert(cd->next_free_native < ETNA_MAX_TEMPS);
-    int rv = cd->next_free_native;
-    cd->next_free_native++;
-    return (struct etna_native_reg){ .valid=1, .rgroup=INST_RGROUP_TEMP, .id=rv };
+    return first_a < last_b && first_b < last_a;
+}
+
+/* Find the declaration representing the register allocation node of declaration idx */
+static int ra_find_node(struct etna_compile_data *cd, int idx)
+{
+    while(cd->ra_parent[idx] != idx)
+    {
+        cd->ra_parent[idx] = cd->ra_parent[cd->ra_parent[idx]];
+        idx = cd->ra_parent[idx];
+    }
+    return idx;
 }
 
-/* assign TEMPs to native registers */
-static void assign_temporaries_to_native(struct etna_compile_data *cd, struct etna_reg_desc *temps, int num_temps)
+static void ra_init_nodes(struct etna_compile_data *cd)
 {
-    for(int idx=0; idx<num_temps; ++idx)
+    for(int idx=0; idx<cd->total_decls; ++idx)
     {
-        temps[idx].native = alloc_new_native_reg(cd);
+        cd->ra_parent[idx] = idx;
+        get_live_interval(&cd->decl[idx], &cd->ra_first[idx], &cd->ra_last[idx]);
     }
 }
 
-/* assign inputs and outputs to temporaries
- * Gallium assumes that the hardware has separate registers for taking input and output,
- * however Vivante GPUs use temporaries both for passing in inputs and passing back outputs.
- * Try to re-use temporary registers where possible.
+/* Merge the node of declaration b into that of a, so that both end up in the same native register */
+static void ra_coalesce_nodes(struct etna_compile_data *cd, int a, int b)
+{
+    a = ra_find_node(cd, a);
+    b = ra_find_node(cd, b);
+    cd->ra_parent[b] = a;
+    cd->ra_first[a] = MIN2(cd->ra_first[a], cd->ra_first[b]);
+    cd->ra_last[a] = MAX2(cd->ra_last[a], cd->ra_last[b]);
+}
+
+/* Assign native registers to all inputs, outputs and temporaries.
+ * This builds an interference graph from the live intervals of the (coalesced)
+ * registers and colors it with the shared register allocator, so that registers
+ * whose live ranges do not overlap share a native register. Registers that
+ * already have a native register assigned (such as the fragment shader position)
+ * are pre-colored.
+ * Returns false if the shader needs more temporaries than any hardware has.
  */
-static void assign_inouts_to_temporaries(struct etna_compile_data *cd, uint file)
+static bool assign_registers_to_native(struct etna_compile_data *cd)
 {
-    bool mode_inputs = (file == TGSI_FILE_INPUT);
-    int inout_ptr = 0, num_inouts;
-    int temp_ptr = 0, num_temps;
-    struct sort_rec inout_order[ETNA_MAX_TEMPS];
-    struct sort_rec temps_order[ETNA_MAX_TEMPS];
-    num_inouts = sort_registers(inout_order,
-            cd->file[file], cd->file_size[file],
-            mode_inputs ? LAST_USE_ASC : FIRST_USE_ASC);
-    num_temps = sort_registers(temps_order,
-            cd->file[TGSI_FILE_TEMPORARY], cd->file_size[TGSI_FILE_TEMPORARY],
-            mode_inputs ? FIRST_USE_ASC : LAST_USE_ASC);
-
-    while(inout_ptr < num_inouts && temp_ptr < num_temps)
+    void *mem_ctx = ralloc_context(NULL);
+    struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, ETNA_MAX_TEMPS, true);
+    unsigned int reg_class = ra_alloc_reg_class(regs);
+    /* t0 is reserved for the position in fragment shaders, even if it is unused */
+    int first_reg = (cd->processor == TGSI_PROCESSOR_FRAGMENT) ? 1 : 0;
+    int num_nodes = 0;
+    bool ret = true;
+
+    for(int r=first_reg; r<ETNA_MAX_TEMPS; ++r)
+        ra_class_add_reg(regs, reg_class, r);
+    ra_set_finalize(regs, NULL);
+
+    for(int idx=0; idx<cd->total_decls; ++idx)
     {
-        struct etna_reg_desc *inout = inout_order[inout_ptr].ptr;
-        struct etna_reg_desc *temp = temps_order[temp_ptr].ptr;
-        if(!inout->active || inout->native.valid) /* Skip if already a native register assigned */
-        {
-            inout_ptr++;
+        if(is_native_temp_candidate(&cd->decl[idx]) && ra_find_node(cd, idx) == idx)
+            cd->ra_node[idx] = num_nodes++;
+    }
+
+    struct ra_graph *g = ra_alloc_interference_graph(regs, num_nodes);
+    ralloc_steal(mem_ctx, g);
+    for(int n=0; n<num_nodes; ++n)
+        ra_set_node_class(g, n, reg_class);
+
+    for(int a=0; a<cd->total_decls; ++a)
+    {
+        const struct etna_reg_desc *reg_a = &cd->decl[a];
+        int first_a, last_a;
+        if(!is_native_temp_candidate(reg_a))
             continue;
-        }
-        /* last usage of this input is before or in same instruction of first use of temporary? */
-        if(mode_inputs ? (inout->last_use <= temp->first_use) :
-                         (inout->first_use >= temp->last_use))
+        int node_a = cd->ra_node[ra_find_node(cd, a)];
+        if(reg_a->native.valid)
+            ra_set_node_reg(g, node_a, reg_a->native.id);
+        get_live_interval(reg_a, &first_a, &last_a);
+        for(int b=a+1; b<cd->total_decls; ++b)
         {
-            /* assign it and advance to next input */
-            inout->native = temp->native;
-            inout_ptr++;
+            const struct etna_reg_desc *reg_b = &cd->decl[b];
+            int first_b, last_b;
+            if(!is_native_temp_candidate(reg_b))
+                continue;
+            int node_b = cd->ra_node[ra_find_node(cd, b)];
+            get_live_interval(reg_b, &first_b, &last_b);
+            if(node_a != node_b && intervals_overlap(first_a, last_a, first_b, last_b))
+                ra_add_node_interference(g, node_a, node_b);
         }
-        temp_ptr++;
     }
-    /* if we couldn't reuse current ones, allocate new temporaries
-     */
-    for(inout_ptr=0; inout_ptr<num_inouts; ++inout_ptr)
+
+    if(!ra_allocate(g))
     {
-        struct etna_reg_desc *inout = inout_order[inout_ptr].ptr;
-        if(inout->active && !inout->native.valid)
-        {
-            inout->native = alloc_new_native_reg(cd);
-        }
+        DBG("Register allocation failed, more than %d temporaries needed", ETNA_MAX_TEMPS);
+        ret = false;
+        goto out;
+    }
+
+    for(int idx=0; idx<cd->total_decls; ++idx)
+    {
+        struct etna_reg_desc *reg = &cd->decl[idx];
+        if(!is_native_temp_candidate(reg))
+            continue;
+        unsigned int id = ra_get_node_reg(g, cd->ra_node[ra_find_node(cd, idx)]);
+        reg->native = (struct etna_native_reg){ .valid=1, .rgroup=INST_RGROUP_TEMP, .id=id };
+        cd->next_free_native = MAX2(cd->next_free_native, id + 1);
     }
+
+out:
+    ralloc_free(mem_ctx);
+    return ret;
 }
 
 /* Allocate an immediate with a certain value and return the index. If
@@ -494,6 +537,21 @@ static void etna_compile_pass_check_usage(struct etna_compile_data *cd)
         case TGSI_TOKEN_TYPE_INSTRUCTION: {
             /* Instruction: iterate over operands of instruction */
             const struct tgsi_full_instruction *inst = &ctx.FullToken.FullInstruction;
+            if(cd->dead_inst[inst_idx])
+            {
+                /* keep the inputs read by removed instructions, so that the shader interface
+                 * does not change, but don't extend their live range */
+                for(int idx=0; idx<inst->Instruction.NumSrcRegs; ++idx)
+                {
+                    if(inst->Src[idx].Register.File != TGSI_FILE_INPUT)
+                        continue;
+                    struct etna_reg_desc *reg_desc = &cd->file[TGSI_FILE_INPUT][inst->Src[idx].Register.Index];
+                    reg_desc->active = true;
+                    reg_desc->usage_mask |= tgsi_util_get_inst_usage_mask(inst, idx);
+                }
+                inst_idx += 1;
+                break;
+            }
             /* iterate over destination registers */
             for(int idx=0; idx<inst->Instruction.NumDstRegs; ++idx)
             {
@@ -535,7 +593,7 @@ static void assign_special_inputs(struct etna_compile_data *cd)
         for(int idx=0; idx<cd->total_decls; ++idx)
         {
             struct etna_reg_desc *reg = &cd->decl[idx];
-            if(reg->active && reg->semantic.Name == TGSI_SEMANTIC_POSITION)
+            if(reg->active && reg->has_semantic && reg->semantic.Name == TGSI_SEMANTIC_POSITION)
             {
                 reg->native.valid = 1;
                 reg->native.rgroup = INST_RGROUP_TEMP;
@@ -557,80 +615,160 @@ static bool etna_mov_check_no_swizzle(const struct tgsi_dst_register dst, const
 
 }
 
-/* Pass -- optimize outputs
- * Mesa tends to generate code like this at the end if their shaders
- *   MOV OUT[1], TEMP[2]
+/* Check that an instruction is a plain register to register copy, which
+ * becomes a no-op if source and destination share a native register.
+ */
+static bool etna_mov_is_plain_copy(const struct tgsi_full_instruction *inst)
+{
+    return inst->Instruction.Opcode == TGSI_OPCODE_MOV &&
+           !inst->Instruction.Saturate &&
+           !inst->Dst[0].Register.Indirect &&
+           !inst->Src[0].Register.Indirect &&
+           !inst->Src[0].Register.Absolute &&
+           !inst->Src[0].Register.Negate &&
+           etna_mov_check_no_swizzle(inst->Dst[0].Register, inst->Src[0].Register);
+}
+
+/* Pass -- eliminate dead code
+ * Remove instructions that only write components of temporaries that are never
+ * read. Removing an instruction can make the instructions computing its sources
+ * dead as well, so repeat until nothing changes.
+ * Reads are tracked per component, so that e.g. computing the unused .w of a
+ * vector does not keep the instruction alive.
+ */
+static void etna_compile_pass_eliminate_dead_code(struct etna_compile_data *cd)
+{
+    struct tgsi_parse_context ctx = {};
+    unsigned status = TGSI_PARSE_OK;
+    uint8_t read_mask[ETNA_MAX_DECL];
+    bool progress;
+
+    do {
+        progress = false;
+        memset(read_mask, 0, sizeof(read_mask));
+
+        /* accumulate the components of each temporary that are read */
+        status = tgsi_parse_init(&ctx, cd->tokens);
+        assert(status == TGSI_PARSE_OK);
+        int inst_idx = 0;
+        while(!tgsi_parse_end_of_tokens(&ctx))
+        {
+            tgsi_parse_token(&ctx);
+            if(ctx.FullToken.Token.Type != TGSI_TOKEN_TYPE_INSTRUCTION)
+                continue;
+            const struct tgsi_full_instruction *inst = &ctx.FullToken.FullInstruction;
+            if(!cd->dead_inst[inst_idx])
+            {
+                for(int idx=0; idx<inst->Instruction.NumSrcRegs; ++idx)
+                {
+                    if(inst->Src[idx].Register.File != TGSI_FILE_TEMPORARY)
+                        continue;
+                    if(inst->Src[idx].Register.Indirect)
+                    {
+                        /* can't tell which temporary is read, give up */
+                        tgsi_parse_free(&ctx);
+                        return;
+                    }
+                    read_mask[inst->Src[idx].Register.Index] |= tgsi_util_get_inst_usage_mask(inst, idx);
+                }
+            }
+            inst_idx += 1;
+        }
+        tgsi_parse_free(&ctx);
+
+        /* kill instructions whose results are never read */
+        status = tgsi_parse_init(&ctx, cd->tokens);
+        assert(status == TGSI_PARSE_OK);
+        inst_idx = 0;
+        while(!tgsi_parse_end_of_tokens(&ctx))
+        {
+            tgsi_parse_token(&ctx);
+            if(ctx.FullToken.Token.Type != TGSI_TOKEN_TYPE_INSTRUCTION)
+                continue;
+            const struct tgsi_full_instruction *inst = &ctx.FullToken.FullInstruction;
+            bool dead = !cd->dead_inst[inst_idx] && inst->Instruction.NumDstRegs > 0;
+            for(int idx=0; idx<inst->Instruction.NumDstRegs && dead; ++idx)
+            {
+                const struct tgsi_dst_register *dst = &inst->Dst[idx].Register;
+                if(dst->File != TGSI_FILE_TEMPORARY || dst->Indirect ||
+                   (dst->WriteMask & read_mask[dst->Index]))
+                    dead = false;
+            }
+            if(dead)
+            {
+                cd->dead_inst[inst_idx] = true;
+                progress = true;
+            }
+            inst_idx += 1;
+        }
+        tgsi_parse_free(&ctx);
+    } while(progress);
+}
+
+/* Pass -- coalesce moves
+ * Mesa tends to generate code like this, especially at the end of shaders
+ *   MOV TEMP[3], TEMP[2]
+ *   MOV OUT[1], TEMP[3]
  *   MOV OUT[0], TEMP[0]
- *   MOV OUT[2], TEMP[1]
- * Recognize if
- * a) there is only a single assignment to an output register and
- * b) the temporary is not used after that
- * Also recognize direct assignment of IN to OUT (passthrough)
+ *   MOV OUT[2], IN[1]
+ * If a plain MOV is the last use of its source and the first use of its
+ * destination, both can be assigned the same native register and the MOV
+ * becomes a no-op. This applies to any combination of temporaries, inputs and
+ * outputs. A direct assignment of an input to an output that is written only
+ * once (passthrough) can always share the register, as inputs are never
+ * written.
  **/
-static void etna_compile_pass_optimize_outputs(struct etna_compile_data *cd)
+static void etna_compile_pass_coalesce_moves(struct etna_compile_data *cd)
 {
     struct tgsi_parse_context ctx = {};
     unsigned status = TGSI_PARSE_OK;
     status = tgsi_parse_init(&ctx, cd->tokens);
     assert(status == TGSI_PARSE_OK);
 
+    ra_init_nodes(cd);
+
     int inst_idx = 0;
     while(!tgsi_parse_end_of_tokens(&ctx))
     {
         tgsi_parse_token(&ctx);
-        switch(ctx.FullToken.Token.Type)
+        if(ctx.FullToken.Token.Type != TGSI_TOKEN_TYPE_INSTRUCTION)
+            continue;
+        const struct tgsi_full_instruction *inst = &ctx.FullToken.FullInstruction;
+        uint dst_file = inst->Dst[0].Register.File;
+        uint src_file = inst->Src[0].Register.File;
+        if(cd->dead_inst[inst_idx] || !etna_mov_is_plain_copy(inst) ||
+           (dst_file != TGSI_FILE_TEMPORARY && dst_file != TGSI_FILE_OUTPUT) ||
+           (src_file != TGSI_FILE_TEMPORARY && src_file != TGSI_FILE_INPUT))
         {
-        case TGSI_TOKEN_TYPE_INSTRUCTION: {
-            const struct tgsi_full_instruction *inst = &ctx.FullToken.FullInstruction;
-            /* iterate over operands */
-            switch(inst->Instruction.Opcode)
+            inst_idx += 1;
+            continue;
+        }
+        struct etna_reg_desc *dst = &cd->file[dst_file][inst->Dst[0].Register.Index];
+        struct etna_reg_desc *src = &cd->file[src_file][inst->Src[0].Register.Index];
+        int dst_idx = dst - cd->decl;
+        int src_idx = src - cd->decl;
+        int dst_node = ra_find_node(cd, dst_idx);
+        int src_node = ra_find_node(cd, src_idx);
+
+        if(dst_node == src_node)
+        {
+            /* copy of a register onto itself */
+            cd->dead_inst[inst_idx] = true;
+        } else if(!dst->native.valid && !src->native.valid) /* not pre-assigned */
+        {
+            /* source node dead after this instruction, destination node not live before it */
+            bool disjoint = cd->ra_last[src_node] <= inst_idx && cd->ra_first[dst_node] >= inst_idx;
+            /* passthrough of an input that was not yet coalesced to an output written only here */
+            bool passthrough = src_file == TGSI_FILE_INPUT && dst_file == TGSI_FILE_OUTPUT &&
+                               src_node == src_idx && dst_node == dst_idx &&
+                               dst->first_use == inst_idx && dst->last_use == inst_idx;
+            if(disjoint || passthrough)
             {
-            case TGSI_OPCODE_MOV: {
-                uint out_idx = inst->Dst[0].Register.Index;
-                uint in_idx = inst->Src[0].Register.Index;
-                /* assignment of temporary to output --
-                 * and the output doesn't yet have a native register assigned
-                 * and the last use of the temporary is this instruction
-                 * and the MOV does not do a swizzle
-                 */
-                if(inst->Dst[0].Register.File == TGSI_FILE_OUTPUT &&
-                   inst->Src[0].Register.File == TGSI_FILE_TEMPORARY &&
-                   !cd->file[TGSI_FILE_OUTPUT][out_idx].native.valid &&
-                   cd->file[TGSI_FILE_TEMPORARY][in_idx].last_use == inst_idx &&
-                   etna_mov_check_no_swizzle(inst->Dst[0].Register, inst->Src[0].Register))
-                {
-                    cd->file[TGSI_FILE_OUTPUT][out_idx].native = cd->file[TGSI_FILE_TEMPORARY][in_idx].native;
-                    /* prevent temp from being re-used for the rest of the shader */
-                    cd->file[TGSI_FILE_TEMPORARY][in_idx].last_use = ETNA_MAX_TOKENS;
-                    /* mark this MOV instruction as a no-op */
-                    cd->dead_inst[inst_idx] = true;
-                }
-                /* direct assignment of input to output --
-                 * and the input or output doesn't yet have a native register assigned
-                 * and the output is only used in this instruction,
-                 * allocate a new register, and associate both input and output to it
-                 * and the MOV does not do a swizzle
-                 */
-                if(inst->Dst[0].Register.File == TGSI_FILE_OUTPUT &&
-                   inst->Src[0].Register.File == TGSI_FILE_INPUT &&
-                   !cd->file[TGSI_FILE_INPUT][in_idx].native.valid &&
-                   !cd->file[TGSI_FILE_OUTPUT][out_idx].native.valid &&
-                   cd->file[TGSI_FILE_OUTPUT][out_idx].last_use == inst_idx &&
-                   cd->file[TGSI_FILE_OUTPUT][out_idx].first_use == inst_idx &&
-                   etna_mov_check_no_swizzle(inst->Dst[0].Register, inst->Src[0].Register))
-                {
-                    cd->file[TGSI_FILE_OUTPUT][out_idx].native =
-                        cd->file[TGSI_FILE_INPUT][in_idx].native =
-                            alloc_new_native_reg(cd);
-                    /* mark this MOV instruction as a no-op */
-                    cd->dead_inst[inst_idx] = true;
-                }
-                } break;
-            default: ;
+                ra_coalesce_nodes(cd, src_idx, dst_idx);
+                cd->dead_inst[inst_idx] = true;
             }
-            inst_idx += 1;
-            } break;
         }
+        inst_idx += 1;
     }
     tgsi_parse_free(&ctx);
 }
@@ -2031,59 +2169,27 @@ bool etna_compile_shader_object(const struct etna_specs* specs, const struct tgs
 
     etna_allocate_decls(cd);
 
+    /* Remove instructions that compute values which are never read */
+    etna_compile_pass_eliminate_dead_code(cd);
+
     /* Pass two -- check usage of temporaries, inputs, outputs */
     etna_compile_pass_check_usage(cd);
 
     assign_special_inputs(cd);
 
-    /* Assign native temp register to TEMPs */
-    assign_temporaries_to_native(cd, cd->file[TGSI_FILE_TEMPORARY], cd->file_size[TGSI_FILE_TEMPORARY]);
-
-    /* optimize outputs */
-    etna_compile_pass_optimize_outputs(cd);
+    /* Coalesce register copies, this turns the MOVs into no-ops */
+    etna_compile_pass_coalesce_moves(cd);
 
     /* XXX assign special inputs: gl_FrontFacing (VARYING_SLOT_FACE)
      *     this is part of RGROUP_INTERNAL
      */
 
-    /* assign inputs: last usage of input should be <= first usage of temp */
-    /*   potential optimization case:
-     *     if single MOV TEMP[y], IN[x] before which temp y is not used, and after which IN[x]
-     *     is not read, temp[y] can be used as input register as-is
-     */
-    /*   sort temporaries by first use
-     *   sort inputs by last usage
-     *   iterate over inputs, temporaries
-     *     if last usage of input <= first usage of temp:
-     *       assign input to temp
-     *       advance input, temporary pointer
-     *     else
-     *       advance temporary pointer
-     *
-     *   potential problem: instruction with multiple inputs of which one is the temp and the other is the input;
-     *      however, as the temp is not used before this, how would this make sense? uninitialized temporaries have an undefined
-     *      value, so this would be ok
-     */
-    assign_inouts_to_temporaries(cd, TGSI_FILE_INPUT);
-
-    /* assign outputs: first usage of output should be >= last usage of temp */
-    /*   potential optimization case:
-     *      if single MOV OUT[x], TEMP[y] (with full write mask, or at least writing all components that are used in
-     *        the shader) after which temp y is no longer used temp[y] can be used as output register as-is
-     *
-     *   potential problem: instruction with multiple outputs of which one is the temp and the other is the output;
-     *      however, as the temp is not used after this, how would this make sense? could just discard the output value
-     */
-    /*   sort temporaries by last use
-     *   sort outputs by first usage
-     *   iterate over outputs, temporaries
-     *     if first usage of output >= last usage of temp:
-     *       assign output to temp
-     *       advance output, temporary pointer
-     *     else
-     *       advance temporary pointer
-     */
-    assign_inouts_to_temporaries(cd, TGSI_FILE_OUTPUT);
+    /* Assign native temp registers to TEMPs, inputs and outputs */
+    if(!assign_registers_to_native(cd))
+    {
+        ret = false;
+        goto out;
+    }
 
     assign_constants_and_immediates(cd);
     assign_texture_units(cd);
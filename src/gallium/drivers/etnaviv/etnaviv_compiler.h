@@ -55,6 +55,7 @@ struct etna_shader_inout
 /* shader object, for linking */
 struct etna_shader_object
 {
+    uint32_t id; /* unique id assigned by the shader cache, 0 if not cached */
     uint processor; /* TGSI_PROCESSOR_... */
     uint32_t code_size; /* code size in uint32 words */
     uint32_t *code;
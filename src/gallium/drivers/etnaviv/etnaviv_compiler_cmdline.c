@@ -29,11 +29,17 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <dirent.h>
 #include <err.h>
 
+#include "os/os_thread.h"
+#include "os/os_time.h"
 #include "tgsi/tgsi_parse.h"
 #include "tgsi/tgsi_text.h"
 #include "tgsi/tgsi_dump.h"
+#include "util/u_atomic.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
 
 #include "etnaviv_internal.h"
 #include "etnaviv_debug.h"
@@ -67,15 +73,25 @@ static int read_file(const char *filename, void **ptr, size_t *size)
 	}
 
 	ret = fstat(fd, &st);
-	if (ret)
-		errx(1, "couldn't stat `%s'", filename);
+	if (ret) {
+		warnx("couldn't stat `%s'", filename);
+		close(fd);
+		return 1;
+	}
+
+	if (st.st_size == 0) {
+		warnx("`%s' is empty", filename);
+		close(fd);
+		return 1;
+	}
 
 	*size = st.st_size;
 	*ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-	if (*ptr == MAP_FAILED)
-		errx(1, "couldn't map `%s'", filename);
-
 	close(fd);
+	if (*ptr == MAP_FAILED) {
+		warnx("couldn't map `%s'", filename);
+		return 1;
+	}
 
 	return 0;
 }
@@ -83,10 +99,174 @@ static int read_file(const char *filename, void **ptr, size_t *size)
 static void print_usage(void)
 {
 	printf("Usage: etnaviv_compiler [OPTIONS]... FILE\n");
+	printf("       etnaviv_compiler [OPTIONS]... --batch DIR\n");
 	printf("    --verbose         - verbose compiler/debug messages\n");
+	printf("    --batch DIR       - compile all shaders in DIR and print statistics\n");
+	printf("    --threads N       - number of compiler threads in batch mode\n");
 	printf("    --help            - show this message\n");
 }
 
+#define MAX_TOKENS 65536
+
+struct batch_shader {
+	char *filename;
+	bool success;
+	unsigned processor;
+	unsigned num_instructions;
+	unsigned num_temps;
+	unsigned num_consts;
+	unsigned num_imms;
+	int64_t compile_time;
+};
+
+struct batch {
+	struct batch_shader *shaders;
+	unsigned num_shaders;
+	int next_shader;
+};
+
+static void batch_compile_one(struct batch_shader *shader)
+{
+	struct etna_shader_object *shader_obj = NULL;
+	struct tgsi_token *toks;
+	void *ptr;
+	size_t size;
+	char *text;
+	int64_t start;
+
+	if (read_file(shader->filename, &ptr, &size))
+		return;
+
+	/* the tgsi text parser wants a terminated string */
+	text = MALLOC(size + 1);
+	toks = MALLOC(MAX_TOKENS * sizeof(*toks));
+	if (!text || !toks)
+		goto out;
+	memcpy(text, ptr, size);
+	text[size] = '\0';
+
+	if (!tgsi_text_translate(text, toks, MAX_TOKENS)) {
+		warnx("could not parse `%s'", shader->filename);
+		goto out;
+	}
+
+	start = os_time_get();
+	shader->success = etna_compile_shader_object(&specs_gc2000, toks, &shader_obj);
+	shader->compile_time = os_time_get() - start;
+
+	if (shader->success) {
+		shader->processor = shader_obj->processor;
+		shader->num_instructions = shader_obj->code_size / 4;
+		shader->num_temps = shader_obj->num_temps;
+		shader->num_consts = shader_obj->const_size;
+		shader->num_imms = shader_obj->imm_size;
+		etna_destroy_shader_object(shader_obj);
+	}
+
+out:
+	FREE(toks);
+	FREE(text);
+	munmap(ptr, size);
+}
+
+static PIPE_THREAD_ROUTINE(batch_thread, param)
+{
+	struct batch *batch = param;
+	int i;
+
+	while ((i = p_atomic_inc_return(&batch->next_shader)) < (int)batch->num_shaders)
+		batch_compile_one(&batch->shaders[i]);
+
+	return 0;
+}
+
+static int compare_shaders(const void *a, const void *b)
+{
+	return strcmp(((const struct batch_shader *)a)->filename,
+		      ((const struct batch_shader *)b)->filename);
+}
+
+static int run_batch(const char *dirname, unsigned num_threads)
+{
+	struct batch batch = { NULL, 0, -1 };
+	pipe_thread threads[64];
+	unsigned i, num_failed = 0, total_instructions = 0;
+	int64_t total_time = 0, wall_time;
+	struct dirent *dent;
+	DIR *dir;
+
+	dir = opendir(dirname);
+	if (!dir)
+		errx(1, "couldn't open directory `%s'", dirname);
+
+	while ((dent = readdir(dir))) {
+		struct batch_shader *shaders;
+		struct stat st;
+		char *path;
+
+		if (asprintf(&path, "%s/%s", dirname, dent->d_name) < 0)
+			errx(1, "out of memory");
+
+		if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+
+		shaders = REALLOC(batch.shaders,
+				  batch.num_shaders * sizeof(*shaders),
+				  (batch.num_shaders + 1) * sizeof(*shaders));
+		if (!shaders)
+			errx(1, "out of memory");
+		batch.shaders = shaders;
+		memset(&shaders[batch.num_shaders], 0, sizeof(*shaders));
+		shaders[batch.num_shaders++].filename = path;
+	}
+	closedir(dir);
+
+	qsort(batch.shaders, batch.num_shaders, sizeof(*batch.shaders), compare_shaders);
+
+	num_threads = MAX2(1, MIN2(num_threads, ARRAY_SIZE(threads)));
+	num_threads = MIN2(num_threads, MAX2(batch.num_shaders, 1));
+
+	wall_time = os_time_get();
+	for (i = 0; i < num_threads; i++)
+		threads[i] = pipe_thread_create(batch_thread, &batch);
+	for (i = 0; i < num_threads; i++)
+		pipe_thread_wait(threads[i]);
+	wall_time = os_time_get() - wall_time;
+
+	printf("%-40s %4s %6s %5s %6s %5s %9s\n",
+	       "shader", "type", "instrs", "temps", "consts", "imms", "time (us)");
+	for (i = 0; i < batch.num_shaders; i++) {
+		struct batch_shader *shader = &batch.shaders[i];
+
+		if (!shader->success) {
+			printf("%-40s FAILED\n", shader->filename);
+			num_failed++;
+			continue;
+		}
+
+		printf("%-40s %4s %6u %5u %6u %5u %9lld\n", shader->filename,
+		       shader->processor == TGSI_PROCESSOR_VERTEX ? "VERT" : "FRAG",
+		       shader->num_instructions, shader->num_temps,
+		       shader->num_consts, shader->num_imms,
+		       (long long)shader->compile_time);
+		total_instructions += shader->num_instructions;
+		total_time += shader->compile_time;
+	}
+
+	printf("%u shaders, %u failed, %u instructions, %lld us compiling, "
+	       "%lld us wall time with %u threads\n",
+	       batch.num_shaders, num_failed, total_instructions,
+	       (long long)total_time, (long long)wall_time, num_threads);
+
+	for (i = 0; i < batch.num_shaders; i++)
+		free(batch.shaders[i].filename);
+	FREE(batch.shaders);
+
+	return num_failed ? 1 : 0;
+}
+
 int main(int argc, char **argv)
 {
 	int ret = 0, n = 1;
@@ -97,6 +277,8 @@ int main(int argc, char **argv)
 	struct etna_shader_object *shader_obj = NULL;
 	void *ptr;
 	size_t size;
+	const char *batch_dir = NULL;
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
 
 	etna_mesa_debug = ETNA_DBG_MSGS;
 
@@ -107,6 +289,18 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (!strcmp(argv[n], "--batch") && n + 1 < argc) {
+			batch_dir = argv[n + 1];
+			n += 2;
+			continue;
+		}
+
+		if (!strcmp(argv[n], "--threads") && n + 1 < argc) {
+			num_threads = atoi(argv[n + 1]);
+			n += 2;
+			continue;
+		}
+
 		if (!strcmp(argv[n], "--help")) {
 			print_usage();
 			return 0;
@@ -115,6 +309,9 @@ int main(int argc, char **argv)
 		break;
 	}
 
+	if (batch_dir)
+		return run_batch(batch_dir, MAX2(num_threads, 1));
+
 	filename = argv[n];
 
 	ret = read_file(filename, &ptr, &size);
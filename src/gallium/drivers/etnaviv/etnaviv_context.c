@@ -238,6 +238,13 @@ static void etna_cmd_stream_reset_notify(struct etna_cmd_stream *stream, void *p
 
     ctx->dirty = ~0UL;
 
+    /* a new command buffer can be executed after any other one, so nothing is
+     * known about the GPU state anymore */
+    if (ctx->state_bytes_saved)
+        DBG_F(ETNA_DBG_FRAME_MSGS, "saved %d bytes of state in submit", ctx->state_bytes_saved);
+    ctx->state_bytes_saved = 0;
+    etna_shadow_invalidate_all(&ctx->gpu3d);
+
     /* go through all the used resources and clear their status flag */
     LIST_FOR_EACH_ENTRY_SAFE(rsc, rsc_tmp, &ctx->used_resources, list) {
         debug_assert(rsc->status != 0);
@@ -30,6 +30,7 @@
 
 #include <stdint.h>
 
+#include "etnaviv_compiler.h"
 #include "etnaviv_tiling.h"
 #include "etnaviv_resource.h"
 #include "indices/u_primconvert.h"
@@ -82,6 +83,15 @@ struct etna_vertexbuf_state {
     uint32_t enabled_mask;
 };
 
+/* Number of vs/fs link results remembered per context */
+#define ETNA_LINK_CACHE_SIZE (8)
+
+struct etna_link_cache_entry
+{
+    uint32_t vs_id, fs_id; /* etna_shader_object ids, 0 if unused */
+    struct etna_shader_link_info link;
+};
+
 /* private opaque context structure */
 struct etna_context
 {
@@ -151,6 +161,9 @@ struct etna_context
     struct etna_shader_object *vs;
     struct etna_shader_object *fs;
 
+    /* recent link results, indexed by a hash of the shader ids */
+    struct etna_link_cache_entry link_cache[ETNA_LINK_CACHE_SIZE];
+
     /* saved parameter-like state. these are mainly kept around for the blitter. */
     struct pipe_framebuffer_state framebuffer_s;
     struct pipe_stencil_ref stencil_ref_s;
@@ -161,6 +174,10 @@ struct etna_context
 
     /* cached state of entire GPU */
     struct etna_3d_state gpu3d;
+
+    /* bytes of state not emitted into the current command buffer because the
+     * GPU already had the values */
+    int state_bytes_saved;
 };
 
 static inline struct etna_context *
@@ -41,13 +41,6 @@
 #include "etnaviv_zsa.h"
 #include "util/u_math.h"
 
-struct etna_coalesce
-{
-    uint32_t start;
-    uint32_t last_reg;
-    uint32_t last_fixp;
-};
-
 /* Queue a STALL command (queues 2 words) */
 static inline void CMD_STALL(struct etna_cmd_stream *stream, uint32_t from, uint32_t to)
 {
@@ -73,77 +66,6 @@ void etna_stall(struct etna_cmd_stream *stream, uint32_t from, uint32_t to)
     }
 }
 
-static void etna_coalesce_start(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
-        uint32_t max)
-{
-    etna_cmd_stream_reserve(stream, max);
-    coalesce->start = etna_cmd_stream_offset(stream);
-    coalesce->last_reg = 0;
-    coalesce->last_fixp = 0;
-}
-
-static void etna_coalesce_end(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce)
-{
-    uint32_t end = etna_cmd_stream_offset(stream);
-    uint32_t size = end - coalesce->start;
-
-    if (size)
-    {
-        uint32_t offset = coalesce->start - 1;
-        uint32_t value = etna_cmd_stream_get(stream, offset);
-
-        value |= VIV_FE_LOAD_STATE_HEADER_COUNT(size);
-        etna_cmd_stream_set(stream, offset, value);
-    }
-
-    /* append needed padding */
-    if (end % 2 == 1)
-        etna_cmd_stream_emit(stream, 0xdeadbeef);
-}
-
-static void check_coalsence(struct etna_cmd_stream *stream,
-        struct etna_coalesce *coalesce, uint32_t reg, uint32_t fixp)
-{
-    if (coalesce->last_reg != 0)
-    {
-        if (((coalesce->last_reg + 4)!= reg) || (coalesce->last_fixp != fixp))
-        {
-            etna_coalesce_end(stream, coalesce);
-            etna_emit_load_state(stream, reg >> 2, 0, fixp);
-            coalesce->start = etna_cmd_stream_offset(stream);
-        }
-    } else {
-        etna_emit_load_state(stream, reg >> 2, 0, fixp);
-        coalesce->start = etna_cmd_stream_offset(stream);
-    }
-
-    coalesce->last_reg = reg;
-    coalesce->last_fixp = fixp;
-}
-
-static inline void etna_coalsence_emit(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
-        uint32_t reg, uint32_t value)
-{
-    check_coalsence(stream, coalesce, reg, 0);
-    etna_cmd_stream_emit(stream, value);
-}
-
-static inline void etna_coalsence_emit_fixp(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
-        uint32_t reg, uint32_t value)
-{
-    check_coalsence(stream, coalesce, reg, 1);
-    etna_cmd_stream_emit(stream, value);
-}
-
-static inline void etna_coalsence_emit_reloc(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
-        uint32_t reg, const struct etna_reloc *r)
-{
-    if (r->bo) {
-        check_coalsence(stream, coalesce, reg, 0);
-        etna_cmd_stream_reloc(stream, r);
-    }
-}
-
 #define EMIT_STATE(state_name, src_value) \
     etna_coalsence_emit(stream, &coalesce, VIVS_##state_name, src_value)
 
@@ -163,7 +85,7 @@ void etna_submit_rs_state(struct etna_context *ctx, const struct compiled_rs_sta
 
     if (screen->specs.pixel_pipes == 1)
     {
-        etna_coalesce_start(stream, &coalesce, 22);
+        etna_coalesce_start(stream, &coalesce, 22, NULL);
         /* 0/1 */ EMIT_STATE(RS_CONFIG, cs->RS_CONFIG);
         /* 2   */ EMIT_STATE_RELOC(RS_SOURCE_ADDR, &cs->source[0]);
         /* 3   */ EMIT_STATE(RS_SOURCE_STRIDE, cs->RS_SOURCE_STRIDE);
@@ -184,7 +106,7 @@ void etna_submit_rs_state(struct etna_context *ctx, const struct compiled_rs_sta
     }
     else if (screen->specs.pixel_pipes == 2)
     {
-        etna_coalesce_start(stream, &coalesce, 34); /* worst case - both pipes multi=1 */
+        etna_coalesce_start(stream, &coalesce, 34, NULL); /* worst case - both pipes multi=1 */
         /* 0/1 */ EMIT_STATE(RS_CONFIG, cs->RS_CONFIG);
         /* 2/3 */ EMIT_STATE(RS_SOURCE_STRIDE, cs->RS_SOURCE_STRIDE);
         /* 4/5 */ EMIT_STATE(RS_DEST_STRIDE, cs->RS_DEST_STRIDE);
@@ -239,7 +161,8 @@ static uint32_t active_samplers_bits(struct etna_context *ctx)
 
 /* Weave state before draw operation. This function merges all the compiled state blocks under
  * the context into one device register state. Parts of this state that are changed since
- * last call (dirty) will be uploaded as state changes in the command buffer.
+ * last call (dirty) will be uploaded as state changes in the command buffer, skipping
+ * registers that already hold the same value according to the shadow in ctx->gpu3d.
  */
 void etna_emit_state(struct etna_context *ctx)
 {
@@ -296,14 +219,15 @@ void etna_emit_state(struct etna_context *ctx)
      * state to make sure it is always rewritten. */
     if (unlikely(dirty & (ETNA_DIRTY_FRAMEBUFFER)))
     {
-        if ((ctx->gpu3d.GL_MULTI_SAMPLE_CONFIG & VIVS_GL_MULTI_SAMPLE_CONFIG_MSAA_SAMPLES__MASK) !=
-           (ctx->framebuffer.GL_MULTI_SAMPLE_CONFIG & VIVS_GL_MULTI_SAMPLE_CONFIG_MSAA_SAMPLES__MASK))
+        if (!etna_shadow_is_valid(&ctx->gpu3d, VIVS_GL_MULTI_SAMPLE_CONFIG, 0) ||
+            (ctx->gpu3d.state[VIVS_GL_MULTI_SAMPLE_CONFIG >> 2] & VIVS_GL_MULTI_SAMPLE_CONFIG_MSAA_SAMPLES__MASK) !=
+            (ctx->framebuffer.GL_MULTI_SAMPLE_CONFIG & VIVS_GL_MULTI_SAMPLE_CONFIG_MSAA_SAMPLES__MASK))
         {
             /* XXX what does the GPU set these states to on MSAA samples change? Does it do the right thing?
-             * (increase/decrease as necessary) or something else? Just set some invalid value until we know for
+             * (increase/decrease as necessary) or something else? Just forget their values until we know for
              * sure. */
-            ctx->gpu3d.PS_INPUT_COUNT = 0xffffffff;
-            ctx->gpu3d.PS_TEMP_REGISTER_CONTROL = 0xffffffff;
+            etna_shadow_invalidate(&ctx->gpu3d, VIVS_PS_INPUT_COUNT);
+            etna_shadow_invalidate(&ctx->gpu3d, VIVS_PS_TEMP_REGISTER_CONTROL);
         }
     }
 
@@ -336,7 +260,7 @@ void etna_emit_state(struct etna_context *ctx)
      */
     struct etna_coalesce coalesce;
 
-    etna_coalesce_start(stream, &coalesce, ETNA_3D_CONTEXT_SIZE);
+    etna_coalesce_start(stream, &coalesce, ETNA_3D_CONTEXT_SIZE, &ctx->gpu3d);
 
     /* begin only EMIT_STATE -- make sure no new etna_reserve calls are done here directly
      *    or indirectly */
@@ -707,7 +631,7 @@ void etna_emit_state(struct etna_context *ctx)
             /*03828*/ EMIT_STATE(GL_VARYING_COMPONENT_USE(x), ctx->shader_state.GL_VARYING_COMPONENT_USE[x]);
         }
     }
-    etna_coalesce_end(stream, &coalesce);
+    ctx->state_bytes_saved += etna_coalesce_end(stream, &coalesce);
     /* end only EMIT_STATE */
 
     /* Insert a FE/PE stall as changing the shader instructions (and maybe
@@ -746,7 +670,7 @@ void etna_emit_state(struct etna_context *ctx)
         /* If new uniforms loaded with current shader, only submit what changed */
         if (dirty & (ETNA_DIRTY_VS_UNIFORMS))
         {
-            etna_coalesce_start(stream, &coalesce, ctx->shader_state.vs_uniforms_size); /* worst case */
+            etna_coalesce_start(stream, &coalesce, ctx->shader_state.vs_uniforms_size, NULL); /* worst case */
             for (int x = 0; x < ctx->shader_state.vs_uniforms_size; ++x)
             {
                 if (ctx->gpu3d.VS_UNIFORMS[x] != ctx->shader_state.VS_UNIFORMS[x])
@@ -759,7 +683,7 @@ void etna_emit_state(struct etna_context *ctx)
         }
         if (dirty & (ETNA_DIRTY_PS_UNIFORMS))
         {
-            etna_coalesce_start(stream, &coalesce, ctx->shader_state.ps_uniforms_size); /* worst case */
+            etna_coalesce_start(stream, &coalesce, ctx->shader_state.ps_uniforms_size, NULL); /* worst case */
             for (int x = 0; x < ctx->shader_state.ps_uniforms_size; ++x)
             {
                 if (ctx->gpu3d.PS_UNIFORMS[x] != ctx->shader_state.PS_UNIFORMS[x])
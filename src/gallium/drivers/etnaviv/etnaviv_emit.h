@@ -29,6 +29,7 @@
 
 #include "hw/cmdstream.xml.h"
 #include "etnaviv_screen.h"
+#include "util/u_math.h"
 
 struct etna_context;
 struct compiled_rs_state;
@@ -77,6 +78,201 @@ static inline void etna_set_state_multi(struct etna_cmd_stream *stream, uint32_t
         etna_cmd_stream_emit(stream, 0);
 }
 
+/* Mark a register as unknown in the shadow, so that the next write is not skipped.
+ * Must be called for shadowed registers that are written outside etna_emit_state. */
+static inline void etna_shadow_invalidate(struct etna_3d_state *shadow, uint32_t reg)
+{
+    if ((reg >> 2) < ETNA_3D_STATE_COUNT)
+        BITSET_CLEAR(shadow->state_valid, reg >> 2);
+}
+
+static inline void etna_shadow_invalidate_all(struct etna_3d_state *shadow)
+{
+    BITSET_ZERO(shadow->state_valid);
+}
+
+static inline bool etna_shadow_is_valid(const struct etna_3d_state *shadow, uint32_t reg, uint32_t fixp)
+{
+    uint32_t idx = reg >> 2;
+
+    return idx < ETNA_3D_STATE_COUNT && BITSET_TEST(shadow->state_valid, idx) &&
+           !BITSET_TEST(shadow->state_fixp, idx) == !fixp;
+}
+
+/* Emission of consecutive registers into as few LOAD_STATE commands as possible.
+ * If a shadow is given, registers that already hold the value are skipped.
+ */
+struct etna_coalesce
+{
+    uint32_t start;
+    uint32_t last_reg;
+    uint32_t last_fixp;
+
+    struct etna_3d_state *shadow;
+    /* stream offset at etna_coalesce_start, and size in words the stream would
+     * have had without the shadow, to compute the number of bytes saved */
+    uint32_t begin;
+    uint32_t unshadowed_size;
+    uint32_t unshadowed_run;
+    uint32_t unshadowed_last_reg;
+    uint32_t unshadowed_last_fixp;
+};
+
+static inline void etna_coalesce_start(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
+        uint32_t max, struct etna_3d_state *shadow)
+{
+    etna_cmd_stream_reserve(stream, max);
+    coalesce->start = etna_cmd_stream_offset(stream);
+    coalesce->last_reg = 0;
+    coalesce->last_fixp = 0;
+    coalesce->shadow = shadow;
+    coalesce->begin = coalesce->start;
+    coalesce->unshadowed_size = 0;
+    coalesce->unshadowed_run = 0;
+    coalesce->unshadowed_last_reg = 0;
+    coalesce->unshadowed_last_fixp = 0;
+}
+
+static inline void etna_coalesce_end_run(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce)
+{
+    uint32_t end = etna_cmd_stream_offset(stream);
+    uint32_t size = end - coalesce->start;
+
+    if (size)
+    {
+        uint32_t offset = coalesce->start - 1;
+        uint32_t value = etna_cmd_stream_get(stream, offset);
+
+        value |= VIV_FE_LOAD_STATE_HEADER_COUNT(size);
+        etna_cmd_stream_set(stream, offset, value);
+    }
+
+    /* append needed padding */
+    if (end % 2 == 1)
+        etna_cmd_stream_emit(stream, 0xdeadbeef);
+}
+
+/* Finish coalesced emission, returns the number of bytes saved by skipping
+ * registers that were already up to date (negative if the skipping forced
+ * more LOAD_STATE headers than it saved). */
+static inline int etna_coalesce_end(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce)
+{
+    etna_coalesce_end_run(stream, coalesce);
+
+    if (!coalesce->shadow)
+        return 0;
+
+    /* header plus values, padded to 64 bit */
+    if (coalesce->unshadowed_run)
+        coalesce->unshadowed_size += align(1 + coalesce->unshadowed_run, 2);
+    return 4 * ((int)coalesce->unshadowed_size - (int)(etna_cmd_stream_offset(stream) - coalesce->begin));
+}
+
+static inline void check_coalsence(struct etna_cmd_stream *stream,
+        struct etna_coalesce *coalesce, uint32_t reg, uint32_t fixp)
+{
+    struct etna_3d_state *shadow = coalesce->shadow;
+
+    if (coalesce->last_reg != 0)
+    {
+        if (shadow && coalesce->last_reg + 8 == reg && coalesce->last_fixp == fixp &&
+            etna_shadow_is_valid(shadow, coalesce->last_reg + 4, fixp))
+        {
+            /* a single skipped register: re-emitting its current value is
+             * cheaper than starting a new LOAD_STATE */
+            etna_cmd_stream_emit(stream, shadow->state[(coalesce->last_reg + 4) >> 2]);
+        }
+        else if (((coalesce->last_reg + 4)!= reg) || (coalesce->last_fixp != fixp))
+        {
+            etna_coalesce_end_run(stream, coalesce);
+            etna_emit_load_state(stream, reg >> 2, 0, fixp);
+            coalesce->start = etna_cmd_stream_offset(stream);
+        }
+    } else {
+        etna_emit_load_state(stream, reg >> 2, 0, fixp);
+        coalesce->start = etna_cmd_stream_offset(stream);
+    }
+
+    coalesce->last_reg = reg;
+    coalesce->last_fixp = fixp;
+}
+
+/* Keep track of the size the stream would have had without the shadow */
+static inline void etna_coalesce_account(struct etna_coalesce *coalesce, uint32_t reg, uint32_t fixp)
+{
+    if (coalesce->unshadowed_run && coalesce->unshadowed_last_reg + 4 == reg &&
+        coalesce->unshadowed_last_fixp == fixp)
+    {
+        coalesce->unshadowed_run++;
+    } else {
+        if (coalesce->unshadowed_run)
+            coalesce->unshadowed_size += align(1 + coalesce->unshadowed_run, 2);
+        coalesce->unshadowed_run = 1;
+    }
+    coalesce->unshadowed_last_reg = reg;
+    coalesce->unshadowed_last_fixp = fixp;
+}
+
+/* Returns true if the register is known to hold the value, otherwise records
+ * the value in the shadow */
+static inline bool etna_coalesce_skip(struct etna_coalesce *coalesce,
+        uint32_t reg, uint32_t value, uint32_t fixp)
+{
+    struct etna_3d_state *shadow = coalesce->shadow;
+    uint32_t idx = reg >> 2;
+
+    if (!shadow)
+        return false;
+
+    etna_coalesce_account(coalesce, reg, fixp);
+    if (idx >= ETNA_3D_STATE_COUNT)
+        return false;
+    if (etna_shadow_is_valid(shadow, reg, fixp) && shadow->state[idx] == value)
+        return true;
+
+    shadow->state[idx] = value;
+    BITSET_SET(shadow->state_valid, idx);
+    if (fixp)
+        BITSET_SET(shadow->state_fixp, idx);
+    else
+        BITSET_CLEAR(shadow->state_fixp, idx);
+    return false;
+}
+
+static inline void etna_coalsence_emit(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
+        uint32_t reg, uint32_t value)
+{
+    if (etna_coalesce_skip(coalesce, reg, value, 0))
+        return;
+    check_coalsence(stream, coalesce, reg, 0);
+    etna_cmd_stream_emit(stream, value);
+}
+
+static inline void etna_coalsence_emit_fixp(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
+        uint32_t reg, uint32_t value)
+{
+    if (etna_coalesce_skip(coalesce, reg, value, 1))
+        return;
+    check_coalsence(stream, coalesce, reg, 1);
+    etna_cmd_stream_emit(stream, value);
+}
+
+static inline void etna_coalsence_emit_reloc(struct etna_cmd_stream *stream, struct etna_coalesce *coalesce,
+        uint32_t reg, const struct etna_reloc *r)
+{
+    if (r->bo) {
+        /* the address is only known after relocation, and the kernel needs to
+         * see every buffer used by a submit, so always emit relocations */
+        if (coalesce->shadow)
+        {
+            etna_coalesce_account(coalesce, reg, 0);
+            etna_shadow_invalidate(coalesce->shadow, reg);
+        }
+        check_coalsence(stream, coalesce, reg, 0);
+        etna_cmd_stream_reloc(stream, r);
+    }
+}
+
 void etna_stall(struct etna_cmd_stream *stream, uint32_t from, uint32_t to);
 
 void etna_submit_rs_state(struct etna_context *ctx, const struct compiled_rs_state *cs);
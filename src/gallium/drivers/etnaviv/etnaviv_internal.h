@@ -29,6 +29,7 @@
 
 #include "hw/state.xml.h"
 #include "hw/state_3d.xml.h"
+#include "util/bitset.h"
 
 #include <libdrm/etnaviv_drmif.h>
 
@@ -230,15 +231,22 @@ struct compiled_shader_state
     uint32_t PS_UNIFORMS[ETNA_MAX_UNIFORMS*4];
 };
 
+/* number of registers below the shader instruction and uniform memories that are shadowed */
+#define ETNA_3D_STATE_COUNT (0x4000 >> 2)
+
 /* state of some 3d and common registers relevant to etna driver */
 struct etna_3d_state
 {
     unsigned vs_uniforms_size;
     unsigned ps_uniforms_size;
 
-    uint32_t /*01008*/ PS_INPUT_COUNT;
-    uint32_t /*0100C*/ PS_TEMP_REGISTER_CONTROL;
-    uint32_t /*03818*/ GL_MULTI_SAMPLE_CONFIG;
+    /* shadow of the registers written by etna_emit_state, indexed by address/4.
+     * Only entries with their bit set in state_valid are known to be in the GPU,
+     * state_fixp records whether they were loaded with the FIXP conversion. */
+    uint32_t state[ETNA_3D_STATE_COUNT];
+    BITSET_DECLARE(state_valid, ETNA_3D_STATE_COUNT);
+    BITSET_DECLARE(state_fixp, ETNA_3D_STATE_COUNT);
+
     uint32_t /*04000*/ VS_INST_MEM[VIVS_VS_INST_MEM__LEN];
     uint32_t /*05000*/ VS_UNIFORMS[VIVS_VS_UNIFORMS__LEN];
     uint32_t /*06000*/ PS_INST_MEM[VIVS_PS_INST_MEM__LEN];
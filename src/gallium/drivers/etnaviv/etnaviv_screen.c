@@ -35,6 +35,7 @@
 #include "etnaviv_debug.h"
 #include "etnaviv_fence.h"
 #include "etnaviv_resource.h"
+#include "etnaviv_shader_cache.h"
 
 #include "util/u_string.h"
 #include "util/u_memory.h"
@@ -71,6 +72,9 @@ static void etna_screen_destroy(struct pipe_screen *pscreen)
 {
     struct etna_screen *screen = etna_screen(pscreen);
 
+    if (screen->shader_cache)
+      etna_shader_cache_destroy(screen->shader_cache);
+
     if (screen->pipe)
       etna_pipe_del(screen->pipe);
 
@@ -650,6 +654,10 @@ etna_screen_create(struct etna_device *dev, struct etna_gpu *gpu)
     if (!etna_get_specs(screen))
         goto fail;
 
+    screen->shader_cache = etna_shader_cache_create();
+    if (!screen->shader_cache)
+        goto fail;
+
     /* Initialize vtable */
     pscreen->destroy = etna_screen_destroy;
     pscreen->get_param = etna_screen_get_param;
@@ -34,6 +34,7 @@
 #include "os/os_thread.h"
 
 struct etna_bo;
+struct etna_shader_cache;
 
 /* Enum with indices for each of the feature words */
 enum viv_features_word
@@ -66,6 +67,8 @@ struct etna_screen {
     uint32_t features[5];
 
     struct etna_specs specs;
+
+    struct etna_shader_cache *shader_cache;
 };
 
 static inline struct etna_screen *
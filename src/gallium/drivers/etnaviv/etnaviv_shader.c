@@ -29,6 +29,8 @@
 #include "etnaviv_context.h"
 #include "etnaviv_compiler.h"
 #include "etnaviv_debug.h"
+#include "etnaviv_screen.h"
+#include "etnaviv_shader_cache.h"
 
 #include "util/u_memory.h"
 #include "util/u_math.h"
@@ -62,12 +64,38 @@ static void etna_fetch_uniforms(struct etna_context *ctx, uint shader)
 }
 
 
+/* Link vs outputs to fs inputs, reusing a previous result for the same pair
+ * of shader objects if there is one. Returns true if the linking fails. */
+static bool etna_link_shader_objects_cached(struct etna_context *ctx, struct etna_shader_link_info *link,
+                                            const struct etna_shader_object *vs, const struct etna_shader_object *fs)
+{
+    struct etna_link_cache_entry *entry;
+
+    /* shader objects that did not come from the cache have no stable id */
+    if(!vs->id || !fs->id)
+        return etna_link_shader_objects(link, vs, fs);
+
+    entry = &ctx->link_cache[(vs->id * 31 + fs->id) % ETNA_LINK_CACHE_SIZE];
+    if(entry->vs_id == vs->id && entry->fs_id == fs->id)
+    {
+        *link = entry->link;
+        return false;
+    }
+
+    if(etna_link_shader_objects(link, vs, fs))
+        return true;
+
+    entry->vs_id = vs->id;
+    entry->fs_id = fs->id;
+    entry->link = *link;
+    return false;
+}
+
 /* Link vs and fs together: fill in shader_state from vs and fs
  * as this function is called every time a new fs or vs is bound, the goal is to do
  * little processing as possible here, and to precompute as much as possible in the
- * vs/fs shader_object.
- * XXX we could cache the link result for a certain set of VS/PS; usually a pair
- * of VS and PS will be used together anyway.
+ * vs/fs shader_object. The vs/fs linkage itself is cached per pair of shader
+ * objects, as usually a pair of VS and PS will be used together anyway.
  */
 void etna_link_shaders(struct etna_context* ctx, struct compiled_shader_state* cs, const struct etna_shader_object* vs, const struct etna_shader_object* fs)
 {
@@ -97,7 +125,7 @@ void etna_link_shaders(struct etna_context* ctx, struct compiled_shader_state* c
 
     /* link vs outputs to fs inputs */
     struct etna_shader_link_info link = {};
-    if(etna_link_shader_objects(&link, vs, fs))
+    if(etna_link_shader_objects_cached(ctx, &link, vs, fs))
     {
         assert(0); /* linking failed: some fs inputs do not have corresponding vs outputs */
     }
@@ -283,17 +311,15 @@ static void etna_set_constant_buffer(struct pipe_context *pctx,
 static void *etna_create_shader_state(struct pipe_context *pctx, const struct pipe_shader_state *pss)
 {
     struct etna_context *ctx = etna_context(pctx);
-    struct etna_shader_object *out = NULL;
 
-    if (etna_compile_shader_object(&ctx->specs, pss->tokens, &out) == false)
-        return NULL;
-    else
-        return out;
+    return etna_shader_cache_get(ctx->screen->shader_cache, &ctx->screen->specs, pss->tokens);
 }
 
 static void etna_delete_shader_state(struct pipe_context *pctx, void *ss)
 {
-    etna_destroy_shader_object((struct etna_shader_object*)ss);
+    struct etna_context *ctx = etna_context(pctx);
+
+    etna_shader_cache_release(ctx->screen->shader_cache, (struct etna_shader_object*)ss);
 }
 
 static void etna_bind_fs_state(struct pipe_context *pctx, void *fss_)
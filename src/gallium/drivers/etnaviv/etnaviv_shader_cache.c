@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2016 Etnaviv Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "etnaviv_shader_cache.h"
+
+#include "etnaviv_compiler.h"
+#include "etnaviv_debug.h"
+
+#include "os/os_thread.h"
+#include "tgsi/tgsi_parse.h"
+#include "util/hash_table.h"
+#include "util/list.h"
+#include "util/mesa-sha1.h"
+#include "util/u_memory.h"
+
+/* Max number of shader objects without users kept in the cache */
+#define ETNA_SHADER_CACHE_UNUSED_MAX (32)
+
+struct etna_shader_cache_entry
+{
+    struct list_head unused; /* link in cache->unused while refcount is zero */
+    unsigned char key[20];
+    struct etna_shader_object *obj;
+    unsigned refcount;
+};
+
+struct etna_shader_cache
+{
+    pipe_mutex lock;
+    struct hash_table *by_key; /* key -> entry */
+    struct hash_table *by_obj; /* shader object -> entry */
+    struct list_head unused; /* entries without users, most recently used first */
+    unsigned num_unused;
+    uint32_t last_id;
+
+    unsigned hits;
+    unsigned misses;
+};
+
+static uint32_t key_hash(const void *key)
+{
+    uint32_t hash;
+
+    /* the key is a SHA-1 already */
+    memcpy(&hash, key, sizeof(hash));
+    return hash;
+}
+
+static bool key_equals(const void *a, const void *b)
+{
+    return memcmp(a, b, 20) == 0;
+}
+
+static uint32_t pointer_hash(const void *key)
+{
+    return _mesa_hash_pointer(key);
+}
+
+static void destroy_entry(struct etna_shader_cache *cache, struct etna_shader_cache_entry *entry)
+{
+    _mesa_hash_table_remove(cache->by_key, _mesa_hash_table_search(cache->by_key, entry->key));
+    _mesa_hash_table_remove(cache->by_obj, _mesa_hash_table_search(cache->by_obj, entry->obj));
+    etna_destroy_shader_object(entry->obj);
+    FREE(entry);
+}
+
+struct etna_shader_cache *etna_shader_cache_create(void)
+{
+    struct etna_shader_cache *cache = CALLOC_STRUCT(etna_shader_cache);
+
+    if(!cache)
+        return NULL;
+
+    pipe_mutex_init(cache->lock);
+    list_inithead(&cache->unused);
+
+    cache->by_key = _mesa_hash_table_create(NULL, key_hash, key_equals);
+    cache->by_obj = _mesa_hash_table_create(NULL, pointer_hash, _mesa_key_pointer_equal);
+    if(!cache->by_key || !cache->by_obj)
+    {
+        etna_shader_cache_destroy(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void etna_shader_cache_destroy(struct etna_shader_cache *cache)
+{
+    if(cache->by_obj)
+    {
+        struct hash_entry *he;
+
+        /* all users should be gone by now */
+        hash_table_foreach(cache->by_obj, he)
+        {
+            struct etna_shader_cache_entry *entry = he->data;
+            etna_destroy_shader_object(entry->obj);
+            FREE(entry);
+        }
+        _mesa_hash_table_destroy(cache->by_obj, NULL);
+    }
+
+    if(cache->by_key)
+        _mesa_hash_table_destroy(cache->by_key, NULL);
+
+    pipe_mutex_destroy(cache->lock);
+
+    DBG_F(ETNA_DBG_COMPILER_MSGS, "shader cache: %u hits, %u misses", cache->hits, cache->misses);
+    FREE(cache);
+}
+
+struct etna_shader_object *etna_shader_cache_get(struct etna_shader_cache *cache,
+                                                 const struct etna_specs *specs,
+                                                 const struct tgsi_token *tokens)
+{
+    struct etna_shader_cache_entry *entry;
+    struct etna_shader_object *obj;
+    struct hash_entry *he;
+    struct mesa_sha1 *ctx;
+    unsigned char key[20];
+
+    ctx = _mesa_sha1_init();
+    if(!ctx)
+        return NULL;
+    _mesa_sha1_update(ctx, specs, sizeof(*specs));
+    _mesa_sha1_update(ctx, tokens, tgsi_num_tokens(tokens) * sizeof(*tokens));
+    _mesa_sha1_final(ctx, key);
+
+    pipe_mutex_lock(cache->lock);
+    he = _mesa_hash_table_search(cache->by_key, key);
+    if(he)
+    {
+        entry = he->data;
+        if(entry->refcount++ == 0)
+        {
+            list_del(&entry->unused);
+            cache->num_unused--;
+        }
+        cache->hits++;
+        pipe_mutex_unlock(cache->lock);
+        return entry->obj;
+    }
+    cache->misses++;
+    pipe_mutex_unlock(cache->lock);
+
+    /* Compile without holding the lock, other threads may be looking up
+     * unrelated shaders in the meantime. */
+    if(!etna_compile_shader_object(specs, tokens, &obj))
+        return NULL;
+
+    entry = CALLOC_STRUCT(etna_shader_cache_entry);
+    if(!entry)
+    {
+        etna_destroy_shader_object(obj);
+        return NULL;
+    }
+    memcpy(entry->key, key, sizeof(key));
+    entry->obj = obj;
+    entry->refcount = 1;
+
+    pipe_mutex_lock(cache->lock);
+    he = _mesa_hash_table_search(cache->by_key, key);
+    if(he)
+    {
+        /* somebody else compiled the same shader concurrently, use theirs */
+        struct etna_shader_cache_entry *other = he->data;
+
+        if(other->refcount++ == 0)
+        {
+            list_del(&other->unused);
+            cache->num_unused--;
+        }
+        pipe_mutex_unlock(cache->lock);
+
+        etna_destroy_shader_object(obj);
+        FREE(entry);
+        return other->obj;
+    }
+    obj->id = ++cache->last_id;
+    _mesa_hash_table_insert(cache->by_key, entry->key, entry);
+    _mesa_hash_table_insert(cache->by_obj, obj, entry);
+    pipe_mutex_unlock(cache->lock);
+
+    return obj;
+}
+
+void etna_shader_cache_release(struct etna_shader_cache *cache,
+                               struct etna_shader_object *obj)
+{
+    struct etna_shader_cache_entry *entry;
+    struct hash_entry *he;
+
+    pipe_mutex_lock(cache->lock);
+    he = _mesa_hash_table_search(cache->by_obj, obj);
+    assert(he);
+    entry = he->data;
+    assert(entry->refcount > 0);
+    if(--entry->refcount == 0)
+    {
+        list_add(&entry->unused, &cache->unused);
+        if(++cache->num_unused > ETNA_SHADER_CACHE_UNUSED_MAX)
+        {
+            struct etna_shader_cache_entry *oldest =
+                LIST_ENTRY(struct etna_shader_cache_entry, cache->unused.prev, unused);
+
+            list_del(&oldest->unused);
+            cache->num_unused--;
+            destroy_entry(cache, oldest);
+        }
+    }
+    pipe_mutex_unlock(cache->lock);
+}
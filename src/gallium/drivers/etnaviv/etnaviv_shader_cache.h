@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2016 Etnaviv Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef H_ETNAVIV_SHADER_CACHE
+#define H_ETNAVIV_SHADER_CACHE
+
+#include "pipe/p_shader_tokens.h"
+
+struct etna_specs;
+struct etna_shader_object;
+struct etna_shader_cache;
+
+/* Screen-wide cache of compiled shader objects, keyed by a hash of the TGSI
+ * tokens and the chip specs. Shader objects are shared between all users
+ * of the same tokens; when the last user releases one it is kept around for
+ * a while, so that re-creating the shader does not compile it again.
+ */
+struct etna_shader_cache *etna_shader_cache_create(void);
+
+void etna_shader_cache_destroy(struct etna_shader_cache *cache);
+
+/* Return a referenced shader object for tokens, compiling it on a miss.
+ * Returns NULL if compilation fails. */
+struct etna_shader_object *etna_shader_cache_get(struct etna_shader_cache *cache,
+                                                 const struct etna_specs *specs,
+                                                 const struct tgsi_token *tokens);
+
+/* Drop a reference obtained with etna_shader_cache_get */
+void etna_shader_cache_release(struct etna_shader_cache *cache,
+                               struct etna_shader_object *obj);
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2016 Etnaviv Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Unit test for coalesced state emission: checks the exact LOAD_STATE stream
+ * produced with and without the register shadow, that up-to-date registers
+ * are skipped, single skipped registers are filled in from the shadow, and
+ * that the number of bytes saved is reported correctly.
+ */
+
+#include "etnaviv_emit.h"
+#include "etnaviv_internal.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_SIZE (64)
+#define REG(i) (0x01000 + 4 * (i))
+#define RELOC_MARKER (0xa0000000)
+#define PAD (0xdeadbeef)
+
+/* The test does not link against libdrm: provide the out-of-line parts of
+ * the command stream on top of a plain buffer. */
+static uint32_t buffer[STREAM_SIZE];
+static struct etna_cmd_stream stream = { buffer, 0, STREAM_SIZE };
+static bool overflow;
+
+void etna_cmd_stream_flush(struct etna_cmd_stream *s)
+{
+    overflow = true;
+}
+
+void etna_cmd_stream_reloc(struct etna_cmd_stream *s, const struct etna_reloc *r)
+{
+    etna_cmd_stream_emit(s, RELOC_MARKER | r->offset);
+}
+
+#define HEADER(reg, count, fixp) \
+    (VIV_FE_LOAD_STATE_HEADER_OP_LOAD_STATE | \
+     ((fixp) ? VIV_FE_LOAD_STATE_HEADER_FIXP : 0) | \
+     VIV_FE_LOAD_STATE_HEADER_OFFSET(REG(reg) >> 2) | \
+     VIV_FE_LOAD_STATE_HEADER_COUNT(count))
+
+/* One register write in a coalesced emission, value < 0 is a relocation */
+struct write
+{
+    unsigned reg;
+    int64_t value;
+    bool fixp;
+};
+
+static int emit(struct etna_3d_state *shadow, const struct write *writes, unsigned num)
+{
+    struct etna_coalesce coalesce;
+
+    stream.offset = 0;
+    memset(buffer, 0, sizeof(buffer));
+    etna_coalesce_start(&stream, &coalesce, STREAM_SIZE / 2, shadow);
+    for(unsigned i=0; i<num; ++i)
+    {
+        if(writes[i].value < 0)
+        {
+            struct etna_reloc r = { .bo = (struct etna_bo *)&r, .offset = -writes[i].value };
+            etna_coalsence_emit_reloc(&stream, &coalesce, REG(writes[i].reg), &r);
+        }
+        else if(writes[i].fixp)
+            etna_coalsence_emit_fixp(&stream, &coalesce, REG(writes[i].reg), writes[i].value);
+        else
+            etna_coalsence_emit(&stream, &coalesce, REG(writes[i].reg), writes[i].value);
+    }
+    return etna_coalesce_end(&stream, &coalesce);
+}
+
+static bool check(const char *name, struct etna_3d_state *shadow,
+                  const struct write *writes, unsigned num,
+                  const uint32_t *expected, unsigned expected_num, int expected_saved)
+{
+    int saved = emit(shadow, writes, num);
+    bool success = !overflow && stream.offset == expected_num &&
+                   (!expected_num || !memcmp(buffer, expected, expected_num * 4)) && saved == expected_saved;
+
+    printf("%s: %s\n", success ? "PASS" : "FAIL", name);
+    if(!success)
+    {
+        printf("  saved %d bytes, expected %d\n  stream:  ", saved, expected_saved);
+        for(unsigned i=0; i<stream.offset; ++i)
+            printf(" %08x", buffer[i]);
+        printf("\n  expected:");
+        for(unsigned i=0; i<expected_num; ++i)
+            printf(" %08x", expected[i]);
+        printf("\n");
+    }
+    overflow = false;
+    return success;
+}
+
+#define CHECK(name, shadow, writes, expected, saved) \
+    check(name, shadow, writes, ARRAY_SIZE(writes), expected, ARRAY_SIZE(expected), saved)
+
+int main(int argc, char **argv)
+{
+    struct etna_3d_state *shadow = calloc(1, sizeof(*shadow));
+    unsigned failures = 0;
+
+    if(!shadow)
+        return 1;
+
+    static const struct write initial[] = {
+        { 0, 0x10 }, { 1, 0x11 }, { 2, 0x12 },
+    };
+    static const uint32_t initial_stream[] = {
+        HEADER(0, 3, false), 0x10, 0x11, 0x12,
+    };
+    failures += !CHECK("no shadow", NULL, initial, initial_stream, 0);
+    failures += !CHECK("empty shadow", shadow, initial, initial_stream, 0);
+
+    failures += !check("all up to date", shadow, initial, ARRAY_SIZE(initial), NULL, 0, 16);
+
+    static const struct write change_first[] = {
+        { 0, 0x20 }, { 1, 0x11 }, { 2, 0x12 },
+    };
+    static const uint32_t change_first_stream[] = {
+        HEADER(0, 1, false), 0x20,
+    };
+    failures += !CHECK("first changed", shadow, change_first, change_first_stream, 8);
+
+    static const struct write change_two[] = {
+        { 0, 0x30 }, { 1, 0x31 }, { 2, 0x12 },
+    };
+    static const uint32_t change_two_stream[] = {
+        HEADER(0, 2, false), 0x30, 0x31, PAD,
+    };
+    failures += !CHECK("padding", shadow, change_two, change_two_stream, 0);
+
+    static const struct write change_outer[] = {
+        { 0, 0x40 }, { 1, 0x31 }, { 2, 0x42 },
+    };
+    static const uint32_t change_outer_stream[] = {
+        HEADER(0, 3, false), 0x40, 0x31, 0x42,
+    };
+    failures += !CHECK("gap filled from shadow", shadow, change_outer, change_outer_stream, 0);
+
+    static const struct write fixp_initial[] = {
+        { 0, 0x40 }, { 1, 0x31, true }, { 2, 0x42 },
+    };
+    static const uint32_t fixp_initial_stream[] = {
+        HEADER(1, 1, true), 0x31,
+    };
+    failures += !CHECK("fixp differs", shadow, fixp_initial, fixp_initial_stream, 16);
+
+    static const struct write fixp_outer[] = {
+        { 0, 0x50 }, { 1, 0x31, true }, { 2, 0x52 },
+    };
+    static const uint32_t fixp_outer_stream[] = {
+        HEADER(0, 1, false), 0x50, HEADER(2, 1, false), 0x52,
+    };
+    failures += !CHECK("no gap fill across fixp", shadow, fixp_outer, fixp_outer_stream, 8);
+
+    static const struct write reloc[] = {
+        { 0, -0x100 }, { 1, 0x31, true }, { 2, 0x52 },
+    };
+    static const uint32_t reloc_stream[] = {
+        HEADER(0, 1, false), RELOC_MARKER | 0x100,
+    };
+    failures += !CHECK("relocation always emitted", shadow, reloc, reloc_stream, 16);
+
+    static const struct write after_reloc[] = {
+        { 0, 0x50 }, { 1, 0x31, true }, { 2, 0x52 },
+    };
+    static const uint32_t after_reloc_stream[] = {
+        HEADER(0, 1, false), 0x50,
+    };
+    failures += !CHECK("relocation invalidates", shadow, after_reloc, after_reloc_stream, 16);
+
+    etna_shadow_invalidate(shadow, REG(2));
+    static const uint32_t invalidate_stream[] = {
+        HEADER(2, 1, false), 0x52,
+    };
+    failures += !CHECK("invalidate", shadow, after_reloc, invalidate_stream, 16);
+
+    etna_shadow_invalidate_all(shadow);
+    static const uint32_t invalidate_all_stream[] = {
+        HEADER(0, 1, false), 0x50, HEADER(1, 1, true), 0x31,
+        HEADER(2, 1, false), 0x52,
+    };
+    failures += !CHECK("invalidate all", shadow, after_reloc, invalidate_all_stream, 0);
+
+    free(shadow);
+    printf("%u tests failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2016 Etnaviv Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sub license,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Unit test and benchmark for the texture (super)tiling kernels: compares
+ * them against the element-at-a-time reference implementation on random
+ * rectangles, strides and element sizes, then times a full-surface upload
+ * and readback with both.
+ */
+
+#include "etnaviv_tiling.h"
+
+#include "os/os_time.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SURFACE_SIZE (256) /* multiple of the 64 pixel supertile size */
+#define NUM_ITERATIONS (2000)
+#define BENCH_SIZE (1024)
+#define BENCH_ITERATIONS (20)
+
+typedef void (*tile_func)(void *dest, void *src, unsigned basex, unsigned basey, unsigned tiled_stride, unsigned width, unsigned height, unsigned linear_stride, unsigned elmtsize);
+
+struct tiling_funcs
+{
+    const char *name;
+    tile_func tile, untile;
+    tile_func tile_ref, untile_ref;
+};
+
+static const struct tiling_funcs layouts[] = {
+    { "tiled", etna_texture_tile, etna_texture_untile,
+      etna_texture_tile_scalar, etna_texture_untile_scalar },
+    { "supertiled", etna_texture_supertile, etna_texture_unsupertile,
+      etna_texture_supertile_scalar, etna_texture_unsupertile_scalar },
+};
+
+static const unsigned elmtsizes[] = { 1, 2, 4 };
+
+static void fill_random(uint8_t *buf, size_t size)
+{
+    for(size_t i=0; i<size; ++i)
+        buf[i] = rand();
+}
+
+static bool test_one(const struct tiling_funcs *funcs, unsigned elmtsize, bool verbose)
+{
+    unsigned tiled_stride = SURFACE_SIZE * elmtsize;
+    size_t tiled_size = (size_t)tiled_stride * SURFACE_SIZE;
+    unsigned basex = rand() % SURFACE_SIZE;
+    unsigned basey = rand() % SURFACE_SIZE;
+    unsigned width = 1 + rand() % (SURFACE_SIZE - basex);
+    unsigned height = 1 + rand() % (SURFACE_SIZE - basey);
+    unsigned linear_stride = width * elmtsize + (rand() % 4) * elmtsize * (rand() % 17);
+    size_t linear_size = (size_t)linear_stride * height;
+    uint8_t *linear = malloc(linear_size);
+    uint8_t *tiled = malloc(tiled_size), *tiled_ref = malloc(tiled_size);
+    uint8_t *out = malloc(linear_size), *out_ref = malloc(linear_size);
+    bool success = true;
+
+    if(!linear || !tiled || !tiled_ref || !out || !out_ref)
+    {
+        success = false;
+        goto out;
+    }
+
+    fill_random(linear, linear_size);
+    fill_random(tiled, tiled_size);
+    memcpy(tiled_ref, tiled, tiled_size);
+
+    funcs->tile(tiled, linear, basex, basey, tiled_stride, width, height, linear_stride, elmtsize);
+    funcs->tile_ref(tiled_ref, linear, basex, basey, tiled_stride, width, height, linear_stride, elmtsize);
+    if(memcmp(tiled, tiled_ref, tiled_size))
+        success = false;
+
+    fill_random(out, linear_size);
+    memcpy(out_ref, out, linear_size);
+
+    funcs->untile(out, tiled, basex, basey, tiled_stride, width, height, linear_stride, elmtsize);
+    funcs->untile_ref(out_ref, tiled, basex, basey, tiled_stride, width, height, linear_stride, elmtsize);
+    if(memcmp(out, out_ref, linear_size))
+        success = false;
+
+    if(verbose || !success)
+    {
+        printf("%s: %s %ubpp rect %ux%u+%u+%u linear stride %u\n",
+               success ? "PASS" : "FAIL", funcs->name, elmtsize * 8,
+               width, height, basex, basey, linear_stride);
+    }
+
+out:
+    free(linear);
+    free(tiled);
+    free(tiled_ref);
+    free(out);
+    free(out_ref);
+    return success;
+}
+
+static int64_t time_func(tile_func func, void *dest, void *src, unsigned tiled_stride, unsigned elmtsize)
+{
+    int64_t start = os_time_get();
+
+    for(unsigned i=0; i<BENCH_ITERATIONS; ++i)
+        func(dest, src, 0, 0, tiled_stride, BENCH_SIZE, BENCH_SIZE, BENCH_SIZE * elmtsize, elmtsize);
+
+    return os_time_get() - start;
+}
+
+static void bench_one(const struct tiling_funcs *funcs, unsigned elmtsize)
+{
+    size_t size = (size_t)BENCH_SIZE * BENCH_SIZE * elmtsize;
+    uint8_t *linear = malloc(size), *tiled = malloc(size);
+    double mpix = (double)BENCH_SIZE * BENCH_SIZE * BENCH_ITERATIONS;
+
+    if(!linear || !tiled)
+        goto out;
+
+    fill_random(linear, size);
+
+    int64_t tile_ref = time_func(funcs->tile_ref, tiled, linear, BENCH_SIZE * elmtsize, elmtsize);
+    int64_t tile = time_func(funcs->tile, tiled, linear, BENCH_SIZE * elmtsize, elmtsize);
+    int64_t untile_ref = time_func(funcs->untile_ref, linear, tiled, BENCH_SIZE * elmtsize, elmtsize);
+    int64_t untile = time_func(funcs->untile, linear, tiled, BENCH_SIZE * elmtsize, elmtsize);
+
+    printf("%-10s %2ubpp: tile %7.1f -> %7.1f Mpix/s, untile %7.1f -> %7.1f Mpix/s\n",
+           funcs->name, elmtsize * 8,
+           mpix / (tile_ref ? tile_ref : 1), mpix / (tile ? tile : 1),
+           mpix / (untile_ref ? untile_ref : 1), mpix / (untile ? untile : 1));
+
+out:
+    free(linear);
+    free(tiled);
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false, bench = false;
+    unsigned failures = 0;
+
+    for(int i=1; i<argc; ++i)
+    {
+        if(!strcmp(argv[i], "-v"))
+            verbose = true;
+        else if(!strcmp(argv[i], "-b"))
+            bench = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [-v] [-b]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    srand(0x7111e);
+
+    for(unsigned i=0; i<NUM_ITERATIONS; ++i)
+    {
+        const struct tiling_funcs *funcs = &layouts[i % 2];
+        unsigned elmtsize = elmtsizes[(i / 2) % 3];
+
+        if(!test_one(funcs, elmtsize, verbose))
+            failures++;
+    }
+
+    if(bench)
+    {
+        for(unsigned l=0; l<2; ++l)
+            for(unsigned e=0; e<3; ++e)
+                bench_one(&layouts[l], elmtsizes[e]);
+    }
+
+    printf("%u of %u tests failed\n", failures, NUM_ITERATIONS);
+    return failures ? 1 : 0;
+}
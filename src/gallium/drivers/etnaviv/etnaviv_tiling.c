@@ -26,13 +26,34 @@
 
 #include "etnaviv_tiling.h"
 
+#include "pipe/p_config.h"
+
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(PIPE_ARCH_SSE)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ETNA_TILING_NEON
+#endif
 
 #define TEX_TILE_WIDTH (4)
 #define TEX_TILE_HEIGHT (4)
 #define TEX_TILE_WORDS (TEX_TILE_WIDTH*TEX_TILE_HEIGHT)
 
+/* A supertile is 64x64 pixels, made of 16x16 tiles in row-major order.
+ * Supertiles themselves are laid out in row-major order. */
+#define TEX_SUPERTILE_TILES (16)
+#define TEX_SUPERTILE_WIDTH (TEX_SUPERTILE_TILES*TEX_TILE_WIDTH)
+#define TEX_SUPERTILE_HEIGHT (TEX_SUPERTILE_TILES*TEX_TILE_HEIGHT)
+
+/* Bytes of a linear row handled at once by the block kernels: one tile row
+ * of 32 bpp, two of 16 bpp or four of 8 bpp. */
+#define TEX_BLOCK_BYTES (16)
+
 #define DO_TILE(type) \
         src_stride /= sizeof(type); \
         dst_stride = (dst_stride * TEX_TILE_HEIGHT) / sizeof(type); \
@@ -63,7 +84,298 @@
             } \
         }
 
-void etna_texture_tile(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize)
+#define DO_SUPERTILE(type) \
+        src_stride /= sizeof(type); \
+        dst_stride /= sizeof(type); \
+        for(unsigned srcy=0; srcy<height; ++srcy) \
+        { \
+            for(unsigned srcx=0; srcx<width; ++srcx) \
+            { \
+                ((type*)dest)[supertile_offset(basex + srcx, basey + srcy, dst_stride)] = \
+                    ((type*)src)[srcy * src_stride + srcx]; \
+            } \
+        }
+
+#define DO_UNSUPERTILE(type) \
+        src_stride /= sizeof(type); \
+        dst_stride /= sizeof(type); \
+        for(unsigned dsty=0; dsty<height; ++dsty) \
+        { \
+            for(unsigned dstx=0; dstx<width; ++dstx) \
+            { \
+                ((type*)dest)[dsty * dst_stride + dstx] = \
+                    ((type*)src)[supertile_offset(basex + dstx, basey + dsty, src_stride)]; \
+            } \
+        }
+
+/* Offset in elements of pixel (x, y) in a tiled surface, with the row
+ * stride also given in elements. */
+static inline unsigned tile_offset(unsigned x, unsigned y, unsigned stride)
+{
+    return (y/TEX_TILE_HEIGHT) * stride * TEX_TILE_HEIGHT +
+           (x/TEX_TILE_WIDTH) * TEX_TILE_WORDS +
+           (y%TEX_TILE_HEIGHT) * TEX_TILE_WIDTH + (x%TEX_TILE_WIDTH);
+}
+
+/* Offset in elements of pixel (x, y) in a supertiled surface, with the row
+ * stride also given in elements. */
+static inline unsigned supertile_offset(unsigned x, unsigned y, unsigned stride)
+{
+    unsigned tx = (x/TEX_TILE_WIDTH) % TEX_SUPERTILE_TILES;
+    unsigned ty = (y/TEX_TILE_HEIGHT) % TEX_SUPERTILE_TILES;
+
+    return (y/TEX_SUPERTILE_HEIGHT) * stride * TEX_SUPERTILE_HEIGHT +
+           (x/TEX_SUPERTILE_WIDTH) * TEX_SUPERTILE_WIDTH * TEX_SUPERTILE_HEIGHT +
+           (ty * TEX_SUPERTILE_TILES + tx) * TEX_TILE_WORDS +
+           (y%TEX_TILE_HEIGHT) * TEX_TILE_WIDTH + (x%TEX_TILE_WIDTH);
+}
+
+/*
+ * Block kernels: move a TEX_BLOCK_BYTES wide, TEX_TILE_HEIGHT high block of
+ * linear pixels to/from the 64 contiguous bytes of the tiles covering it.
+ * The block must start on a tile boundary; the tiles it covers are then
+ * adjacent in both the tiled and the supertiled layout.
+ */
+#if defined(PIPE_ARCH_SSE)
+
+static inline void tile_block(uint8_t *tiled, const uint8_t *linear, unsigned stride, unsigned elmtsize)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(linear));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(linear + stride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(linear + 2 * stride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(linear + 3 * stride));
+    __m128i t0, t1, t2, t3;
+
+    if(elmtsize == 4)
+    {
+        t0 = r0; t1 = r1; t2 = r2; t3 = r3;
+    } else if(elmtsize == 2)
+    {
+        t0 = _mm_unpacklo_epi64(r0, r1);
+        t1 = _mm_unpacklo_epi64(r2, r3);
+        t2 = _mm_unpackhi_epi64(r0, r1);
+        t3 = _mm_unpackhi_epi64(r2, r3);
+    } else
+    {
+        /* 4x4 transpose of 32-bit tile rows */
+        __m128i a = _mm_unpacklo_epi32(r0, r1);
+        __m128i b = _mm_unpacklo_epi32(r2, r3);
+        __m128i c = _mm_unpackhi_epi32(r0, r1);
+        __m128i d = _mm_unpackhi_epi32(r2, r3);
+        t0 = _mm_unpacklo_epi64(a, b);
+        t1 = _mm_unpackhi_epi64(a, b);
+        t2 = _mm_unpacklo_epi64(c, d);
+        t3 = _mm_unpackhi_epi64(c, d);
+    }
+
+    _mm_storeu_si128((__m128i *)(tiled), t0);
+    _mm_storeu_si128((__m128i *)(tiled + 16), t1);
+    _mm_storeu_si128((__m128i *)(tiled + 32), t2);
+    _mm_storeu_si128((__m128i *)(tiled + 48), t3);
+}
+
+static inline void untile_block(uint8_t *linear, unsigned stride, const uint8_t *tiled, unsigned elmtsize)
+{
+    __m128i t0 = _mm_loadu_si128((const __m128i *)(tiled));
+    __m128i t1 = _mm_loadu_si128((const __m128i *)(tiled + 16));
+    __m128i t2 = _mm_loadu_si128((const __m128i *)(tiled + 32));
+    __m128i t3 = _mm_loadu_si128((const __m128i *)(tiled + 48));
+    __m128i r0, r1, r2, r3;
+
+    if(elmtsize == 4)
+    {
+        r0 = t0; r1 = t1; r2 = t2; r3 = t3;
+    } else if(elmtsize == 2)
+    {
+        r0 = _mm_unpacklo_epi64(t0, t2);
+        r1 = _mm_unpackhi_epi64(t0, t2);
+        r2 = _mm_unpacklo_epi64(t1, t3);
+        r3 = _mm_unpackhi_epi64(t1, t3);
+    } else
+    {
+        /* the 4x4 transpose is its own inverse */
+        __m128i a = _mm_unpacklo_epi32(t0, t1);
+        __m128i b = _mm_unpacklo_epi32(t2, t3);
+        __m128i c = _mm_unpackhi_epi32(t0, t1);
+        __m128i d = _mm_unpackhi_epi32(t2, t3);
+        r0 = _mm_unpacklo_epi64(a, b);
+        r1 = _mm_unpackhi_epi64(a, b);
+        r2 = _mm_unpacklo_epi64(c, d);
+        r3 = _mm_unpackhi_epi64(c, d);
+    }
+
+    _mm_storeu_si128((__m128i *)(linear), r0);
+    _mm_storeu_si128((__m128i *)(linear + stride), r1);
+    _mm_storeu_si128((__m128i *)(linear + 2 * stride), r2);
+    _mm_storeu_si128((__m128i *)(linear + 3 * stride), r3);
+}
+
+#elif defined(ETNA_TILING_NEON)
+
+static inline void transpose_4x4(uint32x4_t *v)
+{
+    uint32x4x2_t a = vtrnq_u32(v[0], v[1]);
+    uint32x4x2_t b = vtrnq_u32(v[2], v[3]);
+
+    v[0] = vcombine_u32(vget_low_u32(a.val[0]), vget_low_u32(b.val[0]));
+    v[1] = vcombine_u32(vget_low_u32(a.val[1]), vget_low_u32(b.val[1]));
+    v[2] = vcombine_u32(vget_high_u32(a.val[0]), vget_high_u32(b.val[0]));
+    v[3] = vcombine_u32(vget_high_u32(a.val[1]), vget_high_u32(b.val[1]));
+}
+
+static inline void tile_block(uint8_t *tiled, const uint8_t *linear, unsigned stride, unsigned elmtsize)
+{
+    uint32x4_t v[4];
+
+    for(unsigned i=0; i<4; ++i)
+        v[i] = vreinterpretq_u32_u8(vld1q_u8(linear + i * stride));
+
+    if(elmtsize == 2)
+    {
+        uint64x2_t r0 = vreinterpretq_u64_u32(v[0]), r1 = vreinterpretq_u64_u32(v[1]);
+        uint64x2_t r2 = vreinterpretq_u64_u32(v[2]), r3 = vreinterpretq_u64_u32(v[3]);
+        v[0] = vreinterpretq_u32_u64(vcombine_u64(vget_low_u64(r0), vget_low_u64(r1)));
+        v[1] = vreinterpretq_u32_u64(vcombine_u64(vget_low_u64(r2), vget_low_u64(r3)));
+        v[2] = vreinterpretq_u32_u64(vcombine_u64(vget_high_u64(r0), vget_high_u64(r1)));
+        v[3] = vreinterpretq_u32_u64(vcombine_u64(vget_high_u64(r2), vget_high_u64(r3)));
+    } else if(elmtsize == 1)
+    {
+        transpose_4x4(v);
+    }
+
+    for(unsigned i=0; i<4; ++i)
+        vst1q_u8(tiled + i * 16, vreinterpretq_u8_u32(v[i]));
+}
+
+static inline void untile_block(uint8_t *linear, unsigned stride, const uint8_t *tiled, unsigned elmtsize)
+{
+    uint32x4_t v[4];
+
+    for(unsigned i=0; i<4; ++i)
+        v[i] = vreinterpretq_u32_u8(vld1q_u8(tiled + i * 16));
+
+    if(elmtsize == 2)
+    {
+        uint64x2_t t0 = vreinterpretq_u64_u32(v[0]), t1 = vreinterpretq_u64_u32(v[1]);
+        uint64x2_t t2 = vreinterpretq_u64_u32(v[2]), t3 = vreinterpretq_u64_u32(v[3]);
+        v[0] = vreinterpretq_u32_u64(vcombine_u64(vget_low_u64(t0), vget_low_u64(t2)));
+        v[1] = vreinterpretq_u32_u64(vcombine_u64(vget_high_u64(t0), vget_high_u64(t2)));
+        v[2] = vreinterpretq_u32_u64(vcombine_u64(vget_low_u64(t1), vget_low_u64(t3)));
+        v[3] = vreinterpretq_u32_u64(vcombine_u64(vget_high_u64(t1), vget_high_u64(t3)));
+    } else if(elmtsize == 1)
+    {
+        transpose_4x4(v);
+    }
+
+    for(unsigned i=0; i<4; ++i)
+        vst1q_u8(linear + i * stride, vreinterpretq_u8_u32(v[i]));
+}
+
+#else
+
+static inline void tile_block(uint8_t *tiled, const uint8_t *linear, unsigned stride, unsigned elmtsize)
+{
+    unsigned row_bytes = TEX_TILE_WIDTH * elmtsize;
+
+    for(unsigned k=0; k<TEX_BLOCK_BYTES/row_bytes; ++k)
+        for(unsigned i=0; i<TEX_TILE_HEIGHT; ++i)
+            memcpy(tiled + (k * TEX_TILE_HEIGHT + i) * row_bytes, linear + i * stride + k * row_bytes, row_bytes);
+}
+
+static inline void untile_block(uint8_t *linear, unsigned stride, const uint8_t *tiled, unsigned elmtsize)
+{
+    unsigned row_bytes = TEX_TILE_WIDTH * elmtsize;
+
+    for(unsigned k=0; k<TEX_BLOCK_BYTES/row_bytes; ++k)
+        for(unsigned i=0; i<TEX_TILE_HEIGHT; ++i)
+            memcpy(linear + i * stride + k * row_bytes, tiled + (k * TEX_TILE_HEIGHT + i) * row_bytes, row_bytes);
+}
+
+#endif
+
+static inline void copy_element(uint8_t *dst, const uint8_t *src, unsigned elmtsize)
+{
+    switch(elmtsize)
+    {
+    case 4: memcpy(dst, src, 4); break;
+    case 2: memcpy(dst, src, 2); break;
+    default: *dst = *src; break;
+    }
+}
+
+/* Element-wise copy of the pixels in [x0, x1) x [y0, y1), for the edges of
+ * the rectangle which do not cover whole blocks. */
+static void copy_elements(uint8_t *tiled, uint8_t *linear, unsigned basex, unsigned basey,
+                          unsigned tiled_stride, unsigned linear_stride, unsigned elmtsize,
+                          bool super, bool untile,
+                          unsigned x0, unsigned x1, unsigned y0, unsigned y1)
+{
+    unsigned stride = tiled_stride / elmtsize;
+
+    for(unsigned y=y0; y<y1; ++y)
+    {
+        uint8_t *l = linear + (y - basey) * linear_stride;
+        for(unsigned x=x0; x<x1; ++x)
+        {
+            unsigned offset = super ? supertile_offset(x, y, stride) : tile_offset(x, y, stride);
+            uint8_t *t = tiled + offset * elmtsize;
+            if(untile)
+                copy_element(l + (x - basex) * elmtsize, t, elmtsize);
+            else
+                copy_element(t, l + (x - basex) * elmtsize, elmtsize);
+        }
+    }
+}
+
+/* Tile (or untile) a rectangle one row of tiles at a time, moving whole
+ * TEX_BLOCK_BYTES blocks through the block kernels and only falling back to
+ * per-element copies at the unaligned edges. */
+static void tile_rect(uint8_t *tiled, uint8_t *linear, unsigned basex, unsigned basey,
+                      unsigned tiled_stride, unsigned width, unsigned height,
+                      unsigned linear_stride, unsigned elmtsize, bool super, bool untile)
+{
+    unsigned block_width = TEX_BLOCK_BYTES / elmtsize;
+    unsigned stride = tiled_stride / elmtsize;
+    unsigned x1 = basex + width, y1 = basey + height;
+    /* [xa, xb) is the range covered by whole blocks */
+    unsigned xa = (basex + block_width - 1) & ~(block_width - 1);
+    unsigned xb = x1 & ~(block_width - 1);
+    unsigned y = basey;
+
+    if(xa >= xb)
+        xa = xb = x1;
+
+    while(y < y1)
+    {
+        if(y % TEX_TILE_HEIGHT || y + TEX_TILE_HEIGHT > y1)
+        {
+            copy_elements(tiled, linear, basex, basey, tiled_stride, linear_stride, elmtsize,
+                          super, untile, basex, x1, y, y + 1);
+            y += 1;
+            continue;
+        }
+
+        copy_elements(tiled, linear, basex, basey, tiled_stride, linear_stride, elmtsize,
+                      super, untile, basex, xa, y, y + TEX_TILE_HEIGHT);
+
+        uint8_t *l = linear + (y - basey) * linear_stride + (xa - basex) * elmtsize;
+        for(unsigned x=xa; x<xb; x+=block_width, l+=TEX_BLOCK_BYTES)
+        {
+            unsigned offset = super ? supertile_offset(x, y, stride) : tile_offset(x, y, stride);
+            uint8_t *t = tiled + offset * elmtsize;
+            if(untile)
+                untile_block(l, linear_stride, t, elmtsize);
+            else
+                tile_block(t, l, linear_stride, elmtsize);
+        }
+
+        copy_elements(tiled, linear, basex, basey, tiled_stride, linear_stride, elmtsize,
+                      super, untile, xb, x1, y, y + TEX_TILE_HEIGHT);
+        y += TEX_TILE_HEIGHT;
+    }
+}
+
+void etna_texture_tile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize)
 {
     if(elmtsize == 4)
     {
@@ -81,7 +393,7 @@ void etna_texture_tile(void *dest, void *src, unsigned basex, unsigned basey, un
     }
 }
 
-void etna_texture_untile(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize)
+void etna_texture_untile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize)
 {
     if(elmtsize == 4)
     {
@@ -98,3 +410,69 @@ void etna_texture_untile(void *dest, void *src, unsigned basex, unsigned basey,
         printf("etna_texture_tile: unhandled element size %i\n", elmtsize);
     }
 }
+
+void etna_texture_supertile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize)
+{
+    if(elmtsize == 4)
+    {
+        DO_SUPERTILE(uint32_t)
+    } else if(elmtsize == 2)
+    {
+        DO_SUPERTILE(uint16_t)
+    } else if(elmtsize == 1)
+    {
+        DO_SUPERTILE(uint8_t)
+    } else
+    {
+        printf("etna_texture_supertile: unhandled element size %i\n", elmtsize);
+    }
+}
+
+void etna_texture_unsupertile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize)
+{
+    if(elmtsize == 4)
+    {
+        DO_UNSUPERTILE(uint32_t)
+    } else if(elmtsize == 2)
+    {
+        DO_UNSUPERTILE(uint16_t)
+    } else if(elmtsize == 1)
+    {
+        DO_UNSUPERTILE(uint8_t)
+    } else
+    {
+        printf("etna_texture_unsupertile: unhandled element size %i\n", elmtsize);
+    }
+}
+
+void etna_texture_tile(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize)
+{
+    if(elmtsize == 4 || elmtsize == 2 || elmtsize == 1)
+        tile_rect(dest, src, basex, basey, dst_stride, width, height, src_stride, elmtsize, false, false);
+    else
+        etna_texture_tile_scalar(dest, src, basex, basey, dst_stride, width, height, src_stride, elmtsize);
+}
+
+void etna_texture_untile(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize)
+{
+    if(elmtsize == 4 || elmtsize == 2 || elmtsize == 1)
+        tile_rect(src, dest, basex, basey, src_stride, width, height, dst_stride, elmtsize, false, true);
+    else
+        etna_texture_untile_scalar(dest, src, basex, basey, src_stride, width, height, dst_stride, elmtsize);
+}
+
+void etna_texture_supertile(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize)
+{
+    if(elmtsize == 4 || elmtsize == 2 || elmtsize == 1)
+        tile_rect(dest, src, basex, basey, dst_stride, width, height, src_stride, elmtsize, true, false);
+    else
+        etna_texture_supertile_scalar(dest, src, basex, basey, dst_stride, width, height, src_stride, elmtsize);
+}
+
+void etna_texture_unsupertile(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize)
+{
+    if(elmtsize == 4 || elmtsize == 2 || elmtsize == 1)
+        tile_rect(src, dest, basex, basey, src_stride, width, height, dst_stride, elmtsize, true, true);
+    else
+        etna_texture_unsupertile_scalar(dest, src, basex, basey, src_stride, width, height, dst_stride, elmtsize);
+}
@@ -42,9 +42,24 @@ enum etna_surface_layout
     ETNA_LAYOUT_MULTI_SUPERTILED = ETNA_LAYOUT_BIT_TILE | ETNA_LAYOUT_BIT_SUPER | ETNA_LAYOUT_BIT_MULTI,
 };
 
+/* Copy a width x height rectangle of elements between a linear buffer and a
+ * (super)tiled surface, at position (basex, basey) of the tiled surface.
+ * Strides are in bytes; for the tiled side it is the stride of one row of
+ * pixels, as stored in etna_resource_level::stride. */
 void etna_texture_tile(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize);
 void etna_texture_untile(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize);
 
-/* XXX from/to supertiling (can have different layouts, may be better to leave to RS) */
+/* Supertiled layout: 64x64 supertiles of 4x4 tiles, both in row-major order.
+ * XXX from/to supertiling (can have different layouts, may be better to leave
+ * to RS). Only the layout above is implemented and nothing checks that the
+ * core uses it, so transfers of supertiled resources don't call these. */
+void etna_texture_supertile(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize);
+void etna_texture_unsupertile(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize);
+
+/* Element-at-a-time reference implementations of the above */
+void etna_texture_tile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize);
+void etna_texture_untile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize);
+void etna_texture_supertile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned dst_stride, unsigned width, unsigned height, unsigned src_stride, unsigned elmtsize);
+void etna_texture_unsupertile_scalar(void *dest, void *src, unsigned basex, unsigned basey, unsigned src_stride, unsigned width, unsigned height, unsigned dst_stride, unsigned elmtsize);
 
 #endif
@@ -0,0 +1,170 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#include "os/os_thread.h"
+#include "util/simple_list.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "lp_limits.h"
+#include "lp_compile_queue.h"
+
+
+struct lp_compile_queue
+{
+   pipe_mutex mutex;
+   pipe_condvar change;   /**< job added, job finished or shutdown */
+
+   struct lp_compile_job jobs;   /**< list of queued jobs */
+   boolean exit;
+
+   unsigned num_threads;
+   pipe_thread threads[LP_MAX_COMPILE_THREADS];
+};
+
+
+static PIPE_THREAD_ROUTINE( compile_thread_func, init_data )
+{
+   struct lp_compile_queue *queue = (struct lp_compile_queue *) init_data;
+   LLVMContextRef context = LLVMContextCreate();
+
+   pipe_mutex_lock(queue->mutex);
+
+   for (;;) {
+      struct lp_compile_job *job;
+
+      while (is_empty_list(&queue->jobs) && !queue->exit)
+         pipe_condvar_wait(queue->change, queue->mutex);
+
+      /* Queued jobs are still run on exit, their owners wait for them. */
+      if (is_empty_list(&queue->jobs))
+         break;
+
+      job = first_elem(&queue->jobs);
+      remove_from_list(job);
+      p_atomic_set(&job->state, LP_COMPILE_JOB_RUNNING);
+      pipe_mutex_unlock(queue->mutex);
+
+      job->func(job, context);
+
+      pipe_mutex_lock(queue->mutex);
+      p_atomic_set(&job->state, LP_COMPILE_JOB_DONE);
+      pipe_condvar_broadcast(queue->change);
+   }
+
+   pipe_mutex_unlock(queue->mutex);
+
+   LLVMContextDispose(context);
+   return 0;
+}
+
+
+struct lp_compile_queue *
+lp_compile_queue_create(unsigned num_threads)
+{
+   struct lp_compile_queue *queue;
+   unsigned i;
+
+   queue = CALLOC_STRUCT(lp_compile_queue);
+   if (!queue)
+      return NULL;
+
+   pipe_mutex_init(queue->mutex);
+   pipe_condvar_init(queue->change);
+   make_empty_list(&queue->jobs);
+
+   queue->num_threads = MIN2(MAX2(num_threads, 1), LP_MAX_COMPILE_THREADS);
+   for (i = 0; i < queue->num_threads; i++) {
+      queue->threads[i] = pipe_thread_create(compile_thread_func, queue);
+   }
+
+   return queue;
+}
+
+
+/**
+ * Finish all queued jobs and stop the threads.
+ */
+void
+lp_compile_queue_destroy(struct lp_compile_queue *queue)
+{
+   unsigned i;
+
+   pipe_mutex_lock(queue->mutex);
+   queue->exit = TRUE;
+   pipe_condvar_broadcast(queue->change);
+   pipe_mutex_unlock(queue->mutex);
+
+   for (i = 0; i < queue->num_threads; i++)
+      pipe_thread_wait(queue->threads[i]);
+
+   pipe_condvar_destroy(queue->change);
+   pipe_mutex_destroy(queue->mutex);
+   FREE(queue);
+}
+
+
+void
+lp_compile_queue_add(struct lp_compile_queue *queue,
+                     struct lp_compile_job *job)
+{
+   assert(job->func);
+
+   job->state = LP_COMPILE_JOB_QUEUED;
+
+   pipe_mutex_lock(queue->mutex);
+   insert_at_tail(&queue->jobs, job);
+   pipe_condvar_signal(queue->change);
+   pipe_mutex_unlock(queue->mutex);
+}
+
+
+/**
+ * Make sure the job is no longer referenced by the queue: drop it if it
+ * hasn't started yet, otherwise wait for it to finish.
+ * \return  TRUE if the job ran
+ */
+boolean
+lp_compile_queue_cancel(struct lp_compile_queue *queue,
+                        struct lp_compile_job *job)
+{
+   boolean ran = TRUE;
+
+   pipe_mutex_lock(queue->mutex);
+
+   if (job->state == LP_COMPILE_JOB_QUEUED) {
+      remove_from_list(job);
+      ran = FALSE;
+   }
+   else {
+      while (job->state != LP_COMPILE_JOB_DONE)
+         pipe_condvar_wait(queue->change, queue->mutex);
+   }
+
+   pipe_mutex_unlock(queue->mutex);
+   return ran;
+}
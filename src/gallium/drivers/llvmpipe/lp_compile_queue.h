@@ -0,0 +1,92 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Pool of threads compiling shader variants in the background.
+ *
+ * Each thread owns an LLVMContext, so jobs must build their modules in
+ * the context they are handed and must not touch any LLVM objects of
+ * the llvmpipe context.
+ */
+
+#ifndef LP_COMPILE_QUEUE_H
+#define LP_COMPILE_QUEUE_H
+
+#include "pipe/p_compiler.h"
+#include "util/u_atomic.h"
+#include "gallivm/lp_bld.h"
+
+
+struct lp_compile_queue;
+struct lp_compile_job;
+
+typedef void
+(*lp_compile_job_func)(struct lp_compile_job *job, LLVMContextRef context);
+
+enum lp_compile_job_state {
+   LP_COMPILE_JOB_QUEUED,
+   LP_COMPILE_JOB_RUNNING,
+   LP_COMPILE_JOB_DONE
+};
+
+
+/**
+ * Embed this at the start of the job's own struct.
+ */
+struct lp_compile_job
+{
+   struct lp_compile_job *next, *prev;
+   lp_compile_job_func func;
+   int state;  /**< enum lp_compile_job_state */
+};
+
+
+struct lp_compile_queue *
+lp_compile_queue_create(unsigned num_threads);
+
+void
+lp_compile_queue_destroy(struct lp_compile_queue *queue);
+
+void
+lp_compile_queue_add(struct lp_compile_queue *queue,
+                     struct lp_compile_job *job);
+
+boolean
+lp_compile_queue_cancel(struct lp_compile_queue *queue,
+                        struct lp_compile_job *job);
+
+
+static inline boolean
+lp_compile_job_done(const struct lp_compile_job *job)
+{
+   return p_atomic_read(&job->state) == LP_COMPILE_JOB_DONE;
+}
+
+
+#endif /* LP_COMPILE_QUEUE_H */
@@ -33,6 +33,7 @@
 #include "draw/draw_context.h"
 #include "draw/draw_vbuf.h"
 #include "pipe/p_defines.h"
+#include "util/u_debug.h"
 #include "util/u_inlines.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -45,6 +46,10 @@
 #include "lp_surface.h"
 #include "lp_query.h"
 #include "lp_setup.h"
+#include "lp_screen.h"
+#include "lp_debug.h"
+#include "lp_compile_queue.h"
+#include "lp_jit_batch.h"
 
 /* This is only safe if there's just one concurrent context */
 #ifdef PIPE_SUBSYSTEM_EMBEDDED
@@ -58,6 +63,19 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
 
    lp_print_counters();
 
+   if (LP_DEBUG & DEBUG_COUNTERS) {
+      debug_printf("llvmpipe: nr_fallback_draws:            %9llu\n",
+                   (unsigned long long) llvmpipe->nr_fallback_draws);
+      debug_printf("llvmpipe: nr_fs_tier_ups:               %9llu\n",
+                   (unsigned long long) llvmpipe->nr_fs_tier_ups);
+      debug_printf("llvmpipe: fs variant cache hits:        %9llu\n",
+                   (unsigned long long) llvmpipe->fs_variant_cache.hits);
+      debug_printf("llvmpipe: fs variant cache misses:      %9llu\n",
+                   (unsigned long long) llvmpipe->fs_variant_cache.misses);
+      debug_printf("llvmpipe: fs variant cache evictions:   %9llu\n",
+                   (unsigned long long) llvmpipe->fs_variant_cache.evictions);
+   }
+
    if (llvmpipe->blitter) {
       util_blitter_destroy(llvmpipe->blitter);
    }
@@ -97,6 +115,13 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
 
    lp_delete_setup_variants(llvmpipe);
 
+   /* After all shaders, whose variants may cancel jobs, are gone. */
+   if (llvmpipe->compile_queue)
+      lp_compile_queue_destroy(llvmpipe->compile_queue);
+
+   if (llvmpipe->jit_batch)
+      lp_jit_batch_destroy(llvmpipe->jit_batch);
+
 #ifndef USE_GLOBAL_LLVM_CONTEXT
    LLVMContextDispose(llvmpipe->context);
 #endif
@@ -141,9 +166,15 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
 
    memset(llvmpipe, 0, sizeof *llvmpipe);
 
-   make_empty_list(&llvmpipe->fs_variants_list);
+   lp_variant_cache_init(&llvmpipe->fs_variant_cache,
+                         LP_MAX_SHADER_VARIANTS,
+                         (size_t) debug_get_num_option("LP_SHADER_CACHE_SIZE",
+                                                       LP_MAX_SHADER_CODE_SIZE >> 20) << 20);
 
    make_empty_list(&llvmpipe->setup_variants_list);
+   lp_variant_cache_init(&llvmpipe->setup_variant_cache,
+                         LP_MAX_SETUP_VARIANTS,
+                         LP_MAX_SETUP_CODE_SIZE);
 
 
    llvmpipe->pipe.screen = screen;
@@ -180,6 +211,17 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    if (!llvmpipe->context)
       goto fail;
 
+#ifndef USE_GLOBAL_LLVM_CONTEXT
+   if (llvmpipe_screen(screen)->num_compile_threads) {
+      llvmpipe->compile_queue =
+         lp_compile_queue_create(llvmpipe_screen(screen)->num_compile_threads);
+   }
+#endif
+
+   if (llvmpipe_screen(screen)->jit_batch) {
+      llvmpipe->jit_batch = lp_jit_batch_create(llvmpipe->context);
+   }
+
    /*
     * Create drawing context and plug our rendering stage into it.
     */
@@ -48,8 +48,11 @@ struct draw_context;
 struct draw_stage;
 struct draw_vertex_shader;
 struct lp_fragment_shader;
+struct lp_fragment_shader_variant;
 struct lp_blend_state;
 struct lp_setup_context;
+struct lp_compile_queue;
+struct lp_jit_batch;
 struct lp_setup_variant;
 struct lp_velems_state;
 
@@ -141,13 +144,25 @@ struct llvmpipe_context {
    unsigned tex_timestamp;
    boolean no_rast;
 
-   /** List of all fragment shader variants */
-   struct lp_fs_variant_list_item fs_variants_list;
-   unsigned nr_fs_variants;
+   /** All fragment shader variants, for eviction */
+   struct lp_variant_cache fs_variant_cache;
    unsigned nr_fs_instrs;
 
+   /** Currently bound fragment shader variant */
+   struct lp_fragment_shader_variant *fs_variant;
+
+   /** Background compilation of optimized fragment shader variants */
+   struct lp_compile_queue *compile_queue;
+   /** Draws which ran on unoptimized (fallback) fragment shader code */
+   uint64_t nr_fallback_draws;
+   /** Fallback variants whose optimized code has been swapped in */
+   uint64_t nr_fs_tier_ups;
+
+   /** Variants JIT compiled together during state validation, or NULL */
+   struct lp_jit_batch *jit_batch;
+
    struct lp_setup_variant_list_item setup_variants_list;
-   unsigned nr_setup_variants;
+   struct lp_variant_cache setup_variant_cache;
 
    /** Conditional query object and mode */
    struct pipe_query *render_cond_query;
@@ -69,6 +69,8 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   llvmpipe_update_fs_tier(lp);
+
    /*
     * Map vertex buffers
     */
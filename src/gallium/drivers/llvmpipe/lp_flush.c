@@ -112,12 +112,14 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
 
       if (cpu_access) {
          /*
-          * Flush and wait.
+          * Flush and wait, but only for the scenes which access the
+          * resource.
           */
          if (do_not_block)
             return FALSE;
 
-         llvmpipe_finish(pipe, reason);
+         llvmpipe_flush(pipe, NULL, reason);
+         lp_setup_wait_resource(llvmpipe_context(pipe)->setup, resource);
       } else {
          /*
           * Just flush.
@@ -0,0 +1,201 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+#include "os/os_time.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "gallivm/lp_bld_init.h"
+#include "lp_limits.h"
+#include "lp_perf.h"
+#include "lp_jit_batch.h"
+
+
+struct lp_jit_batch_entry
+{
+   lp_jit_batch_func func;
+   void *data;
+};
+
+
+struct lp_jit_batch
+{
+   LLVMContextRef context;
+   boolean open;
+   unsigned no;
+
+   /** The shared module, NULL until a variant asks for it */
+   struct gallivm_state *gallivm;
+
+   struct lp_jit_batch_entry entries[LP_MAX_JIT_BATCH];
+   unsigned num_entries;
+};
+
+
+struct lp_jit_batch *
+lp_jit_batch_create(LLVMContextRef context)
+{
+   struct lp_jit_batch *batch = CALLOC_STRUCT(lp_jit_batch);
+
+   if (batch)
+      batch->context = context;
+
+   return batch;
+}
+
+
+void
+lp_jit_batch_destroy(struct lp_jit_batch *batch)
+{
+   assert(!batch->open);
+   assert(!batch->gallivm);
+   FREE(batch);
+}
+
+
+/**
+ * Start collecting variants.
+ */
+void
+lp_jit_batch_begin(struct lp_jit_batch *batch)
+{
+   assert(!batch->open);
+   batch->open = TRUE;
+}
+
+
+/**
+ * Get the shared module to build a variant's functions into.  The
+ * caller owns a reference and must pass the variant to lp_jit_batch_add()
+ * once its IR is complete, or drop the reference on failure.
+ * \return NULL if no batch is open or it is full, in which case the
+ *         variant should be compiled on its own
+ */
+struct gallivm_state *
+lp_jit_batch_module(struct lp_jit_batch *batch)
+{
+   if (!batch->open || batch->num_entries == LP_MAX_JIT_BATCH)
+      return NULL;
+
+   if (!batch->gallivm) {
+      char module_name[64];
+
+      util_snprintf(module_name, sizeof(module_name), "jit_batch%u",
+                    batch->no++);
+
+      batch->gallivm = gallivm_create(module_name, batch->context);
+      if (!batch->gallivm)
+         return NULL;
+   }
+
+   gallivm_reference(batch->gallivm);
+   return batch->gallivm;
+}
+
+
+/**
+ * Defer resolving a variant's functions to lp_jit_batch_end().
+ */
+void
+lp_jit_batch_add(struct lp_jit_batch *batch,
+                 lp_jit_batch_func func, void *data)
+{
+   struct lp_jit_batch_entry *entry;
+
+   assert(batch->open && batch->gallivm);
+   assert(batch->num_entries < LP_MAX_JIT_BATCH);
+
+   entry = &batch->entries[batch->num_entries++];
+   entry->func = func;
+   entry->data = data;
+}
+
+
+/**
+ * Undo lp_jit_batch_module() for a variant which failed before it could be
+ * added: delete whatever functions it built into the shared module, so
+ * they aren't compiled with the rest of the batch, and drop its reference.
+ * NULL entries in \p functions are skipped.
+ */
+void
+lp_jit_batch_drop(struct lp_jit_batch *batch, struct gallivm_state *gallivm,
+                  LLVMValueRef *functions, unsigned num_functions)
+{
+   unsigned i;
+
+   assert(batch->open && gallivm == batch->gallivm);
+
+   for (i = 0; i < num_functions; i++) {
+      if (functions[i])
+         LLVMDeleteFunction(functions[i]);
+   }
+
+   gallivm_destroy(gallivm);
+}
+
+
+/**
+ * Compile the shared module and resolve the functions of all the
+ * variants added since lp_jit_batch_begin().
+ */
+void
+lp_jit_batch_end(struct lp_jit_batch *batch, struct llvmpipe_context *lp)
+{
+   struct gallivm_state *gallivm = batch->gallivm;
+   unsigned i;
+
+   assert(batch->open);
+   batch->open = FALSE;
+
+   if (!gallivm)
+      return;
+
+   if (batch->num_entries) {
+      int64_t t0, dt;
+
+      t0 = os_time_get();
+      gallivm_compile_module(gallivm);
+      dt = os_time_get() - t0;
+      LP_COUNT_ADD(llvm_compile_time, dt);
+
+      for (i = 0; i < batch->num_entries; i++) {
+         batch->entries[i].func(lp, batch->entries[i].data,
+                                gallivm_code_size(gallivm) /
+                                batch->num_entries,
+                                dt / batch->num_entries);
+      }
+
+      gallivm_free_ir(gallivm);
+   }
+
+   batch->gallivm = NULL;
+   batch->num_entries = 0;
+
+   /* the variants hold the remaining references */
+   gallivm_destroy(gallivm);
+}
@@ -0,0 +1,88 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/**
+ * @file
+ * JIT several shader variants in one LLVM module.
+ *
+ * Every module gets its own MCJIT engine and code memory manager, whose
+ * fixed costs dominate for small shaders.  Variants created while a
+ * batch is open (i.e. during one state validation) build their functions
+ * into a shared module, which is compiled once when the batch ends.  The
+ * variants then share the engine and code memory, which is released with
+ * the last of them.
+ */
+
+#ifndef LP_JIT_BATCH_H
+#define LP_JIT_BATCH_H
+
+#include "pipe/p_compiler.h"
+#include "gallivm/lp_bld.h"
+
+
+struct gallivm_state;
+struct llvmpipe_context;
+struct lp_jit_batch;
+
+/**
+ * Called once the batched module is compiled, to resolve the variant's
+ * functions.  The IR is freed right after.
+ * \param code_size     the variant's share of the code size
+ * \param compile_time  the variant's share of the compile time (usecs)
+ */
+typedef void
+(*lp_jit_batch_func)(struct llvmpipe_context *lp, void *data,
+                     size_t code_size, int64_t compile_time);
+
+
+struct lp_jit_batch *
+lp_jit_batch_create(LLVMContextRef context);
+
+void
+lp_jit_batch_destroy(struct lp_jit_batch *batch);
+
+void
+lp_jit_batch_begin(struct lp_jit_batch *batch);
+
+struct gallivm_state *
+lp_jit_batch_module(struct lp_jit_batch *batch);
+
+void
+lp_jit_batch_add(struct lp_jit_batch *batch,
+                 lp_jit_batch_func func, void *data);
+
+void
+lp_jit_batch_drop(struct lp_jit_batch *batch, struct gallivm_state *gallivm,
+                  LLVMValueRef *functions, unsigned num_functions);
+
+void
+lp_jit_batch_end(struct lp_jit_batch *batch, struct llvmpipe_context *lp);
+
+
+#endif /* LP_JIT_BATCH_H */
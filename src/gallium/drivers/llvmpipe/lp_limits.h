@@ -63,6 +63,27 @@
 
 #define LP_MAX_THREADS 16
 
+/**
+ * Max number of threads compiling shader variants in the background.
+ */
+#define LP_MAX_COMPILE_THREADS 4
+
+/**
+ * With background compilation, fragment shader variants start out with
+ * quickly compiled unoptimized code and are only rebuilt with the full
+ * optimization pipeline once they've been used in this many draws, or
+ * covered this many pixels (estimated from triangle areas).
+ */
+#define LP_TIER_UP_DRAWS  32
+#define LP_TIER_UP_PIXELS (1024*1024)
+
+
+/**
+ * Max number of variants JIT compiled together in one module, see
+ * lp_jit_batch.h.
+ */
+#define LP_MAX_JIT_BATCH 4
+
 
 /**
  * Max bytes per scene.  This may be replaced by a runtime parameter.
@@ -76,12 +97,11 @@
 #define LP_MAX_SHADER_VARIANTS 1024
 
 /**
- * Max number of instructions (for all fragment shaders combined per context)
- * that will be kept around (counted in terms of llvm ir).
- * Note: the definition looks odd, but there's branches which use a different
- * number of max shader variants.
+ * Max amount of JIT code, in bytes, (for all fragment shaders combined per
+ * context) that will be kept around.  Can be overridden with the
+ * LP_SHADER_CACHE_SIZE environment variable (in MiB).
  */
-#define LP_MAX_SHADER_INSTRUCTIONS MAX2(256*1024, 512*LP_MAX_SHADER_VARIANTS)
+#define LP_MAX_SHADER_CODE_SIZE (64*1024*1024)
 
 /**
  * Max number of setup variants that will be kept around.
@@ -93,4 +113,9 @@
  */
 #define LP_MAX_SETUP_VARIANTS 64
 
+/**
+ * Max amount of JIT code, in bytes, for all setup variants combined.
+ */
+#define LP_MAX_SETUP_CODE_SIZE (4*1024*1024)
+
 #endif /* LP_LIMITS_H */
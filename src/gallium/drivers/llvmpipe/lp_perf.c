@@ -26,6 +26,7 @@
  **************************************************************************/
 
 #include "util/u_debug.h"
+#include "gallivm/lp_bld_cache.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 
@@ -45,6 +46,7 @@ void
 lp_print_counters(void)
 {
    if (LP_DEBUG & DEBUG_COUNTERS) {
+      struct lp_disk_cache_stats cache_stats;
       unsigned total_64, total_16, total_4;
       float p1, p2, p3, p4, p5, p6;
 
@@ -106,5 +108,10 @@ lp_print_counters(void)
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
+      lp_disk_cache_get_stats(&cache_stats);
+      debug_printf("llvmpipe: nr_disk_cache_hits:           %u\n", cache_stats.hits);
+      debug_printf("llvmpipe: nr_disk_cache_misses:         %u\n", cache_stats.misses);
+      debug_printf("llvmpipe: nr_disk_cache_uncacheable:    %u\n", cache_stats.uncacheable);
+
    }
 }
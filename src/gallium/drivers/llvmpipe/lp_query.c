@@ -55,7 +55,8 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= LP_QUERY_FS_VARIANTS && type <= LP_QUERY_FS_TIER_UPS));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -89,6 +90,62 @@ llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 }
 
 
+/**
+ * Sample the CPU-side counter behind a driver-specific query.
+ */
+static uint64_t
+get_driver_query_value(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   struct lp_variant_cache_stats stats;
+
+   memset(&stats, 0, sizeof stats);
+
+   switch (type) {
+   case LP_QUERY_FS_VARIANTS:
+   case LP_QUERY_FS_CODE_SIZE:
+      lp_variant_cache_add_stats(&llvmpipe->fs_variant_cache, &stats);
+      break;
+   case LP_QUERY_SETUP_VARIANTS:
+      lp_variant_cache_add_stats(&llvmpipe->setup_variant_cache, &stats);
+      break;
+   case LP_QUERY_DRAW_VARIANTS:
+   case LP_QUERY_DRAW_CODE_SIZE:
+      draw_get_variant_cache_stats(llvmpipe->draw, &stats);
+      break;
+   case LP_QUERY_VARIANT_CACHE_HITS:
+   case LP_QUERY_VARIANT_CACHE_MISSES:
+   case LP_QUERY_VARIANT_CACHE_EVICTIONS:
+      lp_variant_cache_add_stats(&llvmpipe->fs_variant_cache, &stats);
+      lp_variant_cache_add_stats(&llvmpipe->setup_variant_cache, &stats);
+      draw_get_variant_cache_stats(llvmpipe->draw, &stats);
+      break;
+   case LP_QUERY_FALLBACK_DRAWS:
+      return llvmpipe->nr_fallback_draws;
+   case LP_QUERY_FS_TIER_UPS:
+      return llvmpipe->nr_fs_tier_ups;
+   default:
+      assert(0);
+      return 0;
+   }
+
+   switch (type) {
+   case LP_QUERY_FS_VARIANTS:
+   case LP_QUERY_SETUP_VARIANTS:
+   case LP_QUERY_DRAW_VARIANTS:
+      return stats.num_variants;
+   case LP_QUERY_FS_CODE_SIZE:
+   case LP_QUERY_DRAW_CODE_SIZE:
+      return stats.code_size;
+   case LP_QUERY_VARIANT_CACHE_HITS:
+      return stats.hits;
+   case LP_QUERY_VARIANT_CACHE_MISSES:
+      return stats.misses;
+   default:
+      return stats.evictions;
+   }
+}
+
+
 static boolean
 llvmpipe_get_query_result(struct pipe_context *pipe, 
                           struct pipe_query *q,
@@ -119,6 +176,20 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    *result = 0;
 
    switch (pq->type) {
+   case LP_QUERY_FS_VARIANTS:
+   case LP_QUERY_FS_CODE_SIZE:
+   case LP_QUERY_SETUP_VARIANTS:
+   case LP_QUERY_DRAW_VARIANTS:
+   case LP_QUERY_DRAW_CODE_SIZE:
+      *result = pq->end[0];
+      break;
+   case LP_QUERY_VARIANT_CACHE_HITS:
+   case LP_QUERY_VARIANT_CACHE_MISSES:
+   case LP_QUERY_VARIANT_CACHE_EVICTIONS:
+   case LP_QUERY_FALLBACK_DRAWS:
+   case LP_QUERY_FS_TIER_UPS:
+      *result = pq->end[0] - pq->start[0];
+      break;
    case PIPE_QUERY_OCCLUSION_COUNTER:
       for (i = 0; i < num_threads; i++) {
          *result += pq->end[i];
@@ -201,6 +272,13 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 
    memset(pq->start, 0, sizeof(pq->start));
    memset(pq->end, 0, sizeof(pq->end));
+
+   /* Driver queries only sample CPU-side counters; nothing is binned. */
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->start[0] = get_driver_query_value(llvmpipe, pq->type);
+      return true;
+   }
+
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -245,6 +323,11 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      pq->end[0] = get_driver_query_value(llvmpipe, pq->type);
+      return;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -320,6 +403,40 @@ llvmpipe_check_render_cond(struct llvmpipe_context *lp)
       return TRUE;
 }
 
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   static const struct pipe_driver_query_info queries[] = {
+      /* running total counters */
+      {"fs-variants", LP_QUERY_FS_VARIANTS, {0}},
+      {"fs-code-size", LP_QUERY_FS_CODE_SIZE, {0},
+       PIPE_DRIVER_QUERY_TYPE_BYTES},
+      {"setup-variants", LP_QUERY_SETUP_VARIANTS, {0}},
+      {"draw-variants", LP_QUERY_DRAW_VARIANTS, {0}},
+      {"draw-code-size", LP_QUERY_DRAW_CODE_SIZE, {0},
+       PIPE_DRIVER_QUERY_TYPE_BYTES},
+
+      /* per-frame counters */
+      {"variant-cache-hits", LP_QUERY_VARIANT_CACHE_HITS, {0}},
+      {"variant-cache-misses", LP_QUERY_VARIANT_CACHE_MISSES, {0}},
+      {"variant-cache-evictions", LP_QUERY_VARIANT_CACHE_EVICTIONS, {0}},
+      {"fallback-draws", LP_QUERY_FALLBACK_DRAWS, {0}},
+      {"fs-tier-ups", LP_QUERY_FS_TIER_UPS, {0}},
+   };
+
+   if (!info)
+      return Elements(queries);
+
+   if (index >= Elements(queries))
+      return 0;
+
+   *info = queries[index];
+   return 1;
+}
+
+
 void llvmpipe_init_query_funcs(struct llvmpipe_context *llvmpipe )
 {
    llvmpipe->pipe.create_query = llvmpipe_create_query;
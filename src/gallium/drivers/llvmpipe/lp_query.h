@@ -41,6 +41,21 @@
 struct llvmpipe_context;
 
 
+/* running total counters */
+#define LP_QUERY_FS_VARIANTS          (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_FS_CODE_SIZE         (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+#define LP_QUERY_SETUP_VARIANTS       (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+#define LP_QUERY_DRAW_VARIANTS        (PIPE_QUERY_DRIVER_SPECIFIC + 3)
+#define LP_QUERY_DRAW_CODE_SIZE       (PIPE_QUERY_DRIVER_SPECIFIC + 4)
+
+/* per-frame counters */
+#define LP_QUERY_VARIANT_CACHE_HITS      (PIPE_QUERY_DRIVER_SPECIFIC + 5)
+#define LP_QUERY_VARIANT_CACHE_MISSES    (PIPE_QUERY_DRIVER_SPECIFIC + 6)
+#define LP_QUERY_VARIANT_CACHE_EVICTIONS (PIPE_QUERY_DRIVER_SPECIFIC + 7)
+#define LP_QUERY_FALLBACK_DRAWS          (PIPE_QUERY_DRIVER_SPECIFIC + 8)
+#define LP_QUERY_FS_TIER_UPS             (PIPE_QUERY_DRIVER_SPECIFIC + 9)
+
+
 struct llvmpipe_query {
    uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
    uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
@@ -55,6 +70,10 @@ struct llvmpipe_query {
 
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
+extern int llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                                          unsigned index,
+                                          struct pipe_driver_query_info *info);
+
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
 #endif /* LP_QUERY_H */
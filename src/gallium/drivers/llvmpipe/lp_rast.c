@@ -69,16 +69,31 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->num_threads );
 }
 
 
+/**
+ * Finish rasterizing a scene.
+ * Called once per scene by one thread, after all threads are done with it.
+ * The scene belongs to the setup thread again as soon as its fence is
+ * signalled, so the scene must not be touched after that.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
+   struct lp_fence *fence = NULL;
+
+   lp_fence_reference(&fence, rast->curr_scene->fence);
+
    lp_scene_end_rasterization( rast->curr_scene );
 
    rast->curr_scene = NULL;
+
+   if (fence) {
+      lp_fence_signal(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 }
 
 
@@ -297,7 +312,6 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_scene *scene = task->scene;
    const struct lp_rast_shader_inputs *inputs = arg.shade_tile;
    const struct lp_rast_state *state;
-   struct lp_fragment_shader_variant *variant;
    const unsigned tile_x = task->x, tile_y = task->y;
    unsigned x, y;
 
@@ -313,7 +327,6 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    if (!state) {
       return;
    }
-   variant = state->variant;
 
    /* render the whole 64x64 tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
@@ -349,18 +362,18 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
          /* run shader on 4x4 block */
          BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
+         state->jit_function[RAST_WHOLE]( &state->jit_context,
+                                          tile_x + x, tile_y + y,
+                                          inputs->frontfacing,
+                                          GET_A0(inputs),
+                                          GET_DADX(inputs),
+                                          GET_DADY(inputs),
+                                          color,
+                                          depth,
+                                          0xffff,
+                                          &task->thread_data,
+                                          stride,
+                                          depth_stride);
          END_JIT_CALL();
       }
    }
@@ -454,18 +467,18 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
-                                            x, y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            mask,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride);
+      state->jit_function[RAST_EDGE_TEST](&state->jit_context,
+                                          x, y,
+                                          inputs->frontfacing,
+                                          GET_A0(inputs),
+                                          GET_DADX(inputs),
+                                          GET_DADY(inputs),
+                                          color,
+                                          depth,
+                                          mask,
+                                          &task->thread_data,
+                                          stride,
+                                          depth_stride);
       END_JIT_CALL();
    }
 }
@@ -683,7 +696,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                              &i, &j))) {
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
@@ -705,10 +719,6 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -757,29 +767,14 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
-void
-lp_rast_finish( struct lp_rasterizer *rast )
-{
-   if (rast->num_threads == 0) {
-      /* nothing to do */
-   }
-   else {
-      int i;
-
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
-   }
-}
-
-
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
  *   1. wait for work
  *   2. do work
- *   3. signal that we're done
+ *   3. signal the scene's fence (thread 0, in lp_rast_end)
+ * Completion is only reported through scene fences, so the setup thread
+ * can keep binning while earlier scenes are still being rasterized.
  */
 static PIPE_THREAD_ROUTINE( thread_function, init_data )
 {
@@ -831,17 +826,12 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
       /* wait for all threads to finish with this scene */
       pipe_barrier_wait( &rast->barrier );
 
-      /* XXX: shouldn't be necessary:
-       */
       if (task->thread_index == 0) {
          lp_rast_end( rast );
       }
 
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
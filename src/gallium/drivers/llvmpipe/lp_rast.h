@@ -88,6 +88,13 @@ struct lp_rast_state {
     * the tile color/z/stencil data somehow
      */
    struct lp_fragment_shader_variant *variant;
+
+   /* The variant's code, copied when the variant is bound.  The variant's
+    * own jit_function[] is replaced on the main thread when optimized code
+    * is swapped in, while binned scenes keep running the code they were
+    * set up with.
+    */
+   lp_jit_frag_func jit_function[2];
 };
 
 
@@ -160,9 +167,6 @@ void
 lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
-void
-lp_rast_finish( struct lp_rasterizer *rast );
-
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
@@ -268,18 +268,18 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
 
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                         x, y,
-                                         inputs->frontfacing,
-                                         GET_A0(inputs),
-                                         GET_DADX(inputs),
-                                         GET_DADY(inputs),
-                                         color,
-                                         depth,
-                                         0xffff,
-                                         &task->thread_data,
-                                         stride,
-                                         depth_stride);
+      state->jit_function[RAST_WHOLE]( &state->jit_context,
+                                       x, y,
+                                       inputs->frontfacing,
+                                       GET_A0(inputs),
+                                       GET_DADX(inputs),
+                                       GET_DADY(inputs),
+                                       color,
+                                       depth,
+                                       0xffff,
+                                       &task->thread_data,
+                                       stride,
+                                       depth_stride);
       END_JIT_CALL();
    }
 }
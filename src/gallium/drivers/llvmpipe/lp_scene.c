@@ -31,6 +31,7 @@
 #include "util/u_inlines.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
+#include "util/u_atomic.h"
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
@@ -62,8 +63,6 @@ lp_scene_create( struct pipe_context *pipe )
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   pipe_mutex_init(scene->mutex);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,7 +89,6 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   pipe_mutex_destroy(scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
    FREE(scene);
@@ -139,9 +137,11 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
 
    bin->last_state = NULL;
    bin->head = bin->tail;
+   bin->num_blocks = 0;
    if (bin->tail) {
       bin->tail->next = NULL;
       bin->tail->count = 0;
+      bin->num_blocks = 1;
    }
 }
 
@@ -204,12 +204,14 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 
 /**
- * Free all the temporary data in a scene.
+ * Unmap the framebuffer surfaces mapped by lp_scene_begin_rasterization().
+ * Called by the rasterizer once all bins have been executed.  The scene
+ * contents stay intact until lp_scene_reset().
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -232,6 +234,22 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                               zsbuf->u.tex.first_layer);
       scene->zsbuf.map = NULL;
    }
+}
+
+
+/**
+ * Free all the temporary data in a scene.
+ *
+ * Only the setup thread which owns the scene may call this, either
+ * after the scene's fence has signalled or for a scene which was never
+ * queued for rasterization.  Deferring this to the owner means the
+ * resource list can be inspected by lp_scene_is_resource_referenced()
+ * without racing the rasterizer threads.
+ */
+void
+lp_scene_reset(struct lp_scene *scene )
+{
+   int i, j;
 
    /* Reset all command lists:
     */
@@ -241,6 +259,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
          bin->head = NULL;
          bin->tail = NULL;
          bin->last_state = NULL;
+         bin->num_blocks = 0;
       }
    }
 
@@ -322,6 +341,7 @@ lp_scene_new_cmd_block( struct lp_scene *scene,
       //memset(block, 0, sizeof *block);
       block->next = NULL;
       block->count = 0;
+      bin->num_blocks++;
    }
    return block;
 }
@@ -429,81 +449,213 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
 /**
  * Does this scene have a reference to the given resource?
+ * \return  bitmask of LP_REFERENCED_FOR_READ/WRITE
  */
-boolean
+unsigned
 lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                 const struct pipe_resource *resource)
 {
    const struct resource_ref *ref;
    int i;
 
+   /* render targets */
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && scene->fb.cbufs[i]->texture == resource)
+         return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+   }
+   if (scene->fb.zsbuf && scene->fb.zsbuf->texture == resource)
+      return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+
+   /* textures read by the scene commands */
    for (ref = scene->resources; ref; ref = ref->next) {
       for (i = 0; i < ref->count; i++)
          if (ref->resource[i] == resource)
-            return TRUE;
+            return LP_REFERENCED_FOR_READ;
    }
 
-   return FALSE;
+   return LP_UNREFERENCED;
 }
 
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/**
+ * Inverse of the Morton bit interleave: gather the even bits of d.
+ */
+static inline unsigned
+morton_compact(unsigned d)
+{
+   d &= 0x55555555;
+   d = (d | (d >> 1)) & 0x33333333;
+   d = (d | (d >> 2)) & 0x0f0f0f0f;
+   d = (d | (d >> 4)) & 0x00ff00ff;
+   d = (d | (d >> 8)) & 0x0000ffff;
+   return d;
+}
+
+
+/**
+ * Sort keys of bin_by_cost are (cost << 16) | bin_order index, so that
+ * sorting them in decreasing order puts the most expensive bins first.
+ */
+static int
+compare_bin_cost(const void *a, const void *b)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
+   uint32_t ka = *(const uint32_t *) a;
+   uint32_t kb = *(const uint32_t *) b;
+   return ka > kb ? -1 : ka < kb;
+}
+
+
+/**
+ * Build the bin schedule for this scene, see struct lp_bin_slice.
+ * Called by one thread before any thread calls lp_scene_bin_iter_next().
+ * \param num_threads  number of rasterizer threads (zero means the
+ *                     calling thread rasterizes on its own)
+ */
+void
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads )
+{
+   unsigned side = util_next_power_of_two(MAX2(scene->tiles_x,
+                                                scene->tiles_y));
+   unsigned num_bins = 0, total_cost = 0;
+   unsigned num_slices, i, d;
+
+   STATIC_ASSERT(TILES_X <= 256 && TILES_Y <= 256);
+
+   /* Walk the Morton curve over the enclosing power-of-two square and
+    * keep the non-empty bins which are inside the framebuffer.
+    */
+   for (d = 0; d < side * side; d++) {
+      unsigned x = morton_compact(d);
+      unsigned y = morton_compact(d >> 1);
+      const struct cmd_bin *bin;
+
+      if (x >= scene->tiles_x || y >= scene->tiles_y)
+         continue;
+
+      bin = lp_scene_get_bin(scene, x, y);
+      if (!bin->head)
+         continue;
+
+      scene->bin_order[num_bins] = (y << 8) | x;
+      scene->bin_cost[num_bins] = MAX2(bin->num_blocks, 1);
+      scene->bin_claimed[num_bins] = 0;
+      total_cost += scene->bin_cost[num_bins];
+      num_bins++;
    }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+
+   num_slices = MAX2(1, MIN2(num_threads, LP_MAX_THREADS));
+   num_slices = MIN2(num_slices, MAX2(num_bins, 1));
+
+   /* Cut the curve into runs of roughly equal cost. */
+   {
+      unsigned begin = 0, acc = 0;
+
+      for (i = 0; i < num_slices; i++) {
+         struct lp_bin_slice *slice = &scene->slice[i];
+         unsigned target = (uint64_t) total_cost * (i + 1) / num_slices;
+         unsigned end = begin, cost = 0;
+
+         while (end < num_bins &&
+                (i == num_slices - 1 || acc + cost < target ||
+                 end == begin)) {
+            cost += scene->bin_cost[end];
+            end++;
+         }
+
+         slice->begin = begin;
+         slice->end = end;
+         slice->next = begin;
+         slice->next_steal = 0;
+         slice->remaining_cost = cost;
+
+         for (d = begin; d < end; d++)
+            scene->bin_by_cost[d] = (MIN2(scene->bin_cost[d], 0xffff) << 16) | d;
+         qsort(&scene->bin_by_cost[begin], end - begin,
+               sizeof scene->bin_by_cost[0], compare_bin_cost);
+
+         acc += cost;
+         begin = end;
+      }
    }
-   return TRUE;
+
+   scene->num_slices = num_slices;
+   scene->num_sched_bins = num_bins;
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+/**
+ * Try to take ownership of the bin at bin_order[pos].
+ */
+static inline struct cmd_bin *
+claim_bin(struct lp_scene *scene, struct lp_bin_slice *slice,
+          unsigned pos, int *x, int *y)
 {
-   scene->curr_x = scene->curr_y = -1;
+   unsigned xy;
+
+   if (p_atomic_read(&scene->bin_claimed[pos]) ||
+       p_atomic_cmpxchg(&scene->bin_claimed[pos], 0, 1) != 0)
+      return NULL;
+
+   p_atomic_add(&slice->remaining_cost, -(int) scene->bin_cost[pos]);
+
+   xy = scene->bin_order[pos];
+   *x = xy & 0xff;
+   *y = xy >> 8;
+   return lp_scene_get_bin(scene, *x, *y);
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Return pointer to next bin to be rendered, or NULL when all bins
+ * have been handed out.  Empty bins are never returned.
  * Multiple rendering threads will call this function to get a chunk
  * of work (a bin) to work on.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y )
 {
-   struct cmd_bin *bin = NULL;
-
-   pipe_mutex_lock(scene->mutex);
-
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   struct lp_bin_slice *own = &scene->slice[thread_index % scene->num_slices];
+   struct cmd_bin *bin;
+   int pos;
+
+   /* Own slice, in Morton order. */
+   while ((pos = p_atomic_inc_return(&own->next) - 1) < own->end) {
+      bin = claim_bin(scene, own, pos, x, y);
+      if (bin)
+         return bin;
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   /* Steal the most expensive bins of the busiest slice. */
+   for (;;) {
+      struct lp_bin_slice *victim = NULL;
+      int best = 0;
+      unsigned i;
+
+      for (i = 0; i < scene->num_slices; i++) {
+         struct lp_bin_slice *slice = &scene->slice[i];
+         int cost = p_atomic_read(&slice->remaining_cost);
+         if (cost > best &&
+             p_atomic_read(&slice->next_steal) < slice->end - slice->begin) {
+            victim = slice;
+            best = cost;
+         }
+      }
+
+      if (!victim)
+         return NULL;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   pipe_mutex_unlock(scene->mutex);
-   return bin;
+      while ((pos = p_atomic_inc_return(&victim->next_steal) - 1) <
+             victim->end - victim->begin) {
+         bin = claim_bin(scene, victim,
+                         scene->bin_by_cost[victim->begin + pos] & 0xffff,
+                         x, y);
+         if (bin)
+            return bin;
+      }
+   }
 }
 
 
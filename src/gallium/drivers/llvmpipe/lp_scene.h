@@ -97,6 +97,7 @@ struct cmd_bin {
    const struct lp_rast_state *last_state;       /* most recent state set in bin */
    struct cmd_block *head;
    struct cmd_block *tail;
+   unsigned num_blocks;                          /* length of the block list */
 };
    
 
@@ -117,6 +118,27 @@ struct data_block_list {
 
 struct resource_ref;
 
+
+/**
+ * Bins are handed out to the rasterizer threads without taking a lock.
+ *
+ * At the start of rasterization the non-empty bins are laid out in
+ * Morton (Z) order in lp_scene::bin_order and cut into one contiguous
+ * slice per thread, balanced by cmd_block count.  Each thread walks its
+ * own slice front to back, which keeps neighbouring tiles (and their
+ * texels) on the same core.  A thread whose slice is exhausted steals
+ * from the slice with the most work left, taking the most expensive
+ * unclaimed bins first.  Ownership of a bin is decided by a
+ * compare-and-swap on its lp_scene::bin_claimed flag.
+ */
+struct lp_bin_slice {
+   int begin, end;        /**< range of lp_scene::bin_order */
+   int next;              /**< owner's cursor, atomic */
+   int next_steal;        /**< thieves' cursor into bin_by_cost, atomic */
+   int remaining_cost;    /**< cmd_blocks not yet claimed, atomic */
+};
+
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -173,8 +195,14 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   pipe_mutex mutex;
+   /** Bin scheduling state, see struct lp_bin_slice */
+   struct lp_bin_slice slice[LP_MAX_THREADS];
+   unsigned num_slices;
+   unsigned num_sched_bins;
+   uint16_t bin_order[TILES_X * TILES_Y];    /**< (y << 8) | x */
+   uint32_t bin_by_cost[TILES_X * TILES_Y];  /**< cost-sorted, per slice */
+   unsigned bin_cost[TILES_X * TILES_Y];     /**< by bin_order index */
+   int bin_claimed[TILES_X * TILES_Y];       /**< by bin_order index */
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -199,8 +227,8 @@ boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
                                         boolean initializing_scene);
 
-boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                        const struct pipe_resource *resource );
+unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
+                                         const struct pipe_resource *resource );
 
 
 /**
@@ -379,10 +407,11 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y );
 
 
 
@@ -406,6 +435,13 @@ void
 lp_scene_end_rasterization(struct lp_scene *scene );
 
 
+/* Release the scene's commands, data and references so it can be
+ * binned again.
+ */
+void
+lp_scene_reset(struct lp_scene *scene );
+
+
 
 
 
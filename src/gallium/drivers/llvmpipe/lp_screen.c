@@ -46,6 +46,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_public.h"
+#include "lp_query.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
 
@@ -67,6 +68,8 @@ static const struct debug_named_value lp_debug_flags[] = {
    { "fence", DEBUG_FENCE, NULL },
    { "mem", DEBUG_MEM, NULL },
    { "fs", DEBUG_FS, NULL },
+   { "tier0", DEBUG_TIER0, NULL },
+   { "tier1", DEBUG_TIER1, NULL },
    DEBUG_NAMED_VALUE_END
 };
 #endif
@@ -604,6 +607,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -614,6 +618,17 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   /* Compile shader variants in the background, running unoptimized code
+    * meanwhile, when there are spare cores.
+    */
+   screen->num_compile_threads = screen->num_threads ? 1 : 0;
+   screen->num_compile_threads = debug_get_num_option("LP_COMPILE_THREADS",
+                                                      screen->num_compile_threads);
+   screen->num_compile_threads = MIN2(screen->num_compile_threads,
+                                      LP_MAX_COMPILE_THREADS);
+
+   screen->jit_batch = debug_get_bool_option("LP_JIT_BATCH", FALSE);
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
       lp_jit_screen_cleanup(screen);
@@ -50,6 +50,8 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_compile_threads;
+   boolean jit_batch;
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
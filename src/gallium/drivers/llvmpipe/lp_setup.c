@@ -69,7 +69,7 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
    assert(setup->scene == NULL);
 
    setup->scene_idx++;
-   setup->scene_idx %= Elements(setup->scenes);
+   setup->scene_idx %= setup->num_scenes;
 
    setup->scene = setup->scenes[setup->scene_idx];
 
@@ -79,6 +79,11 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
                       __FUNCTION__, setup->scene->fence->id);
 
       lp_fence_wait(setup->scene->fence);
+
+      /* The rasterizer is done with the scene, release what it held
+       * on to.
+       */
+      lp_scene_reset(setup->scene);
    }
 
    lp_scene_begin_binning(setup->scene, &setup->fb, setup->rasterizer_discard);
@@ -146,6 +151,25 @@ void lp_setup_reset( struct lp_setup_context *setup )
 }
 
 
+/**
+ * Does the scene render into a display target?  Those get presented by
+ * flush_frontbuffer, which has no context to wait on, so they must be
+ * complete by the time the flush returns.
+ */
+static boolean
+scene_renders_to_display_target( const struct lp_scene *scene )
+{
+   unsigned i;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      struct pipe_surface *cbuf = scene->fb.cbufs[i];
+      if (cbuf && llvmpipe_resource(cbuf->texture)->dt)
+         return TRUE;
+   }
+   return FALSE;
+}
+
+
 /** Rasterize all scene's bins */
 static void
 lp_setup_rasterize_scene( struct lp_setup_context *setup )
@@ -164,23 +188,18 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   pipe_mutex_lock(screen->rast_mutex);
-
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* Don't wait for the rasterizer here.  The next scene is binned while
+    * this one is rasterized, and the scene is only reclaimed (see
+    * lp_setup_get_empty_scene) once its fence has signalled.  Anybody
+    * needing the results waits on the fence, see lp_setup_wait_resource.
     */
+   pipe_mutex_lock(screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    pipe_mutex_unlock(screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
+   if (scene->fence && scene_renders_to_display_target(scene))
+      lp_fence_wait(scene->fence);
+
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -198,9 +217,10 @@ begin_binning( struct lp_setup_context *setup )
    assert(scene);
    assert(scene->fence == NULL);
 
-   /* Always create a fence:
+   /* Always create a fence.  It is signalled once, by the rasterizer
+    * after the whole scene has been executed.
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -341,7 +361,7 @@ set_scene_state( struct lp_setup_context *setup,
 
 fail:
    if (setup->scene) {
-      lp_scene_end_rasterization(setup->scene);
+      lp_scene_reset(setup->scene);
       setup->scene = NULL;
    }
 
@@ -630,6 +650,10 @@ lp_setup_set_fs_variant( struct lp_setup_context *setup,
    /* FIXME: reference count */
 
    setup->fs.current.variant = variant;
+   if (variant) {
+      memcpy(setup->fs.current.jit_function, variant->jit_function,
+             sizeof setup->fs.current.jit_function);
+   }
    setup->dirty |= LP_SETUP_NEW_FS;
 }
 
@@ -964,6 +988,7 @@ unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
                                 const struct pipe_resource *texture )
 {
+   unsigned referenced = LP_UNREFERENCED;
    unsigned i;
 
    /* check the render targets */
@@ -975,14 +1000,51 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < Elements(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
-      }
+   /* check textures referenced by the scenes still pending */
+   for (i = 0; i < setup->num_scenes; i++) {
+      const struct lp_scene *scene = setup->scenes[i];
+
+      if (scene->fence && lp_fence_signalled(scene->fence))
+         continue;
+
+      referenced |= lp_scene_is_resource_referenced(scene, texture);
    }
 
-   return LP_UNREFERENCED;
+   return referenced;
+}
+
+
+/**
+ * Wait until no queued scene accesses the given resource any more.
+ * Scenes are rasterized in order, so it's enough to wait for the most
+ * recent one which references the resource; later scenes which don't
+ * touch it may keep running.  The current scene must have been flushed.
+ */
+void
+lp_setup_wait_resource( struct lp_setup_context *setup,
+                        const struct pipe_resource *resource )
+{
+   unsigned i;
+
+   assert(setup->scene == NULL);
+
+   for (i = 0; i < setup->num_scenes; i++) {
+      unsigned idx = (setup->scene_idx + setup->num_scenes - i) %
+                     setup->num_scenes;
+      struct lp_scene *scene = setup->scenes[idx];
+
+      if (!scene->fence || lp_fence_signalled(scene->fence))
+         continue;
+
+      if (lp_scene_is_resource_referenced(scene, resource)) {
+         if (LP_DEBUG & DEBUG_SETUP)
+            debug_printf("%s: wait for scene %d\n",
+                         __FUNCTION__, scene->fence->id);
+
+         lp_fence_wait(scene->fence);
+         return;
+      }
+   }
 }
 
 
@@ -1277,13 +1339,14 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < Elements(setup->scenes); i++) {
+   /* wait for the scenes still being rasterized, then free them all */
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
+      if (scene->fence && lp_fence_issued(scene->fence))
          lp_fence_wait(scene->fence);
 
+      lp_scene_reset(scene);
       lp_scene_destroy(scene);
    }
 
@@ -1327,8 +1390,11 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
-   /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
+   /* create some empty scenes; without rasterizer threads scenes are
+    * executed synchronously so there's nothing to overlap with.
+    */
+   setup->num_scenes = setup->num_threads ? MAX_SCENES : 1;
+   for (i = 0; i < setup->num_scenes; i++) {
       setup->scenes[i] = lp_scene_create( pipe );
       if (!setup->scenes[i]) {
          goto no_scenes;
@@ -1344,7 +1410,7 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       if (setup->scenes[i]) {
          lp_scene_destroy(setup->scenes[i]);
       }
@@ -54,9 +54,10 @@
 struct lp_setup_variant;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
+/** Max number of scenes.  While the rasterizer threads work on one
+ * scene the setup code can bin up to MAX_SCENES - 1 further scenes.
+ */
+#define MAX_SCENES 3
 
 
 
@@ -87,6 +88,7 @@ struct lp_setup_context
     */
    struct draw_stage *vbuf;
    unsigned num_threads;
+   unsigned num_scenes;                  /**< scenes in the ring */
    unsigned scene_idx;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
@@ -354,6 +354,10 @@ do_triangle_ccw(struct lp_setup_context *setup,
 
    LP_COUNT(nr_tris);
 
+   /* Area is in fixed point and doubled.  Drives the variant's tier-up. */
+   setup->fs.current.variant->nr_pixels +=
+      position->area >> (2 * FIXED_ORDER + 1);
+
    /* Setup parameter interpolants:
     */
    setup->setup.variant->jit_function( v0,
@@ -35,6 +35,7 @@
 #include "lp_screen.h"
 #include "lp_setup.h"
 #include "lp_state.h"
+#include "lp_jit_batch.h"
 
 
 
@@ -174,6 +175,10 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
                           LP_NEW_VS))
       compute_vertex_info( llvmpipe );
 
+   /* JIT the fragment shader and setup variants created below together */
+   if (llvmpipe->jit_batch)
+      lp_jit_batch_begin(llvmpipe->jit_batch);
+
    if (llvmpipe->dirty & (LP_NEW_FS |
                           LP_NEW_FRAMEBUFFER |
                           LP_NEW_BLEND |
@@ -198,6 +203,9 @@ void llvmpipe_update_derived( struct llvmpipe_context *llvmpipe )
                           LP_NEW_RASTERIZER))
       llvmpipe_update_setup( llvmpipe );
 
+   if (llvmpipe->jit_batch)
+      lp_jit_batch_end(llvmpipe->jit_batch, llvmpipe);
+
    if (llvmpipe->dirty & LP_NEW_BLEND_COLOR)
       lp_setup_set_blend_color(llvmpipe->setup,
                                &llvmpipe->blend_color);
@@ -101,6 +101,8 @@
 #include "lp_flush.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
+#include "lp_compile_queue.h"
+#include "lp_jit_batch.h"
 
 
 /** Fragment shader number (for debugging) */
@@ -2160,8 +2162,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2270,6 +2271,9 @@ generate_fragment(struct llvmpipe_context *lp,
                                 arg_types, Elements(arg_types), 0);
 
    function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   if (!function)
+      return;
+
    LLVMSetFunctionCallConv(function, LLVMCCallConv);
 
    variant->function[partial_mask] = function;
@@ -2548,9 +2552,185 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/**
+ * Background compile of the optimized code for a fallback variant.
+ */
+struct lp_fs_compile_job
+{
+   struct lp_compile_job base;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_fragment_shader_variant *optimized;
+   int64_t compile_time;
+};
+
+
+/**
+ * Resolve the variant's functions once its module is compiled.
+ */
+static void
+jit_variant(struct lp_fragment_shader_variant *variant)
+{
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->nr_instrs +=
+         lp_build_count_instructions(variant->function[RAST_EDGE_TEST]);
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+      variant->nr_instrs +=
+         lp_build_count_instructions(variant->function[RAST_WHOLE]);
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   }
+}
+
+
+/**
+ * lp_jit_batch_func for variants built into a batched module.
+ */
+static void
+batched_variant_jitted(struct llvmpipe_context *lp, void *data,
+                       size_t code_size, int64_t compile_time)
+{
+   struct lp_fragment_shader_variant *variant =
+      (struct lp_fragment_shader_variant *) data;
+
+   jit_variant(variant);
+   lp->nr_fs_instrs += variant->nr_instrs;
+
+   lp_variant_cache_update(&lp->fs_variant_cache, &variant->cache_entry,
+                           code_size,
+                           variant->cache_entry.cost + compile_time);
+}
+
+
+/**
+ * Build and JIT the variant's functions in the given LLVM context.
+ *
+ * If a JIT batch is open the functions are built into its shared module
+ * instead, and only resolved in lp_jit_batch_end().
+ */
+static boolean
+compile_variant(struct lp_fragment_shader_variant *variant,
+                LLVMContextRef context, struct lp_jit_batch *batch,
+                boolean fast)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+   char module_name[64];
+
+   if (batch && !fast)
+      variant->gallivm = lp_jit_batch_module(batch);
+   else
+      batch = NULL;
+
+   if (!variant->gallivm) {
+      util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u%s",
+                    shader->no, variant->no, fast ? "_fast" : "");
+
+      variant->gallivm = gallivm_create(module_name, context);
+      if (!variant->gallivm)
+         return FALSE;
+
+      variant->gallivm->fast_compile = fast;
+      batch = NULL;
+   }
+
+   gallivm_add_cache_key(variant->gallivm, &variant->key,
+                         shader->variant_key_size);
+   gallivm_add_cache_key(variant->gallivm, shader->base.tokens,
+                         tgsi_num_tokens(shader->base.tokens) *
+                         sizeof(struct tgsi_token));
+   /* Some LP_PERF flags (PERF_NO_TEX) change the code without showing up
+    * in the variant key.
+    */
+   gallivm_add_cache_key(variant->gallivm, &LP_PERF, sizeof LP_PERF);
+
+   lp_jit_init_types(variant);
+   
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(shader, variant, RAST_WHOLE);
+      }
+   }
+
+   if (!variant->function[RAST_EDGE_TEST] ||
+       (variant->opaque && !variant->function[RAST_WHOLE])) {
+      if (batch)
+         lp_jit_batch_drop(batch, variant->gallivm, variant->function, 2);
+      else
+         gallivm_destroy(variant->gallivm);
+      variant->gallivm = NULL;
+      return FALSE;
+   }
+
+   if (batch) {
+      lp_jit_batch_add(batch, batched_variant_jitted, variant);
+      return TRUE;
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   jit_variant(variant);
+
+   gallivm_free_ir(variant->gallivm);
+
+   return TRUE;
+}
+
+
+/**
+ * Runs on a compile thread.  Only reads the immutable parts of the
+ * fallback variant (key, shader, flags derived from the key).
+ */
+static void
+compile_job_func(struct lp_compile_job *base, LLVMContextRef context)
+{
+   struct lp_fs_compile_job *job = (struct lp_fs_compile_job *) base;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader_variant *optimized;
+   int64_t t0;
+
+   optimized = CALLOC_STRUCT(lp_fragment_shader_variant);
+   if (!optimized)
+      return;
+
+   memcpy(&optimized->key, &variant->key, variant->shader->variant_key_size);
+   optimized->shader = variant->shader;
+   optimized->no = variant->no;
+   optimized->opaque = variant->opaque;
+   optimized->ps_inv_multiplier = variant->ps_inv_multiplier;
+
+   t0 = os_time_get();
+   if (!compile_variant(optimized, context, NULL, FALSE)) {
+      FREE(optimized);
+      return;
+   }
+   job->compile_time = os_time_get() - t0;
+   job->optimized = optimized;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * With a compile queue the variant is first built with a fast,
+ * unoptimized compile.  Once it is hot, tier_up_variant() rebuilds it
+ * in the background and update_fallback_variant() swaps the optimized
+ * code in.  LP_DEBUG=tier0/tier1 force either kind of code throughout.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
@@ -2560,23 +2740,12 @@ generate_variant(struct llvmpipe_context *lp,
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc;
    boolean fullcolormask;
-   char module_name[64];
 
    variant = CALLOC_STRUCT(lp_fragment_shader_variant);
    if(!variant)
       return NULL;
 
-   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
-
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
-
    variant->shader = shader;
-   variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
 
@@ -2613,43 +2782,124 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+   variant->fallback = (LP_DEBUG & DEBUG_TIER0) ||
+                       (lp->compile_queue && !(LP_DEBUG & DEBUG_TIER1));
 
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
+   if (!compile_variant(variant, lp->context, lp->jit_batch,
+                        variant->fallback)) {
+      FREE(variant);
+      return NULL;
    }
 
-   /*
-    * Compile everything
-    */
+   return variant;
+}
 
-   gallivm_compile_module(variant->gallivm);
 
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+/**
+ * Queue the optimized build of a fallback variant.
+ */
+static void
+tier_up_variant(struct llvmpipe_context *lp,
+                struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_compile_job *job = CALLOC_STRUCT(lp_fs_compile_job);
 
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
-   }
+   if (!job)
+      return;
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   job->base.func = compile_job_func;
+   job->variant = variant;
+   variant->compile_job = job;
+   lp_compile_queue_add(lp->compile_queue, &job->base);
+}
+
+
+/**
+ * Swap in the optimized code of a fallback variant, if it is ready.
+ *
+ * Rasterizer threads never read the variant's jit_function[]: binned
+ * scenes run the copy taken into their lp_rast_state when the variant was
+ * bound, so the new code is only picked up by state set up after it is
+ * rebound here.  The fallback code is kept until the variant is destroyed,
+ * as those scenes may still be running it.
+ */
+static void
+update_fallback_variant(struct llvmpipe_context *lp,
+                        struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_compile_job *job = variant->compile_job;
+   struct lp_fragment_shader_variant *optimized;
+
+   if (!lp_compile_job_done(&job->base))
+      return;
+
+   optimized = job->optimized;
+   if (optimized) {
+      variant->fallback_gallivm = variant->gallivm;
+      variant->gallivm = optimized->gallivm;
+      variant->jit_function[RAST_EDGE_TEST] =
+         optimized->jit_function[RAST_EDGE_TEST];
+      variant->jit_function[RAST_WHOLE] =
+         optimized->jit_function[RAST_WHOLE];
+
+      lp->nr_fs_instrs -= variant->nr_instrs;
+      lp->nr_fs_instrs += optimized->nr_instrs;
+      variant->nr_instrs = optimized->nr_instrs;
+      variant->fallback = FALSE;
+
+      lp_variant_cache_update(&lp->fs_variant_cache, &variant->cache_entry,
+                              gallivm_code_size(variant->fallback_gallivm) +
+                              gallivm_code_size(variant->gallivm),
+                              variant->cache_entry.cost + job->compile_time);
+
+      LP_COUNT_ADD(llvm_compile_time, job->compile_time);
+      LP_COUNT_ADD(nr_llvm_compiles, 1);
+      lp->nr_fs_tier_ups++;
+
+      FREE(optimized);
+
+      if (lp->fs_variant == variant)
+         lp_setup_set_fs_variant(lp->setup, variant);
+   }
+   else {
+      /* Keep the fallback code rather than retrying on every draw. */
+      variant->tier_up_failed = TRUE;
    }
 
-   gallivm_free_ir(variant->gallivm);
+   variant->compile_job = NULL;
+   FREE(job);
+}
 
-   return variant;
+
+/**
+ * Called on every draw: count the draw against the bound variant, start
+ * optimizing it once it is hot, pick up the optimized code when it
+ * becomes available, and count the draws made without it.
+ */
+void
+llvmpipe_update_fs_tier(struct llvmpipe_context *lp)
+{
+   struct lp_fragment_shader_variant *variant = lp->fs_variant;
+
+   if (!variant)
+      return;
+
+   variant->nr_draws++;
+
+   if (variant->fallback) {
+      if (variant->compile_job) {
+         update_fallback_variant(lp, variant);
+      }
+      else if (lp->compile_queue && !(LP_DEBUG & DEBUG_TIER0) &&
+               !variant->tier_up_failed &&
+               (variant->nr_draws >= LP_TIER_UP_DRAWS ||
+                variant->nr_pixels >= LP_TIER_UP_PIXELS)) {
+         tier_up_variant(lp, variant);
+      }
+
+      if (variant->fallback)
+         lp->nr_fallback_draws++;
+   }
 }
 
 
@@ -2780,18 +3030,41 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    variant->no,
                    variant->shader->variants_created,
                    variant->shader->variants_cached,
-                   lp->nr_fs_variants);
+                   lp->fs_variant_cache.num_variants);
    }
 
+   if (LP_DEBUG & DEBUG_COUNTERS) {
+      debug_printf("llvmpipe: fs #%u var #%u: %llu draws, %llu pixels, %s\n",
+                   variant->shader->no,
+                   variant->no,
+                   (unsigned long long) variant->nr_draws,
+                   (unsigned long long) variant->nr_pixels,
+                   variant->fallback ? "unoptimized" : "optimized");
+   }
+
+   if (variant->compile_job) {
+      struct lp_fs_compile_job *job = variant->compile_job;
+      lp_compile_queue_cancel(lp->compile_queue, &job->base);
+      if (job->optimized) {
+         gallivm_destroy(job->optimized->gallivm);
+         FREE(job->optimized);
+      }
+      FREE(job);
+   }
+
+   if (variant->fallback_gallivm)
+      gallivm_destroy(variant->fallback_gallivm);
    gallivm_destroy(variant->gallivm);
 
+   if (lp->fs_variant == variant)
+      lp->fs_variant = NULL;
+
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
 
-   /* remove from context's list */
-   remove_from_list(&variant->list_item_global);
-   lp->nr_fs_variants--;
+   /* remove from context's cache */
+   lp_variant_cache_remove(&lp->fs_variant_cache, &variant->cache_entry);
    lp->nr_fs_instrs -= variant->nr_instrs;
 
    FREE(variant);
@@ -3086,6 +3359,14 @@ make_variant_key(struct llvmpipe_context *lp,
 
 
 
+static void
+evict_fs_variant(void *variant, void *data)
+{
+   llvmpipe_remove_shader_variant((struct llvmpipe_context *) data,
+                                  (struct lp_fragment_shader_variant *) variant);
+}
+
+
 /**
  * Update fragment shader state.  This is called just prior to drawing
  * something when some fragment-related state has changed.
@@ -3111,31 +3392,29 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
 
    if (variant) {
-      /* Move this variant to the head of the list to implement LRU
-       * deletion of shader's when we have too many.
-       */
-      move_to_head(&lp->fs_variants_list, &variant->list_item_global);
+      lp_variant_cache_hit(&lp->fs_variant_cache, &variant->cache_entry);
+
+      if (variant->compile_job)
+         update_fallback_variant(lp, variant);
    }
    else {
       /* variant not found, create it now */
+      struct lp_variant_cache *cache = &lp->fs_variant_cache;
       int64_t t0, t1, dt;
-      unsigned i;
-      unsigned variants_to_cull;
 
       if (0) {
-         debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
-                      lp->nr_fs_variants,
+         debug_printf("%u variants,\t%u instrs,\t%u bytes/variant\n",
+                      cache->num_variants,
                       lp->nr_fs_instrs,
-                      lp->nr_fs_variants ? lp->nr_fs_instrs / lp->nr_fs_variants : 0);
+                      cache->num_variants ?
+                      (unsigned) (cache->code_size / cache->num_variants) : 0);
       }
 
-      /* First, check if we've exceeded the max number of shader variants.
-       * If so, free 25% of them (the least recently used ones).
+      /* First, check if we've exceeded the variant count or code size
+       * budget.  If so, evict the variants which are cheapest to rebuild
+       * relative to their size, least recently used first.
        */
-      variants_to_cull = lp->nr_fs_variants >= LP_MAX_SHADER_VARIANTS ? LP_MAX_SHADER_VARIANTS / 4 : 0;
-
-      if (variants_to_cull ||
-          lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
+      if (lp_variant_cache_full(cache)) {
          struct pipe_context *pipe = &lp->pipe;
 
          /*
@@ -3146,21 +3425,11 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          llvmpipe_finish(pipe, __FUNCTION__);
 
          /*
-          * We need to re-check lp->nr_fs_variants because an arbitrarliy large
-          * number of shader variants (potentially all of them) could be
-          * pending for destruction on flush.
+          * The cache is re-checked as it is trimmed, because an arbitrarily
+          * large number of shader variants (potentially all of them) could
+          * be pending for destruction on flush.
           */
-
-         for (i = 0; i < variants_to_cull || lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS; i++) {
-            struct lp_fs_variant_list_item *item;
-            if (is_empty_list(&lp->fs_variants_list)) {
-               break;
-            }
-            item = last_elem(&lp->fs_variants_list);
-            assert(item);
-            assert(item->base);
-            llvmpipe_remove_shader_variant(lp, item->base);
-         }
+         lp_variant_cache_evict(cache, evict_fs_variant, lp);
       }
 
       /*
@@ -3176,14 +3445,15 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       /* Put the new variant into the list */
       if (variant) {
          insert_at_head(&shader->variants, &variant->list_item_local);
-         insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
-         lp->nr_fs_variants++;
+         lp_variant_cache_insert(cache, &variant->cache_entry, variant,
+                                 gallivm_code_size(variant->gallivm), dt);
          lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
 
    /* Bind this variant */
+   lp->fs_variant = variant;
    lp_setup_set_fs_variant(lp->setup, variant);
 }
 
@@ -35,11 +35,13 @@
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "gallivm/lp_bld_variant_cache.h"
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct lp_fs_compile_job;
 
 
 /** Indexes into jit_function[] array */
@@ -113,7 +115,21 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
-   struct lp_fs_variant_list_item list_item_global, list_item_local;
+   /** Draws made with this variant bound */
+   uint64_t nr_draws;
+   /** Pixels covered by its triangles, estimated from their areas */
+   uint64_t nr_pixels;
+
+   /** Running unoptimized code, until compile_job (if any) finishes */
+   boolean fallback;
+   struct lp_fs_compile_job *compile_job;
+   /** The optimized build failed, so the variant stays on fallback code */
+   boolean tier_up_failed;
+   /** Unoptimized code, kept alive while scenes may reference it */
+   struct gallivm_state *fallback_gallivm;
+
+   struct lp_fs_variant_list_item list_item_local;
+   struct lp_variant_cache_entry cache_entry;
    struct lp_fragment_shader *shader;
 
    /* For debugging/profiling purposes */
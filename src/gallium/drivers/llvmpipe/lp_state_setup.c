@@ -48,6 +48,7 @@
 #include "lp_state.h"
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
+#include "lp_jit_batch.h"
 
 
 /** Setup shader number (for debugging) */
@@ -700,16 +701,37 @@ init_args(struct gallivm_state *gallivm,
    emit_linear_coef(gallivm, args, 0, attr_pos);
 }
 
+/**
+ * lp_jit_batch_func for variants built into a batched module.
+ */
+static void
+batched_setup_variant_jitted(struct llvmpipe_context *lp, void *data,
+                             size_t code_size, int64_t compile_time)
+{
+   struct lp_setup_variant *variant = (struct lp_setup_variant *) data;
+
+   variant->jit_function = (lp_jit_setup_triangle)
+      gallivm_jit_function(variant->gallivm, variant->function);
+   assert(variant->jit_function);
+
+   lp_variant_cache_update(&lp->setup_variant_cache, &variant->cache_entry,
+                           code_size,
+                           variant->cache_entry.cost + compile_time);
+}
+
+
 /**
  * Generate the runtime callable function for the coefficient calculation.
  *
+ * While a JIT batch is open the function is built into its shared module
+ * and only resolved in lp_jit_batch_end().
  */
 static struct lp_setup_variant *
 generate_setup_variant(struct lp_setup_variant_key *key,
                        struct llvmpipe_context *lp)
 {
    struct lp_setup_variant *variant = NULL;
-   struct gallivm_state *gallivm;
+   struct gallivm_state *gallivm = NULL;
    struct lp_setup_args args;
    char func_name[64];
    LLVMTypeRef vec4f_type;
@@ -717,6 +739,7 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    LLVMTypeRef arg_types[7];
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
+   boolean batched = FALSE;
    int64_t t0 = 0, t1;
 
    if (0)
@@ -731,7 +754,13 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    util_snprintf(func_name, sizeof(func_name), "setup_variant_%u",
                  variant->no);
 
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context);
+   if (lp->jit_batch)
+      gallivm = lp_jit_batch_module(lp->jit_batch);
+   batched = gallivm != NULL;
+   if (!gallivm)
+      gallivm = gallivm_create(func_name, lp->context);
+
+   variant->gallivm = gallivm;
    if (!variant->gallivm) {
       goto fail;
    }
@@ -745,6 +774,8 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    memcpy(&variant->key, key, key->size);
    variant->list_item_global.base = variant;
 
+   gallivm_add_cache_key(gallivm, key, key->size);
+
    /* Currently always deal with full 4-wide vertex attributes from
     * the vertices.
     */
@@ -799,14 +830,19 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    gallivm_verify_function(gallivm, variant->function);
 
-   gallivm_compile_module(gallivm);
+   if (batched) {
+      lp_jit_batch_add(lp->jit_batch, batched_setup_variant_jitted, variant);
+   }
+   else {
+      gallivm_compile_module(gallivm);
 
-   variant->jit_function = (lp_jit_setup_triangle)
-      gallivm_jit_function(gallivm, variant->function);
-   if (!variant->jit_function)
-      goto fail;
+      variant->jit_function = (lp_jit_setup_triangle)
+         gallivm_jit_function(gallivm, variant->function);
+      if (!variant->jit_function)
+         goto fail;
 
-   gallivm_free_ir(variant->gallivm);
+      gallivm_free_ir(variant->gallivm);
+   }
 
    /*
     * Update timing information:
@@ -821,7 +857,11 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
 fail:
    if (variant) {
-      if (variant->gallivm) {
+      if (batched) {
+         lp_jit_batch_drop(lp->jit_batch, variant->gallivm,
+                           &variant->function, 1);
+      }
+      else if (variant->gallivm) {
          gallivm_destroy(variant->gallivm);
       }
       FREE(variant);
@@ -893,7 +933,7 @@ remove_setup_variant(struct llvmpipe_context *lp,
 {
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       debug_printf("llvmpipe: del setup_variant #%u total %u\n",
-                   variant->no, lp->nr_setup_variants);
+                   variant->no, lp->setup_variant_cache.num_variants);
    }
 
    if (variant->gallivm) {
@@ -901,20 +941,26 @@ remove_setup_variant(struct llvmpipe_context *lp,
    }
 
    remove_from_list(&variant->list_item_global);
-   lp->nr_setup_variants--;
+   lp_variant_cache_remove(&lp->setup_variant_cache, &variant->cache_entry);
    FREE(variant);
 }
 
 
+static void
+evict_setup_variant(void *variant, void *data)
+{
+   remove_setup_variant((struct llvmpipe_context *) data,
+                        (struct lp_setup_variant *) variant);
+}
+
 
-/* When the number of setup variants exceeds a threshold, cull a
- * fraction (currently a quarter) of them.
+/* When the setup variants exceed their count or code size budget, evict
+ * the ones which are cheapest to rebuild, least recently used first.
  */
 static void
 cull_setup_variants(struct llvmpipe_context *lp)
 {
    struct pipe_context *pipe = &lp->pipe;
-   int i;
 
    /*
     * XXX: we need to flush the context until we have some sort of reference
@@ -923,16 +969,7 @@ cull_setup_variants(struct llvmpipe_context *lp)
     */
    llvmpipe_finish(pipe, __FUNCTION__);
 
-   for (i = 0; i < LP_MAX_SETUP_VARIANTS / 4; i++) {
-      struct lp_setup_variant_list_item *item;
-      if (is_empty_list(&lp->setup_variants_list)) {
-         break;
-      }
-      item = last_elem(&lp->setup_variants_list);
-      assert(item);
-      assert(item->base);
-      remove_setup_variant(lp, item->base);
-   }
+   lp_variant_cache_evict(&lp->setup_variant_cache, evict_setup_variant, lp);
 }
 
 
@@ -960,16 +997,24 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
 
    if (variant) {
       move_to_head(&lp->setup_variants_list, &variant->list_item_global);
+      lp_variant_cache_hit(&lp->setup_variant_cache, &variant->cache_entry);
    }
    else {
-      if (lp->nr_setup_variants >= LP_MAX_SETUP_VARIANTS) {
+      int64_t t0, t1;
+
+      if (lp_variant_cache_full(&lp->setup_variant_cache)) {
          cull_setup_variants(lp);
       }
 
+      t0 = os_time_get();
       variant = generate_setup_variant(key, lp);
+      t1 = os_time_get();
       if (variant) {
          insert_at_head(&lp->setup_variants_list, &variant->list_item_global);
-         lp->nr_setup_variants++;
+         lp_variant_cache_insert(&lp->setup_variant_cache,
+                                 &variant->cache_entry, variant,
+                                 gallivm_code_size(variant->gallivm),
+                                 t1 - t0);
       }
    }
 
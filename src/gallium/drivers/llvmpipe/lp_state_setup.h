@@ -1,6 +1,7 @@
 #ifndef LP_STATE_SETUP_H
 #define LP_STATE_SETUP_H
 
+#include "gallivm/lp_bld_variant_cache.h"
 #include "lp_bld_interp.h"
 
 
@@ -57,6 +58,7 @@ struct lp_setup_variant {
    struct lp_setup_variant_key key;
    
    struct lp_setup_variant_list_item list_item_global;
+   struct lp_variant_cache_entry cache_entry;
 
    struct gallivm_state *gallivm;
 
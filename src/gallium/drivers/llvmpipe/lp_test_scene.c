@@ -0,0 +1,385 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit test and microbenchmark for the scene bin scheduler.
+ *
+ * Fills a scene with synthetic bins and has N threads drain it, once
+ * through lp_scene_bin_iter_next() and once through a mutex-protected
+ * raster-order iterator equivalent to the one it replaced.  Every
+ * non-empty bin must be handed out exactly once.
+ */
+
+
+#include <string.h>
+
+#include "os/os_thread.h"
+#include "os/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "lp_scene.h"
+#include "lp_test.h"
+
+
+enum bin_load {
+   LOAD_UNIFORM,
+   LOAD_HOTSPOT,
+   LOAD_SPARSE,
+   NUM_LOADS
+};
+
+static const char *load_names[NUM_LOADS] = {
+   "uniform",
+   "hotspot",
+   "sparse"
+};
+
+
+struct sched_test {
+   struct lp_scene *scene;
+   boolean reference;
+   pipe_barrier barrier;
+
+   /* reference iterator state */
+   pipe_mutex mutex;
+   int curr_x, curr_y;
+
+   /* per-tile "framebuffer" touched for every command block */
+   uint8_t *tiles;
+   int visits[TILES_X * TILES_Y];
+};
+
+
+struct sched_thread {
+   struct sched_test *test;
+   unsigned index;
+   unsigned checksum;
+};
+
+
+static struct cmd_bin *
+reference_iter_next(struct sched_test *test, int *x, int *y)
+{
+   struct lp_scene *scene = test->scene;
+   struct cmd_bin *bin = NULL;
+
+   pipe_mutex_lock(test->mutex);
+
+   if (test->curr_x < 0) {
+      test->curr_x = 0;
+      test->curr_y = 0;
+   }
+   else if (++test->curr_x >= (int) scene->tiles_x) {
+      test->curr_x = 0;
+      test->curr_y++;
+   }
+
+   if (test->curr_y < (int) scene->tiles_y) {
+      bin = lp_scene_get_bin(scene, test->curr_x, test->curr_y);
+      *x = test->curr_x;
+      *y = test->curr_y;
+   }
+
+   pipe_mutex_unlock(test->mutex);
+   return bin;
+}
+
+
+/**
+ * Stand-in for rasterize_bin(): touch the tile once per command.
+ */
+static unsigned
+process_bin(struct sched_test *test, const struct cmd_bin *bin,
+            int x, int y)
+{
+   uint8_t *tile = test->tiles +
+      (y * TILES_X + x) * (size_t) (TILE_SIZE * TILE_SIZE);
+   const struct cmd_block *block;
+   unsigned sum = 0;
+   unsigned i, k;
+
+   for (block = bin->head; block; block = block->next) {
+      for (k = 0; k < block->count; k++) {
+         for (i = 0; i < TILE_SIZE * TILE_SIZE; i += 16) {
+            tile[i] += block->cmd[k];
+            sum += tile[i];
+         }
+      }
+   }
+
+   return sum;
+}
+
+
+static PIPE_THREAD_ROUTINE( sched_thread_func, param )
+{
+   struct sched_thread *thread = (struct sched_thread *) param;
+   struct sched_test *test = thread->test;
+   struct cmd_bin *bin;
+   int x, y;
+
+   pipe_barrier_wait(&test->barrier);
+
+   for (;;) {
+      if (test->reference)
+         bin = reference_iter_next(test, &x, &y);
+      else
+         bin = lp_scene_bin_iter_next(test->scene, thread->index, &x, &y);
+      if (!bin)
+         break;
+
+      p_atomic_inc(&test->visits[y * TILES_X + x]);
+      if (bin->head)
+         thread->checksum += process_bin(test, bin, x, y);
+   }
+
+   return 0;
+}
+
+
+/**
+ * Bin the synthetic load.  Returns the number of non-empty bins.
+ */
+static unsigned
+fill_scene(struct lp_scene *scene, enum bin_load load,
+           unsigned width, unsigned height)
+{
+   struct pipe_framebuffer_state fb;
+   unsigned x, y, k, n, num_bins = 0;
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = width;
+   fb.height = height;
+   lp_scene_begin_binning(scene, &fb, FALSE);
+
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         switch (load) {
+         case LOAD_HOTSPOT: {
+            int dx = (int) x - (int) scene->tiles_x / 2;
+            int dy = (int) y - (int) scene->tiles_y / 2;
+            n = dx * dx + dy * dy < 16 ? 8 * CMD_BLOCK_MAX : 2;
+            break;
+         }
+         case LOAD_SPARSE:
+            n = (rand() % 4) ? 0 : 1 + rand() % (4 * CMD_BLOCK_MAX);
+            break;
+         case LOAD_UNIFORM:
+         default:
+            n = 1 + rand() % (2 * CMD_BLOCK_MAX);
+            break;
+         }
+
+         for (k = 0; k < n; k++) {
+            if (!lp_scene_bin_command(scene, x, y,
+                                      LP_RAST_OP_SHADE_TILE,
+                                      lp_rast_arg_null()))
+               break;
+         }
+         if (k)
+            num_bins++;
+      }
+   }
+
+   lp_scene_end_binning(scene);
+   return num_bins;
+}
+
+
+/**
+ * Drain the scene with num_threads threads.  Returns elapsed time in
+ * microseconds, or a negative value if bins were lost or duplicated.
+ */
+static int64_t
+run_one(struct sched_test *test, boolean reference, unsigned num_threads)
+{
+   struct lp_scene *scene = test->scene;
+   struct sched_thread threads[LP_MAX_THREADS];
+   pipe_thread handles[LP_MAX_THREADS];
+   int64_t start, end;
+   unsigned i, x, y;
+
+   memset(test->visits, 0, sizeof test->visits);
+   test->reference = reference;
+   test->curr_x = test->curr_y = -1;
+   pipe_barrier_init(&test->barrier, num_threads + 1);
+
+   start = os_time_get();
+
+   if (!reference)
+      lp_scene_bin_iter_begin(scene, num_threads);
+
+   for (i = 0; i < num_threads; i++) {
+      threads[i].test = test;
+      threads[i].index = i;
+      threads[i].checksum = 0;
+      handles[i] = pipe_thread_create(sched_thread_func, &threads[i]);
+   }
+
+   pipe_barrier_wait(&test->barrier);
+
+   for (i = 0; i < num_threads; i++)
+      pipe_thread_wait(handles[i]);
+
+   end = os_time_get();
+
+   pipe_barrier_destroy(&test->barrier);
+
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+         int expected = (reference || bin->head) ? 1 : 0;
+         if (test->visits[y * TILES_X + x] != expected)
+            return -1;
+      }
+   }
+
+   return end - start;
+}
+
+
+static boolean
+test_one(unsigned verbose, FILE *fp, enum bin_load load,
+         unsigned num_threads)
+{
+   struct sched_test *test;
+   unsigned width = 1920, height = 1080;
+   unsigned num_bins;
+   int64_t ref_time, sched_time;
+   boolean success = TRUE;
+
+   test = CALLOC_STRUCT(sched_test);
+   if (!test)
+      return FALSE;
+
+   test->scene = lp_scene_create(NULL);
+   test->tiles = CALLOC(TILES_X * (align(height, TILE_SIZE) / TILE_SIZE),
+                        TILE_SIZE * TILE_SIZE);
+   pipe_mutex_init(test->mutex);
+
+   if (!test->scene || !test->tiles) {
+      success = FALSE;
+      goto out;
+   }
+
+   num_bins = fill_scene(test->scene, load, width, height);
+
+   ref_time = run_one(test, TRUE, num_threads);
+   sched_time = run_one(test, FALSE, num_threads);
+
+   if (ref_time < 0 || sched_time < 0)
+      success = FALSE;
+
+   if (verbose >= 1 || !success) {
+      fprintf(stderr,
+              "%s: %s bins=%u threads=%u raster-order=%lldus scheduled=%lldus\n",
+              success ? "PASS" : "FAIL", load_names[load], num_bins,
+              num_threads, (long long) ref_time, (long long) sched_time);
+   }
+
+   if (fp) {
+      fprintf(fp,
+              "%s\t%s\t%u\t%u\t%lld\t%lld\n",
+              success ? "pass" : "fail", load_names[load], num_bins,
+              num_threads, (long long) ref_time, (long long) sched_time);
+      fflush(fp);
+   }
+
+   lp_scene_end_rasterization(test->scene);
+   lp_scene_reset(test->scene);
+
+out:
+   pipe_mutex_destroy(test->mutex);
+   if (test->scene)
+      lp_scene_destroy(test->scene);
+   FREE(test->tiles);
+   FREE(test);
+   return success;
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "load\t"
+           "bins\t"
+           "threads\t"
+           "raster_order_us\t"
+           "scheduled_us\n");
+
+   fflush(fp);
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   unsigned max_threads = MIN2(MAX2(util_cpu_caps.nr_cpus, 1),
+                               LP_MAX_THREADS);
+   unsigned load, num_threads;
+   boolean success = TRUE;
+
+   for (load = 0; load < NUM_LOADS; load++) {
+      for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+         if (!test_one(verbose, fp, load, num_threads))
+            success = FALSE;
+      }
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   unsigned max_threads = MIN2(MAX2(util_cpu_caps.nr_cpus, 1),
+                               LP_MAX_THREADS);
+   unsigned long i;
+   boolean success = TRUE;
+
+   for (i = 0; i < n; ++i) {
+      if (!test_one(verbose, fp, rand() % NUM_LOADS,
+                    1 + rand() % max_threads))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_one(verbose, fp, LOAD_HOTSPOT, LP_MAX_THREADS);
+}
@@ -48,6 +48,7 @@
 #include "sp_tex_tile_cache.h"
 #include "sp_texture.h"
 #include "sp_query.h"
+#include "sp_rast.h"
 #include "sp_screen.h"
 #include "sp_tex_sample.h"
 
@@ -73,17 +74,9 @@ softpipe_destroy( struct pipe_context *pipe )
    if (softpipe->draw)
       draw_destroy( softpipe->draw );
 
-   if (softpipe->quad.shade)
-      softpipe->quad.shade->destroy( softpipe->quad.shade );
+   sp_rast_destroy(softpipe->rast);
 
-   if (softpipe->quad.depth_test)
-      softpipe->quad.depth_test->destroy( softpipe->quad.depth_test );
-
-   if (softpipe->quad.blend)
-      softpipe->quad.blend->destroy( softpipe->quad.blend );
-
-   if (softpipe->quad.pstipple)
-      softpipe->quad.pstipple->destroy( softpipe->quad.pstipple );
+   sp_destroy_quad_pipeline(&softpipe->quad);
 
    for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
       sp_destroy_tile_cache(softpipe->cbuf_cache[i]);
@@ -246,10 +239,14 @@ softpipe_create_context(struct pipe_screen *screen,
    softpipe->fs_machine = tgsi_exec_machine_create();
 
    /* setup quad rendering stages */
-   softpipe->quad.shade = sp_quad_shade_stage(softpipe);
-   softpipe->quad.depth_test = sp_quad_depth_test_stage(softpipe);
-   softpipe->quad.blend = sp_quad_blend_stage(softpipe);
-   softpipe->quad.pstipple = sp_quad_polygon_stipple_stage(softpipe);
+   softpipe->quad_target.fs_machine = softpipe->fs_machine;
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      softpipe->quad_target.cbuf_cache[i] = softpipe->cbuf_cache[i];
+   softpipe->quad_target.zsbuf_cache = softpipe->zsbuf_cache;
+   softpipe->quad_target.occlusion_count = &softpipe->occlusion_count;
+   if (!sp_create_quad_pipeline(softpipe, &softpipe->quad,
+                                &softpipe->quad_target))
+      goto fail;
 
 
    /*
@@ -307,6 +304,8 @@ softpipe_create_context(struct pipe_screen *screen,
 
    sp_init_surface_functions(softpipe);
 
+   softpipe->rast = sp_rast_create(softpipe);
+
 #if DO_PSTIPPLE_IN_HELPER_MODULE
    /* create the polgon stipple sampler */
    softpipe->pstipple.sampler = util_pstipple_create_sampler(&softpipe->pipe);
@@ -47,6 +47,7 @@
 
 
 struct softpipe_vbuf_render;
+struct sp_rasterizer;
 struct draw_context;
 struct draw_stage;
 struct softpipe_tile_cache;
@@ -157,13 +158,8 @@ struct softpipe_context {
    } pstipple;
 
    /** Software quad rendering pipeline */
-   struct {
-      struct quad_stage *shade;
-      struct quad_stage *depth_test;
-      struct quad_stage *blend;
-      struct quad_stage *pstipple;
-      struct quad_stage *first; /**< points to one of the above stages */
-   } quad;
+   struct sp_quad_pipeline quad;
+   struct sp_quad_target quad_target;
 
    /** TGSI exec things */
    struct {
@@ -181,6 +177,9 @@ struct softpipe_context {
 
    struct blitter_context *blitter;
 
+   /** Tile rasterizer threads, NULL when rendering on the calling thread */
+   struct sp_rasterizer *rast;
+
    boolean dirty_render_cache;
 
    struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
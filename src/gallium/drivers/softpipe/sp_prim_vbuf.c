@@ -37,6 +37,7 @@
 
 
 #include "sp_context.h"
+#include "sp_rast.h"
 #include "sp_setup.h"
 #include "sp_state.h"
 #include "sp_prim_vbuf.h"
@@ -65,6 +66,12 @@ struct softpipe_vbuf_render
    uint nr_vertices;
    uint vertex_buffer_size;
    void *vertex_buffer;
+
+   /** the vertices being drawn, in vertex_buffer or a binned scene */
+   void *vertices;
+
+   /** binning primitives for the tile rasterizer threads */
+   boolean binning;
 };
 
 
@@ -90,17 +97,26 @@ sp_vbuf_allocate_vertices(struct vbuf_render *vbr,
                           ushort vertex_size, ushort nr_vertices)
 {
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
+   struct sp_rasterizer *rast = cvbr->softpipe->rast;
    unsigned size = vertex_size * nr_vertices;
 
+   cvbr->vertex_size = vertex_size;
+   cvbr->nr_vertices = nr_vertices;
+
+   /* binned vertices have to stay around until the scene is rendered */
+   if (rast && sp_rast_binning(rast)) {
+      cvbr->vertices = sp_rast_alloc_vertices(rast, size);
+      return cvbr->vertices != NULL;
+   }
+
    if (cvbr->vertex_buffer_size < size) {
       align_free(cvbr->vertex_buffer);
       cvbr->vertex_buffer = align_malloc(size, 16);
       cvbr->vertex_buffer_size = size;
    }
 
-   cvbr->vertex_size = vertex_size;
-   cvbr->nr_vertices = nr_vertices;
-   
+   cvbr->vertices = cvbr->vertex_buffer;
+
    return cvbr->vertex_buffer != NULL;
 }
 
@@ -116,7 +132,7 @@ static void *
 sp_vbuf_map_vertices(struct vbuf_render *vbr)
 {
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
-   return cvbr->vertex_buffer;
+   return cvbr->vertices;
 }
 
 
@@ -126,7 +142,7 @@ sp_vbuf_unmap_vertices(struct vbuf_render *vbr,
                        ushort max_index )
 {
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
-   assert( cvbr->vertex_buffer_size >= (max_index+1) * cvbr->vertex_size );
+   assert( max_index < cvbr->nr_vertices );
    (void) cvbr;
    /* do nothing */
 }
@@ -136,15 +152,65 @@ static void
 sp_vbuf_set_primitive(struct vbuf_render *vbr, unsigned prim)
 {
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
+   struct softpipe_context *softpipe = cvbr->softpipe;
    struct setup_context *setup_ctx = cvbr->setup;
-   
+
+   /* The state doesn't change while binning a draw, but the setup code
+    * expects the primitives it's given to be of the current type.
+    */
+   if (softpipe->rast && sp_rast_binning(softpipe->rast) &&
+       !sp_rast_scene_empty(softpipe->rast) &&
+       softpipe->reduced_prim != u_reduced_prim(prim)) {
+      sp_rast_flush_scene(softpipe->rast);
+   }
+
    sp_setup_prepare( setup_ctx );
 
-   cvbr->softpipe->reduced_prim = u_reduced_prim(prim);
+   softpipe->reduced_prim = u_reduced_prim(prim);
    cvbr->prim = prim;
 }
 
 
+/*
+ * Hand a primitive to the setup code, or bin it for the tile rasterizer
+ * threads.
+ */
+static inline void
+emit_point(struct softpipe_vbuf_render *cvbr,
+           const float (*v0)[4])
+{
+   if (cvbr->binning)
+      sp_rast_bin_point(cvbr->softpipe->rast, v0);
+   else
+      sp_setup_point(cvbr->setup, v0);
+}
+
+
+static inline void
+emit_line(struct softpipe_vbuf_render *cvbr,
+          const float (*v0)[4],
+          const float (*v1)[4])
+{
+   if (cvbr->binning)
+      sp_rast_bin_line(cvbr->softpipe->rast, v0, v1);
+   else
+      sp_setup_line(cvbr->setup, v0, v1);
+}
+
+
+static inline void
+emit_tri(struct softpipe_vbuf_render *cvbr,
+         const float (*v0)[4],
+         const float (*v1)[4],
+         const float (*v2)[4])
+{
+   if (cvbr->binning)
+      sp_rast_bin_tri(cvbr->softpipe->rast, v0, v1, v2);
+   else
+      sp_setup_tri(cvbr->setup, v0, v1, v2);
+}
+
+
 static inline cptrf4 get_vert( const void *vertex_buffer,
                                int index,
                                int stride )
@@ -162,54 +228,55 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
    struct softpipe_context *softpipe = cvbr->softpipe;
    const unsigned stride = softpipe->vertex_info_vbuf.size * sizeof(float);
-   const void *vertex_buffer = cvbr->vertex_buffer;
-   struct setup_context *setup = cvbr->setup;
+   const void *vertex_buffer = cvbr->vertices;
    const boolean flatshade_first = softpipe->rasterizer->flatshade_first;
    unsigned i;
 
+   cvbr->binning = softpipe->rast && sp_rast_binning(softpipe->rast);
+
    switch (cvbr->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
-         sp_setup_point( setup,
-                         get_vert(vertex_buffer, indices[i-0], stride) );
+         emit_point( cvbr,
+                     get_vert(vertex_buffer, indices[i-0], stride) );
       }
       break;
 
    case PIPE_PRIM_LINES:
       for (i = 1; i < nr; i += 2) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, indices[i-1], stride),
-                        get_vert(vertex_buffer, indices[i-0], stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, indices[i-1], stride),
+                    get_vert(vertex_buffer, indices[i-0], stride) );
       }
       break;
 
    case PIPE_PRIM_LINE_STRIP:
       for (i = 1; i < nr; i ++) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, indices[i-1], stride),
-                        get_vert(vertex_buffer, indices[i-0], stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, indices[i-1], stride),
+                    get_vert(vertex_buffer, indices[i-0], stride) );
       }
       break;
 
    case PIPE_PRIM_LINE_LOOP:
       for (i = 1; i < nr; i ++) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, indices[i-1], stride),
-                        get_vert(vertex_buffer, indices[i-0], stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, indices[i-1], stride),
+                    get_vert(vertex_buffer, indices[i-0], stride) );
       }
       if (nr) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, indices[nr-1], stride),
-                        get_vert(vertex_buffer, indices[0], stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, indices[nr-1], stride),
+                    get_vert(vertex_buffer, indices[0], stride) );
       }
       break;
 
    case PIPE_PRIM_TRIANGLES:
       for (i = 2; i < nr; i += 3) {
-         sp_setup_tri( setup,
-                       get_vert(vertex_buffer, indices[i-2], stride),
-                       get_vert(vertex_buffer, indices[i-1], stride),
-                       get_vert(vertex_buffer, indices[i-0], stride) );
+         emit_tri( cvbr,
+                   get_vert(vertex_buffer, indices[i-2], stride),
+                   get_vert(vertex_buffer, indices[i-1], stride),
+                   get_vert(vertex_buffer, indices[i-0], stride) );
       }
       break;
 
@@ -217,20 +284,20 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       if (flatshade_first) {
          for (i = 2; i < nr; i += 1) {
             /* emit first triangle vertex as first triangle vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i+(i&1)-1], stride),
-                          get_vert(vertex_buffer, indices[i-(i&1)], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-2], stride),
+                      get_vert(vertex_buffer, indices[i+(i&1)-1], stride),
+                      get_vert(vertex_buffer, indices[i-(i&1)], stride) );
 
          }
       }
       else {
          for (i = 2; i < nr; i += 1) {
             /* emit last triangle vertex as last triangle vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i+(i&1)-2], stride),
-                          get_vert(vertex_buffer, indices[i-(i&1)-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i+(i&1)-2], stride),
+                      get_vert(vertex_buffer, indices[i-(i&1)-1], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride) );
          }
       }
       break;
@@ -239,19 +306,19 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       if (flatshade_first) {
          for (i = 2; i < nr; i += 1) {
             /* emit first non-spoke vertex as first vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride),
-                          get_vert(vertex_buffer, indices[0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-1], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride),
+                      get_vert(vertex_buffer, indices[0], stride) );
          }
       }
       else {
          for (i = 2; i < nr; i += 1) {
             /* emit last non-spoke vertex as last vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[0], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[0], stride),
+                      get_vert(vertex_buffer, indices[i-1], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride) );
          }
       }
       break;
@@ -261,29 +328,29 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-0], stride),
-                          get_vert(vertex_buffer, indices[i-3], stride),
-                          get_vert(vertex_buffer, indices[i-2], stride) );
-
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-0], stride),
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-0], stride),
+                      get_vert(vertex_buffer, indices[i-3], stride),
+                      get_vert(vertex_buffer, indices[i-2], stride) );
+
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-0], stride),
+                      get_vert(vertex_buffer, indices[i-2], stride),
+                      get_vert(vertex_buffer, indices[i-1], stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-3], stride),
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
-
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-3], stride),
+                      get_vert(vertex_buffer, indices[i-2], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride) );
+
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-2], stride),
+                      get_vert(vertex_buffer, indices[i-1], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride) );
          }
       }
       break;
@@ -293,27 +360,27 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-0], stride),
-                          get_vert(vertex_buffer, indices[i-3], stride),
-                          get_vert(vertex_buffer, indices[i-2], stride) );
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-0], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-3], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-0], stride),
+                      get_vert(vertex_buffer, indices[i-3], stride),
+                      get_vert(vertex_buffer, indices[i-2], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-0], stride),
+                      get_vert(vertex_buffer, indices[i-1], stride),
+                      get_vert(vertex_buffer, indices[i-3], stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-3], stride),
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-3], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-3], stride),
+                      get_vert(vertex_buffer, indices[i-2], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-1], stride),
+                      get_vert(vertex_buffer, indices[i-3], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride) );
          }
       }
       break;
@@ -325,19 +392,19 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       if (flatshade_first) { 
          /* emit first polygon  vertex as first triangle vertex */
          for (i = 2; i < nr; i += 1) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[0], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[0], stride),
+                      get_vert(vertex_buffer, indices[i-1], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride) );
          }
       }
       else {
          /* emit first polygon  vertex as last triangle vertex */
          for (i = 2; i < nr; i += 1) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride),
-                          get_vert(vertex_buffer, indices[0], stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, indices[i-1], stride),
+                      get_vert(vertex_buffer, indices[i-0], stride),
+                      get_vert(vertex_buffer, indices[0], stride) );
          }
       }
       break;
@@ -357,81 +424,82 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
 {
    struct softpipe_vbuf_render *cvbr = softpipe_vbuf_render(vbr);
    struct softpipe_context *softpipe = cvbr->softpipe;
-   struct setup_context *setup = cvbr->setup;
    const unsigned stride = softpipe->vertex_info_vbuf.size * sizeof(float);
    const void *vertex_buffer =
-      (void *) get_vert(cvbr->vertex_buffer, start, stride);
+      (void *) get_vert(cvbr->vertices, start, stride);
    const boolean flatshade_first = softpipe->rasterizer->flatshade_first;
    unsigned i;
 
+   cvbr->binning = softpipe->rast && sp_rast_binning(softpipe->rast);
+
    switch (cvbr->prim) {
    case PIPE_PRIM_POINTS:
       for (i = 0; i < nr; i++) {
-         sp_setup_point( setup,
-                         get_vert(vertex_buffer, i-0, stride) );
+         emit_point( cvbr,
+                     get_vert(vertex_buffer, i-0, stride) );
       }
       break;
 
    case PIPE_PRIM_LINES:
       for (i = 1; i < nr; i += 2) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, i-1, stride),
-                        get_vert(vertex_buffer, i-0, stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, i-1, stride),
+                    get_vert(vertex_buffer, i-0, stride) );
       }
       break;
 
    case PIPE_PRIM_LINES_ADJACENCY:
       for (i = 3; i < nr; i += 4) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, i-2, stride),
-                        get_vert(vertex_buffer, i-1, stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, i-2, stride),
+                    get_vert(vertex_buffer, i-1, stride) );
       }
       break;
 
    case PIPE_PRIM_LINE_STRIP:
       for (i = 1; i < nr; i ++) {
-         sp_setup_line( setup,
-                     get_vert(vertex_buffer, i-1, stride),
-                     get_vert(vertex_buffer, i-0, stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, i-1, stride),
+                    get_vert(vertex_buffer, i-0, stride) );
       }
       break;
 
    case PIPE_PRIM_LINE_STRIP_ADJACENCY:
       for (i = 3; i < nr; i++) {
-         sp_setup_line( setup,
-                     get_vert(vertex_buffer, i-2, stride),
-                     get_vert(vertex_buffer, i-1, stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, i-2, stride),
+                    get_vert(vertex_buffer, i-1, stride) );
       }
       break;
 
    case PIPE_PRIM_LINE_LOOP:
       for (i = 1; i < nr; i ++) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, i-1, stride),
-                        get_vert(vertex_buffer, i-0, stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, i-1, stride),
+                    get_vert(vertex_buffer, i-0, stride) );
       }
       if (nr) {
-         sp_setup_line( setup,
-                        get_vert(vertex_buffer, nr-1, stride),
-                        get_vert(vertex_buffer, 0, stride) );
+         emit_line( cvbr,
+                    get_vert(vertex_buffer, nr-1, stride),
+                    get_vert(vertex_buffer, 0, stride) );
       }
       break;
 
    case PIPE_PRIM_TRIANGLES:
       for (i = 2; i < nr; i += 3) {
-         sp_setup_tri( setup,
-                       get_vert(vertex_buffer, i-2, stride),
-                       get_vert(vertex_buffer, i-1, stride),
-                       get_vert(vertex_buffer, i-0, stride) );
+         emit_tri( cvbr,
+                   get_vert(vertex_buffer, i-2, stride),
+                   get_vert(vertex_buffer, i-1, stride),
+                   get_vert(vertex_buffer, i-0, stride) );
       }
       break;
 
    case PIPE_PRIM_TRIANGLES_ADJACENCY:
       for (i = 5; i < nr; i += 6) {
-         sp_setup_tri( setup,
-                       get_vert(vertex_buffer, i-5, stride),
-                       get_vert(vertex_buffer, i-3, stride),
-                       get_vert(vertex_buffer, i-1, stride) );
+         emit_tri( cvbr,
+                   get_vert(vertex_buffer, i-5, stride),
+                   get_vert(vertex_buffer, i-3, stride),
+                   get_vert(vertex_buffer, i-1, stride) );
       }
       break;
 
@@ -439,19 +507,19 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) {
          for (i = 2; i < nr; i++) {
             /* emit first triangle vertex as first triangle vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i+(i&1)-1, stride),
-                          get_vert(vertex_buffer, i-(i&1), stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-2, stride),
+                      get_vert(vertex_buffer, i+(i&1)-1, stride),
+                      get_vert(vertex_buffer, i-(i&1), stride) );
          }
       }
       else {
          for (i = 2; i < nr; i++) {
             /* emit last triangle vertex as last triangle vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i+(i&1)-2, stride),
-                          get_vert(vertex_buffer, i-(i&1)-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i+(i&1)-2, stride),
+                      get_vert(vertex_buffer, i-(i&1)-1, stride),
+                      get_vert(vertex_buffer, i-0, stride) );
          }
       }
       break;
@@ -460,19 +528,19 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) {
          for (i = 5; i < nr; i += 2) {
             /* emit first triangle vertex as first triangle vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-5, stride),
-                          get_vert(vertex_buffer, i+(i&1)*2-3, stride),
-                          get_vert(vertex_buffer, i-(i&1)*2-1, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-5, stride),
+                      get_vert(vertex_buffer, i+(i&1)*2-3, stride),
+                      get_vert(vertex_buffer, i-(i&1)*2-1, stride) );
          }
       }
       else {
          for (i = 5; i < nr; i += 2) {
             /* emit last triangle vertex as last triangle vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i+(i&1)*2-5, stride),
-                          get_vert(vertex_buffer, i-(i&1)*2-3, stride),
-                          get_vert(vertex_buffer, i-1, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i+(i&1)*2-5, stride),
+                      get_vert(vertex_buffer, i-(i&1)*2-3, stride),
+                      get_vert(vertex_buffer, i-1, stride) );
          }
       }
       break;
@@ -481,19 +549,19 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) {
          for (i = 2; i < nr; i += 1) {
             /* emit first non-spoke vertex as first vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride),
-                          get_vert(vertex_buffer, 0, stride)  );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-1, stride),
+                      get_vert(vertex_buffer, i-0, stride),
+                      get_vert(vertex_buffer, 0, stride)  );
          }
       }
       else {
          for (i = 2; i < nr; i += 1) {
             /* emit last non-spoke vertex as last vertex */
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, 0, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, 0, stride),
+                      get_vert(vertex_buffer, i-1, stride),
+                      get_vert(vertex_buffer, i-0, stride) );
          }
       }
       break;
@@ -503,27 +571,27 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-0, stride),
-                          get_vert(vertex_buffer, i-3, stride),
-                          get_vert(vertex_buffer, i-2, stride) );
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-0, stride),
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-1, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-0, stride),
+                      get_vert(vertex_buffer, i-3, stride),
+                      get_vert(vertex_buffer, i-2, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-0, stride),
+                      get_vert(vertex_buffer, i-2, stride),
+                      get_vert(vertex_buffer, i-1, stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 4) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-3, stride),
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-3, stride),
+                      get_vert(vertex_buffer, i-2, stride),
+                      get_vert(vertex_buffer, i-0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-2, stride),
+                      get_vert(vertex_buffer, i-1, stride),
+                      get_vert(vertex_buffer, i-0, stride) );
          }
       }
       break;
@@ -533,27 +601,27 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) { 
          /* emit last quad vertex as first triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-0, stride),
-                          get_vert(vertex_buffer, i-3, stride),
-                          get_vert(vertex_buffer, i-2, stride) );
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-0, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-3, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-0, stride),
+                      get_vert(vertex_buffer, i-3, stride),
+                      get_vert(vertex_buffer, i-2, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-0, stride),
+                      get_vert(vertex_buffer, i-1, stride),
+                      get_vert(vertex_buffer, i-3, stride) );
          }
       }
       else {
          /* emit last quad vertex as last triangle vertex */
          for (i = 3; i < nr; i += 2) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-3, stride),
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-3, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-3, stride),
+                      get_vert(vertex_buffer, i-2, stride),
+                      get_vert(vertex_buffer, i-0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-1, stride),
+                      get_vert(vertex_buffer, i-3, stride),
+                      get_vert(vertex_buffer, i-0, stride) );
          }
       }
       break;
@@ -565,19 +633,19 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       if (flatshade_first) { 
          /* emit first polygon  vertex as first triangle vertex */
          for (i = 2; i < nr; i += 1) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, 0, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, 0, stride),
+                      get_vert(vertex_buffer, i-1, stride),
+                      get_vert(vertex_buffer, i-0, stride) );
          }
       }
       else {
          /* emit first polygon  vertex as last triangle vertex */
          for (i = 2; i < nr; i += 1) {
-            sp_setup_tri( setup,
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride),
-                          get_vert(vertex_buffer, 0, stride) );
+            emit_tri( cvbr,
+                      get_vert(vertex_buffer, i-1, stride),
+                      get_vert(vertex_buffer, i-0, stride),
+                      get_vert(vertex_buffer, 0, stride) );
          }
       }
       break;
@@ -667,7 +735,8 @@ sp_create_vbuf_backend(struct softpipe_context *sp)
 
    cvbr->softpipe = sp;
 
-   cvbr->setup = sp_setup_create_context(cvbr->softpipe);
+   cvbr->setup = sp_setup_create_context(cvbr->softpipe, &sp->quad,
+                                         &sp->cliprect);
 
    return &cvbr->base;
 }
@@ -31,11 +31,29 @@
 #ifndef SP_QUAD_PIPE_H
 #define SP_QUAD_PIPE_H
 
+#include "pipe/p_state.h"
+
 
 struct softpipe_context;
+struct softpipe_tile_cache;
+struct tgsi_exec_machine;
 struct quad_header;
 
 
+/**
+ * What the quad stages render with: the shader interpreter, the tile
+ * caches of the bound surfaces and the occlusion counter.  The context
+ * has one for rendering on the calling thread and every tile rasterizer
+ * thread has its own (see sp_rast.h).
+ */
+struct sp_quad_target {
+   struct tgsi_exec_machine *fs_machine;
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+   uint64_t *occlusion_count;
+};
+
+
 /**
  * Fragment processing is performed on 2x2 blocks of pixels called "quads".
  * Quad processing is performed with a pipeline of stages represented by
@@ -43,6 +61,7 @@ struct quad_header;
  */
 struct quad_stage {
    struct softpipe_context *softpipe;
+   struct sp_quad_target *target;
 
    struct quad_stage *next;
 
@@ -67,6 +86,21 @@ struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_colormask_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_output_stage( struct softpipe_context *softpipe );
 
-void sp_build_quad_pipeline(struct softpipe_context *sp);
+
+/** Software quad rendering pipeline */
+struct sp_quad_pipeline {
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+   struct quad_stage *first; /**< points to one of the above stages */
+};
+
+boolean sp_create_quad_pipeline(struct softpipe_context *sp,
+                                struct sp_quad_pipeline *quad,
+                                struct sp_quad_target *target);
+void sp_destroy_quad_pipeline(struct sp_quad_pipeline *quad);
+void sp_build_quad_pipeline(struct softpipe_context *sp,
+                            struct sp_quad_pipeline *quad);
 
 #endif /* SP_QUAD_PIPE_H */
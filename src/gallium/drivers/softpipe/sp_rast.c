@@ -0,0 +1,992 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Binning of primitives into screen tiles and rasterization of the tiles
+ * by a pool of threads, see sp_rast.h.
+ *
+ * The tiles are the TILE_SIZE x TILE_SIZE tiles of sp_tile_cache, so each
+ * cached surface tile belongs to exactly one thread.  Triangle spans are
+ * processed in chunks aligned to 16 pixels and rows are paired, so cutting
+ * a triangle at tile boundaries yields the same runs of quads (which
+ * matters for the Z interpolation in the depth test) as rendering it
+ * whole.
+ *
+ * The threads borrow the tiles of the context's tile caches rather than
+ * going through the surfaces, since the cached color tiles are kept as
+ * floats and writing them back rounds them.  For the same reason no two
+ * tiles of a scene may share a tile cache position: the context's cache
+ * would have written one of them back in the middle of the scene.  A
+ * primitive touching a tile which conflicts with the scene so far makes
+ * it render first, and one conflicting with itself (only primitives more
+ * than five tiles wide or ten tiles high can) is rendered on its own on
+ * the calling thread.
+ */
+
+#include "pipe/p_defines.h"
+#include "os/os_thread.h"
+#include "tgsi/tgsi_exec.h"
+#include "util/u_atomic.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+
+#include "sp_context.h"
+#include "sp_fs.h"
+#include "sp_limits.h"
+#include "sp_quad_pipe.h"
+#include "sp_rast.h"
+#include "sp_setup.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+
+
+/** Size of the blocks the vertices of a scene are stored in */
+#define SCENE_BLOCK_SIZE (64 * 1024)
+
+/** Max vertex blocks in a scene before it's rendered to make room */
+#define SCENE_MAX_BLOCKS 256
+
+/**
+ * Pixels added around the bounding box of a primitive when binning it,
+ * to cover the rounding done by the setup code.
+ */
+#define BIN_MARGIN 2.0f
+
+
+struct sp_scene_prim {
+   const float (*v[3])[4];
+   unsigned nr_verts;
+};
+
+
+/** The primitives touching one tile, in submission order */
+struct sp_bin {
+   unsigned *prims;
+   unsigned count;
+   unsigned size;
+};
+
+
+struct sp_scene {
+   /** vertex storage, the blocks are kept for the next scene */
+   ubyte **blocks;
+   unsigned num_blocks, max_blocks;
+   unsigned cur_block;   /**< block being filled */
+   unsigned cur_used;    /**< bytes used in it */
+
+   struct sp_scene_prim *prims;
+   unsigned num_prims, max_prims;
+
+   struct sp_bin *bins;
+   unsigned max_bins;
+   unsigned tiles_x, tiles_y;
+
+   /** indices of the non-empty bins */
+   unsigned *active;
+   unsigned num_active;
+
+   /** bin index + 1 of the active tile in each tile cache position */
+   unsigned cache_owner[NUM_ENTRIES];
+
+   int next_active;      /**< next entry of active to rasterize */
+};
+
+
+/** Per-thread rasterization state */
+struct sp_rasterizer_task {
+   struct sp_rasterizer *rast;
+   unsigned thread_index;
+
+   struct setup_context *setup;
+   struct sp_quad_pipeline quad;
+   struct sp_quad_target target;
+   struct pipe_scissor_state cliprect;   /**< current tile */
+
+   struct sp_tgsi_sampler *sampler;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+
+   /** shader variant bound to target.fs_machine */
+   struct sp_fragment_shader_variant *fs_variant;
+
+   uint64_t occlusion_count;
+
+   pipe_semaphore work_ready;
+   pipe_semaphore work_done;
+};
+
+
+struct sp_rasterizer {
+   struct softpipe_context *softpipe;
+
+   /** binning primitives of the current draw */
+   boolean binning;
+
+   struct sp_scene scene;
+
+   /** for rendering scenes on the calling thread */
+   struct setup_context *setup;
+
+   unsigned num_threads;
+   struct sp_rasterizer_task tasks[SP_MAX_THREADS];
+   pipe_thread threads[SP_MAX_THREADS];
+   boolean exit_flag;
+};
+
+
+/**
+ * Empty the bins.  The vertices stay until scene_reset_vertices().
+ */
+static void
+scene_reset_bins(struct sp_scene *scene)
+{
+   unsigned i;
+
+   for (i = 0; i < scene->num_active; i++)
+      scene->bins[scene->active[i]].count = 0;
+
+   memset(scene->cache_owner, 0, sizeof scene->cache_owner);
+   scene->num_active = 0;
+   scene->num_prims = 0;
+}
+
+
+static void
+scene_reset_vertices(struct sp_scene *scene)
+{
+   assert(scene->num_prims == 0);
+
+   scene->cur_block = 0;
+   scene->cur_used = 0;
+}
+
+
+/**
+ * Size the tile grid for the given framebuffer.
+ */
+static boolean
+scene_set_grid(struct sp_scene *scene, unsigned width, unsigned height)
+{
+   const unsigned tiles_x = DIV_ROUND_UP(width, TILE_SIZE);
+   const unsigned tiles_y = DIV_ROUND_UP(height, TILE_SIZE);
+   const unsigned num_bins = tiles_x * tiles_y;
+
+   assert(scene->num_active == 0);
+
+   if (num_bins > scene->max_bins) {
+      struct sp_bin *bins;
+      unsigned *active;
+
+      active = REALLOC(scene->active, 0, num_bins * sizeof *active);
+      if (!active)
+         return FALSE;
+      scene->active = active;
+
+      bins = REALLOC(scene->bins, scene->max_bins * sizeof *bins,
+                     num_bins * sizeof *bins);
+      if (!bins)
+         return FALSE;
+      memset(&bins[scene->max_bins], 0,
+             (num_bins - scene->max_bins) * sizeof *bins);
+      scene->bins = bins;
+      scene->max_bins = num_bins;
+   }
+
+   scene->tiles_x = tiles_x;
+   scene->tiles_y = tiles_y;
+   return TRUE;
+}
+
+
+static void
+scene_destroy(struct sp_scene *scene)
+{
+   unsigned i;
+
+   for (i = 0; i < scene->num_blocks; i++)
+      align_free(scene->blocks[i]);
+   FREE(scene->blocks);
+
+   for (i = 0; i < scene->max_bins; i++)
+      FREE(scene->bins[i].prims);
+   FREE(scene->bins);
+   FREE(scene->active);
+   FREE(scene->prims);
+}
+
+
+/**
+ * Make room for one more primitive in a bin.
+ */
+static boolean
+bin_reserve(struct sp_bin *bin)
+{
+   if (bin->count == bin->size) {
+      const unsigned size = MAX2(bin->size * 2, 16);
+      unsigned *prims = REALLOC(bin->prims, bin->size * sizeof *prims,
+                                size * sizeof *prims);
+      if (!prims)
+         return FALSE;
+      bin->prims = prims;
+      bin->size = size;
+   }
+   return TRUE;
+}
+
+
+static void
+bin_add_prim(struct sp_scene *scene, unsigned bin_index, unsigned prim)
+{
+   struct sp_bin *bin = &scene->bins[bin_index];
+
+   assert(bin->count < bin->size);
+
+   if (bin->count == 0) {
+      const unsigned tx = bin_index % scene->tiles_x;
+      const unsigned ty = bin_index / scene->tiles_x;
+
+      scene->active[scene->num_active++] = bin_index;
+      scene->cache_owner[CACHE_POS(tx, ty, 0)] = bin_index + 1;
+   }
+
+   bin->prims[bin->count++] = prim;
+}
+
+
+/**
+ * Clamp a bounding box coordinate to [lo, hi].  Written so that a NaN
+ * gives lo for the minimum and hi for the maximum, which bins the
+ * primitive everywhere and leaves it to the setup code.
+ */
+static inline int
+clamp_min(float x, int lo, int hi)
+{
+   if (x > (float) lo)
+      return x < (float) hi ? (int) x : hi;
+   return lo;
+}
+
+static inline int
+clamp_max(float x, int lo, int hi)
+{
+   if (x < (float) hi)
+      return x > (float) lo ? (int) x : lo;
+   return hi;
+}
+
+
+static inline void
+rasterize_prim(struct setup_context *setup, const struct sp_scene_prim *prim)
+{
+   switch (prim->nr_verts) {
+   case 1:
+      sp_setup_point(setup, prim->v[0]);
+      break;
+   case 2:
+      sp_setup_line(setup, prim->v[0], prim->v[1]);
+      break;
+   default:
+      sp_setup_tri(setup, prim->v[0], prim->v[1], prim->v[2]);
+      break;
+   }
+}
+
+
+static void
+scene_render(struct sp_rasterizer *rast);
+
+
+/**
+ * Add a primitive to the bins of all the tiles its bounding box touches.
+ */
+static void
+bin_prim(struct sp_rasterizer *rast, const struct sp_scene_prim *prim,
+         float minx, float miny, float maxx, float maxy)
+{
+   const struct pipe_scissor_state *cliprect = &rast->softpipe->cliprect;
+   struct sp_scene *scene = &rast->scene;
+   int x0, y0, x1, y1, tx, ty, first_tx, first_ty, last_tx, last_ty;
+   uint64_t positions = 0;
+   boolean conflict = FALSE;
+   unsigned index;
+
+   x0 = clamp_min(minx - BIN_MARGIN, cliprect->minx, cliprect->maxx);
+   y0 = clamp_min(miny - BIN_MARGIN, cliprect->miny, cliprect->maxy);
+   x1 = clamp_max(maxx + BIN_MARGIN + 1.0f, cliprect->minx, cliprect->maxx);
+   y1 = clamp_max(maxy + BIN_MARGIN + 1.0f, cliprect->miny, cliprect->maxy);
+   if (x0 >= x1 || y0 >= y1)
+      return;
+
+   first_tx = x0 / TILE_SIZE;
+   first_ty = y0 / TILE_SIZE;
+   last_tx = MIN2((x1 - 1) / TILE_SIZE, (int) scene->tiles_x - 1);
+   last_ty = MIN2((y1 - 1) / TILE_SIZE, (int) scene->tiles_y - 1);
+
+   STATIC_ASSERT(NUM_ENTRIES <= 64);
+
+   for (ty = first_ty; ty <= last_ty; ty++) {
+      for (tx = first_tx; tx <= last_tx; tx++) {
+         const unsigned bin_index = ty * scene->tiles_x + tx;
+         const unsigned pos = CACHE_POS(tx, ty, 0);
+         const unsigned owner = scene->cache_owner[pos];
+
+         if (positions & (1ull << pos))
+            goto render_now;
+         positions |= 1ull << pos;
+
+         if (owner && owner != bin_index + 1)
+            conflict = TRUE;
+
+         if (!bin_reserve(&scene->bins[bin_index]))
+            goto render_now;
+      }
+   }
+
+   if (scene->num_prims == scene->max_prims) {
+      const unsigned size = MAX2(scene->max_prims * 2, 256);
+      struct sp_scene_prim *prims =
+         REALLOC(scene->prims, scene->max_prims * sizeof *prims,
+                 size * sizeof *prims);
+      if (!prims)
+         goto render_now;
+      scene->prims = prims;
+      scene->max_prims = size;
+   }
+
+   if (conflict)
+      scene_render(rast);
+
+   index = scene->num_prims++;
+   scene->prims[index] = *prim;
+
+   for (ty = first_ty; ty <= last_ty; ty++) {
+      for (tx = first_tx; tx <= last_tx; tx++)
+         bin_add_prim(scene, ty * scene->tiles_x + tx, index);
+   }
+   return;
+
+render_now:
+   /* The primitive conflicts with itself, or we're out of memory */
+   scene_render(rast);
+   sp_setup_prepare(rast->setup);
+   rasterize_prim(rast->setup, prim);
+}
+
+
+void
+sp_rast_bin_point(struct sp_rasterizer *rast,
+                  const float (*v0)[4])
+{
+   const struct softpipe_context *sp = rast->softpipe;
+   const float size = sp->psize_slot > 0
+      ? v0[sp->psize_slot][0] : sp->rasterizer->point_size;
+   const float half_size = 0.5f * size;
+   struct sp_scene_prim prim;
+
+   prim.v[0] = v0;
+   prim.nr_verts = 1;
+
+   bin_prim(rast, &prim,
+            v0[0][0] - half_size, v0[0][1] - half_size,
+            v0[0][0] + half_size, v0[0][1] + half_size);
+}
+
+
+void
+sp_rast_bin_line(struct sp_rasterizer *rast,
+                 const float (*v0)[4],
+                 const float (*v1)[4])
+{
+   struct sp_scene_prim prim;
+
+   prim.v[0] = v0;
+   prim.v[1] = v1;
+   prim.nr_verts = 2;
+
+   bin_prim(rast, &prim,
+            MIN2(v0[0][0], v1[0][0]), MIN2(v0[0][1], v1[0][1]),
+            MAX2(v0[0][0], v1[0][0]), MAX2(v0[0][1], v1[0][1]));
+}
+
+
+void
+sp_rast_bin_tri(struct sp_rasterizer *rast,
+                const float (*v0)[4],
+                const float (*v1)[4],
+                const float (*v2)[4])
+{
+   struct sp_scene_prim prim;
+
+   prim.v[0] = v0;
+   prim.v[1] = v1;
+   prim.v[2] = v2;
+   prim.nr_verts = 3;
+
+   bin_prim(rast, &prim,
+            MIN3(v0[0][0], v1[0][0], v2[0][0]),
+            MIN3(v0[0][1], v1[0][1], v2[0][1]),
+            MAX3(v0[0][0], v1[0][0], v2[0][0]),
+            MAX3(v0[0][1], v1[0][1], v2[0][1]));
+}
+
+
+/**
+ * Rasterize the bins handed out to this task until there are none left.
+ */
+static void
+rasterize_bins(struct sp_rasterizer_task *task)
+{
+   const struct pipe_scissor_state *cliprect = &task->rast->softpipe->cliprect;
+   const struct sp_scene *scene = &task->rast->scene;
+   unsigned i;
+
+   while ((i = p_atomic_inc_return(&task->rast->scene.next_active) - 1) <
+          scene->num_active) {
+      const unsigned bin_index = scene->active[i];
+      const struct sp_bin *bin = &scene->bins[bin_index];
+      const unsigned x = bin_index % scene->tiles_x * TILE_SIZE;
+      const unsigned y = bin_index / scene->tiles_x * TILE_SIZE;
+      unsigned j;
+
+      task->cliprect.minx = MAX2(x, cliprect->minx);
+      task->cliprect.miny = MAX2(y, cliprect->miny);
+      task->cliprect.maxx = MIN2(x + TILE_SIZE, cliprect->maxx);
+      task->cliprect.maxy = MIN2(y + TILE_SIZE, cliprect->maxy);
+
+      for (j = 0; j < bin->count; j++)
+         rasterize_prim(task->setup, &scene->prims[bin->prims[j]]);
+   }
+}
+
+
+/**
+ * Point the task at the context's current surfaces, textures and
+ * shader.  Called on the calling thread before the task is started.
+ */
+static boolean
+task_begin(struct sp_rasterizer_task *task)
+{
+   struct softpipe_context *sp = task->rast->softpipe;
+   const unsigned num_views = sp->num_sampler_views[PIPE_SHADER_FRAGMENT];
+   unsigned i;
+
+   for (i = 0; i < num_views; i++) {
+      struct pipe_sampler_view *view =
+         sp->sampler_views[PIPE_SHADER_FRAGMENT][i];
+      struct softpipe_tex_tile_cache *tc = task->tex_cache[i];
+
+      if (view && !tc) {
+         tc = task->tex_cache[i] = sp_create_tex_tile_cache(&sp->pipe);
+         if (!tc)
+            return FALSE;
+      }
+
+      if (tc) {
+         sp_tex_tile_cache_set_sampler_view(tc, view);
+         if (tc->texture) {
+            struct softpipe_resource *spt = softpipe_resource(tc->texture);
+            if (spt->timestamp != tc->timestamp) {
+               sp_tex_tile_cache_validate_texture(tc);
+               tc->timestamp = spt->timestamp;
+            }
+         }
+      }
+   }
+
+   memcpy(task->sampler, sp->tgsi.sampler[PIPE_SHADER_FRAGMENT],
+          sizeof *task->sampler);
+   for (i = 0; i < num_views; i++) {
+      if (task->sampler->sp_sview[i].cache)
+         task->sampler->sp_sview[i].cache = task->tex_cache[i];
+   }
+
+   if (task->fs_variant != sp->fs_variant) {
+      sp->fs_variant->prepare(sp->fs_variant, task->target.fs_machine,
+                              (struct tgsi_sampler *) task->sampler);
+      task->fs_variant = sp->fs_variant;
+   }
+
+   for (i = 0; i < sp->framebuffer.nr_cbufs; i++) {
+      if (sp->framebuffer.cbufs[i])
+         sp_tile_cache_borrow(task->target.cbuf_cache[i], sp->cbuf_cache[i]);
+   }
+   if (sp->framebuffer.zsbuf)
+      sp_tile_cache_borrow(task->target.zsbuf_cache, sp->zsbuf_cache);
+
+   task->occlusion_count = 0;
+
+   sp_build_quad_pipeline(sp, &task->quad);
+   sp_setup_prepare(task->setup);
+
+   return TRUE;
+}
+
+
+/**
+ * Hand the tiles the task rendered back to the context's tile caches.
+ */
+static void
+task_end(struct sp_rasterizer_task *task)
+{
+   struct softpipe_context *sp = task->rast->softpipe;
+   unsigned i;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      if (task->target.cbuf_cache[i]->parent)
+         sp_tile_cache_return_tiles(task->target.cbuf_cache[i]);
+   }
+   if (task->target.zsbuf_cache->parent)
+      sp_tile_cache_return_tiles(task->target.zsbuf_cache);
+
+   sp->occlusion_count += task->occlusion_count;
+}
+
+
+/**
+ * Render the scene on the calling thread, through the context's quad
+ * pipeline and tile caches.
+ */
+static void
+scene_render_serial(struct sp_rasterizer *rast)
+{
+   const struct sp_scene *scene = &rast->scene;
+   unsigned i;
+
+   sp_setup_prepare(rast->setup);
+
+   for (i = 0; i < scene->num_prims; i++)
+      rasterize_prim(rast->setup, &scene->prims[i]);
+}
+
+
+/**
+ * Render the primitives binned so far and empty the bins.
+ */
+static void
+scene_render(struct sp_rasterizer *rast)
+{
+   struct softpipe_context *sp = rast->softpipe;
+   struct sp_scene *scene = &rast->scene;
+   unsigned i;
+
+   if (scene->num_active == 0)
+      goto out;
+
+   /* Not worth handing a single tile to another thread */
+   if (scene->num_active == 1) {
+      scene_render_serial(rast);
+      goto out;
+   }
+
+   /* make sure the vertex layout the setup code uses is up to date */
+   (void) softpipe_get_vertex_info(sp);
+
+   for (i = 0; i < rast->num_threads; i++) {
+      if (!task_begin(&rast->tasks[i])) {
+         while (i--)
+            task_end(&rast->tasks[i]);
+         scene_render_serial(rast);
+         goto out;
+      }
+   }
+
+   scene->next_active = 0;
+
+   for (i = 0; i < rast->num_threads; i++)
+      pipe_semaphore_signal(&rast->tasks[i].work_ready);
+
+   for (i = 0; i < rast->num_threads; i++)
+      pipe_semaphore_wait(&rast->tasks[i].work_done);
+
+   for (i = 0; i < rast->num_threads; i++)
+      task_end(&rast->tasks[i]);
+
+out:
+   scene_reset_bins(scene);
+}
+
+
+/**
+ * Start binning the primitives of a draw, if it can be rasterized by
+ * the threads.
+ */
+void
+sp_rast_begin_scene(struct sp_rasterizer *rast)
+{
+   const struct softpipe_context *sp = rast->softpipe;
+   const struct pipe_rasterizer_state *rs = sp->rasterizer;
+   boolean has_surface = sp->framebuffer.zsbuf != NULL;
+   unsigned i;
+
+   assert(!rast->binning);
+
+   for (i = 0; i < sp->framebuffer.nr_cbufs; i++)
+      has_surface |= sp->framebuffer.cbufs[i] != NULL;
+
+   /* Pipeline statistics are counted per primitive and fragment on the
+    * context, the draw module's AA line/point stages change the fragment
+    * shader and samplers in the middle of a draw, and the tiles aren't
+    * binned per layer.
+    */
+   if (!has_surface ||
+       !sp->fs_variant ||
+       sp->no_rast ||
+       sp->layer_slot > 0 ||
+       sp->active_statistics_queries ||
+       rs->rasterizer_discard ||
+       rs->line_smooth ||
+       rs->point_smooth)
+      return;
+
+   if (!scene_set_grid(&rast->scene, sp->framebuffer.width,
+                       sp->framebuffer.height))
+      return;
+
+   rast->binning = TRUE;
+}
+
+
+/**
+ * Render the binned primitives of the draw and stop binning.
+ */
+void
+sp_rast_end_scene(struct sp_rasterizer *rast)
+{
+   if (rast->binning) {
+      scene_render(rast);
+      scene_reset_vertices(&rast->scene);
+      rast->binning = FALSE;
+   }
+}
+
+
+boolean
+sp_rast_binning(const struct sp_rasterizer *rast)
+{
+   return rast->binning;
+}
+
+
+/**
+ * Render the primitives binned so far, keep binning.  Must only be
+ * called when no allocated vertices are still to be drawn.
+ */
+void
+sp_rast_flush_scene(struct sp_rasterizer *rast)
+{
+   assert(rast->binning);
+   scene_render(rast);
+   scene_reset_vertices(&rast->scene);
+}
+
+
+boolean
+sp_rast_scene_empty(const struct sp_rasterizer *rast)
+{
+   return rast->scene.num_prims == 0;
+}
+
+
+/**
+ * Allocate post-transform vertex storage which lives until the scene is
+ * rendered.  May render the scene so far to make room.
+ */
+void *
+sp_rast_alloc_vertices(struct sp_rasterizer *rast, unsigned size)
+{
+   struct sp_scene *scene = &rast->scene;
+   void *ptr;
+
+   assert(rast->binning);
+
+   size = align(size, 16);
+   if (size > SCENE_BLOCK_SIZE)
+      return NULL;
+
+   if (scene->cur_block >= scene->num_blocks ||
+       scene->cur_used + size > SCENE_BLOCK_SIZE) {
+      if (scene->cur_block + 1 >= SCENE_MAX_BLOCKS) {
+         scene_render(rast);
+         scene_reset_vertices(scene);
+      }
+      else if (scene->cur_block < scene->num_blocks)
+         scene->cur_block++;
+
+      if (scene->cur_block == scene->num_blocks) {
+         ubyte *block;
+
+         if (scene->num_blocks == scene->max_blocks) {
+            const unsigned max_blocks = MAX2(scene->max_blocks * 2, 16);
+            ubyte **blocks = REALLOC(scene->blocks,
+                                     scene->max_blocks * sizeof *blocks,
+                                     max_blocks * sizeof *blocks);
+            if (!blocks)
+               return NULL;
+            scene->blocks = blocks;
+            scene->max_blocks = max_blocks;
+         }
+
+         block = align_malloc(SCENE_BLOCK_SIZE, 16);
+         if (!block)
+            return NULL;
+         scene->blocks[scene->num_blocks++] = block;
+      }
+
+      scene->cur_used = 0;
+   }
+
+   ptr = scene->blocks[scene->cur_block] + scene->cur_used;
+   scene->cur_used += size;
+   return ptr;
+}
+
+
+void
+sp_rast_flush_texture_caches(struct sp_rasterizer *rast)
+{
+   unsigned i, j;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      for (j = 0; j < PIPE_MAX_SHADER_SAMPLER_VIEWS; j++) {
+         if (rast->tasks[i].tex_cache[j])
+            sp_flush_tex_tile_cache(rast->tasks[i].tex_cache[j]);
+      }
+   }
+}
+
+
+/**
+ * Unbind a fragment shader variant which is about to be deleted.
+ */
+void
+sp_rast_release_fs_variant(struct sp_rasterizer *rast,
+                           struct sp_fragment_shader_variant *var)
+{
+   unsigned i;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      struct sp_rasterizer_task *task = &rast->tasks[i];
+      if (task->fs_variant == var) {
+         tgsi_exec_machine_bind_shader(task->target.fs_machine, NULL, NULL);
+         task->fs_variant = NULL;
+      }
+   }
+}
+
+
+/**
+ * The thread's main entrypoint: wait for a scene, rasterize bins until
+ * there are none left, report back.
+ */
+static PIPE_THREAD_ROUTINE( thread_function, init_data )
+{
+   struct sp_rasterizer_task *task = (struct sp_rasterizer_task *) init_data;
+   struct sp_rasterizer *rast = task->rast;
+   char thread_name[16];
+
+   util_snprintf(thread_name, sizeof thread_name, "softpipe-%u",
+                 task->thread_index);
+   pipe_thread_setname(thread_name);
+
+   while (1) {
+      pipe_semaphore_wait(&task->work_ready);
+
+      if (rast->exit_flag)
+         break;
+
+      rasterize_bins(task);
+
+      pipe_semaphore_signal(&task->work_done);
+   }
+
+#ifdef _WIN32
+   pipe_semaphore_signal(&task->work_done);
+#endif
+
+   return 0;
+}
+
+
+static boolean
+task_init(struct sp_rasterizer *rast, unsigned index)
+{
+   struct softpipe_context *sp = rast->softpipe;
+   struct sp_rasterizer_task *task = &rast->tasks[index];
+   unsigned i;
+
+   task->rast = rast;
+   task->thread_index = index;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      task->target.cbuf_cache[i] = sp_create_tile_cache(&sp->pipe);
+      if (!task->target.cbuf_cache[i])
+         return FALSE;
+   }
+
+   task->target.zsbuf_cache = sp_create_tile_cache(&sp->pipe);
+   if (!task->target.zsbuf_cache)
+      return FALSE;
+
+   task->target.fs_machine = tgsi_exec_machine_create();
+   if (!task->target.fs_machine)
+      return FALSE;
+
+   task->target.occlusion_count = &task->occlusion_count;
+
+   task->sampler = sp_create_tgsi_sampler();
+   if (!task->sampler)
+      return FALSE;
+
+   if (!sp_create_quad_pipeline(sp, &task->quad, &task->target))
+      return FALSE;
+
+   task->setup = sp_setup_create_context(sp, &task->quad, &task->cliprect);
+   if (!task->setup)
+      return FALSE;
+
+   return TRUE;
+}
+
+
+static void
+task_destroy(struct sp_rasterizer_task *task)
+{
+   unsigned i;
+
+   if (task->setup)
+      sp_setup_destroy_context(task->setup);
+
+   sp_destroy_quad_pipeline(&task->quad);
+
+   FREE(task->sampler);
+
+   tgsi_exec_machine_destroy(task->target.fs_machine);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_destroy_tile_cache(task->target.cbuf_cache[i]);
+   sp_destroy_tile_cache(task->target.zsbuf_cache);
+
+   for (i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; i++) {
+      if (task->tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(task->tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(task->tex_cache[i]);
+      }
+   }
+}
+
+
+/**
+ * Create the tile rasterizer threads of a context.
+ * \return NULL if SOFTPIPE_NUM_THREADS isn't set, or on failure, in which
+ *         case everything is rendered on the calling thread
+ */
+struct sp_rasterizer *
+sp_rast_create(struct softpipe_context *softpipe)
+{
+   struct sp_rasterizer *rast;
+   unsigned num_threads;
+   unsigned i;
+
+   num_threads = debug_get_num_option("SOFTPIPE_NUM_THREADS", 0);
+   num_threads = MIN2(num_threads, SP_MAX_THREADS);
+   if (!num_threads)
+      return NULL;
+
+   rast = CALLOC_STRUCT(sp_rasterizer);
+   if (!rast)
+      return NULL;
+
+   rast->softpipe = softpipe;
+
+   rast->setup = sp_setup_create_context(softpipe, &softpipe->quad,
+                                         &softpipe->cliprect);
+   if (!rast->setup)
+      goto fail;
+
+   for (i = 0; i < num_threads; i++) {
+      if (!task_init(rast, i)) {
+         task_destroy(&rast->tasks[i]);
+         goto fail;
+      }
+      rast->num_threads++;
+   }
+
+   for (i = 0; i < num_threads; i++) {
+      pipe_semaphore_init(&rast->tasks[i].work_ready, 0);
+      pipe_semaphore_init(&rast->tasks[i].work_done, 0);
+      rast->threads[i] = pipe_thread_create(thread_function,
+                                            (void *) &rast->tasks[i]);
+   }
+
+   return rast;
+
+fail:
+   for (i = 0; i < rast->num_threads; i++)
+      task_destroy(&rast->tasks[i]);
+   if (rast->setup)
+      sp_setup_destroy_context(rast->setup);
+   FREE(rast);
+   return NULL;
+}
+
+
+void
+sp_rast_destroy(struct sp_rasterizer *rast)
+{
+   unsigned i;
+
+   if (!rast)
+      return;
+
+   /* Wake the threads up with exit_flag set so they leave their loop */
+   rast->exit_flag = TRUE;
+   for (i = 0; i < rast->num_threads; i++)
+      pipe_semaphore_signal(&rast->tasks[i].work_ready);
+
+   /* See lp_rast_destroy() about not calling pipe_thread_wait on Windows */
+   for (i = 0; i < rast->num_threads; i++) {
+#ifdef _WIN32
+      pipe_semaphore_wait(&rast->tasks[i].work_done);
+#else
+      pipe_thread_wait(rast->threads[i]);
+#endif
+   }
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_destroy(&rast->tasks[i].work_ready);
+      pipe_semaphore_destroy(&rast->tasks[i].work_done);
+      task_destroy(&rast->tasks[i]);
+   }
+
+   sp_setup_destroy_context(rast->setup);
+   scene_destroy(&rast->scene);
+   FREE(rast);
+}
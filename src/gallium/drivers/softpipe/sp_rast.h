@@ -0,0 +1,100 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Tiled, multi-threaded rasterization.
+ *
+ * With SOFTPIPE_NUM_THREADS set, the points, lines and triangles of a
+ * draw are binned into screen tiles instead of being rasterized as they
+ * arrive.  When the draw is done the tiles are handed out to a pool of
+ * threads, each of which replays the primitives of its tiles in order
+ * through its own setup context, quad pipeline, shader interpreter and
+ * tile caches.  Since no two threads ever touch the same tile and the
+ * quads of a primitive within a tile are the same as when rendering the
+ * whole primitive, the result is identical to rendering on the calling
+ * thread.
+ */
+
+#ifndef SP_RAST_H
+#define SP_RAST_H
+
+#include "pipe/p_compiler.h"
+
+
+struct softpipe_context;
+struct sp_fragment_shader_variant;
+struct sp_rasterizer;
+
+
+struct sp_rasterizer *
+sp_rast_create(struct softpipe_context *softpipe);
+
+void
+sp_rast_destroy(struct sp_rasterizer *rast);
+
+void
+sp_rast_begin_scene(struct sp_rasterizer *rast);
+
+void
+sp_rast_end_scene(struct sp_rasterizer *rast);
+
+boolean
+sp_rast_binning(const struct sp_rasterizer *rast);
+
+void
+sp_rast_flush_scene(struct sp_rasterizer *rast);
+
+boolean
+sp_rast_scene_empty(const struct sp_rasterizer *rast);
+
+void *
+sp_rast_alloc_vertices(struct sp_rasterizer *rast, unsigned size);
+
+void
+sp_rast_bin_point(struct sp_rasterizer *rast,
+                  const float (*v0)[4]);
+
+void
+sp_rast_bin_line(struct sp_rasterizer *rast,
+                 const float (*v0)[4],
+                 const float (*v1)[4]);
+
+void
+sp_rast_bin_tri(struct sp_rasterizer *rast,
+                const float (*v0)[4],
+                const float (*v1)[4],
+                const float (*v2)[4]);
+
+void
+sp_rast_flush_texture_caches(struct sp_rasterizer *rast);
+
+void
+sp_rast_release_fs_variant(struct sp_rasterizer *rast,
+                           struct sp_fragment_shader_variant *var);
+
+
+#endif /* SP_RAST_H */
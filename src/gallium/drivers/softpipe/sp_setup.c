@@ -75,6 +75,10 @@ struct edge {
 struct setup_context {
    struct softpipe_context *softpipe;
 
+   /** Where the quads go and what they're clipped to */
+   struct sp_quad_pipeline *pipeline;
+   const struct pipe_scissor_state *cliprect;
+
    /* Vertices are just an array of floats making up each attribute in
     * turn.  Currently fixed at 4 floats, but should change in time.
     * Codegen will help cope with this.
@@ -128,7 +132,7 @@ struct setup_context {
 static inline void
 quad_clip(struct setup_context *setup, struct quad_header *quad)
 {
-   const struct pipe_scissor_state *cliprect = &setup->softpipe->cliprect;
+   const struct pipe_scissor_state *cliprect = setup->cliprect;
    const int minx = (int) cliprect->minx;
    const int maxx = (int) cliprect->maxx;
    const int miny = (int) cliprect->miny;
@@ -162,13 +166,13 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
    quad_clip( setup, quad );
 
    if (quad->inout.mask) {
-      struct softpipe_context *sp = setup->softpipe;
+      struct quad_stage *pipe = setup->pipeline->first;
 
 #if DEBUG_FRAGS
       setup->numFragsEmitted += util_bitcount(quad->inout.mask);
 #endif
 
-      sp->quad.first->run( sp->quad.first, &quad, 1 );
+      pipe->run( pipe, &quad, 1 );
    }
 }
 
@@ -203,7 +207,7 @@ flush_spans(struct setup_context *setup)
    const int xleft1 = setup->span.left[1];
    const int xright0 = setup->span.right[0];
    const int xright1 = setup->span.right[1];
-   struct quad_stage *pipe = setup->softpipe->quad.first;
+   struct quad_stage *pipe = setup->pipeline->first;
 
    const int minleft = block_x(MIN2(xleft0, xleft1));
    const int maxright = MAX2(xright0, xright1);
@@ -709,7 +713,7 @@ subtriangle(struct setup_context *setup,
             struct edge *eright,
             int lines)
 {
-   const struct pipe_scissor_state *cliprect = &setup->softpipe->cliprect;
+   const struct pipe_scissor_state *cliprect = setup->cliprect;
    const int minx = (int) cliprect->minx;
    const int maxx = (int) cliprect->maxx;
    const int miny = (int) cliprect->miny;
@@ -1449,7 +1453,7 @@ sp_setup_prepare(struct setup_context *setup)
 
    setup->max_layer = max_layer;
 
-   sp->quad.first->begin( sp->quad.first );
+   setup->pipeline->first->begin( setup->pipeline->first );
 
    if (sp->reduced_api_prim == PIPE_PRIM_TRIANGLES &&
        sp->rasterizer->fill_front == PIPE_POLYGON_MODE_FILL &&
@@ -1473,14 +1477,23 @@ sp_setup_destroy_context(struct setup_context *setup)
 
 /**
  * Create a new primitive setup/render stage.
+ * \param pipeline  the quad pipeline to render with
+ * \param cliprect  the rectangle to clip primitives to
  */
 struct setup_context *
-sp_setup_create_context(struct softpipe_context *softpipe)
+sp_setup_create_context(struct softpipe_context *softpipe,
+                        struct sp_quad_pipeline *pipeline,
+                        const struct pipe_scissor_state *cliprect)
 {
    struct setup_context *setup = CALLOC_STRUCT(setup_context);
    unsigned i;
 
+   if (!setup)
+      return NULL;
+
    setup->softpipe = softpipe;
+   setup->pipeline = pipeline;
+   setup->cliprect = cliprect;
 
    for (i = 0; i < MAX_QUADS; i++) {
       setup->quad[i].coef = setup->coef;
@@ -404,7 +404,7 @@ softpipe_update_derived(struct softpipe_context *softpipe, unsigned prim)
                           SP_NEW_FRAMEBUFFER |
                           SP_NEW_STIPPLE |
                           SP_NEW_FS))
-      sp_build_quad_pipeline(softpipe);
+      sp_build_quad_pipeline(softpipe, &softpipe->quad);
 
    softpipe->dirty = 0;
 }
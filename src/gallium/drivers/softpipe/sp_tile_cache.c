@@ -42,16 +42,6 @@ static struct softpipe_cached_tile *
 sp_alloc_tile(struct softpipe_tile_cache *tc);
 
 
-/**
- * Return the position in the cache for the tile that contains win pos (x,y).
- * We currently use a direct mapped cache so this is like a hack key.
- * At some point we should investige something more sophisticated, like
- * a LRU replacement policy.
- */
-#define CACHE_POS(x, y, l)                        \
-   (((x) + (y) * 5 + (l) * 10) % NUM_ENTRIES)
-
-
 static inline int addr_to_clear_pos(union tile_address addr)
 {
    int pos;
@@ -474,6 +464,70 @@ sp_flush_tile_cache(struct softpipe_tile_cache *tc)
 #endif
 }
 
+/**
+ * Let tc render into the tiles of parent, without parent writing them
+ * back to the surface first: a tile tc doesn't have is taken from parent
+ * if it's there, or else cleared or read from the surface like parent
+ * would.  This is used by the tile rasterizer threads (sp_rast.c).
+ * parent must not be used until sp_tile_cache_return_tiles() is called,
+ * and tiles with the same cache position must not be used through
+ * different caches (nor two of them through the same one).
+ */
+void
+sp_tile_cache_borrow(struct softpipe_tile_cache *tc,
+                     struct softpipe_tile_cache *parent)
+{
+   assert(!tc->num_maps);
+   assert(!tc->parent);
+   assert(parent->surface);
+
+   tc->parent = parent;
+   tc->surface = parent->surface;
+   tc->transfer = parent->transfer;
+   tc->transfer_map = parent->transfer_map;
+   tc->depth_stencil = parent->depth_stencil;
+   tc->last_tile_addr.bits.invalid = 1;
+
+   parent->last_tile_addr.bits.invalid = 1;
+}
+
+
+/**
+ * Put the tiles used since sp_tile_cache_borrow() into the parent cache,
+ * writing back the tiles they replace, and detach from the parent.
+ */
+void
+sp_tile_cache_return_tiles(struct softpipe_tile_cache *tc)
+{
+   struct softpipe_tile_cache *parent = tc->parent;
+   unsigned pos;
+
+   assert(parent);
+
+   for (pos = 0; pos < Elements(tc->entries); pos++) {
+      struct softpipe_cached_tile *tile = tc->entries[pos];
+      const union tile_address addr = tc->tile_addrs[pos];
+
+      if (addr.bits.invalid)
+         continue;
+
+      sp_flush_tile(parent, pos);
+
+      tc->entries[pos] = parent->entries[pos];
+      tc->tile_addrs[pos].bits.invalid = 1;
+      parent->entries[pos] = tile;
+      parent->tile_addrs[pos] = addr;
+      clear_clear_flag(parent->clear_flags, addr, parent->clear_flags_size);
+   }
+
+   tc->parent = NULL;
+   tc->surface = NULL;
+   tc->transfer = NULL;
+   tc->transfer_map = NULL;
+   tc->last_tile_addr.bits.invalid = 1;
+}
+
+
 static struct softpipe_cached_tile *
 sp_alloc_tile(struct softpipe_tile_cache *tc)
 {
@@ -520,6 +574,8 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
    const int pos = CACHE_POS(addr.bits.x,
                              addr.bits.y, addr.bits.layer);
    struct softpipe_cached_tile *tile = tc->entries[pos];
+   /* the cache whose clear flags and values apply */
+   const struct softpipe_tile_cache *clear_tc = tc->parent ? tc->parent : tc;
    int layer;
    if (!tile) {
       tile = sp_alloc_tile(tc);
@@ -530,6 +586,9 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
 
       layer = tc->tile_addrs[pos].bits.layer;
       if (tc->tile_addrs[pos].bits.invalid == 0) {
+         /* the parent's clear flag of the tile would be lost */
+         assert(!tc->parent);
+
          /* put dirty tile back in framebuffer */
          if (tc->depth_stencil) {
             pipe_put_tile_raw(tc->transfer[layer], tc->transfer_map[layer],
@@ -570,15 +629,26 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
       pt = tc->transfer[layer];
       assert(pt->resource);
 
-      if (is_clear_flag_set(tc->clear_flags, addr, tc->clear_flags_size)) {
+      if (tc->parent && tc->parent->tile_addrs[pos].value == addr.value) {
+         /* take the parent's tile, swapping in ours */
+         tc->entries[pos] = tc->parent->entries[pos];
+         tc->parent->entries[pos] = tile;
+         tc->parent->tile_addrs[pos].bits.invalid = 1;
+         tile = tc->entries[pos];
+      }
+      else if (is_clear_flag_set(clear_tc->clear_flags, addr,
+                                 clear_tc->clear_flags_size)) {
          /* don't get tile from framebuffer, just clear it */
          if (tc->depth_stencil) {
-            clear_tile(tile, pt->resource->format, tc->clear_val);
+            clear_tile(tile, pt->resource->format, clear_tc->clear_val);
          }
          else {
-            clear_tile_rgba(tile, pt->resource->format, &tc->clear_color);
+            clear_tile_rgba(tile, pt->resource->format,
+                            &clear_tc->clear_color);
          }
-         clear_clear_flag(tc->clear_flags, addr, tc->clear_flags_size);
+         /* a parent's flag is cleared in sp_tile_cache_return_tiles() */
+         if (!tc->parent)
+            clear_clear_flag(tc->clear_flags, addr, tc->clear_flags_size);
       }
       else {
          /* get new tile data from transfer */
@@ -78,6 +78,15 @@ struct softpipe_cached_tile
 
 #define NUM_ENTRIES 50
 
+/**
+ * Return the position in the cache for the tile that contains win pos (x,y).
+ * We currently use a direct mapped cache so this is like a hack key.
+ * At some point we should investige something more sophisticated, like
+ * a LRU replacement policy.
+ */
+#define CACHE_POS(x, y, l)                        \
+   (((x) + (y) * 5 + (l) * 10) % NUM_ENTRIES)
+
 
 struct softpipe_tile_cache
 {
@@ -99,6 +108,9 @@ struct softpipe_tile_cache
 
    union tile_address last_tile_addr;
    struct softpipe_cached_tile *last_tile;  /**< most recently retrieved tile */
+
+   /** cache whose tiles are borrowed, see sp_tile_cache_borrow() */
+   struct softpipe_tile_cache *parent;
 };
 
 
@@ -123,6 +135,13 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
                     const union pipe_color_union *color,
                     uint64_t clearValue);
 
+extern void
+sp_tile_cache_borrow(struct softpipe_tile_cache *tc,
+                     struct softpipe_tile_cache *parent);
+
+extern void
+sp_tile_cache_return_tiles(struct softpipe_tile_cache *tc);
+
 extern struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
                     union tile_address addr );
@@ -0,0 +1,463 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+
+/*
+ * Checks cso_hash against a plain array, including duplicate keys and
+ * erasing while iterating, then times the cso_context set/save/restore
+ * cycles of state trackers and u_blitter and checks that the right
+ * states end up bound.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "cso_cache/cso_context.h"
+#include "cso_cache/cso_hash.h"
+#include "os/os_time.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+#define NUM_ENTRIES 5000
+#define NUM_STATES 64
+#define NUM_DRAWS 100000
+#define BLIT_INTERVAL 8
+#define NUM_RUNS 10
+
+
+/*
+ * cso_hash
+ */
+
+static boolean
+check_hash(struct cso_hash *hash, const unsigned *keys, const boolean *present)
+{
+   struct cso_hash_iter iter;
+   unsigned i, count = 0;
+
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      boolean found = FALSE;
+
+      iter = cso_hash_find(hash, keys[i]);
+      while (!cso_hash_iter_is_null(iter)) {
+         if (cso_hash_iter_key(iter) != keys[i])
+            return FALSE;
+         if (cso_hash_iter_data(iter) == &keys[i])
+            found = TRUE;
+         iter = cso_hash_iter_next(iter);
+      }
+
+      if (found != present[i])
+         return FALSE;
+      if (present[i])
+         count++;
+   }
+
+   if (cso_hash_size(hash) != (int) count)
+      return FALSE;
+
+   for (iter = cso_hash_first_node(hash); !cso_hash_iter_is_null(iter);
+        iter = cso_hash_iter_next(iter))
+      count--;
+
+   return count == 0;
+}
+
+
+static boolean
+test_hash(void)
+{
+   struct cso_hash *hash = cso_hash_create();
+   unsigned *keys = MALLOC(NUM_ENTRIES * sizeof(unsigned));
+   boolean *present = CALLOC(NUM_ENTRIES, sizeof(boolean));
+   struct cso_hash_iter iter;
+   boolean pass = TRUE;
+   unsigned i;
+
+   /* many duplicate keys, differing in the low bits only */
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      keys[i] = (rand() % 1500) << 4;
+      cso_hash_insert(hash, keys[i], &keys[i]);
+      present[i] = TRUE;
+   }
+   if (!check_hash(hash, keys, present)) {
+      printf("cso_hash: insert failed\n");
+      pass = FALSE;
+   }
+
+   /* take every third key */
+   for (i = 0; i < NUM_ENTRIES; i += 3) {
+      unsigned *data = cso_hash_take(hash, keys[i]);
+      if (data)
+         present[data - keys] = FALSE;
+   }
+   if (!check_hash(hash, keys, present)) {
+      printf("cso_hash: take failed\n");
+      pass = FALSE;
+   }
+
+   /* erase the odd entries while iterating */
+   iter = cso_hash_first_node(hash);
+   while (!cso_hash_iter_is_null(iter)) {
+      unsigned *data = cso_hash_iter_data(iter);
+      if ((data - keys) & 1) {
+         present[data - keys] = FALSE;
+         iter = cso_hash_erase(hash, iter);
+      }
+      else
+         iter = cso_hash_iter_next(iter);
+   }
+   if (!check_hash(hash, keys, present)) {
+      printf("cso_hash: erase failed\n");
+      pass = FALSE;
+   }
+
+   /* reinsert, reusing the removed slots */
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      if (!present[i]) {
+         cso_hash_insert(hash, keys[i], &keys[i]);
+         present[i] = TRUE;
+      }
+   }
+   if (!check_hash(hash, keys, present)) {
+      printf("cso_hash: reinsert failed\n");
+      pass = FALSE;
+   }
+
+   cso_hash_delete(hash);
+   FREE(keys);
+   FREE(present);
+
+   return pass;
+}
+
+
+/*
+ * cso_context
+ */
+
+struct dummy_state {
+   char templ[sizeof(struct pipe_rasterizer_state) +
+              sizeof(struct pipe_blend_state) +
+              sizeof(struct pipe_depth_stencil_alpha_state)];
+};
+
+struct dummy_context {
+   struct pipe_context base;
+   struct dummy_state *blend, *dsa, *rast;
+   unsigned num_creates;
+};
+
+
+static void *
+create_state(struct pipe_context *pipe, const void *templ, size_t size)
+{
+   struct dummy_state *state = CALLOC_STRUCT(dummy_state);
+   memcpy(state->templ, templ, size);
+   ((struct dummy_context *) pipe)->num_creates++;
+   return state;
+}
+
+static void
+delete_state(struct pipe_context *pipe, void *state)
+{
+   FREE(state);
+}
+
+static void *
+create_blend_state(struct pipe_context *pipe,
+                   const struct pipe_blend_state *templ)
+{
+   return create_state(pipe, templ, sizeof *templ);
+}
+
+static void
+bind_blend_state(struct pipe_context *pipe, void *state)
+{
+   ((struct dummy_context *) pipe)->blend = state;
+}
+
+static void *
+create_dsa_state(struct pipe_context *pipe,
+                 const struct pipe_depth_stencil_alpha_state *templ)
+{
+   return create_state(pipe, templ, sizeof *templ);
+}
+
+static void
+bind_dsa_state(struct pipe_context *pipe, void *state)
+{
+   ((struct dummy_context *) pipe)->dsa = state;
+}
+
+static void *
+create_rasterizer_state(struct pipe_context *pipe,
+                        const struct pipe_rasterizer_state *templ)
+{
+   return create_state(pipe, templ, sizeof *templ);
+}
+
+static void
+bind_rasterizer_state(struct pipe_context *pipe, void *state)
+{
+   ((struct dummy_context *) pipe)->rast = state;
+}
+
+static void
+bind_shader_state(struct pipe_context *pipe, void *state)
+{
+}
+
+static void
+set_index_buffer(struct pipe_context *pipe,
+                 const struct pipe_index_buffer *ib)
+{
+}
+
+static void
+set_constant_buffer(struct pipe_context *pipe, uint shader, uint index,
+                    struct pipe_constant_buffer *buf)
+{
+}
+
+static int
+dummy_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   switch (param) {
+   case PIPE_CAP_USER_VERTEX_BUFFERS:
+   case PIPE_CAP_MAX_VERTEX_BUFFERS:
+      return 1;
+   default:
+      return 0;
+   }
+}
+
+static int
+dummy_get_shader_param(struct pipe_screen *screen, unsigned shader,
+                       enum pipe_shader_cap param)
+{
+   return 0;
+}
+
+static boolean
+dummy_is_format_supported(struct pipe_screen *screen,
+                          enum pipe_format format,
+                          enum pipe_texture_target target,
+                          unsigned sample_count,
+                          unsigned bindings)
+{
+   return TRUE;
+}
+
+
+/**
+ * Does the bound state match the template?
+ */
+static inline boolean
+is_bound(const struct dummy_state *state, const void *templ, size_t size)
+{
+   return state && memcmp(state->templ, templ, size) == 0;
+}
+
+
+/**
+ * Switch to u_blitter's states and back.
+ */
+static void
+blit(struct cso_context *cso,
+     const struct pipe_blend_state *blend,
+     const struct pipe_depth_stencil_alpha_state *dsa,
+     const struct pipe_rasterizer_state *rast)
+{
+   cso_save_blend(cso);
+   cso_save_depth_stencil_alpha(cso);
+   cso_save_rasterizer(cso);
+   cso_set_blend(cso, blend);
+   cso_set_depth_stencil_alpha(cso, dsa);
+   cso_set_rasterizer(cso, rast);
+   cso_restore_blend(cso);
+   cso_restore_depth_stencil_alpha(cso);
+   cso_restore_rasterizer(cso);
+}
+
+
+static boolean
+test_context(void)
+{
+   static struct pipe_blend_state blend[NUM_STATES];
+   static struct pipe_depth_stencil_alpha_state dsa[NUM_STATES];
+   static struct pipe_rasterizer_state rast[NUM_STATES];
+   struct pipe_blend_state blit_blend;
+   struct pipe_depth_stencil_alpha_state blit_dsa;
+   struct pipe_rasterizer_state blit_rast;
+   struct pipe_screen screen;
+   struct dummy_context ctx;
+   struct cso_context *cso;
+   int64_t set_time = INT64_MAX, blit_time = INT64_MAX, t0, t1;
+   unsigned run;
+   boolean pass = TRUE;
+   unsigned i;
+
+   memset(&screen, 0, sizeof screen);
+   screen.get_param = dummy_get_param;
+   screen.get_shader_param = dummy_get_shader_param;
+   screen.is_format_supported = dummy_is_format_supported;
+
+   memset(&ctx, 0, sizeof ctx);
+   ctx.base.screen = &screen;
+   ctx.base.create_blend_state = create_blend_state;
+   ctx.base.bind_blend_state = bind_blend_state;
+   ctx.base.delete_blend_state = delete_state;
+   ctx.base.create_depth_stencil_alpha_state = create_dsa_state;
+   ctx.base.bind_depth_stencil_alpha_state = bind_dsa_state;
+   ctx.base.delete_depth_stencil_alpha_state = delete_state;
+   ctx.base.create_rasterizer_state = create_rasterizer_state;
+   ctx.base.bind_rasterizer_state = bind_rasterizer_state;
+   ctx.base.delete_rasterizer_state = delete_state;
+   ctx.base.bind_fs_state = bind_shader_state;
+   ctx.base.bind_vs_state = bind_shader_state;
+   ctx.base.bind_vertex_elements_state = bind_shader_state;
+   ctx.base.set_index_buffer = set_index_buffer;
+   ctx.base.set_constant_buffer = set_constant_buffer;
+
+   cso = cso_create_context(&ctx.base);
+   if (!cso) {
+      printf("failed to create cso context\n");
+      return FALSE;
+   }
+
+   /* states differing in a few fields, like an app's */
+   for (i = 0; i < NUM_STATES; i++) {
+      blend[i].rt[0].blend_enable = i & 1;
+      blend[i].rt[0].rgb_src_factor = (i >> 1) & 7;
+      blend[i].rt[0].rgb_dst_factor = (i >> 4) & 3;
+      blend[i].rt[0].colormask = 0xf;
+      blend[i].dither = 1;
+      dsa[i].depth.enabled = 1;
+      dsa[i].depth.writemask = i & 1;
+      dsa[i].depth.func = (i >> 1) & 7;
+      dsa[i].alpha.ref_value = (float) (i >> 4);
+      rast[i].cull_face = i & 3;
+      rast[i].offset_units = (float) (i >> 2);
+      rast[i].line_width = 1.0f;
+   }
+
+   /* u_blitter's states */
+   memset(&blit_blend, 0, sizeof blit_blend);
+   blit_blend.rt[0].colormask = 0xf;
+   memset(&blit_dsa, 0, sizeof blit_dsa);
+   memset(&blit_rast, 0, sizeof blit_rast);
+   blit_rast.half_pixel_center = 1;
+   blit_rast.depth_clip = 1;
+
+   for (i = 0; i < NUM_DRAWS; i++) {
+      /* state tracker validation: states change every few draws, and
+       * unchanged ones are set again
+       */
+      const unsigned s = (i / 4) * 7 % NUM_STATES;
+      const unsigned d = (s + i % 2) % NUM_STATES;
+
+      cso_set_blend(cso, &blend[s]);
+      cso_set_depth_stencil_alpha(cso, &dsa[d]);
+      cso_set_rasterizer(cso, &rast[s / 2]);
+
+      if (!is_bound(ctx.blend, &blend[s], sizeof blend[s]) ||
+          !is_bound(ctx.dsa, &dsa[d], sizeof dsa[d]) ||
+          !is_bound(ctx.rast, &rast[s / 2], sizeof rast[0])) {
+         printf("draw %u: wrong state bound\n", i);
+         pass = FALSE;
+         break;
+      }
+
+      if (i % BLIT_INTERVAL == 0) {
+         blit(cso, &blit_blend, &blit_dsa, &blit_rast);
+
+         if (!is_bound(ctx.blend, &blend[s], sizeof blend[s]) ||
+             !is_bound(ctx.dsa, &dsa[d], sizeof dsa[d]) ||
+             !is_bound(ctx.rast, &rast[s / 2], sizeof rast[0])) {
+            printf("draw %u: state not restored\n", i);
+            pass = FALSE;
+            break;
+         }
+      }
+   }
+
+   /* the same, timed without the checks, best of a few runs */
+   for (run = 0; run < NUM_RUNS; run++) {
+      t0 = os_time_get();
+      for (i = 0; i < NUM_DRAWS; i++) {
+         const unsigned s = (i / 4) * 7 % NUM_STATES;
+
+         cso_set_blend(cso, &blend[s]);
+         cso_set_depth_stencil_alpha(cso, &dsa[(s + i % 2) % NUM_STATES]);
+         cso_set_rasterizer(cso, &rast[s / 2]);
+      }
+      t1 = os_time_get();
+      set_time = MIN2(set_time, t1 - t0);
+
+      for (i = 0; i < NUM_DRAWS; i++)
+         blit(cso, &blit_blend, &blit_dsa, &blit_rast);
+      blit_time = MIN2(blit_time, os_time_get() - t1);
+   }
+
+   /* one driver state per distinct template */
+   if (ctx.num_creates != NUM_STATES * 2 + NUM_STATES / 2 + 3) {
+      printf("%u states created, expected %u\n", ctx.num_creates,
+             NUM_STATES * 2 + NUM_STATES / 2 + 3);
+      pass = FALSE;
+   }
+
+   printf("per draw: %.1f ns setting 3 states, %.1f ns per blit "
+          "save/set/restore\n",
+          set_time * 1000.0 / NUM_DRAWS, blit_time * 1000.0 / NUM_DRAWS);
+
+   cso_destroy_context(cso);
+
+   return pass;
+}
+
+
+int main(int argc, char **argv)
+{
+   boolean pass = TRUE;
+
+   srand(0);
+
+   pass = test_hash() && pass;
+   pass = test_context() && pass;
+
+   printf("%s\n", pass ? "pass" : "FAIL");
+
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Clips random triangles and lines against the frustum and user clip
+ * planes with the SSE and the plain C clipper, and checks that both
+ * produce bit-identical primitives.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_config.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "draw/draw_context.h"
+#include "draw/draw_pipe.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_draw.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+#define NUM_VERTS 3000
+#define NUM_ATTRIBS 3
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL OUT[2], GENERIC[1]\n"
+   "  0: MOV OUT[0], IN[0]\n"
+   "  1: MOV OUT[1], IN[1]\n"
+   "  2: MUL OUT[2], IN[1], IN[0]\n"
+   "  3: END\n";
+
+
+/**
+ * Rasterize stage which records the vertices of every primitive.
+ */
+struct capture_stage {
+   struct draw_stage stage;
+   float *data;
+   unsigned count, size;
+   unsigned num_prims;
+};
+
+
+static void
+capture_prim(struct draw_stage *stage, struct prim_header *header,
+             unsigned nr)
+{
+   struct capture_stage *cs = (struct capture_stage *) stage;
+   const unsigned floats = NUM_ATTRIBS * 4;
+   unsigned i;
+
+   for (i = 0; i < nr; i++) {
+      if (cs->count + floats > cs->size) {
+         cs->size = MAX2(cs->size * 2, 4096);
+         cs->data = REALLOC(cs->data, cs->count * sizeof(float),
+                            cs->size * sizeof(float));
+      }
+      memcpy(cs->data + cs->count, header->v[i]->data,
+             floats * sizeof(float));
+      cs->count += floats;
+   }
+   cs->num_prims++;
+}
+
+static void
+capture_point(struct draw_stage *stage, struct prim_header *header)
+{
+   capture_prim(stage, header, 1);
+}
+
+static void
+capture_line(struct draw_stage *stage, struct prim_header *header)
+{
+   capture_prim(stage, header, 2);
+}
+
+static void
+capture_tri(struct draw_stage *stage, struct prim_header *header)
+{
+   capture_prim(stage, header, 3);
+}
+
+static void
+capture_flush(struct draw_stage *stage, unsigned flags)
+{
+}
+
+static void
+capture_reset_stipple_counter(struct draw_stage *stage)
+{
+}
+
+static void
+capture_destroy(struct draw_stage *stage)
+{
+   /* outlives the draw context, see capture_free() */
+}
+
+static void
+capture_free(struct capture_stage *cs)
+{
+   FREE(cs->data);
+   FREE(cs);
+}
+
+
+static int
+dummy_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return 0;
+}
+
+
+/**
+ * Draw the vertices as lines, triangles and a triangle strip, clipped
+ * against the frustum and two user clip planes, and capture the result.
+ */
+static struct capture_stage *
+capture_draws(struct pipe_context *pipe, const float (*verts)[2][4])
+{
+   struct draw_context *draw;
+   struct capture_stage *cs;
+   struct tgsi_token tokens[1024];
+   struct pipe_shader_state vs_state;
+   struct draw_vertex_shader *vs;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct pipe_clip_state clip;
+   struct pipe_vertex_buffer vb;
+   struct pipe_vertex_element ve[2];
+   struct pipe_draw_info info;
+   unsigned mode;
+
+   draw = draw_create_no_llvm(pipe);
+   if (!draw)
+      return NULL;
+
+   cs = CALLOC_STRUCT(capture_stage);
+   cs->stage.draw = draw;
+   cs->stage.name = "capture";
+   cs->stage.point = capture_point;
+   cs->stage.line = capture_line;
+   cs->stage.tri = capture_tri;
+   cs->stage.flush = capture_flush;
+   cs->stage.reset_stipple_counter = capture_reset_stipple_counter;
+   cs->stage.destroy = capture_destroy;
+   draw_set_rasterize_stage(draw, &cs->stage);
+
+   memset(&rast, 0, sizeof rast);
+   rast.depth_clip = 1;
+   rast.half_pixel_center = 1;
+   rast.point_size = 1.0f;
+   rast.line_width = 1.0f;
+   rast.clip_plane_enable = 0x3;
+   draw_set_rasterizer_state(draw, &rast, NULL);
+
+   memset(&viewport, 0, sizeof viewport);
+   viewport.scale[0] = viewport.scale[1] = 128.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = viewport.translate[1] = 128.0f;
+   viewport.translate[2] = 0.5f;
+   draw_set_viewport_states(draw, 0, 1, &viewport);
+
+   memset(&clip, 0, sizeof clip);
+   clip.ucp[0][0] = 1.0f;
+   clip.ucp[0][1] = 1.0f;
+   clip.ucp[0][3] = 0.5f;
+   clip.ucp[1][1] = -0.5f;
+   clip.ucp[1][2] = 0.25f;
+   clip.ucp[1][3] = 0.75f;
+   draw_set_clip_state(draw, &clip);
+
+   if (!tgsi_text_translate(vs_text, tokens, ARRAY_SIZE(tokens))) {
+      printf("failed to translate shader\n");
+      exit(1);
+   }
+   memset(&vs_state, 0, sizeof vs_state);
+   vs_state.tokens = tokens;
+   vs = draw_create_vertex_shader(draw, &vs_state);
+   draw_bind_vertex_shader(draw, vs);
+
+   memset(&vb, 0, sizeof vb);
+   vb.stride = sizeof verts[0];
+   vb.user_buffer = verts;
+   draw_set_vertex_buffers(draw, 0, 1, &vb);
+   draw_set_mapped_vertex_buffer(draw, 0, verts, NUM_VERTS * sizeof verts[0]);
+
+   memset(ve, 0, sizeof ve);
+   ve[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   ve[1].src_offset = sizeof verts[0][0];
+   ve[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   draw_set_vertex_elements(draw, 2, ve);
+
+   for (mode = PIPE_PRIM_LINES; mode <= PIPE_PRIM_TRIANGLE_STRIP; mode++) {
+      util_draw_init_info(&info);
+      info.mode = mode;
+      info.count = NUM_VERTS;
+      info.max_index = NUM_VERTS - 1;
+      draw_vbo(draw, &info);
+   }
+   draw_flush(draw);
+
+   draw_delete_vertex_shader(draw, vs);
+   draw_destroy(draw);
+
+   return cs;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_screen screen;
+   struct pipe_context pipe;
+   float (*verts)[2][4];
+   struct capture_stage *sse, *c;
+   boolean pass = TRUE;
+   unsigned i, j;
+
+   util_cpu_detect();
+
+#if defined(PIPE_ARCH_SSE)
+   if (!util_cpu_caps.has_sse)
+#endif
+   {
+      printf("no SSE support, skipping\n");
+      return 0;
+   }
+
+   memset(&screen, 0, sizeof screen);
+   screen.get_param = dummy_get_param;
+   memset(&pipe, 0, sizeof pipe);
+   pipe.screen = &screen;
+
+   /* positions mostly straddling the frustum, some behind the eye */
+   verts = CALLOC(NUM_VERTS, sizeof verts[0]);
+   srand(0);
+   for (i = 0; i < NUM_VERTS; i++) {
+      for (j = 0; j < 3; j++)
+         verts[i][0][j] = (float) rand() / RAND_MAX * 6.0f - 3.0f;
+      verts[i][0][3] = (float) rand() / RAND_MAX * 2.0f - 0.25f;
+      for (j = 0; j < 4; j++)
+         verts[i][1][j] = (float) rand() / RAND_MAX;
+   }
+
+   sse = capture_draws(&pipe, (const float (*)[2][4]) verts);
+
+   util_cpu_caps.has_sse = 0;
+   c = capture_draws(&pipe, (const float (*)[2][4]) verts);
+   util_cpu_caps.has_sse = 1;
+
+   if (sse->num_prims != c->num_prims || sse->count != c->count ||
+       memcmp(sse->data, c->data, c->count * sizeof(float)) != 0) {
+      printf("clipped primitives differ\n");
+      pass = FALSE;
+   }
+
+   printf("%u primitives\n", c->num_prims);
+
+   capture_free(sse);
+   capture_free(c);
+   FREE(verts);
+
+   printf("%s\n", pass ? "pass" : "FAIL");
+
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Runs the same draws through a single-threaded and a multi-threaded draw
+ * module (see DRAW_NUM_THREADS) and checks that the primitives reaching the
+ * rasterize stage are identical and arrive in the same order.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "draw/draw_context.h"
+#include "draw/draw_pipe.h"
+#include "draw/draw_private.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_draw.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+#define NUM_VERTS 10000
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL CONST[0]\n"
+   "DCL TEMP[0]\n"
+   "IMM[0] FLT32 { 0.5, 0.25, 1.0, 2.0 }\n"
+   "  0: MAD TEMP[0], IN[0], IMM[0].xxxx, IMM[0].yyyy\n"
+   "  1: MOV TEMP[0].w, IMM[0].zzzz\n"
+   "  2: MOV OUT[0], TEMP[0]\n"
+   "  3: DP4 TEMP[0].x, IN[1], IN[0]\n"
+   "  4: MUL OUT[1], IN[1], TEMP[0].xxxx\n"
+   "  5: END\n";
+
+
+/**
+ * Rasterize stage which records the vertices of every primitive.
+ */
+struct capture_stage {
+   struct draw_stage stage;
+   unsigned num_attribs;
+   float *data;
+   unsigned count, size;
+};
+
+
+static void
+capture_prim(struct draw_stage *stage, struct prim_header *header,
+             unsigned nr)
+{
+   struct capture_stage *cs = (struct capture_stage *) stage;
+   unsigned floats = cs->num_attribs * 4;
+   unsigned i;
+
+   for (i = 0; i < nr; i++) {
+      if (cs->count + floats > cs->size) {
+         cs->size = MAX2(cs->size * 2, 4096);
+         cs->data = REALLOC(cs->data, cs->count * sizeof(float),
+                            cs->size * sizeof(float));
+      }
+      memcpy(cs->data + cs->count, header->v[i]->data,
+             floats * sizeof(float));
+      cs->count += floats;
+   }
+}
+
+static void
+capture_point(struct draw_stage *stage, struct prim_header *header)
+{
+   capture_prim(stage, header, 1);
+}
+
+static void
+capture_line(struct draw_stage *stage, struct prim_header *header)
+{
+   capture_prim(stage, header, 2);
+}
+
+static void
+capture_tri(struct draw_stage *stage, struct prim_header *header)
+{
+   capture_prim(stage, header, 3);
+}
+
+static void
+capture_flush(struct draw_stage *stage, unsigned flags)
+{
+}
+
+static void
+capture_reset_stipple_counter(struct draw_stage *stage)
+{
+}
+
+static void
+capture_destroy(struct draw_stage *stage)
+{
+   /* outlives the draw context, see capture_free() */
+}
+
+static void
+capture_free(struct capture_stage *cs)
+{
+   FREE(cs->data);
+   FREE(cs);
+}
+
+
+static int
+dummy_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return 0;
+}
+
+
+struct test_data {
+   float verts[NUM_VERTS][2][4];
+   ushort elts[NUM_VERTS];
+   float consts[4];
+};
+
+
+/**
+ * Issue a few draws big enough to be split into many segments.
+ */
+static void
+run_draws(struct draw_context *draw, const struct test_data *data)
+{
+   struct pipe_draw_info info;
+   unsigned mode;
+
+   for (mode = PIPE_PRIM_POINTS; mode <= PIPE_PRIM_TRIANGLE_FAN; mode++) {
+      util_draw_init_info(&info);
+      info.mode = mode;
+      info.count = NUM_VERTS;
+      info.max_index = NUM_VERTS - 1;
+      info.instance_count = 2;
+      draw_vbo(draw, &info);
+
+      info.indexed = TRUE;
+      info.count = NUM_VERTS - 3;
+      info.start = 3;
+      draw_vbo(draw, &info);
+   }
+
+   draw_flush(draw);
+}
+
+
+/**
+ * Create a draw context with the given number of worker threads and
+ * capture the primitives it produces for run_draws().
+ * \return the capture stage, or NULL if there's no LLVM support
+ */
+static struct capture_stage *
+capture_draws(struct pipe_context *pipe, const char *num_threads,
+              const struct test_data *data)
+{
+   struct draw_context *draw;
+   struct capture_stage *cs;
+   struct tgsi_token tokens[1024];
+   struct pipe_shader_state vs_state;
+   struct draw_vertex_shader *vs;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_buffer vb;
+   struct pipe_vertex_element ve[2];
+
+   setenv("DRAW_NUM_THREADS", num_threads, 1);
+
+   draw = draw_create(pipe);
+   if (!draw)
+      return NULL;
+
+   if (!draw->llvm) {
+      draw_destroy(draw);
+      return NULL;
+   }
+
+   cs = CALLOC_STRUCT(capture_stage);
+   cs->stage.draw = draw;
+   cs->stage.name = "capture";
+   cs->stage.point = capture_point;
+   cs->stage.line = capture_line;
+   cs->stage.tri = capture_tri;
+   cs->stage.flush = capture_flush;
+   cs->stage.reset_stipple_counter = capture_reset_stipple_counter;
+   cs->stage.destroy = capture_destroy;
+   cs->num_attribs = 2;
+   draw_set_rasterize_stage(draw, &cs->stage);
+
+   memset(&rast, 0, sizeof rast);
+   rast.depth_clip = 1;
+   rast.half_pixel_center = 1;
+   rast.point_size = 1.0f;
+   rast.line_width = 1.0f;
+   draw_set_rasterizer_state(draw, &rast, NULL);
+
+   memset(&viewport, 0, sizeof viewport);
+   viewport.scale[0] = viewport.scale[1] = 128.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = viewport.translate[1] = 128.0f;
+   viewport.translate[2] = 0.5f;
+   draw_set_viewport_states(draw, 0, 1, &viewport);
+
+   if (!tgsi_text_translate(vs_text, tokens, ARRAY_SIZE(tokens))) {
+      printf("failed to translate shader\n");
+      exit(1);
+   }
+   memset(&vs_state, 0, sizeof vs_state);
+   vs_state.tokens = tokens;
+   vs = draw_create_vertex_shader(draw, &vs_state);
+   draw_bind_vertex_shader(draw, vs);
+
+   draw_set_mapped_constant_buffer(draw, PIPE_SHADER_VERTEX, 0,
+                                   data->consts, sizeof data->consts);
+
+   memset(&vb, 0, sizeof vb);
+   vb.stride = sizeof data->verts[0];
+   vb.user_buffer = data->verts;
+   draw_set_vertex_buffers(draw, 0, 1, &vb);
+   draw_set_mapped_vertex_buffer(draw, 0, data->verts, sizeof data->verts);
+
+   memset(ve, 0, sizeof ve);
+   ve[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   ve[1].src_offset = sizeof data->verts[0][0];
+   ve[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   draw_set_vertex_elements(draw, 2, ve);
+
+   draw_set_indexes(draw, data->elts, sizeof data->elts[0],
+                    sizeof data->elts);
+
+   run_draws(draw, data);
+
+   draw_delete_vertex_shader(draw, vs);
+   draw_destroy(draw);
+
+   return cs;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_screen screen;
+   struct pipe_context pipe;
+   struct test_data *data;
+   struct capture_stage *ref, *mt;
+   const char *threads[] = { "1", "3", "8" };
+   boolean pass = TRUE;
+   unsigned i, j;
+
+   memset(&screen, 0, sizeof screen);
+   screen.get_param = dummy_get_param;
+   memset(&pipe, 0, sizeof pipe);
+   pipe.screen = &screen;
+
+   data = CALLOC_STRUCT(test_data);
+   srand(0);
+   for (i = 0; i < NUM_VERTS; i++) {
+      for (j = 0; j < 8; j++)
+         data->verts[i][j / 4][j % 4] = (float) rand() / RAND_MAX * 1.8f - 0.9f;
+      data->elts[i] = rand() % NUM_VERTS;
+   }
+   data->consts[0] = 1.0f;
+
+   ref = capture_draws(&pipe, "0", data);
+   if (!ref) {
+      printf("no LLVM support, skipping\n");
+      FREE(data);
+      return 0;
+   }
+
+   for (i = 0; i < ARRAY_SIZE(threads); i++) {
+      mt = capture_draws(&pipe, threads[i], data);
+
+      if (mt->count != ref->count ||
+          memcmp(mt->data, ref->data, ref->count * sizeof(float)) != 0) {
+         printf("%s threads: primitives differ\n", threads[i]);
+         pass = FALSE;
+      }
+
+      capture_free(mt);
+   }
+
+   capture_free(ref);
+   FREE(data);
+
+   printf("%s\n", pass ? "pass" : "FAIL");
+
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Draws a grid mesh with shuffled triangles with and without the
+ * post-transform vertex cache (see DRAW_VERTEX_CACHE) and checks that the
+ * primitives are identical while fewer vertices get shaded.  Also checks
+ * that u_index_reorder_triangles() only permutes the triangles and
+ * improves vertex reuse.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "draw/draw_context.h"
+#include "draw/draw_pipe.h"
+#include "indices/u_indices.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_draw.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+#define GRID 64
+#define NUM_VERTS ((GRID + 1) * (GRID + 1))
+#define NUM_ELTS (GRID * GRID * 6)
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL TEMP[0]\n"
+   "IMM[0] FLT32 { 0.5, 0.25, 1.0, 2.0 }\n"
+   "  0: MAD TEMP[0], IN[0], IMM[0].wwww, -IMM[0].zzzz\n"
+   "  1: MOV TEMP[0].zw, IMM[0].xxxz\n"
+   "  2: MOV OUT[0], TEMP[0]\n"
+   "  3: MUL OUT[1], IN[0], IN[0].yxxy\n"
+   "  4: END\n";
+
+
+/**
+ * Rasterize stage which records the vertices of every primitive.
+ */
+struct capture_stage {
+   struct draw_stage stage;
+   float *data;
+   unsigned count, size;
+};
+
+
+static void
+capture_tri(struct draw_stage *stage, struct prim_header *header)
+{
+   struct capture_stage *cs = (struct capture_stage *) stage;
+   const unsigned floats = 2 * 4;
+   unsigned i;
+
+   for (i = 0; i < 3; i++) {
+      if (cs->count + floats > cs->size) {
+         cs->size = MAX2(cs->size * 2, 4096);
+         cs->data = REALLOC(cs->data, cs->count * sizeof(float),
+                            cs->size * sizeof(float));
+      }
+      memcpy(cs->data + cs->count, header->v[i]->data,
+             floats * sizeof(float));
+      cs->count += floats;
+   }
+}
+
+static void
+capture_flush(struct draw_stage *stage, unsigned flags)
+{
+}
+
+static void
+capture_reset_stipple_counter(struct draw_stage *stage)
+{
+}
+
+static void
+capture_destroy(struct draw_stage *stage)
+{
+   /* outlives the draw context, see capture_free() */
+}
+
+static void
+capture_free(struct capture_stage *cs)
+{
+   FREE(cs->data);
+   FREE(cs);
+}
+
+
+static int
+dummy_get_param(struct pipe_screen *screen, enum pipe_cap param)
+{
+   return 0;
+}
+
+
+/**
+ * Draw the triangle list with the given vertex cache size and capture
+ * the result.
+ * \param shaded  returns the number of vertices shaded
+ */
+static struct capture_stage *
+capture_draws(struct pipe_context *pipe, const char *cache_size,
+              const float (*verts)[4], const ushort *elts,
+              uint64_t *shaded)
+{
+   struct draw_context *draw;
+   struct capture_stage *cs;
+   struct tgsi_token tokens[1024];
+   struct pipe_shader_state vs_state;
+   struct draw_vertex_shader *vs;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_buffer vb;
+   struct pipe_vertex_element ve;
+   struct pipe_draw_info info;
+   struct draw_vertex_stats stats;
+
+   setenv("DRAW_VERTEX_CACHE", cache_size, 1);
+
+   draw = draw_create_no_llvm(pipe);
+   if (!draw)
+      return NULL;
+
+   cs = CALLOC_STRUCT(capture_stage);
+   cs->stage.draw = draw;
+   cs->stage.name = "capture";
+   cs->stage.tri = capture_tri;
+   cs->stage.flush = capture_flush;
+   cs->stage.reset_stipple_counter = capture_reset_stipple_counter;
+   cs->stage.destroy = capture_destroy;
+   draw_set_rasterize_stage(draw, &cs->stage);
+
+   memset(&rast, 0, sizeof rast);
+   rast.depth_clip = 1;
+   rast.half_pixel_center = 1;
+   rast.point_size = 1.0f;
+   rast.line_width = 1.0f;
+   draw_set_rasterizer_state(draw, &rast, NULL);
+
+   memset(&viewport, 0, sizeof viewport);
+   viewport.scale[0] = viewport.scale[1] = 128.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = viewport.translate[1] = 128.0f;
+   viewport.translate[2] = 0.5f;
+   draw_set_viewport_states(draw, 0, 1, &viewport);
+
+   if (!tgsi_text_translate(vs_text, tokens, ARRAY_SIZE(tokens))) {
+      printf("failed to translate shader\n");
+      exit(1);
+   }
+   memset(&vs_state, 0, sizeof vs_state);
+   vs_state.tokens = tokens;
+   vs = draw_create_vertex_shader(draw, &vs_state);
+   draw_bind_vertex_shader(draw, vs);
+
+   memset(&vb, 0, sizeof vb);
+   vb.stride = sizeof verts[0];
+   vb.user_buffer = verts;
+   draw_set_vertex_buffers(draw, 0, 1, &vb);
+   draw_set_mapped_vertex_buffer(draw, 0, verts, NUM_VERTS * sizeof verts[0]);
+
+   memset(&ve, 0, sizeof ve);
+   ve.src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   draw_set_vertex_elements(draw, 1, &ve);
+
+   draw_set_indexes(draw, elts, sizeof elts[0], NUM_ELTS * sizeof elts[0]);
+
+   util_draw_init_info(&info);
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.indexed = TRUE;
+   info.count = NUM_ELTS;
+   info.max_index = NUM_VERTS - 1;
+   info.instance_count = 2;
+   draw_vbo(draw, &info);
+   draw_flush(draw);
+
+   draw_get_vertex_stats(draw, &stats);
+   *shaded = stats.shaded;
+
+   draw_delete_vertex_shader(draw, vs);
+   draw_destroy(draw);
+
+   return cs;
+}
+
+
+static int
+compare_tris(const void *a, const void *b)
+{
+   return memcmp(a, b, 3 * sizeof(ushort));
+}
+
+
+/**
+ * Check that the two triangle lists contain the same triangles.
+ */
+static boolean
+same_triangles(const ushort *a, const ushort *b)
+{
+   ushort *sa = MALLOC(NUM_ELTS * sizeof(ushort));
+   ushort *sb = MALLOC(NUM_ELTS * sizeof(ushort));
+   boolean same;
+
+   memcpy(sa, a, NUM_ELTS * sizeof(ushort));
+   memcpy(sb, b, NUM_ELTS * sizeof(ushort));
+   qsort(sa, NUM_ELTS / 3, 3 * sizeof(ushort), compare_tris);
+   qsort(sb, NUM_ELTS / 3, 3 * sizeof(ushort), compare_tris);
+   same = memcmp(sa, sb, NUM_ELTS * sizeof(ushort)) == 0;
+
+   FREE(sa);
+   FREE(sb);
+   return same;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_screen screen;
+   struct pipe_context pipe;
+   float (*verts)[4];
+   ushort *elts, *reordered;
+   struct capture_stage *ref, *cached, *opt;
+   uint64_t ref_shaded, cached_shaded, opt_shaded;
+   boolean pass = TRUE;
+   unsigned i, x, y;
+
+   memset(&screen, 0, sizeof screen);
+   screen.get_param = dummy_get_param;
+   memset(&pipe, 0, sizeof pipe);
+   pipe.screen = &screen;
+
+   verts = CALLOC(NUM_VERTS, sizeof verts[0]);
+   for (y = 0; y <= GRID; y++) {
+      for (x = 0; x <= GRID; x++) {
+         verts[y * (GRID + 1) + x][0] = (float) x / GRID;
+         verts[y * (GRID + 1) + x][1] = (float) y / GRID;
+      }
+   }
+
+   /* two triangles per grid cell, then shuffle the triangles */
+   elts = MALLOC(NUM_ELTS * sizeof(ushort));
+   reordered = MALLOC(NUM_ELTS * sizeof(ushort));
+   for (y = 0, i = 0; y < GRID; y++) {
+      for (x = 0; x < GRID; x++) {
+         const ushort v = y * (GRID + 1) + x;
+         elts[i++] = v;
+         elts[i++] = v + 1;
+         elts[i++] = v + GRID + 1;
+         elts[i++] = v + 1;
+         elts[i++] = v + GRID + 2;
+         elts[i++] = v + GRID + 1;
+      }
+   }
+   srand(0);
+   for (i = NUM_ELTS / 3 - 1; i > 0; i--) {
+      const unsigned j = rand() % (i + 1);
+      ushort tmp[3];
+      memcpy(tmp, &elts[i * 3], sizeof tmp);
+      memcpy(&elts[i * 3], &elts[j * 3], sizeof tmp);
+      memcpy(&elts[j * 3], tmp, sizeof tmp);
+   }
+
+   ref = capture_draws(&pipe, "0", (const float (*)[4]) verts, elts,
+                       &ref_shaded);
+   cached = capture_draws(&pipe, "4096", (const float (*)[4]) verts, elts,
+                          &cached_shaded);
+
+   if (cached->count != ref->count ||
+       memcmp(cached->data, ref->data, ref->count * sizeof(float)) != 0) {
+      printf("cached primitives differ\n");
+      pass = FALSE;
+   }
+
+   if (cached_shaded >= ref_shaded) {
+      printf("cache didn't reduce shaded vertices\n");
+      pass = FALSE;
+   }
+
+   if (!u_index_reorder_triangles(elts, sizeof(ushort), NUM_ELTS, 32,
+                                  reordered)) {
+      printf("reordering failed\n");
+      exit(1);
+   }
+
+   if (!same_triangles(elts, reordered)) {
+      printf("reordered triangles differ\n");
+      pass = FALSE;
+   }
+
+   opt = capture_draws(&pipe, "0", (const float (*)[4]) verts, reordered,
+                       &opt_shaded);
+
+   if (opt->count != ref->count) {
+      printf("reordered primitive count differs\n");
+      pass = FALSE;
+   }
+
+   if (opt_shaded >= ref_shaded) {
+      printf("reordering didn't reduce shaded vertices\n");
+      pass = FALSE;
+   }
+
+   printf("%u indices: %u shaded, %u cached, %u reordered\n",
+          2 * NUM_ELTS, (unsigned) ref_shaded, (unsigned) cached_shaded,
+          (unsigned) opt_shaded);
+
+   capture_free(ref);
+   capture_free(cached);
+   capture_free(opt);
+   FREE(reordered);
+   FREE(elts);
+   FREE(verts);
+
+   printf("%s\n", pass ? "pass" : "FAIL");
+
+   return pass ? 0 : 1;
+}
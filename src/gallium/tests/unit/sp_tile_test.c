@@ -0,0 +1,442 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Renders overlapping, blended, depth tested and textured triangles, lines
+ * and points with softpipe on the calling thread and with tile rasterizer
+ * threads (see SOFTPIPE_NUM_THREADS), and checks that the color and depth
+ * buffers and the occlusion query results are identical.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "softpipe/sp_public.h"
+#include "sw/null/null_sw_winsys.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_box.h"
+#include "util/u_draw.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_sampler.h"
+
+
+#define WIDTH  300
+#define HEIGHT 200
+#define NUM_TRIS 600
+#define NUM_LINES 200
+#define NUM_POINTS 200
+#define NUM_VERTS (NUM_TRIS * 3 + NUM_LINES * 2 + NUM_POINTS)
+#define TEX_SIZE 64
+
+
+static const char vs_text[] =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "  0: MOV OUT[0], IN[0]\n"
+   "  1: MOV OUT[1], IN[1]\n"
+   "  2: END\n";
+
+static const char fs_text[] =
+   "FRAG\n"
+   "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+   "DCL OUT[0], COLOR\n"
+   "DCL SAMP[0]\n"
+   "DCL TEMP[0]\n"
+   "  0: TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+   "  1: MUL OUT[0], TEMP[0], IN[0]\n"
+   "  2: END\n";
+
+
+struct vertex {
+   float pos[4];
+   float color[4];
+};
+
+
+static float
+rand_float(float min, float max)
+{
+   return min + (max - min) * ((float) rand() / RAND_MAX);
+}
+
+
+static void *
+create_shader(struct pipe_context *pipe, const char *text, boolean vertex)
+{
+   struct tgsi_token tokens[1024];
+   struct pipe_shader_state state;
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens))) {
+      printf("failed to translate shader\n");
+      exit(1);
+   }
+
+   memset(&state, 0, sizeof state);
+   state.tokens = tokens;
+
+   return vertex ? pipe->create_vs_state(pipe, &state)
+                 : pipe->create_fs_state(pipe, &state);
+}
+
+
+static struct pipe_resource *
+create_texture(struct pipe_screen *screen, enum pipe_format format,
+               unsigned width, unsigned height, unsigned bind)
+{
+   struct pipe_resource templ;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = bind;
+
+   return screen->resource_create(screen, &templ);
+}
+
+
+static struct pipe_surface *
+create_surface(struct pipe_context *pipe, struct pipe_resource *tex)
+{
+   struct pipe_surface templ;
+
+   memset(&templ, 0, sizeof templ);
+   templ.format = tex->format;
+
+   return pipe->create_surface(pipe, tex, &templ);
+}
+
+
+/**
+ * Read back a texture into a malloc'ed buffer.
+ */
+static void *
+read_texture(struct pipe_context *pipe, struct pipe_resource *tex)
+{
+   const unsigned stride = util_format_get_stride(tex->format, tex->width0);
+   struct pipe_transfer *transfer;
+   ubyte *data = MALLOC(stride * tex->height0);
+   const ubyte *map;
+   unsigned y;
+
+   map = pipe_transfer_map(pipe, tex, 0, 0, PIPE_TRANSFER_READ,
+                           0, 0, tex->width0, tex->height0, &transfer);
+   for (y = 0; y < tex->height0; y++)
+      memcpy(data + y * stride, map + y * transfer->stride, stride);
+   pipe->transfer_unmap(pipe, transfer);
+
+   return data;
+}
+
+
+struct result {
+   void *color;
+   void *depth;
+   uint64_t occlusion;
+};
+
+
+/**
+ * Draw the vertices in a new context and read back the result.
+ */
+static void
+render(struct pipe_screen *screen, const char *num_threads,
+       const struct vertex *verts, const ubyte *texels,
+       struct result *result)
+{
+   struct pipe_context *pipe;
+   struct pipe_resource *cbuf, *zsbuf, *tex;
+   struct pipe_surface *cbuf_surf, *zsbuf_surf;
+   struct pipe_sampler_view view_templ, *view, *view_null;
+   struct pipe_framebuffer_state fb;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rast;
+   struct pipe_sampler_state sampler;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element ve[2];
+   struct pipe_vertex_buffer vb;
+   struct pipe_draw_info info;
+   struct pipe_box box;
+   union pipe_color_union clear_color;
+   union pipe_query_result query_result;
+   struct pipe_query *query;
+   void *blend_cso, *dsa_cso, *rast_cso, *sampler_cso, *ve_cso, *vs, *fs;
+
+   setenv("SOFTPIPE_NUM_THREADS", num_threads, 1);
+
+   pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      printf("failed to create context\n");
+      exit(1);
+   }
+
+   cbuf = create_texture(screen, PIPE_FORMAT_B8G8R8A8_UNORM, WIDTH, HEIGHT,
+                         PIPE_BIND_RENDER_TARGET);
+   zsbuf = create_texture(screen, PIPE_FORMAT_Z24_UNORM_S8_UINT,
+                          WIDTH, HEIGHT, PIPE_BIND_DEPTH_STENCIL);
+   tex = create_texture(screen, PIPE_FORMAT_R8G8B8A8_UNORM,
+                        TEX_SIZE, TEX_SIZE, PIPE_BIND_SAMPLER_VIEW);
+   cbuf_surf = create_surface(pipe, cbuf);
+   zsbuf_surf = create_surface(pipe, zsbuf);
+
+   u_box_origin_2d(TEX_SIZE, TEX_SIZE, &box);
+   pipe->transfer_inline_write(pipe, tex, 0, PIPE_TRANSFER_WRITE, &box,
+                               texels, TEX_SIZE * 4, 0);
+
+   u_sampler_view_default_template(&view_templ, tex, tex->format);
+   view = pipe->create_sampler_view(pipe, tex, &view_templ);
+   pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 1, &view);
+
+   memset(&sampler, 0, sizeof sampler);
+   sampler.wrap_s = PIPE_TEX_WRAP_REPEAT;
+   sampler.wrap_t = PIPE_TEX_WRAP_REPEAT;
+   sampler.wrap_r = PIPE_TEX_WRAP_REPEAT;
+   sampler.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   sampler.normalized_coords = 1;
+   sampler_cso = pipe->create_sampler_state(pipe, &sampler);
+   pipe->bind_sampler_states(pipe, PIPE_SHADER_FRAGMENT, 0, 1, &sampler_cso);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = cbuf_surf;
+   fb.zsbuf = zsbuf_surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].blend_enable = 1;
+   blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+   blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+   blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+   blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   blend_cso = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, blend_cso);
+
+   memset(&dsa, 0, sizeof dsa);
+   dsa.depth.enabled = 1;
+   dsa.depth.writemask = 1;
+   dsa.depth.func = PIPE_FUNC_LEQUAL;
+   dsa_cso = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, dsa_cso);
+
+   memset(&rast, 0, sizeof rast);
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip = 1;
+   rast.point_size = 5.0f;
+   rast.line_width = 1.0f;
+   rast_cso = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, rast_cso);
+
+   memset(&viewport, 0, sizeof viewport);
+   viewport.scale[0] = WIDTH / 2.0f;
+   viewport.scale[1] = HEIGHT / 2.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = WIDTH / 2.0f;
+   viewport.translate[1] = HEIGHT / 2.0f;
+   viewport.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &viewport);
+
+   memset(ve, 0, sizeof ve);
+   ve[0].src_offset = 0;
+   ve[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   ve[1].src_offset = 4 * sizeof(float);
+   ve[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   ve_cso = pipe->create_vertex_elements_state(pipe, 2, ve);
+   pipe->bind_vertex_elements_state(pipe, ve_cso);
+
+   memset(&vb, 0, sizeof vb);
+   vb.stride = sizeof verts[0];
+   vb.user_buffer = verts;
+   pipe->set_vertex_buffers(pipe, 0, 1, &vb);
+
+   vs = create_shader(pipe, vs_text, TRUE);
+   fs = create_shader(pipe, fs_text, FALSE);
+   pipe->bind_vs_state(pipe, vs);
+   pipe->bind_fs_state(pipe, fs);
+
+   clear_color.f[0] = 0.2f;
+   clear_color.f[1] = 0.3f;
+   clear_color.f[2] = 0.4f;
+   clear_color.f[3] = 0.0f;
+   pipe->clear(pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTHSTENCIL,
+               &clear_color, 1.0, 0);
+
+   query = pipe->create_query(pipe, PIPE_QUERY_OCCLUSION_COUNTER, 0);
+   pipe->begin_query(pipe, query);
+
+   util_draw_init_info(&info);
+   info.mode = PIPE_PRIM_TRIANGLES;
+   info.count = NUM_TRIS * 3;
+   pipe->draw_vbo(pipe, &info);
+
+   info.mode = PIPE_PRIM_LINES;
+   info.start = NUM_TRIS * 3;
+   info.count = NUM_LINES * 2;
+   pipe->draw_vbo(pipe, &info);
+
+   info.mode = PIPE_PRIM_POINTS;
+   info.start = NUM_TRIS * 3 + NUM_LINES * 2;
+   info.count = NUM_POINTS;
+   pipe->draw_vbo(pipe, &info);
+
+   pipe->end_query(pipe, query);
+   pipe->get_query_result(pipe, query, TRUE, &query_result);
+   result->occlusion = query_result.u64;
+   pipe->destroy_query(pipe, query);
+
+   result->color = read_texture(pipe, cbuf);
+   result->depth = read_texture(pipe, zsbuf);
+
+   view_null = NULL;
+   pipe->set_sampler_views(pipe, PIPE_SHADER_FRAGMENT, 0, 1, &view_null);
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_fs_state(pipe, NULL);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->delete_fs_state(pipe, fs);
+   pipe->delete_vertex_elements_state(pipe, ve_cso);
+   pipe->delete_rasterizer_state(pipe, rast_cso);
+   pipe->delete_depth_stencil_alpha_state(pipe, dsa_cso);
+   pipe->delete_blend_state(pipe, blend_cso);
+   pipe->delete_sampler_state(pipe, sampler_cso);
+   pipe_sampler_view_reference(&view, NULL);
+   pipe_surface_reference(&cbuf_surf, NULL);
+   pipe_surface_reference(&zsbuf_surf, NULL);
+   pipe->destroy(pipe);
+
+   pipe_resource_reference(&cbuf, NULL);
+   pipe_resource_reference(&zsbuf, NULL);
+   pipe_resource_reference(&tex, NULL);
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_screen *screen;
+   struct vertex *verts;
+   ubyte *texels;
+   struct result serial, threaded;
+   const unsigned color_size = WIDTH * HEIGHT * 4;
+   const unsigned depth_size = WIDTH * HEIGHT * 4;
+   boolean pass = TRUE;
+   unsigned i, j;
+
+   screen = softpipe_create_screen(null_sw_create());
+   if (!screen) {
+      printf("failed to create screen\n");
+      return 1;
+   }
+
+   srand(0);
+
+   verts = CALLOC(NUM_VERTS, sizeof verts[0]);
+   for (i = 0; i < NUM_VERTS; i++) {
+      const float w = rand_float(0.5f, 2.0f);
+
+      verts[i].pos[0] = rand_float(-1.2f, 1.2f) * w;
+      verts[i].pos[1] = rand_float(-1.2f, 1.2f) * w;
+      verts[i].pos[2] = rand_float(0.0f, 1.0f) * w;
+      verts[i].pos[3] = w;
+      for (j = 0; j < 4; j++)
+         verts[i].color[j] = rand_float(0.0f, 1.0f);
+   }
+
+   /* keep most triangles small enough to hit only a few tiles */
+   for (i = 0; i < NUM_TRIS * 3; i += 3) {
+      if (i % 4 == 0)
+         continue;
+      for (j = 1; j < 3; j++) {
+         verts[i + j].pos[0] = verts[i].pos[0] + rand_float(-0.2f, 0.2f);
+         verts[i + j].pos[1] = verts[i].pos[1] + rand_float(-0.2f, 0.2f);
+         verts[i + j].pos[3] = verts[i].pos[3];
+      }
+   }
+
+   texels = MALLOC(TEX_SIZE * TEX_SIZE * 4);
+   for (i = 0; i < TEX_SIZE * TEX_SIZE * 4; i++)
+      texels[i] = rand() & 0xff;
+
+   render(screen, "0", verts, texels, &serial);
+   render(screen, "4", verts, texels, &threaded);
+
+   if (memcmp(serial.color, threaded.color, color_size) != 0) {
+      printf("color buffers differ\n");
+      pass = FALSE;
+   }
+
+   if (memcmp(serial.depth, threaded.depth, depth_size) != 0) {
+      printf("depth buffers differ\n");
+      pass = FALSE;
+   }
+
+   if (serial.occlusion != threaded.occlusion) {
+      printf("occlusion counts differ: %u vs %u\n",
+             (unsigned) serial.occlusion, (unsigned) threaded.occlusion);
+      pass = FALSE;
+   }
+
+   if (serial.occlusion == 0) {
+      printf("nothing was drawn\n");
+      pass = FALSE;
+   }
+
+   FREE(serial.color);
+   FREE(serial.depth);
+   FREE(threaded.color);
+   FREE(threaded.depth);
+   FREE(texels);
+   FREE(verts);
+
+   screen->destroy(screen);
+
+   printf("%s\n", pass ? "pass" : "FAIL");
+
+   return pass ? 0 : 1;
+}
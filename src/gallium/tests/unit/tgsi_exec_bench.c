@@ -0,0 +1,288 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Compares the quad and the wide execution modes of tgsi_exec: both must
+ * produce bit-identical outputs.  Also reports the time each takes.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os/os_time.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_scan.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+#define NUM_VERTICES 1000
+#define NUM_CONSTS 16
+
+
+static const char *shaders[] = {
+   /* transform and lighting */
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL IN[2]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], COLOR\n"
+   "DCL OUT[2], GENERIC[0]\n"
+   "DCL CONST[0..15]\n"
+   "DCL TEMP[0..3]\n"
+   "IMM[0] FLT32 { 0.0, 1.0, 0.5, 16.0 }\n"
+   "  0: DP4 OUT[0].x, IN[0], CONST[0]\n"
+   "  1: DP4 OUT[0].y, IN[0], CONST[1]\n"
+   "  2: DP4 OUT[0].z, IN[0], CONST[2]\n"
+   "  3: DP4 OUT[0].w, IN[0], CONST[3]\n"
+   "  4: DP3 TEMP[0].x, IN[1], IN[1]\n"
+   "  5: RSQ TEMP[0].x, |TEMP[0].xxxx|\n"
+   "  6: MUL TEMP[0].xyz, IN[1], TEMP[0].xxxx\n"
+   "  7: DP3 TEMP[1].x, TEMP[0], CONST[4]\n"
+   "  8: DP3 TEMP[1].y, TEMP[0], CONST[5]\n"
+   "  9: MOV TEMP[1].w, IMM[0].wwww\n"
+   " 10: LIT TEMP[2], TEMP[1]\n"
+   " 11: MAD TEMP[3], CONST[6], TEMP[2].yyyy, CONST[7]\n"
+   " 12: MAD_SAT OUT[1], CONST[8], TEMP[2].zzzz, TEMP[3]\n"
+   " 13: XPD TEMP[0].xyz, TEMP[0], CONST[9]\n"
+   " 14: DPH TEMP[0].w, IN[2], CONST[10]\n"
+   " 15: LRP OUT[2], IMM[0].zzzz, TEMP[0], -IN[2]\n"
+   " 16: END\n",
+
+   /* conditionals, integer ops and indirect constants */
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL IN[1]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL OUT[1], GENERIC[0]\n"
+   "DCL OUT[2], GENERIC[1]\n"
+   "DCL CONST[0..15]\n"
+   "DCL TEMP[0..2]\n"
+   "DCL ADDR[0]\n"
+   "IMM[0] FLT32 { 0.0, 1.0, 4.0, -1.0 }\n"
+   "IMM[1] INT32 { 0, 1, 3, 7 }\n"
+   "  0: MUL TEMP[0], IN[1], IMM[0].zzzz\n"
+   "  1: ARL ADDR[0].x, TEMP[0].xxxx\n"
+   "  2: MOV TEMP[1], CONST[ADDR[0].x+2]\n"
+   "  3: SLT TEMP[2].x, IN[0].xxxx, IMM[0].xxxx\n"
+   "  4: IF TEMP[2].xxxx\n"
+   "  5:   ADD TEMP[1], TEMP[1], -IN[0]\n"
+   "  6:   FLR TEMP[1].zw, TEMP[1]\n"
+   "  7: ELSE\n"
+   "  8:   F2I TEMP[2], TEMP[0]\n"
+   "  9:   AND TEMP[2].xy, TEMP[2], IMM[1].zwzw\n"
+   " 10:   UIF TEMP[2].yyyy\n"
+   " 11:     I2F TEMP[1].xy, TEMP[2]\n"
+   " 12:   ENDIF\n"
+   " 13: ENDIF\n"
+   " 14: MOV OUT[0], TEMP[1]\n"
+   " 15: EX2 TEMP[0].x, IN[0].yyyy\n"
+   " 16: LG2 TEMP[0].y, |IN[0].zzzz|\n"
+   " 17: EXP TEMP[2], IN[0].wwww\n"
+   " 18: MAX OUT[1], TEMP[0], TEMP[2]\n"
+   " 19: CMP OUT[2], IN[0], TEMP[0], CONST[ADDR[0].x+3]\n"
+   " 20: END\n",
+};
+
+/* Loops are not supported by the wide mode. */
+static const char *quad_only_shader =
+   "VERT\n"
+   "DCL IN[0]\n"
+   "DCL OUT[0], POSITION\n"
+   "DCL TEMP[0]\n"
+   "IMM[0] FLT32 { 0.0, 1.0, 4.0, -1.0 }\n"
+   "  0: MOV TEMP[0], IN[0]\n"
+   "  1: BGNLOOP\n"
+   "  2:   ADD TEMP[0], TEMP[0], IMM[0].yyyy\n"
+   "  3:   BRK\n"
+   "  4: ENDLOOP\n"
+   "  5: MOV OUT[0], TEMP[0]\n"
+   "  6: END\n";
+
+
+static float
+random_float(void)
+{
+   return (float) rand() / RAND_MAX * 4.0f - 2.0f;
+}
+
+
+/**
+ * Run the shader in \p mach on all vertices, \p lanes at a time.
+ * \return the time taken, in microseconds
+ */
+static int64_t
+run(struct tgsi_exec_machine *mach, const struct tgsi_shader_info *info,
+    unsigned lanes, const float (*inputs)[PIPE_MAX_SHADER_INPUTS][4],
+    float (*outputs)[PIPE_MAX_SHADER_OUTPUTS][4])
+{
+   int64_t start = os_time_get();
+   unsigned v, i, slot, chan;
+
+   for (v = 0; v < NUM_VERTICES; v += lanes) {
+      unsigned count = MIN2(lanes, NUM_VERTICES - v);
+
+      for (i = 0; i < count; i++) {
+         for (slot = 0; slot < info->num_inputs; slot++) {
+            for (chan = 0; chan < 4; chan++) {
+               if (lanes > TGSI_QUAD_SIZE)
+                  mach->WideInputs[slot].xyzw[chan].f[i] =
+                     inputs[v + i][slot][chan];
+               else
+                  mach->Inputs[slot].xyzw[chan].f[i] =
+                     inputs[v + i][slot][chan];
+            }
+         }
+      }
+
+      if (lanes > TGSI_QUAD_SIZE)
+         tgsi_exec_machine_run_wide(mach, count);
+      else
+         tgsi_exec_machine_run(mach);
+
+      for (i = 0; i < count; i++) {
+         for (slot = 0; slot < info->num_outputs; slot++) {
+            for (chan = 0; chan < 4; chan++) {
+               if (lanes > TGSI_QUAD_SIZE)
+                  outputs[v + i][slot][chan] =
+                     mach->WideOutputs[slot].xyzw[chan].f[i];
+               else
+                  outputs[v + i][slot][chan] =
+                     mach->Outputs[slot].xyzw[chan].f[i];
+            }
+         }
+      }
+   }
+
+   return os_time_get() - start;
+}
+
+
+static boolean
+test_shader(const char *text, boolean expect_wide)
+{
+   static float consts[NUM_CONSTS][4];
+   static float inputs[NUM_VERTICES][PIPE_MAX_SHADER_INPUTS][4];
+   static float quad_outputs[NUM_VERTICES][PIPE_MAX_SHADER_OUTPUTS][4];
+   static float wide_outputs[NUM_VERTICES][PIPE_MAX_SHADER_OUTPUTS][4];
+   const void *bufs[1] = { consts };
+   const unsigned buf_sizes[1] = { sizeof(consts) / sizeof(float) };
+   struct tgsi_token tokens[1024];
+   struct tgsi_shader_info info;
+   struct tgsi_exec_machine *quad, *wide;
+   int64_t quad_time = 0, wide_time = 0;
+   boolean pass = TRUE;
+   unsigned i, j, iter;
+
+   if (!tgsi_text_translate(text, tokens, Elements(tokens))) {
+      printf("failed to translate shader\n");
+      return FALSE;
+   }
+   tgsi_scan_shader(tokens, &info);
+
+   for (i = 0; i < NUM_CONSTS; i++)
+      for (j = 0; j < 4; j++)
+         consts[i][j] = random_float();
+   for (i = 0; i < NUM_VERTICES; i++)
+      for (j = 0; j < info.num_inputs; j++) {
+         inputs[i][j][0] = random_float();
+         inputs[i][j][1] = random_float();
+         inputs[i][j][2] = random_float();
+         inputs[i][j][3] = random_float();
+      }
+
+   quad = tgsi_exec_machine_create();
+   wide = tgsi_exec_machine_create();
+   if (!quad || !wide ||
+       !tgsi_exec_machine_set_lanes(wide, TGSI_EXEC_MAX_LANES)) {
+      printf("out of memory\n");
+      tgsi_exec_machine_destroy(quad);
+      tgsi_exec_machine_destroy(wide);
+      return FALSE;
+   }
+
+   tgsi_exec_machine_bind_shader(quad, tokens, NULL);
+   tgsi_exec_machine_bind_shader(wide, tokens, NULL);
+   tgsi_exec_set_constant_buffers(quad, 1, bufs, buf_sizes);
+   tgsi_exec_set_constant_buffers(wide, 1, bufs, buf_sizes);
+
+   if (tgsi_exec_machine_is_wide(wide) != expect_wide) {
+      printf("wide mode unexpectedly %s\n",
+             expect_wide ? "unavailable" : "available");
+      pass = FALSE;
+   }
+
+   if (tgsi_exec_machine_is_wide(wide)) {
+      for (iter = 0; iter < 100; iter++) {
+         quad_time += run(quad, &info, TGSI_QUAD_SIZE,
+                          (const float (*)[PIPE_MAX_SHADER_INPUTS][4]) inputs,
+                          quad_outputs);
+         wide_time += run(wide, &info, TGSI_EXEC_MAX_LANES,
+                          (const float (*)[PIPE_MAX_SHADER_INPUTS][4]) inputs,
+                          wide_outputs);
+      }
+
+      for (i = 0; i < NUM_VERTICES; i++) {
+         if (memcmp(quad_outputs[i], wide_outputs[i],
+                    info.num_outputs * sizeof(quad_outputs[i][0]))) {
+            printf("vertex %u: outputs differ\n", i);
+            pass = FALSE;
+            break;
+         }
+      }
+
+      printf("%u instructions: quad %.1f us, %u-wide %.1f us per %u vertices\n",
+             info.num_instructions, quad_time / 100.0, TGSI_EXEC_MAX_LANES,
+             wide_time / 100.0, NUM_VERTICES);
+   }
+
+   tgsi_exec_machine_destroy(quad);
+   tgsi_exec_machine_destroy(wide);
+
+   return pass;
+}
+
+
+int main(int argc, char **argv)
+{
+   boolean pass = TRUE;
+   unsigned i;
+
+   for (i = 0; i < Elements(shaders); i++)
+      pass = test_shader(shaders[i], TRUE) && pass;
+
+   pass = test_shader(quad_only_shader, FALSE) && pass;
+
+   printf("%s\n", pass ? "pass" : "FAIL");
+
+   return pass ? 0 : 1;
+}
@@ -570,14 +570,14 @@ match_subroutine_by_name(const char *name,
                          struct _mesa_glsl_parse_state *state,
                          ir_variable **var_r)
 {
-   void *ctx = state;
+   void *ctx = state->linalloc;
    ir_function_signature *sig = NULL;
    ir_function *f, *found = NULL;
    const char *new_name;
    ir_variable *var;
    bool is_exact = false;
 
-   new_name = ralloc_asprintf(ctx, "%s_%s", _mesa_shader_stage_to_subroutine_prefix(state->stage), name);
+   new_name = linear_asprintf(ctx, "%s_%s", _mesa_shader_stage_to_subroutine_prefix(state->stage), name);
    var = state->symbols->get_variable(new_name);
    if (!var)
       return NULL;
@@ -4227,7 +4227,7 @@ ast_declarator_list::hir(exec_list *instructions,
             _mesa_glsl_error(& loc, state,
                              "invalid type in declaration of `%s'",
                              decl->identifier);
-         name = ralloc_asprintf(ctx, "%s_%s", _mesa_shader_stage_to_subroutine_prefix(state->stage), decl->identifier);
+         name = linear_asprintf(state->linalloc, "%s_%s", _mesa_shader_stage_to_subroutine_prefix(state->stage), decl->identifier);
 
          identifier = name;
 
@@ -6197,8 +6197,10 @@ ast_process_struct_or_iface_block_members(exec_list *instructions,
     * the types to HIR.  This ensures that structure definitions embedded in
     * other structure definitions or in interface blocks are processed.
     */
-   glsl_struct_field *const fields = ralloc_array(state, glsl_struct_field,
-                                                  decl_count);
+   glsl_struct_field *const fields =
+      (glsl_struct_field *) linear_alloc_child_array(state->linalloc,
+                                                     sizeof(glsl_struct_field),
+                                                     decl_count);
 
    unsigned i = 0;
    foreach_list_typed (ast_declarator_list, decl_list, link, declarations) {
@@ -6982,7 +6984,7 @@ ast_interface_block::hir(exec_list *instructions,
       for (unsigned i = 0; i < num_variables; i++) {
          ir_variable *var =
             new(state) ir_variable(fields[i].type,
-                                   ralloc_strdup(state, fields[i].name),
+                                   linear_strdup(state->linalloc, fields[i].name),
                                    var_mode);
          var->data.interpolation = fields[i].interpolation;
          var->data.centroid = fields[i].centroid;
@@ -34,7 +34,7 @@
 #include "glsl_parser_extras.h"
 #include "glsl_parser.h"
 #include "ir_optimization.h"
-#include "loop_analysis.h"
+#include "ir_pass_scheduler.h"
 
 /**
  * Format a short human-readable description of the given GLSL version.
@@ -62,6 +62,7 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
 
    this->scanner = NULL;
    this->translation_unit.make_empty();
+   this->linalloc = linear_alloc_parent(this, 0);
    this->symbols = new(mem_ctx) glsl_symbol_table;
 
    this->info_log = ralloc_strdup(mem_ctx, "");
@@ -241,12 +242,12 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
    if (ctx->Const.ForceGLSLExtensionsWarn)
       _mesa_glsl_process_extension("all", NULL, "warn", NULL, this);
 
-   this->default_uniform_qualifier = new(this) ast_type_qualifier();
+   this->default_uniform_qualifier = new(this->linalloc) ast_type_qualifier();
    this->default_uniform_qualifier->flags.q.shared = 1;
    this->default_uniform_qualifier->flags.q.column_major = 1;
    this->default_uniform_qualifier->is_default_qualifier = true;
 
-   this->default_shader_storage_qualifier = new(this) ast_type_qualifier();
+   this->default_shader_storage_qualifier = new(this->linalloc) ast_type_qualifier();
    this->default_shader_storage_qualifier->flags.q.shared = 1;
    this->default_shader_storage_qualifier->flags.q.column_major = 1;
    this->default_shader_storage_qualifier->is_default_qualifier = true;
@@ -260,8 +261,8 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
    this->gs_input_prim_type_specified = false;
    this->tcs_output_vertices_specified = false;
    this->gs_input_size = 0;
-   this->in_qualifier = new(this) ast_type_qualifier();
-   this->out_qualifier = new(this) ast_type_qualifier();
+   this->in_qualifier = new(this->linalloc) ast_type_qualifier();
+   this->out_qualifier = new(this->linalloc) ast_type_qualifier();
    this->fs_early_fragment_tests = false;
    memset(this->atomic_counter_offsets, 0,
           sizeof(this->atomic_counter_offsets));
@@ -1801,9 +1802,16 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       /* Do some optimization at compile time to reduce shader IR size
        * and reduce later work if the same shader is linked multiple times
        */
-      while (do_common_optimization(shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
+      ir_pass_scheduler passes(false, false, options,
+                               ctx->Const.NativeIntegers);
+      if (ctx->Shader.Flags & GLSL_PASS_STATS) {
+         char *name = ralloc_asprintf(NULL, "%s shader %u",
+                                      _mesa_shader_stage_to_string(shader->Stage),
+                                      shader->Name);
+         passes.enable_stats(name);
+         ralloc_free(name);
+      }
+      passes.run(shader->ir);
 
       validate_ir_tree(shader->ir);
 
@@ -1895,6 +1903,10 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
  *                                    unrolled.  Setting to 0 disables loop
  *                                    unrolling.
  * \param options                     The driver's preferred shader options.
+ *
+ * To repeat the optimizations until they stop making progress, use
+ * \c ir_pass_scheduler::run, which skips the passes that would find nothing
+ * to do.
  */
 bool
 do_common_optimization(exec_list *ir, bool linked,
@@ -1902,60 +1914,10 @@ do_common_optimization(exec_list *ir, bool linked,
                        const struct gl_shader_compiler_options *options,
                        bool native_integers)
 {
-   GLboolean progress = GL_FALSE;
-
-   progress = lower_instructions(ir, SUB_TO_ADD_NEG) || progress;
-
-   if (linked) {
-      progress = do_function_inlining(ir) || progress;
-      progress = do_dead_functions(ir) || progress;
-      progress = do_structure_splitting(ir) || progress;
-   }
-   progress = do_if_simplification(ir) || progress;
-   progress = opt_flatten_nested_if_blocks(ir) || progress;
-   progress = opt_conditional_discard(ir) || progress;
-   progress = do_copy_propagation(ir) || progress;
-   progress = do_copy_propagation_elements(ir) || progress;
-
-   if (options->OptimizeForAOS && !linked)
-      progress = opt_flip_matrices(ir) || progress;
-
-   if (linked && options->OptimizeForAOS) {
-      progress = do_vectorize(ir) || progress;
-   }
-
-   if (linked)
-      progress = do_dead_code(ir, uniform_locations_assigned) || progress;
-   else
-      progress = do_dead_code_unlinked(ir) || progress;
-   progress = do_dead_code_local(ir) || progress;
-   progress = do_tree_grafting(ir) || progress;
-   progress = do_constant_propagation(ir) || progress;
-   if (linked)
-      progress = do_constant_variable(ir) || progress;
-   else
-      progress = do_constant_variable_unlinked(ir) || progress;
-   progress = do_constant_folding(ir) || progress;
-   progress = do_minmax_prune(ir) || progress;
-   progress = do_rebalance_tree(ir) || progress;
-   progress = do_algebraic(ir, native_integers, options) || progress;
-   progress = do_lower_jumps(ir) || progress;
-   progress = do_vec_index_to_swizzle(ir) || progress;
-   progress = lower_vector_insert(ir, false) || progress;
-   progress = do_swizzle_swizzle(ir) || progress;
-   progress = do_noop_swizzle(ir) || progress;
-
-   progress = optimize_split_arrays(ir, linked) || progress;
-   progress = optimize_redundant_jumps(ir) || progress;
-
-   loop_state *ls = analyze_loop_variables(ir);
-   if (ls->loop_found) {
-      progress = set_loop_controls(ir, ls) || progress;
-      progress = unroll_loops(ir, ls, options) || progress;
-   }
-   delete ls;
+   ir_pass_scheduler passes(linked, uniform_locations_assigned, options,
+                            native_integers);
 
-   return progress;
+   return passes.run_once(ir);
 }
 
 extern "C" {
@@ -271,6 +271,12 @@ struct _mesa_glsl_parse_state {
    struct gl_context *const ctx;
    void *scanner;
    exec_list translation_unit;
+
+   /**
+    * Linear allocator for the AST and the other data which only lives as
+    * long as the parser state.
+    */
+   void *linalloc;
    glsl_symbol_table *symbols;
 
    unsigned num_supported_versions;
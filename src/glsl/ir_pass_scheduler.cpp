@@ -0,0 +1,458 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_pass_scheduler.cpp
+ */
+
+#include "main/core.h" /* for struct gl_shader_compiler_options */
+#include "util/hash_table.h"
+#include "util/ralloc.h"
+#include "ir.h"
+#include "ir_optimization.h"
+#include "ir_pass_scheduler.h"
+#include "loop_analysis.h"
+
+namespace {
+
+enum pass_id {
+   PASS_LOWER_SUB,
+   PASS_FUNCTION_INLINING,
+   PASS_DEAD_FUNCTIONS,
+   PASS_STRUCTURE_SPLITTING,
+   PASS_IF_SIMPLIFICATION,
+   PASS_FLATTEN_NESTED_IF_BLOCKS,
+   PASS_CONDITIONAL_DISCARD,
+   PASS_COPY_PROPAGATION,
+   PASS_COPY_PROPAGATION_ELEMENTS,
+   PASS_FLIP_MATRICES,
+   PASS_VECTORIZE,
+   PASS_DEAD_CODE,
+   PASS_DEAD_CODE_UNLINKED,
+   PASS_DEAD_CODE_LOCAL,
+   PASS_TREE_GRAFTING,
+   PASS_CONSTANT_PROPAGATION,
+   PASS_CONSTANT_VARIABLE,
+   PASS_CONSTANT_VARIABLE_UNLINKED,
+   PASS_CONSTANT_FOLDING,
+   PASS_MINMAX_PRUNE,
+   PASS_REBALANCE_TREE,
+   PASS_ALGEBRAIC,
+   PASS_LOWER_JUMPS,
+   PASS_VEC_INDEX_TO_SWIZZLE,
+   PASS_LOWER_VECTOR_INSERT,
+   PASS_SWIZZLE_SWIZZLE,
+   PASS_NOOP_SWIZZLE,
+   PASS_SPLIT_ARRAYS,
+   PASS_REDUNDANT_JUMPS,
+   PASS_LOOPS,
+   PASS_COUNT
+};
+
+const struct {
+   const char *name;
+
+   /**
+    * Whether the pass only reads and writes the function it is optimizing,
+    * so that it can be run on one \c ir_function at a time.  Passes which
+    * look at global variable declarations or at other functions are run on
+    * the whole shader.
+    */
+   bool per_function;
+} pass_info[PASS_COUNT] = {
+   { "lower_instructions(SUB_TO_ADD_NEG)", true },
+   { "do_function_inlining",               false },
+   { "do_dead_functions",                  false },
+   { "do_structure_splitting",             false },
+   { "do_if_simplification",               true },
+   { "opt_flatten_nested_if_blocks",       true },
+   { "opt_conditional_discard",            true },
+   { "do_copy_propagation",                true },
+   { "do_copy_propagation_elements",       true },
+   { "opt_flip_matrices",                  false },
+   { "do_vectorize",                       true },
+   { "do_dead_code",                       false },
+   { "do_dead_code_unlinked",              false },
+   { "do_dead_code_local",                 true },
+   { "do_tree_grafting",                   false },
+   { "do_constant_propagation",            true },
+   { "do_constant_variable",               false },
+   { "do_constant_variable_unlinked",      false },
+   { "do_constant_folding",                true },
+   { "do_minmax_prune",                    true },
+   { "do_rebalance_tree",                  true },
+   { "do_algebraic",                       true },
+   { "do_lower_jumps",                     true },
+   { "do_vec_index_to_swizzle",            true },
+   { "lower_vector_insert",                true },
+   { "do_swizzle_swizzle",                 true },
+   { "do_noop_swizzle",                    true },
+   { "optimize_split_arrays",              false },
+   { "optimize_redundant_jumps",           true },
+   { "loop optimizations",                 true },
+};
+
+/**
+ * Whether \p ir is made only of functions and variable declarations, so
+ * that the per-function passes can be run one function at a time.  Before
+ * linking, global initializers may still be outside of any function.
+ */
+bool
+only_functions_and_variables(exec_list *ir)
+{
+   foreach_in_list(ir_instruction, node, ir) {
+      if (node->ir_type != ir_type_function &&
+          node->ir_type != ir_type_variable)
+         return false;
+   }
+
+   return true;
+}
+
+} /* anonymous namespace */
+
+struct ir_pass_scheduler::function_state {
+   /** Stamp of the last change to the function */
+   unsigned changed;
+
+   /** Stamp of the last unproductive run of each pass over the function */
+   unsigned clean[MAX_PASSES];
+};
+
+ir_pass_scheduler::ir_pass_scheduler(bool linked,
+                                     bool uniform_locations_assigned,
+                                     const struct gl_shader_compiler_options *options,
+                                     bool native_integers)
+   : num_passes(0), options(options), linked(linked),
+     uniform_locations_assigned(uniform_locations_assigned),
+     native_integers(native_integers), stamp(1), all_changed(1),
+     stats_name(NULL), iterations(0)
+{
+   STATIC_ASSERT((unsigned) PASS_COUNT <= (unsigned) MAX_PASSES);
+
+   mem_ctx = ralloc_context(NULL);
+   functions = _mesa_hash_table_create(mem_ctx, _mesa_hash_pointer,
+                                       _mesa_key_pointer_equal);
+
+   memset(clean, 0, sizeof(clean));
+   memset(runs, 0, sizeof(runs));
+   memset(skipped, 0, sizeof(skipped));
+   memset(progress, 0, sizeof(progress));
+   memset(time, 0, sizeof(time));
+
+   /* Keep this in the order of do_common_optimization. */
+   add_pass(PASS_LOWER_SUB);
+
+   if (linked) {
+      add_pass(PASS_FUNCTION_INLINING);
+      add_pass(PASS_DEAD_FUNCTIONS);
+      add_pass(PASS_STRUCTURE_SPLITTING);
+   }
+   add_pass(PASS_IF_SIMPLIFICATION);
+   add_pass(PASS_FLATTEN_NESTED_IF_BLOCKS);
+   add_pass(PASS_CONDITIONAL_DISCARD);
+   add_pass(PASS_COPY_PROPAGATION);
+   add_pass(PASS_COPY_PROPAGATION_ELEMENTS);
+
+   if (options->OptimizeForAOS && !linked)
+      add_pass(PASS_FLIP_MATRICES);
+
+   if (linked && options->OptimizeForAOS)
+      add_pass(PASS_VECTORIZE);
+
+   if (linked)
+      add_pass(PASS_DEAD_CODE);
+   else
+      add_pass(PASS_DEAD_CODE_UNLINKED);
+   add_pass(PASS_DEAD_CODE_LOCAL);
+   add_pass(PASS_TREE_GRAFTING);
+   add_pass(PASS_CONSTANT_PROPAGATION);
+   if (linked)
+      add_pass(PASS_CONSTANT_VARIABLE);
+   else
+      add_pass(PASS_CONSTANT_VARIABLE_UNLINKED);
+   add_pass(PASS_CONSTANT_FOLDING);
+   add_pass(PASS_MINMAX_PRUNE);
+   add_pass(PASS_REBALANCE_TREE);
+   add_pass(PASS_ALGEBRAIC);
+   add_pass(PASS_LOWER_JUMPS);
+   add_pass(PASS_VEC_INDEX_TO_SWIZZLE);
+   add_pass(PASS_LOWER_VECTOR_INSERT);
+   add_pass(PASS_SWIZZLE_SWIZZLE);
+   add_pass(PASS_NOOP_SWIZZLE);
+
+   add_pass(PASS_SPLIT_ARRAYS);
+   add_pass(PASS_REDUNDANT_JUMPS);
+
+   add_pass(PASS_LOOPS);
+}
+
+ir_pass_scheduler::~ir_pass_scheduler()
+{
+   if (stats_name)
+      print_stats(stderr);
+
+   ralloc_free(mem_ctx);
+}
+
+void
+ir_pass_scheduler::add_pass(unsigned pass)
+{
+   assert(num_passes < MAX_PASSES);
+   passes[num_passes++] = pass;
+}
+
+void
+ir_pass_scheduler::enable_stats(const char *name)
+{
+   stats_name = ralloc_strdup(mem_ctx, name);
+}
+
+void
+ir_pass_scheduler::invalidate()
+{
+   all_changed = ++stamp;
+}
+
+bool
+ir_pass_scheduler::call_pass(unsigned pass, exec_list *ir)
+{
+   switch (pass) {
+   case PASS_LOWER_SUB:
+      return lower_instructions(ir, SUB_TO_ADD_NEG);
+   case PASS_FUNCTION_INLINING:
+      return do_function_inlining(ir);
+   case PASS_DEAD_FUNCTIONS:
+      return do_dead_functions(ir);
+   case PASS_STRUCTURE_SPLITTING:
+      return do_structure_splitting(ir);
+   case PASS_IF_SIMPLIFICATION:
+      return do_if_simplification(ir);
+   case PASS_FLATTEN_NESTED_IF_BLOCKS:
+      return opt_flatten_nested_if_blocks(ir);
+   case PASS_CONDITIONAL_DISCARD:
+      return opt_conditional_discard(ir);
+   case PASS_COPY_PROPAGATION:
+      return do_copy_propagation(ir);
+   case PASS_COPY_PROPAGATION_ELEMENTS:
+      return do_copy_propagation_elements(ir);
+   case PASS_FLIP_MATRICES:
+      return opt_flip_matrices(ir);
+   case PASS_VECTORIZE:
+      return do_vectorize(ir);
+   case PASS_DEAD_CODE:
+      return do_dead_code(ir, uniform_locations_assigned);
+   case PASS_DEAD_CODE_UNLINKED:
+      return do_dead_code_unlinked(ir);
+   case PASS_DEAD_CODE_LOCAL:
+      return do_dead_code_local(ir);
+   case PASS_TREE_GRAFTING:
+      return do_tree_grafting(ir);
+   case PASS_CONSTANT_PROPAGATION:
+      return do_constant_propagation(ir);
+   case PASS_CONSTANT_VARIABLE:
+      return do_constant_variable(ir);
+   case PASS_CONSTANT_VARIABLE_UNLINKED:
+      return do_constant_variable_unlinked(ir);
+   case PASS_CONSTANT_FOLDING:
+      return do_constant_folding(ir);
+   case PASS_MINMAX_PRUNE:
+      return do_minmax_prune(ir);
+   case PASS_REBALANCE_TREE:
+      return do_rebalance_tree(ir);
+   case PASS_ALGEBRAIC:
+      return do_algebraic(ir, native_integers, options);
+   case PASS_LOWER_JUMPS:
+      return do_lower_jumps(ir);
+   case PASS_VEC_INDEX_TO_SWIZZLE:
+      return do_vec_index_to_swizzle(ir);
+   case PASS_LOWER_VECTOR_INSERT:
+      return lower_vector_insert(ir, false);
+   case PASS_SWIZZLE_SWIZZLE:
+      return do_swizzle_swizzle(ir);
+   case PASS_NOOP_SWIZZLE:
+      return do_noop_swizzle(ir);
+   case PASS_SPLIT_ARRAYS:
+      return optimize_split_arrays(ir, linked);
+   case PASS_REDUNDANT_JUMPS:
+      return optimize_redundant_jumps(ir);
+   case PASS_LOOPS: {
+      bool progress = false;
+      loop_state *ls = analyze_loop_variables(ir);
+      if (ls->loop_found) {
+         progress = set_loop_controls(ir, ls) || progress;
+         progress = unroll_loops(ir, ls, options) || progress;
+      }
+      delete ls;
+      return progress;
+   }
+   default:
+      unreachable("invalid pass");
+   }
+}
+
+ir_pass_scheduler::function_state *
+ir_pass_scheduler::get_function_state(ir_function *f)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(functions, f);
+   if (entry)
+      return (function_state *) entry->data;
+
+   /* A function we haven't seen yet was created or moved into the shader
+    * by a whole-shader pass, which set all_changed, so it doesn't matter
+    * that its clean stamps start at zero.
+    */
+   function_state *fs = rzalloc(mem_ctx, function_state);
+   _mesa_hash_table_insert(functions, f, fs);
+   return fs;
+}
+
+bool
+ir_pass_scheduler::run_pass(unsigned index, exec_list *ir)
+{
+   const unsigned pass = passes[index];
+   bool pass_progress = false;
+   clock_t start = 0;
+
+   if (stats_name)
+      start = clock();
+
+   if (pass_info[pass].per_function && only_functions_and_variables(ir)) {
+      foreach_in_list_safe(ir_instruction, node, ir) {
+         ir_function *f = node->as_function();
+         if (!f)
+            continue;
+
+         function_state *fs = get_function_state(f);
+         if (fs->clean[index] >= MAX2(fs->changed, all_changed)) {
+            skipped[index]++;
+            continue;
+         }
+
+         /* Run the pass on a list holding only this function, then put the
+          * function back where it was.
+          */
+         exec_node *prev = f->prev;
+         exec_list single;
+         f->remove();
+         single.push_tail(f);
+
+         runs[index]++;
+         const bool fn_progress = call_pass(pass, &single);
+
+         assert(single.get_head() == f && f->next->is_tail_sentinel());
+         f->remove();
+         prev->insert_after(f);
+
+         if (fn_progress) {
+            fs->changed = ++stamp;
+            progress[index]++;
+            pass_progress = true;
+         } else {
+            fs->clean[index] = stamp;
+         }
+      }
+   } else if (clean[index] == stamp) {
+      skipped[index]++;
+   } else {
+      runs[index]++;
+      if (call_pass(pass, ir)) {
+         all_changed = ++stamp;
+         progress[index]++;
+         pass_progress = true;
+      } else {
+         clean[index] = stamp;
+      }
+   }
+
+   if (stats_name)
+      time[index] += clock() - start;
+
+   return pass_progress;
+}
+
+bool
+ir_pass_scheduler::run_round(exec_list *ir, bool *any_skipped)
+{
+   bool progress = false;
+   unsigned skipped_before = 0, skipped_after = 0;
+
+   for (unsigned i = 0; i < num_passes; i++)
+      skipped_before += skipped[i];
+
+   iterations++;
+   for (unsigned i = 0; i < num_passes; i++)
+      progress = run_pass(i, ir) || progress;
+
+   for (unsigned i = 0; i < num_passes; i++)
+      skipped_after += skipped[i];
+
+   *any_skipped = skipped_after != skipped_before;
+   return progress;
+}
+
+bool
+ir_pass_scheduler::run_once(exec_list *ir)
+{
+   bool any_skipped;
+
+   if (run_round(ir, &any_skipped))
+      return true;
+
+   /* Skipping relies on every pass reporting the changes it makes.  One
+    * that doesn't leaves the others skipped where they would have found
+    * work, so before reporting that nothing more can be done, run all of the
+    * passes once more without skipping any.
+    */
+   if (!any_skipped)
+      return false;
+
+   invalidate();
+   return run_round(ir, &any_skipped);
+}
+
+bool
+ir_pass_scheduler::run(exec_list *ir)
+{
+   bool progress = false;
+
+   while (run_once(ir))
+      progress = true;
+
+   return progress;
+}
+
+void
+ir_pass_scheduler::print_stats(FILE *f) const
+{
+   fprintf(f, "GLSL IR optimization passes for %s: %u iterations\n",
+           stats_name, iterations);
+   fprintf(f, "   %-36s %8s %8s %8s %10s\n",
+           "pass", "runs", "skipped", "progress", "time (ms)");
+
+   for (unsigned i = 0; i < num_passes; i++) {
+      fprintf(f, "   %-36s %8u %8u %8u %10.3f\n",
+              pass_info[passes[i]].name, runs[i], skipped[i], progress[i],
+              (double) time[i] * 1000.0 / CLOCKS_PER_SEC);
+   }
+}
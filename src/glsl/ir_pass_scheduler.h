@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef IR_PASS_SCHEDULER_H
+#define IR_PASS_SCHEDULER_H
+
+/**
+ * \file ir_pass_scheduler.h
+ *
+ * Runs the passes of \c do_common_optimization while remembering which
+ * passes found nothing to do in which functions, so that repeating them
+ * until they stop making progress doesn't re-run every pass over the whole
+ * shader for each small change.
+ *
+ * Most passes only look at the function they are optimizing.  Those are run
+ * one \c ir_function at a time, and skipped for functions which haven't
+ * changed since the pass last made no progress on them.  The passes which
+ * look across functions (inlining, dead code and the like) are skipped if
+ * nothing at all changed since they last made no progress.  Passes are
+ * deterministic, so a skipped pass is one which would have returned false
+ * without touching the IR: the result is the same as running all of them.
+ *
+ * That only holds if the passes report every change they make, so when a
+ * round that skipped some passes makes no progress, the passes are all run
+ * once more before the scheduler reports that they are done.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+struct exec_list;
+struct gl_shader_compiler_options;
+struct hash_table;
+class ir_function;
+
+class ir_pass_scheduler {
+public:
+   /**
+    * \sa do_common_optimization for the parameters.
+    */
+   ir_pass_scheduler(bool linked, bool uniform_locations_assigned,
+                     const struct gl_shader_compiler_options *options,
+                     bool native_integers);
+   ~ir_pass_scheduler();
+
+   /**
+    * Run the passes once, in the order of \c do_common_optimization.  If
+    * none of them made progress but some were skipped, run them all again.
+    *
+    * \return true if any of them made progress.
+    */
+   bool run_once(exec_list *ir);
+
+   /**
+    * Run the passes until they stop making progress.
+    *
+    * \return true if any of them made progress.
+    */
+   bool run(exec_list *ir);
+
+   /**
+    * Tell the scheduler that something besides its passes changed the IR,
+    * so that they are all run again.
+    */
+   void invalidate();
+
+   /**
+    * Time the passes, and when the scheduler is destroyed print to stderr
+    * the number of iterations and, per pass, how many times it ran and made
+    * progress, how many runs were skipped and the time spent.
+    */
+   void enable_stats(const char *name);
+
+   enum {
+      MAX_PASSES = 32
+   };
+
+private:
+   struct function_state;
+
+   void add_pass(unsigned pass);
+   bool call_pass(unsigned pass, exec_list *ir);
+   bool run_pass(unsigned index, exec_list *ir);
+   bool run_round(exec_list *ir, bool *any_skipped);
+   function_state *get_function_state(ir_function *f);
+   void print_stats(FILE *f) const;
+
+   void *mem_ctx;
+
+   /** The passes enabled for the shader, in order */
+   unsigned passes[MAX_PASSES];
+   unsigned num_passes;
+
+   const struct gl_shader_compiler_options *options;
+   bool linked;
+   bool uniform_locations_assigned;
+   bool native_integers;
+
+   /**
+    * Incremented whenever a pass makes progress.  A pass whose last
+    * unproductive run was at the current stamp can be skipped.
+    */
+   unsigned stamp;
+
+   /** Stamp of the last change that may have touched any function */
+   unsigned all_changed;
+
+   /** Stamp of the last unproductive run of each pass over the whole IR */
+   unsigned clean[MAX_PASSES];
+
+   /** ir_function -> function_state */
+   struct hash_table *functions;
+
+   /** Statistics, see enable_stats() */
+   const char *stats_name;
+   unsigned iterations;
+   unsigned runs[MAX_PASSES];
+   unsigned skipped[MAX_PASSES];
+   unsigned progress[MAX_PASSES];
+   clock_t time[MAX_PASSES];
+};
+
+#endif /* IR_PASS_SCHEDULER_H */
@@ -0,0 +1,1323 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.cpp
+ *
+ * Every node is written as its \c ir_node_type followed by its fields, in the
+ * order \c ir_clone.cpp visits them.  Objects that can be shared -- types,
+ * variables, functions and signatures -- are written as references: a
+ * 1-based id, which is followed by the object itself the first time the id
+ * is used.  Ids are handed out in the order objects are first written, so
+ * the reader can allocate them in the same order without storing them.  Id
+ * zero is \c NULL.
+ */
+
+#include <string.h>
+#include "ir.h"
+#include "ir_serialize.h"
+#include "blob.h"
+#include "glsl_types.h"
+#include "util/hash_table.h"
+
+namespace {
+
+enum ref_kind {
+   ref_type,
+   ref_variable,
+   ref_function,
+   ref_signature,
+};
+
+enum type_encoding {
+   type_builtin,
+   type_array,
+   type_record,
+   type_interface,
+   type_subroutine,
+};
+
+enum name_encoding {
+   name_null,
+   name_temporary,
+   name_string,
+};
+
+/**
+ * Built-in types are interned at compile time rather than through the
+ * get_*_instance() functions, so they are encoded by their position here.
+ */
+static const glsl_type *const *const builtin_types[] = {
+#undef  DECL_TYPE
+#define DECL_TYPE(NAME, ...) &glsl_type::NAME##_type,
+#undef  STRUCT_TYPE
+#define STRUCT_TYPE(NAME) &glsl_type::struct_##NAME##_type,
+#include "builtin_type_macros.h"
+#undef  DECL_TYPE
+#undef  STRUCT_TYPE
+};
+
+static int
+builtin_type_index(const glsl_type *type)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(builtin_types); i++) {
+      if (*builtin_types[i] == type)
+         return i;
+   }
+
+   return -1;
+}
+
+static uint32_t
+pack_struct_field(const glsl_struct_field *f)
+{
+   return f->interpolation |
+          f->centroid << 2 |
+          f->sample << 3 |
+          f->matrix_layout << 4 |
+          f->patch << 6 |
+          f->precision << 7 |
+          f->image_read_only << 9 |
+          f->image_write_only << 10 |
+          f->image_coherent << 11 |
+          f->image_volatile << 12 |
+          f->image_restrict << 13;
+}
+
+static void
+unpack_struct_field(glsl_struct_field *f, uint32_t bits)
+{
+   f->interpolation = bits & 3;
+   f->centroid = (bits >> 2) & 1;
+   f->sample = (bits >> 3) & 1;
+   f->matrix_layout = (bits >> 4) & 3;
+   f->patch = (bits >> 6) & 1;
+   f->precision = (bits >> 7) & 3;
+   f->image_read_only = (bits >> 9) & 1;
+   f->image_write_only = (bits >> 10) & 1;
+   f->image_coherent = (bits >> 11) & 1;
+   f->image_volatile = (bits >> 12) & 1;
+   f->image_restrict = (bits >> 13) & 1;
+}
+
+
+class ir_serializer {
+public:
+   ir_serializer(struct blob *blob)
+      : blob(blob), next_id(0), ok(true)
+   {
+      ids = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                    _mesa_key_pointer_equal);
+      if (ids == NULL)
+         ok = false;
+   }
+
+   ~ir_serializer()
+   {
+      if (ids)
+         _mesa_hash_table_destroy(ids, NULL);
+   }
+
+   void write_list(exec_list *list);
+   void write_type(const glsl_type *type);
+
+   struct blob *blob;
+   struct hash_table *ids;
+   uint32_t next_id;
+   bool ok;
+
+private:
+   void write_uint32(uint32_t value)
+   {
+      ok = blob_write_uint32(blob, value) && ok;
+   }
+
+   void write_string(const char *str)
+   {
+      ok = blob_write_string(blob, str) && ok;
+   }
+
+   bool begin_ref(const void *ptr);
+
+   void write_fields(const glsl_type *type);
+   void write_variable(ir_variable *var);
+   void write_function(ir_function *f);
+   void write_signature(ir_function_signature *sig);
+   void write_instruction(ir_instruction *ir);
+   void write_rvalue(ir_rvalue *ir);
+   void write_constant(ir_constant *c);
+};
+
+/**
+ * Write a reference to \c ptr.
+ *
+ * \return true if this is the first reference, in which case the caller must
+ *         write the object itself.
+ */
+bool
+ir_serializer::begin_ref(const void *ptr)
+{
+   if (ptr == NULL || !ok) {
+      write_uint32(0);
+      return false;
+   }
+
+   struct hash_entry *entry = _mesa_hash_table_search(ids, ptr);
+   if (entry) {
+      write_uint32((uint32_t) (uintptr_t) entry->data);
+      return false;
+   }
+
+   next_id++;
+   if (_mesa_hash_table_insert(ids, ptr, (void *) (uintptr_t) next_id) == NULL)
+      ok = false;
+   write_uint32(next_id);
+   return true;
+}
+
+void
+ir_serializer::write_fields(const glsl_type *type)
+{
+   write_uint32(type->length);
+   for (unsigned i = 0; i < type->length; i++) {
+      const glsl_struct_field *f = &type->fields.structure[i];
+
+      write_type(f->type);
+      write_string(f->name);
+      write_uint32(f->location);
+      write_uint32(pack_struct_field(f));
+   }
+}
+
+void
+ir_serializer::write_type(const glsl_type *type)
+{
+   if (!begin_ref(type))
+      return;
+
+   const int builtin = builtin_type_index(type);
+   if (builtin >= 0) {
+      write_uint32(type_builtin);
+      write_uint32(builtin);
+      return;
+   }
+
+   switch (type->base_type) {
+   case GLSL_TYPE_ARRAY:
+      write_uint32(type_array);
+      write_type(type->fields.array);
+      write_uint32(type->length);
+      break;
+   case GLSL_TYPE_STRUCT:
+      write_uint32(type_record);
+      write_string(type->name);
+      write_fields(type);
+      break;
+   case GLSL_TYPE_INTERFACE:
+      write_uint32(type_interface);
+      write_string(type->name);
+      write_uint32(type->interface_packing);
+      write_fields(type);
+      break;
+   case GLSL_TYPE_SUBROUTINE:
+      write_uint32(type_subroutine);
+      write_string(type->name);
+      break;
+   default:
+      /* Every other type is a singleton in builtin_types[]. */
+      ok = false;
+      break;
+   }
+}
+
+void
+ir_serializer::write_variable(ir_variable *var)
+{
+   if (!begin_ref(var))
+      return;
+
+   write_type(var->type);
+
+   if (var->name == NULL) {
+      write_uint32(name_null);
+   } else if (!var->is_name_ralloced()) {
+      write_uint32(name_temporary);
+   } else {
+      write_uint32(name_string);
+      write_string(var->name);
+   }
+
+   write_uint32(var->data.mode);
+   ok = blob_write_bytes(blob, &var->data, sizeof(var->data)) && ok;
+   write_type(var->get_interface_type());
+
+   if (var->is_interface_instance()) {
+      const unsigned *max_ifc = var->get_max_ifc_array_access();
+
+      for (unsigned i = 0; i < var->get_interface_type()->length; i++)
+         write_uint32(max_ifc[i]);
+   } else {
+      const unsigned num_slots = var->get_num_state_slots();
+
+      write_uint32(num_slots);
+      if (num_slots > 0) {
+         ok = blob_write_bytes(blob, var->get_state_slots(),
+                               num_slots * sizeof(ir_state_slot)) && ok;
+      }
+   }
+
+   write_uint32(var->constant_value != NULL);
+   if (var->constant_value)
+      write_constant(var->constant_value);
+
+   write_uint32(var->constant_initializer != NULL);
+   if (var->constant_initializer)
+      write_constant(var->constant_initializer);
+}
+
+void
+ir_serializer::write_function(ir_function *f)
+{
+   if (!begin_ref(f))
+      return;
+
+   write_string(f->name);
+   write_uint32(f->is_subroutine);
+   write_uint32(f->subroutine_index);
+   write_uint32(f->num_subroutine_types);
+   for (int i = 0; i < f->num_subroutine_types; i++)
+      write_type(f->subroutine_types[i]);
+}
+
+void
+ir_serializer::write_signature(ir_function_signature *sig)
+{
+   if (!begin_ref(sig))
+      return;
+
+   write_function(const_cast<ir_function *>(sig->function()));
+   write_type(sig->return_type);
+   write_uint32(sig->is_defined);
+   write_uint32(sig->is_intrinsic);
+
+   write_uint32(sig->parameters.length());
+   foreach_in_list(ir_variable, param, &sig->parameters)
+      write_variable(param);
+}
+
+void
+ir_serializer::write_constant(ir_constant *c)
+{
+   const glsl_type *type = c->type;
+
+   write_type(type);
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_BOOL:
+      for (unsigned i = 0; i < type->components(); i++) {
+         write_uint32(type->base_type == GLSL_TYPE_BOOL ?
+                      (uint32_t) c->value.b[i] : c->value.u[i]);
+      }
+      break;
+   case GLSL_TYPE_DOUBLE:
+      for (unsigned i = 0; i < type->components(); i++) {
+         uint64_t bits;
+
+         memcpy(&bits, &c->value.d[i], sizeof(bits));
+         ok = blob_write_uint64(blob, bits) && ok;
+      }
+      break;
+   case GLSL_TYPE_STRUCT:
+      foreach_in_list(ir_constant, field, &c->components)
+         write_constant(field);
+      break;
+   case GLSL_TYPE_ARRAY:
+      for (unsigned i = 0; i < type->length; i++)
+         write_constant(c->array_elements[i]);
+      break;
+   default:
+      ok = false;
+      break;
+   }
+}
+
+void
+ir_serializer::write_rvalue(ir_rvalue *ir)
+{
+   if (ir == NULL) {
+      write_uint32(ir_type_unset);
+      return;
+   }
+
+   write_instruction(ir);
+}
+
+void
+ir_serializer::write_list(exec_list *list)
+{
+   write_uint32(list->length());
+   foreach_in_list(ir_instruction, ir, list)
+      write_instruction(ir);
+}
+
+void
+ir_serializer::write_instruction(ir_instruction *ir)
+{
+   if (!ok)
+      return;
+
+   write_uint32(ir->ir_type);
+
+   switch (ir->ir_type) {
+   case ir_type_variable:
+      write_variable((ir_variable *) ir);
+      break;
+
+   case ir_type_function: {
+      ir_function *f = (ir_function *) ir;
+
+      write_function(f);
+      write_uint32(f->signatures.length());
+      foreach_in_list(ir_function_signature, sig, &f->signatures) {
+         write_signature(sig);
+         write_list(&sig->body);
+      }
+      break;
+   }
+
+   case ir_type_assignment: {
+      ir_assignment *a = (ir_assignment *) ir;
+
+      write_rvalue(a->lhs);
+      write_rvalue(a->rhs);
+      write_rvalue(a->condition);
+      write_uint32(a->write_mask);
+      break;
+   }
+
+   case ir_type_call: {
+      ir_call *call = (ir_call *) ir;
+
+      write_signature(call->callee);
+      write_rvalue(call->return_deref);
+      write_list(&call->actual_parameters);
+      write_variable(call->sub_var);
+      write_rvalue(call->array_idx);
+      write_uint32(call->use_builtin);
+      break;
+   }
+
+   case ir_type_if: {
+      ir_if *iff = (ir_if *) ir;
+
+      write_rvalue(iff->condition);
+      write_list(&iff->then_instructions);
+      write_list(&iff->else_instructions);
+      break;
+   }
+
+   case ir_type_loop:
+      write_list(&((ir_loop *) ir)->body_instructions);
+      break;
+
+   case ir_type_loop_jump:
+      write_uint32(((ir_loop_jump *) ir)->mode);
+      break;
+
+   case ir_type_return:
+      write_rvalue(((ir_return *) ir)->value);
+      break;
+
+   case ir_type_discard:
+      write_rvalue(((ir_discard *) ir)->condition);
+      break;
+
+   case ir_type_emit_vertex:
+      write_rvalue(((ir_emit_vertex *) ir)->stream);
+      break;
+
+   case ir_type_end_primitive:
+      write_rvalue(((ir_end_primitive *) ir)->stream);
+      break;
+
+   case ir_type_barrier:
+      break;
+
+   case ir_type_dereference_variable:
+      write_variable(((ir_dereference_variable *) ir)->var);
+      break;
+
+   case ir_type_dereference_array: {
+      ir_dereference_array *deref = (ir_dereference_array *) ir;
+
+      write_rvalue(deref->array);
+      write_rvalue(deref->array_index);
+      break;
+   }
+
+   case ir_type_dereference_record: {
+      ir_dereference_record *deref = (ir_dereference_record *) ir;
+
+      write_rvalue(deref->record);
+      write_string(deref->field);
+      break;
+   }
+
+   case ir_type_constant:
+      write_constant((ir_constant *) ir);
+      break;
+
+   case ir_type_expression: {
+      ir_expression *expr = (ir_expression *) ir;
+
+      write_uint32(expr->operation);
+      write_type(expr->type);
+      write_uint32(expr->get_num_operands());
+      for (unsigned i = 0; i < expr->get_num_operands(); i++)
+         write_rvalue(expr->operands[i]);
+      break;
+   }
+
+   case ir_type_swizzle: {
+      ir_swizzle *swiz = (ir_swizzle *) ir;
+
+      write_rvalue(swiz->val);
+      write_uint32(swiz->mask.x | swiz->mask.y << 2 | swiz->mask.z << 4 |
+                   swiz->mask.w << 6 | swiz->mask.num_components << 8);
+      break;
+   }
+
+   case ir_type_texture: {
+      ir_texture *tex = (ir_texture *) ir;
+
+      write_uint32(tex->op);
+      write_type(tex->type);
+      write_rvalue(tex->sampler);
+      write_rvalue(tex->coordinate);
+      write_rvalue(tex->projector);
+      write_rvalue(tex->shadow_comparitor);
+      write_rvalue(tex->offset);
+
+      switch (tex->op) {
+      case ir_tex:
+      case ir_lod:
+      case ir_query_levels:
+      case ir_texture_samples:
+      case ir_samples_identical:
+         break;
+      case ir_txb:
+         write_rvalue(tex->lod_info.bias);
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         write_rvalue(tex->lod_info.lod);
+         break;
+      case ir_txf_ms:
+         write_rvalue(tex->lod_info.sample_index);
+         break;
+      case ir_txd:
+         write_rvalue(tex->lod_info.grad.dPdx);
+         write_rvalue(tex->lod_info.grad.dPdy);
+         break;
+      case ir_tg4:
+         write_rvalue(tex->lod_info.component);
+         break;
+      }
+      break;
+   }
+
+   case ir_type_function_signature:
+   default:
+      /* Signatures only appear inside their ir_function. */
+      ok = false;
+      break;
+   }
+}
+
+
+struct ref_slot {
+   void *ptr;
+   enum ref_kind kind;
+};
+
+class ir_deserializer {
+public:
+   ir_deserializer(struct blob_reader *blob, void *mem_ctx)
+      : blob(blob), mem_ctx(mem_ctx), refs(NULL), num_refs(0), refs_size(0),
+        error(false)
+   {
+   }
+
+   ~ir_deserializer()
+   {
+      ralloc_free(refs);
+   }
+
+   bool failed() const
+   {
+      return error || blob->overrun;
+   }
+
+   void read_list(exec_list *list);
+   const glsl_type *read_type();
+
+private:
+   uint32_t read_uint32()
+   {
+      return blob_read_uint32(blob);
+   }
+
+   bool read_bool()
+   {
+      return blob_read_uint32(blob) != 0;
+   }
+
+   const char *read_string()
+   {
+      const char *str = blob_read_string(blob);
+
+      if (str == NULL)
+         error = true;
+      return str;
+   }
+
+   void *begin_ref(enum ref_kind kind, uint32_t *id);
+   void end_ref(uint32_t id, void *ptr)
+   {
+      refs[id - 1].ptr = ptr;
+   }
+
+   bool read_fields(glsl_struct_field **fields, unsigned *num_fields);
+   ir_variable *read_variable();
+   ir_function *read_function();
+   ir_function_signature *read_signature();
+   ir_instruction *read_instruction(uint32_t tag);
+   ir_rvalue *read_rvalue();
+   ir_dereference *read_dereference();
+   ir_constant *read_constant();
+
+   struct blob_reader *blob;
+   void *mem_ctx;
+   struct ref_slot *refs;
+   uint32_t num_refs;
+   uint32_t refs_size;
+   bool error;
+};
+
+/**
+ * Read a reference of the given kind.
+ *
+ * \return the object if it was read before.  Otherwise \c NULL is returned
+ *         and \c *id is set to the slot of an object that follows (or to
+ *         zero for a \c NULL reference or an error).
+ */
+void *
+ir_deserializer::begin_ref(enum ref_kind kind, uint32_t *id)
+{
+   const uint32_t n = read_uint32();
+
+   *id = 0;
+   if (n == 0 || failed())
+      return NULL;
+
+   if (n <= num_refs) {
+      /* Objects never refer back to themselves, so a reference to a slot
+       * that is still being read means the data is corrupt.
+       */
+      if (refs[n - 1].kind != kind || refs[n - 1].ptr == NULL) {
+         error = true;
+         return NULL;
+      }
+      return refs[n - 1].ptr;
+   }
+
+   if (n != num_refs + 1) {
+      error = true;
+      return NULL;
+   }
+
+   if (num_refs == refs_size) {
+      const uint32_t size = refs_size ? refs_size * 2 : 64;
+      struct ref_slot *new_refs =
+         reralloc(NULL, refs, struct ref_slot, size);
+
+      if (new_refs == NULL) {
+         error = true;
+         return NULL;
+      }
+      refs = new_refs;
+      refs_size = size;
+   }
+
+   refs[num_refs].ptr = NULL;
+   refs[num_refs].kind = kind;
+   *id = ++num_refs;
+   return NULL;
+}
+
+bool
+ir_deserializer::read_fields(glsl_struct_field **fields, unsigned *num_fields)
+{
+   const uint32_t n = read_uint32();
+
+   if (failed() || n > (size_t) (blob->end - blob->current))
+      return false;
+
+   glsl_struct_field *f = ralloc_array(NULL, glsl_struct_field, n ? n : 1);
+   if (f == NULL)
+      return false;
+
+   for (unsigned i = 0; i < n; i++) {
+      f[i].type = read_type();
+      f[i].name = read_string();
+      f[i].location = read_uint32();
+      unpack_struct_field(&f[i], read_uint32());
+
+      if (f[i].type == NULL || failed()) {
+         ralloc_free(f);
+         return false;
+      }
+   }
+
+   *fields = f;
+   *num_fields = n;
+   return true;
+}
+
+const glsl_type *
+ir_deserializer::read_type()
+{
+   uint32_t id;
+   const glsl_type *type = (const glsl_type *) begin_ref(ref_type, &id);
+
+   if (id == 0)
+      return type;
+
+   glsl_struct_field *fields = NULL;
+   unsigned num_fields = 0;
+
+   switch (read_uint32()) {
+   case type_builtin: {
+      const uint32_t index = read_uint32();
+
+      if (index < ARRAY_SIZE(builtin_types))
+         type = *builtin_types[index];
+      break;
+   }
+   case type_array: {
+      const glsl_type *element = read_type();
+      const uint32_t length = read_uint32();
+
+      if (element != NULL && !failed())
+         type = glsl_type::get_array_instance(element, length);
+      break;
+   }
+   case type_record: {
+      const char *name = read_string();
+
+      if (read_fields(&fields, &num_fields))
+         type = glsl_type::get_record_instance(fields, num_fields, name);
+      break;
+   }
+   case type_interface: {
+      const char *name = read_string();
+      const uint32_t packing = read_uint32();
+
+      if (packing <= GLSL_INTERFACE_PACKING_STD430 &&
+          read_fields(&fields, &num_fields)) {
+         type = glsl_type::get_interface_instance(fields, num_fields,
+                                                  (glsl_interface_packing) packing,
+                                                  name);
+      }
+      break;
+   }
+   case type_subroutine: {
+      const char *name = read_string();
+
+      if (!failed())
+         type = glsl_type::get_subroutine_instance(name);
+      break;
+   }
+   }
+
+   /* The get_*_instance() functions copy the fields they keep. */
+   ralloc_free(fields);
+
+   if (type == NULL || failed()) {
+      error = true;
+      return NULL;
+   }
+
+   end_ref(id, (void *) type);
+   return type;
+}
+
+ir_variable *
+ir_deserializer::read_variable()
+{
+   uint32_t id;
+   ir_variable *var = (ir_variable *) begin_ref(ref_variable, &id);
+
+   if (id == 0)
+      return var;
+
+   const glsl_type *type = read_type();
+   const uint32_t name_kind = read_uint32();
+   const char *name = name_kind == name_string ? read_string() : NULL;
+   const uint32_t mode = read_uint32();
+
+   if (type == NULL || failed() || name_kind > name_string ||
+       mode >= ir_var_mode_count) {
+      error = true;
+      return NULL;
+   }
+
+   var = new(mem_ctx) ir_variable(type, name, (ir_variable_mode) mode);
+   if (name_kind == name_string && !var->is_name_ralloced())
+      var->name = ralloc_strdup(var, name);
+
+   blob_copy_bytes(blob, (uint8_t *) &var->data, sizeof(var->data));
+
+   const glsl_type *interface_type = read_type();
+
+   if (failed() || var->data.mode != mode) {
+      error = true;
+      return NULL;
+   }
+
+   if (interface_type != var->get_interface_type()) {
+      if (var->get_interface_type() != NULL) {
+         error = true;
+         return NULL;
+      }
+      var->init_interface_type(interface_type);
+   }
+
+   if (var->is_interface_instance()) {
+      unsigned *max_ifc = var->get_max_ifc_array_access();
+
+      for (unsigned i = 0; i < interface_type->length; i++)
+         max_ifc[i] = read_uint32();
+   } else {
+      const uint32_t num_slots = read_uint32();
+
+      if (num_slots > 0) {
+         if (num_slots > (size_t) (blob->end - blob->current) /
+                         sizeof(ir_state_slot)) {
+            error = true;
+            return NULL;
+         }
+         ir_state_slot *slots = var->allocate_state_slots(num_slots);
+         blob_copy_bytes(blob, (uint8_t *) slots,
+                         num_slots * sizeof(ir_state_slot));
+      } else {
+         var->set_num_state_slots(0);
+      }
+   }
+
+   if (read_bool())
+      var->constant_value = read_constant();
+
+   if (read_bool())
+      var->constant_initializer = read_constant();
+
+   if (failed())
+      return NULL;
+
+   end_ref(id, var);
+   return var;
+}
+
+ir_function *
+ir_deserializer::read_function()
+{
+   uint32_t id;
+   ir_function *f = (ir_function *) begin_ref(ref_function, &id);
+
+   if (id == 0)
+      return f;
+
+   const char *name = read_string();
+   const bool is_subroutine = read_bool();
+   const int subroutine_index = read_uint32();
+   const uint32_t num_subroutine_types = read_uint32();
+
+   if (failed() ||
+       num_subroutine_types > (size_t) (blob->end - blob->current)) {
+      error = true;
+      return NULL;
+   }
+
+   f = new(mem_ctx) ir_function(name);
+   f->is_subroutine = is_subroutine;
+   f->subroutine_index = subroutine_index;
+   f->num_subroutine_types = num_subroutine_types;
+   f->subroutine_types = ralloc_array(mem_ctx, const struct glsl_type *,
+                                      num_subroutine_types);
+   for (unsigned i = 0; i < num_subroutine_types; i++)
+      f->subroutine_types[i] = read_type();
+
+   if (failed())
+      return NULL;
+
+   end_ref(id, f);
+   return f;
+}
+
+ir_function_signature *
+ir_deserializer::read_signature()
+{
+   uint32_t id;
+   ir_function_signature *sig =
+      (ir_function_signature *) begin_ref(ref_signature, &id);
+
+   if (id == 0)
+      return sig;
+
+   ir_function *f = read_function();
+   const glsl_type *return_type = read_type();
+   const bool is_defined = read_bool();
+   const bool is_intrinsic = read_bool();
+
+   if (f == NULL || return_type == NULL || failed()) {
+      error = true;
+      return NULL;
+   }
+
+   sig = new(mem_ctx) ir_function_signature(return_type);
+   sig->is_defined = is_defined;
+   sig->is_intrinsic = is_intrinsic;
+   f->add_signature(sig);
+
+   const uint32_t num_params = read_uint32();
+   for (unsigned i = 0; i < num_params && !failed(); i++) {
+      ir_variable *param = read_variable();
+
+      /* A parameter belongs to exactly one parameter list. */
+      if (param == NULL || param->next != NULL) {
+         error = true;
+         return NULL;
+      }
+      sig->parameters.push_tail(param);
+   }
+
+   if (failed())
+      return NULL;
+
+   end_ref(id, sig);
+   return sig;
+}
+
+ir_constant *
+ir_deserializer::read_constant()
+{
+   const glsl_type *type = read_type();
+
+   if (type == NULL || failed()) {
+      error = true;
+      return NULL;
+   }
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL: {
+      ir_constant_data data;
+
+      if (type->components() > ARRAY_SIZE(data.u)) {
+         error = true;
+         return NULL;
+      }
+
+      memset(&data, 0, sizeof(data));
+      for (unsigned i = 0; i < type->components(); i++) {
+         if (type->base_type == GLSL_TYPE_DOUBLE) {
+            const uint64_t bits = blob_read_uint64(blob);
+            memcpy(&data.d[i], &bits, sizeof(bits));
+         } else if (type->base_type == GLSL_TYPE_BOOL) {
+            data.b[i] = read_bool();
+         } else {
+            data.u[i] = read_uint32();
+         }
+      }
+
+      return failed() ? NULL : new(mem_ctx) ir_constant(type, &data);
+   }
+
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_ARRAY: {
+      exec_list values;
+
+      for (unsigned i = 0; i < type->length; i++) {
+         ir_constant *value = read_constant();
+
+         if (value == NULL)
+            return NULL;
+         values.push_tail(value);
+      }
+      return new(mem_ctx) ir_constant(type, &values);
+   }
+
+   default:
+      error = true;
+      return NULL;
+   }
+}
+
+ir_rvalue *
+ir_deserializer::read_rvalue()
+{
+   const uint32_t tag = read_uint32();
+
+   if (tag == ir_type_unset || failed())
+      return NULL;
+
+   ir_instruction *ir = read_instruction(tag);
+   if (ir == NULL)
+      return NULL;
+
+   ir_rvalue *rvalue = ir->as_rvalue();
+   if (rvalue == NULL)
+      error = true;
+   return rvalue;
+}
+
+/**
+ * Read an rvalue that may not be \c NULL and must be a dereference.
+ */
+ir_dereference *
+ir_deserializer::read_dereference()
+{
+   ir_rvalue *rvalue = read_rvalue();
+   ir_dereference *deref = rvalue ? rvalue->as_dereference() : NULL;
+
+   if (deref == NULL)
+      error = true;
+   return deref;
+}
+
+void
+ir_deserializer::read_list(exec_list *list)
+{
+   const uint32_t length = read_uint32();
+
+   for (unsigned i = 0; i < length && !failed(); i++) {
+      ir_instruction *ir = read_instruction(read_uint32());
+
+      if (ir == NULL) {
+         error = true;
+         return;
+      }
+
+      /* Variables and functions may have been created by an earlier
+       * reference, but they still may only be declared once.
+       */
+      if (ir->next != NULL) {
+         error = true;
+         return;
+      }
+      list->push_tail(ir);
+   }
+}
+
+ir_instruction *
+ir_deserializer::read_instruction(uint32_t tag)
+{
+   if (failed())
+      return NULL;
+
+   switch (tag) {
+   case ir_type_variable:
+      return read_variable();
+
+   case ir_type_function: {
+      ir_function *f = read_function();
+      const uint32_t num_signatures = read_uint32();
+
+      if (f == NULL || failed())
+         return NULL;
+
+      for (unsigned i = 0; i < num_signatures; i++) {
+         ir_function_signature *sig = read_signature();
+
+         if (sig == NULL || sig->function() != f || !sig->body.is_empty()) {
+            error = true;
+            return NULL;
+         }
+
+         /* Signatures first seen in calls were added out of order. */
+         sig->remove();
+         f->signatures.push_tail(sig);
+
+         read_list(&sig->body);
+      }
+      return failed() ? NULL : f;
+   }
+
+   case ir_type_assignment: {
+      ir_dereference *lhs = read_dereference();
+      ir_rvalue *rhs = read_rvalue();
+      ir_rvalue *condition = read_rvalue();
+      const uint32_t write_mask = read_uint32();
+
+      if (lhs == NULL || rhs == NULL || failed() || write_mask > 0xf)
+         return NULL;
+
+      return new(mem_ctx) ir_assignment(lhs, rhs, condition, write_mask);
+   }
+
+   case ir_type_call: {
+      ir_function_signature *callee = read_signature();
+      ir_rvalue *return_deref = read_rvalue();
+      exec_list parameters;
+      read_list(&parameters);
+      ir_variable *sub_var = read_variable();
+      ir_rvalue *array_idx = read_rvalue();
+      const bool use_builtin = read_bool();
+
+      if (callee == NULL || failed() ||
+          (return_deref && !return_deref->as_dereference_variable()))
+         return NULL;
+
+      ir_call *call =
+         new(mem_ctx) ir_call(callee,
+                              (ir_dereference_variable *) return_deref,
+                              &parameters, sub_var, array_idx);
+      call->use_builtin = use_builtin;
+      return call;
+   }
+
+   case ir_type_if: {
+      ir_rvalue *condition = read_rvalue();
+
+      if (condition == NULL)
+         return NULL;
+
+      ir_if *iff = new(mem_ctx) ir_if(condition);
+      read_list(&iff->then_instructions);
+      read_list(&iff->else_instructions);
+      return failed() ? NULL : iff;
+   }
+
+   case ir_type_loop: {
+      ir_loop *loop = new(mem_ctx) ir_loop();
+
+      read_list(&loop->body_instructions);
+      return failed() ? NULL : loop;
+   }
+
+   case ir_type_loop_jump: {
+      const uint32_t mode = read_uint32();
+
+      if (mode > ir_loop_jump::jump_continue || failed())
+         return NULL;
+      return new(mem_ctx) ir_loop_jump((ir_loop_jump::jump_mode) mode);
+   }
+
+   case ir_type_return: {
+      ir_rvalue *value = read_rvalue();
+
+      return failed() ? NULL : new(mem_ctx) ir_return(value);
+   }
+
+   case ir_type_discard: {
+      ir_rvalue *condition = read_rvalue();
+
+      return failed() ? NULL : new(mem_ctx) ir_discard(condition);
+   }
+
+   case ir_type_emit_vertex: {
+      ir_rvalue *stream = read_rvalue();
+
+      return stream ? new(mem_ctx) ir_emit_vertex(stream) : NULL;
+   }
+
+   case ir_type_end_primitive: {
+      ir_rvalue *stream = read_rvalue();
+
+      return stream ? new(mem_ctx) ir_end_primitive(stream) : NULL;
+   }
+
+   case ir_type_barrier:
+      return new(mem_ctx) ir_barrier();
+
+   case ir_type_dereference_variable: {
+      ir_variable *var = read_variable();
+
+      return var ? new(mem_ctx) ir_dereference_variable(var) : NULL;
+   }
+
+   case ir_type_dereference_array: {
+      ir_rvalue *array = read_rvalue();
+      ir_rvalue *index = read_rvalue();
+
+      if (array == NULL || index == NULL)
+         return NULL;
+      return new(mem_ctx) ir_dereference_array(array, index);
+   }
+
+   case ir_type_dereference_record: {
+      ir_rvalue *record = read_rvalue();
+      const char *field = read_string();
+
+      if (record == NULL || failed())
+         return NULL;
+      return new(mem_ctx) ir_dereference_record(record, field);
+   }
+
+   case ir_type_constant:
+      return read_constant();
+
+   case ir_type_expression: {
+      const uint32_t op = read_uint32();
+      const glsl_type *type = read_type();
+      const uint32_t num_operands = read_uint32();
+      ir_rvalue *operands[4] = { NULL, NULL, NULL, NULL };
+
+      if (op > ir_last_opcode || type == NULL || failed() ||
+          num_operands > ARRAY_SIZE(operands) ||
+          num_operands != (op == ir_quadop_vector ? type->vector_elements :
+                           ir_expression::get_num_operands((ir_expression_operation) op))) {
+         error = true;
+         return NULL;
+      }
+
+      for (unsigned i = 0; i < num_operands; i++) {
+         operands[i] = read_rvalue();
+         if (operands[i] == NULL)
+            return NULL;
+      }
+
+      return new(mem_ctx) ir_expression(op, type, operands[0], operands[1],
+                                        operands[2], operands[3]);
+   }
+
+   case ir_type_swizzle: {
+      ir_rvalue *val = read_rvalue();
+      const uint32_t mask = read_uint32();
+      const unsigned count = (mask >> 8) & 7;
+
+      if (val == NULL || failed() || count < 1 || count > 4)
+         return NULL;
+      return new(mem_ctx) ir_swizzle(val, mask & 3, (mask >> 2) & 3,
+                                     (mask >> 4) & 3, (mask >> 6) & 3,
+                                     count);
+   }
+
+   case ir_type_texture: {
+      const uint32_t op = read_uint32();
+      const glsl_type *type = read_type();
+
+      if (op > ir_samples_identical || type == NULL || failed()) {
+         error = true;
+         return NULL;
+      }
+
+      ir_texture *tex = new(mem_ctx) ir_texture((ir_texture_opcode) op);
+      tex->type = type;
+      tex->sampler = read_dereference();
+      tex->coordinate = read_rvalue();
+      tex->projector = read_rvalue();
+      tex->shadow_comparitor = read_rvalue();
+      tex->offset = read_rvalue();
+
+      switch (tex->op) {
+      case ir_tex:
+      case ir_lod:
+      case ir_query_levels:
+      case ir_texture_samples:
+      case ir_samples_identical:
+         break;
+      case ir_txb:
+         tex->lod_info.bias = read_rvalue();
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         tex->lod_info.lod = read_rvalue();
+         break;
+      case ir_txf_ms:
+         tex->lod_info.sample_index = read_rvalue();
+         break;
+      case ir_txd:
+         tex->lod_info.grad.dPdx = read_rvalue();
+         tex->lod_info.grad.dPdy = read_rvalue();
+         break;
+      case ir_tg4:
+         tex->lod_info.component = read_rvalue();
+         break;
+      }
+      return failed() ? NULL : tex;
+   }
+
+   default:
+      error = true;
+      return NULL;
+   }
+}
+
+} /* anonymous namespace */
+
+
+bool
+serialize_ir_list(struct blob *blob, exec_list *instructions)
+{
+   ir_serializer s(blob);
+
+   s.write_list(instructions);
+   return s.ok;
+}
+
+bool
+deserialize_ir_list(struct blob_reader *blob, void *mem_ctx,
+                    exec_list *instructions)
+{
+   ir_deserializer d(blob, mem_ctx);
+
+   d.read_list(instructions);
+   return !d.failed();
+}
+
+bool
+serialize_glsl_type(struct blob *blob, const glsl_type *type)
+{
+   ir_serializer s(blob);
+
+   s.write_type(type);
+   return s.ok;
+}
+
+const glsl_type *
+deserialize_glsl_type(struct blob_reader *blob)
+{
+   ir_deserializer d(blob, NULL);
+   const glsl_type *type = d.read_type();
+
+   return d.failed() ? NULL : type;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef IR_SERIALIZE_H
+#define IR_SERIALIZE_H
+
+/**
+ * \file ir_serialize.h
+ *
+ * Conversion of GLSL IR to and from a flat \c blob.
+ *
+ * The encoding is only meant to be read back by the same build of Mesa that
+ * wrote it: enums and \c ir_variable::data are stored as raw values.  Types
+ * are written structurally and re-interned on the way in, so a deserialized
+ * tree uses the same \c glsl_type pointers as a freshly compiled one.
+ */
+
+struct blob;
+struct blob_reader;
+struct exec_list;
+struct glsl_type;
+
+/**
+ * Append an instruction list to \c blob.
+ *
+ * Variables, functions and signatures referenced from outside the list (for
+ * example the callee of an \c ir_call that was not linked into the list) are
+ * written where they are first referenced.
+ *
+ * \return false if the blob ran out of memory or the list contains something
+ *         that cannot be encoded.
+ */
+extern bool
+serialize_ir_list(struct blob *blob, exec_list *instructions);
+
+/**
+ * Read a list written by \c serialize_ir_list and append it to \c instructions.
+ *
+ * All new nodes are allocated out of \c mem_ctx.
+ *
+ * \return false if the data is truncated or malformed.  Whatever was read so
+ *         far is left in \c instructions and should be freed by the caller.
+ */
+extern bool
+deserialize_ir_list(struct blob_reader *blob, void *mem_ctx,
+                    exec_list *instructions);
+
+extern bool
+serialize_glsl_type(struct blob *blob, const glsl_type *type);
+
+/**
+ * \return the type, or \c NULL if the data is truncated or malformed.
+ */
+extern const glsl_type *
+deserialize_glsl_type(struct blob_reader *blob);
+
+#endif /* IR_SERIALIZE_H */
@@ -75,6 +75,7 @@
 #include "linker.h"
 #include "link_varyings.h"
 #include "ir_optimization.h"
+#include "ir_pass_scheduler.h"
 #include "ir_rvalue_visitor.h"
 #include "ir_uniform.h"
 
@@ -3905,7 +3906,7 @@ link_assign_subroutine_types(struct gl_shader_program *prog)
    }
 }
 
-static void
+void
 split_ubos_and_ssbos(void *mem_ctx,
                      struct gl_uniform_block *blocks,
                      unsigned num_blocks,
@@ -4297,10 +4298,16 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
          lower_tess_level(prog->_LinkedShaders[i]);
       }
 
-      while (do_common_optimization(prog->_LinkedShaders[i]->ir, true, false,
-                                    &ctx->Const.ShaderCompilerOptions[i],
-                                    ctx->Const.NativeIntegers))
-	 ;
+      ir_pass_scheduler passes(true, false,
+                               &ctx->Const.ShaderCompilerOptions[i],
+                               ctx->Const.NativeIntegers);
+      if (ctx->Shader.Flags & GLSL_PASS_STATS) {
+         char *name = ralloc_asprintf(mem_ctx, "%s shader of program %u",
+                                      _mesa_shader_stage_to_string(i),
+                                      prog->Name);
+         passes.enable_stats(name);
+      }
+      passes.run(prog->_LinkedShaders[i]->ir);
 
       lower_const_arrays_to_uniforms(prog->_LinkedShaders[i]->ir);
    }
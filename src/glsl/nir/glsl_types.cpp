@@ -383,6 +383,11 @@ _mesa_glsl_release_types(void)
       _mesa_hash_table_destroy(glsl_type::interface_types, NULL);
       glsl_type::interface_types = NULL;
    }
+
+   if (glsl_type::subroutine_types != NULL) {
+      _mesa_hash_table_destroy(glsl_type::subroutine_types, NULL);
+      glsl_type::subroutine_types = NULL;
+   }
 }
 
 
@@ -699,23 +704,43 @@ glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
    }
 
    const struct hash_entry *entry = _mesa_hash_table_search(array_types, key);
-   if (entry == NULL) {
+   const glsl_type *type =
+      entry != NULL ? (const glsl_type *) entry->data : NULL;
+   const glsl_type *unused = NULL;
+
+   if (type == NULL) {
       mtx_unlock(&glsl_type::mutex);
       const glsl_type *t = new glsl_type(base, array_size);
       mtx_lock(&glsl_type::mutex);
 
-      entry = _mesa_hash_table_insert(array_types,
-                                      ralloc_strdup(mem_ctx, key),
-                                      (void *) t);
+      /* Another thread may have added the same type while the mutex was
+       * unlocked.  Keep the one already in the table so that every user
+       * gets the same pointer.  Entries are freed when an insert rehashes
+       * the table, so only read them with the mutex held.
+       */
+      entry = _mesa_hash_table_search(array_types, key);
+      if (entry == NULL) {
+         _mesa_hash_table_insert(array_types,
+                                 ralloc_strdup(mem_ctx, key),
+                                 (void *) t);
+         type = t;
+      } else {
+         type = (const glsl_type *) entry->data;
+         unused = t;
+      }
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_ARRAY);
-   assert(((glsl_type *) entry->data)->length == array_size);
-   assert(((glsl_type *) entry->data)->fields.array == base);
+   assert(type->base_type == GLSL_TYPE_ARRAY);
+   assert(type->length == array_size);
+   assert(type->fields.array == base);
 
    mtx_unlock(&glsl_type::mutex);
 
-   return (glsl_type *) entry->data;
+   /* operator delete takes the mutex. */
+   if (unused != NULL)
+      delete unused;
+
+   return type;
 }
 
 
@@ -840,21 +865,36 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
 
    const struct hash_entry *entry = _mesa_hash_table_search(record_types,
                                                             &key);
-   if (entry == NULL) {
+   const glsl_type *type =
+      entry != NULL ? (const glsl_type *) entry->data : NULL;
+   const glsl_type *unused = NULL;
+
+   if (type == NULL) {
       mtx_unlock(&glsl_type::mutex);
       const glsl_type *t = new glsl_type(fields, num_fields, name);
       mtx_lock(&glsl_type::mutex);
 
-      entry = _mesa_hash_table_insert(record_types, t, (void *) t);
+      /* As in get_array_instance(), keep any type added meanwhile. */
+      entry = _mesa_hash_table_search(record_types, &key);
+      if (entry == NULL) {
+         _mesa_hash_table_insert(record_types, t, (void *) t);
+         type = t;
+      } else {
+         type = (const glsl_type *) entry->data;
+         unused = t;
+      }
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_STRUCT);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, name) == 0);
+   assert(type->base_type == GLSL_TYPE_STRUCT);
+   assert(type->length == num_fields);
+   assert(strcmp(type->name, name) == 0);
 
    mtx_unlock(&glsl_type::mutex);
 
-   return (glsl_type *) entry->data;
+   if (unused != NULL)
+      delete unused;
+
+   return type;
 }
 
 
@@ -875,22 +915,37 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
 
    const struct hash_entry *entry = _mesa_hash_table_search(interface_types,
                                                             &key);
-   if (entry == NULL) {
+   const glsl_type *type =
+      entry != NULL ? (const glsl_type *) entry->data : NULL;
+   const glsl_type *unused = NULL;
+
+   if (type == NULL) {
       mtx_unlock(&glsl_type::mutex);
       const glsl_type *t = new glsl_type(fields, num_fields,
                                          packing, block_name);
       mtx_lock(&glsl_type::mutex);
 
-      entry = _mesa_hash_table_insert(interface_types, t, (void *) t);
+      /* As in get_array_instance(), keep any type added meanwhile. */
+      entry = _mesa_hash_table_search(interface_types, &key);
+      if (entry == NULL) {
+         _mesa_hash_table_insert(interface_types, t, (void *) t);
+         type = t;
+      } else {
+         type = (const glsl_type *) entry->data;
+         unused = t;
+      }
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_INTERFACE);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, block_name) == 0);
+   assert(type->base_type == GLSL_TYPE_INTERFACE);
+   assert(type->length == num_fields);
+   assert(strcmp(type->name, block_name) == 0);
 
    mtx_unlock(&glsl_type::mutex);
 
-   return (glsl_type *) entry->data;
+   if (unused != NULL)
+      delete unused;
+
+   return type;
 }
 
 const glsl_type *
@@ -907,20 +962,35 @@ glsl_type::get_subroutine_instance(const char *subroutine_name)
 
    const struct hash_entry *entry = _mesa_hash_table_search(subroutine_types,
                                                             &key);
-   if (entry == NULL) {
+   const glsl_type *type =
+      entry != NULL ? (const glsl_type *) entry->data : NULL;
+   const glsl_type *unused = NULL;
+
+   if (type == NULL) {
       mtx_unlock(&glsl_type::mutex);
       const glsl_type *t = new glsl_type(subroutine_name);
       mtx_lock(&glsl_type::mutex);
 
-      entry = _mesa_hash_table_insert(subroutine_types, t, (void *) t);
+      /* As in get_array_instance(), keep any type added meanwhile. */
+      entry = _mesa_hash_table_search(subroutine_types, &key);
+      if (entry == NULL) {
+         _mesa_hash_table_insert(subroutine_types, t, (void *) t);
+         type = t;
+      } else {
+         type = (const glsl_type *) entry->data;
+         unused = t;
+      }
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_SUBROUTINE);
-   assert(strcmp(((glsl_type *) entry->data)->name, subroutine_name) == 0);
+   assert(type->base_type == GLSL_TYPE_SUBROUTINE);
+   assert(strcmp(type->name, subroutine_name) == 0);
 
    mtx_unlock(&glsl_type::mutex);
 
-   return (glsl_type *) entry->data;
+   if (unused != NULL)
+      delete unused;
+
+   return type;
 }
 
 
@@ -29,6 +29,7 @@ import struct
 import sys
 import mako.template
 import re
+from nir_opcodes import opcodes
 
 # Represents a set of variables, each with a unique id
 class VarSet(object):
@@ -140,6 +141,7 @@ class Expression(Value):
       self.opcode = expr[0]
       self.sources = [ Value.create(src, "{0}_{1}".format(name_base, i), varset)
                        for (i, src) in enumerate(expr[1:]) ]
+      assert len(self.sources) == opcodes[self.opcode].num_inputs
 
    def render(self):
       srcs = "\n".join(src.render() for src in self.sources)
@@ -177,6 +179,134 @@ class SearchAndReplace(object):
       else:
          self.replace = Value.create(replace, "replace{0}".format(self.id), varset)
 
+class TreeAutomaton(object):
+   """Bottom-up tree automaton recognizing the search expressions.
+
+   An item is a search expression or sub-expression with its variables
+   replaced by a wildcard, item 0, which matches anything, and its constants
+   and constant variables replaced by item 1, which matches load_const
+   values.  The state of an SSA value is the set of items it could match,
+   going only by the opcodes and sources of the ALU instructions computing
+   it.  State 0 is for values which only match the wildcard and state 1 for
+   load_const values.  The other states are numbered and computed by
+   looking up the states of the sources of an instruction in a table for
+   its opcode.
+
+   To keep the tables small, the state of each source is first filtered to
+   the items which appear as sources of the items of the opcode, and the
+   table is indexed by the filtered states.
+
+   nir_replace_instr() only needs to be tried with the transforms whose
+   search expression is in the state of the instruction.  Since matching
+   also checks the variables, the constants and the swizzles, the state
+   may contain items which don't actually match, but never lacks one that
+   does.
+   """
+   def __init__(self, transforms):
+      self.item_opcodes = [None, None]
+      self.item_srcs = [(), ()]
+      self.items = {}
+      self.opcode_items = {}
+
+      for xform in transforms:
+         xform.item = self.__add_item(xform.search)
+
+      self.__build()
+
+   def __add_item(self, expr):
+      srcs = tuple(self.__add_leaf_item(src) for src in expr.sources)
+      key = (expr.opcode, srcs)
+      if key not in self.items:
+         self.items[key] = len(self.item_opcodes)
+         self.item_opcodes.append(expr.opcode)
+         self.item_srcs.append(srcs)
+         self.opcode_items.setdefault(expr.opcode, []).append(self.items[key])
+      return self.items[key]
+
+   def __add_leaf_item(self, val):
+      if isinstance(val, Expression):
+         return self.__add_item(val)
+      elif isinstance(val, Constant) or val.is_constant:
+         return 1
+      else:
+         return 0
+
+   def __matches(self, item, opcode, src_states):
+      srcs = self.item_srcs[item]
+      if all(src in state for (src, state) in zip(srcs, src_states)):
+         return True
+
+      # Like match_expression(), also try the sources of commutative
+      # opcodes the other way around.
+      if 'commutative' in opcodes[opcode].algebraic_properties:
+         assert len(srcs) == 2
+         return srcs[0] in src_states[1] and srcs[1] in src_states[0]
+
+      return False
+
+   def __build(self):
+      self.states = [frozenset([0]), frozenset([0, 1])]
+      state_index = { self.states[0]: 0, self.states[1]: 1 }
+
+      # For each opcode, the items appearing as sources of its items, the
+      # filtered states, the filtered state of each state and the state for
+      # each tuple of filtered source states.
+      relevant = {}
+      self.filtered_states = {}
+      filtered_index = {}
+      self.filters = {}
+      tables = {}
+      for opcode, items in self.opcode_items.items():
+         relevant[opcode] = frozenset([0] + [src for item in items
+                                             for src in self.item_srcs[item]])
+         self.filtered_states[opcode] = []
+         filtered_index[opcode] = {}
+         self.filters[opcode] = []
+         tables[opcode] = {}
+
+      changed = True
+      while changed:
+         changed = False
+         for opcode in sorted(self.opcode_items.keys()):
+            filtered_states = self.filtered_states[opcode]
+            filter = self.filters[opcode]
+            for state in self.states[len(filter):]:
+               filtered = state & relevant[opcode]
+               if filtered not in filtered_index[opcode]:
+                  filtered_index[opcode][filtered] = len(filtered_states)
+                  filtered_states.append(filtered)
+               filter.append(filtered_index[opcode][filtered])
+
+            table = tables[opcode]
+            num_inputs = opcodes[opcode].num_inputs
+            for srcs in itertools.product(range(len(filtered_states)),
+                                          repeat=num_inputs):
+               if srcs in table:
+                  continue
+
+               src_states = [filtered_states[src] for src in srcs]
+               state = frozenset([0] + [item for item in self.opcode_items[opcode]
+                                        if self.__matches(item, opcode,
+                                                          src_states)])
+               if state not in state_index:
+                  state_index[state] = len(self.states)
+                  self.states.append(state)
+                  changed = True
+               table[srcs] = state_index[state]
+
+      # The state 0xffff marks values whose state isn't known yet.
+      assert len(self.states) < 0xffff
+
+      # Flatten the tables, indexed by the filtered source states as digits
+      # of a number in base len(filtered_states).
+      self.tables = {}
+      for opcode, table in tables.items():
+         num_inputs = opcodes[opcode].num_inputs
+         self.tables[opcode] = \
+            [table[srcs] for srcs in
+             itertools.product(range(len(self.filtered_states[opcode])),
+                               repeat=num_inputs)]
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -190,26 +320,126 @@ struct transform {
    unsigned condition_offset;
 };
 
+/* The transforms to try for an automaton state */
+struct transform_list {
+   uint16_t offset;
+   uint16_t count;
+};
+
+/* The automaton transitions for an opcode */
+struct per_op_table {
+   const uint16_t *filter;
+   uint16_t num_filtered_states;
+   const uint16_t *table;
+};
+
 struct opt_state {
    void *mem_ctx;
    bool progress;
    const bool *condition_flags;
+
+   nir_function_impl *impl;
+   const struct per_op_table *op_tables;
+
+   /* The automaton state of each SSA def, or UNKNOWN_STATE */
+   uint16_t *def_states;
+   unsigned num_def_states;
 };
 
+#define UNKNOWN_STATE 0xffff
+
+% if not reference:
+static uint16_t
+get_def_state(struct opt_state *state, nir_ssa_def *def)
+{
+   if (def->index >= state->num_def_states) {
+      /* A def added by a replacement. */
+      unsigned old_num = state->num_def_states;
+
+      state->num_def_states = state->impl->ssa_alloc;
+      state->def_states = reralloc(NULL, state->def_states, uint16_t,
+                                   state->num_def_states);
+      memset(&state->def_states[old_num], 0xff,
+             (state->num_def_states - old_num) * sizeof(uint16_t));
+   }
+
+   if (state->def_states[def->index] != UNKNOWN_STATE)
+      return state->def_states[def->index];
+
+   uint16_t def_state = 0;
+
+   if (def->parent_instr->type == nir_instr_type_load_const) {
+      def_state = 1;
+   } else if (def->parent_instr->type == nir_instr_type_alu) {
+      nir_alu_instr *alu = nir_instr_as_alu(def->parent_instr);
+      const struct per_op_table *tbl = &state->op_tables[alu->op];
+
+      if (tbl->table) {
+         unsigned index = 0;
+
+         for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+            uint16_t src_state = alu->src[i].src.is_ssa ?
+               get_def_state(state, alu->src[i].src.ssa) : 0;
+
+            index = index * tbl->num_filtered_states + tbl->filter[src_state];
+         }
+
+         def_state = tbl->table[index];
+      }
+   }
+
+   state->def_states[def->index] = def_state;
+   return def_state;
+}
+% endif
+
 #endif
 
-% for (opcode, xform_list) in xform_dict.iteritems():
-% for xform in xform_list:
+% for xform in xforms:
    ${xform.search.render()}
    ${xform.replace.render()}
 % endfor
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
-% for xform in xform_list:
+static const struct transform ${pass_name}_xforms[] = {
+% for xform in xforms:
    { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
 % endfor
 };
+
+% if not reference:
+static const uint16_t ${pass_name}_state_xforms[] = {
+% for indices in state_xforms:
+% if indices:
+   ${', '.join(str(i) for i in indices)},
+% endif
+% endfor
+};
+
+static const struct transform_list ${pass_name}_state_xform_lists[] = {
+% for i, (offset, count) in enumerate(state_xform_lists):
+   { ${offset}, ${count} }, /* state ${i} */
+% endfor
+};
+
+% for opcode in sorted(automaton.tables.keys()):
+static const uint16_t ${pass_name}_${opcode}_filter[] = {
+   ${', '.join(str(f) for f in automaton.filters[opcode])}
+};
+
+static const uint16_t ${pass_name}_${opcode}_table[] = {
+   ${', '.join(str(s) for s in automaton.tables[opcode])}
+};
+
 % endfor
+static const struct per_op_table ${pass_name}_op_tables[nir_num_opcodes] = {
+% for opcode in sorted(automaton.tables.keys()):
+   [nir_op_${opcode}] = {
+      ${pass_name}_${opcode}_filter,
+      ${len(automaton.filtered_states[opcode])},
+      ${pass_name}_${opcode}_table,
+   },
+% endfor
+};
 
 static bool
 ${pass_name}_block(nir_block *block, void *void_state)
@@ -224,38 +454,84 @@ ${pass_name}_block(nir_block *block, void *void_state)
       if (!alu->dest.dest.is_ssa)
          continue;
 
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
-            if (state->condition_flags[xform->condition_offset] &&
-                nir_replace_instr(alu, xform->search, xform->replace,
-                                  state->mem_ctx)) {
-               state->progress = true;
-               break;
-            }
+      uint16_t def_state = get_def_state(state, &alu->dest.dest.ssa);
+      const struct transform_list *list =
+         &${pass_name}_state_xform_lists[def_state];
+
+      for (unsigned i = 0; i < list->count; i++) {
+         const struct transform *xform =
+            &${pass_name}_xforms[${pass_name}_state_xforms[list->offset + i]];
+
+         if (state->condition_flags[xform->condition_offset] &&
+             nir_replace_instr(alu, xform->search, xform->replace,
+                               state->mem_ctx)) {
+            state->progress = true;
+            break;
          }
-         break;
-      % endfor
-      default:
-         break;
       }
    }
 
    return true;
 }
+% else:
+/* Tries every transform of the instruction's opcode in order, without
+ * narrowing them down by automaton state.  This is what the pass did before
+ * the automaton, kept to test the automaton against.
+ */
+static bool
+${pass_name}_reference_block(nir_block *block, void *void_state)
+{
+   struct opt_state *state = void_state;
+
+   nir_foreach_instr_safe(block, instr) {
+      if (instr->type != nir_instr_type_alu)
+         continue;
+
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+      if (!alu->dest.dest.is_ssa)
+         continue;
+
+      for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_xforms); i++) {
+         const struct transform *xform = &${pass_name}_xforms[i];
+
+         if (xform->search->opcode == alu->op &&
+             state->condition_flags[xform->condition_offset] &&
+             nir_replace_instr(alu, xform->search, xform->replace,
+                               state->mem_ctx)) {
+            state->progress = true;
+            break;
+         }
+      }
+   }
+
+   return true;
+}
+% endif
 
 static bool
-${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
+${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags,
+                  nir_foreach_block_cb block_cb)
 {
    struct opt_state state;
 
    state.mem_ctx = ralloc_parent(impl);
    state.progress = false;
    state.condition_flags = condition_flags;
+   state.impl = impl;
+% if reference:
+   state.op_tables = NULL;
+   state.num_def_states = 0;
+   state.def_states = NULL;
+% else:
+   state.op_tables = ${pass_name}_op_tables;
+   state.num_def_states = impl->ssa_alloc;
+   state.def_states = ralloc_array(NULL, uint16_t, state.num_def_states);
+   memset(state.def_states, 0xff, state.num_def_states * sizeof(uint16_t));
+% endif
 
-   nir_foreach_block(impl, ${pass_name}_block, &state);
+   nir_foreach_block(impl, block_cb, &state);
+
+   ralloc_free(state.def_states);
 
    if (state.progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
@@ -265,8 +541,8 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
 }
 
 
-bool
-${pass_name}(nir_shader *shader)
+static bool
+${pass_name}_run(nir_shader *shader, nir_foreach_block_cb block_cb)
 {
    bool progress = false;
    bool condition_flags[${len(condition_list)}];
@@ -278,11 +554,26 @@ ${pass_name}(nir_shader *shader)
 
    nir_foreach_overload(shader, overload) {
       if (overload->impl)
-         progress |= ${pass_name}_impl(overload->impl, condition_flags);
+         progress |= ${pass_name}_impl(overload->impl, condition_flags,
+                                       block_cb);
    }
 
    return progress;
 }
+
+% if reference:
+bool
+${pass_name}_reference(nir_shader *shader)
+{
+   return ${pass_name}_run(shader, ${pass_name}_reference_block);
+}
+% else:
+bool
+${pass_name}(nir_shader *shader)
+{
+   return ${pass_name}_run(shader, ${pass_name}_block);
+}
+% endif
 """)
 
 class AlgebraicPass(object):
@@ -299,7 +590,36 @@ class AlgebraicPass(object):
 
          self.xform_dict[xform.search.opcode].append(xform)
 
-   def render(self):
-      return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
+      # The transforms for each opcode stay in the order they were given,
+      # which is the order they are tried in.
+      self.xforms = []
+      for opcode in sorted(self.xform_dict.keys()):
+         self.xforms += self.xform_dict[opcode]
+
+      self.automaton = TreeAutomaton(self.xforms)
+
+      # For each automaton state, the indices in self.xforms of the
+      # transforms whose search expression is in the state.
+      self.state_xforms = []
+      for state in self.automaton.states:
+         self.state_xforms.append([i for (i, xform) in enumerate(self.xforms)
+                                   if xform.item in state])
+
+      self.state_xform_lists = []
+      offset = 0
+      for indices in self.state_xforms:
+         self.state_xform_lists.append((offset, len(indices)))
+         offset += len(indices)
+
+   def render(self, reference=False):
+      """Renders the pass.  With reference=True, renders only a
+      <pass_name>_reference pass instead, which tries every transform
+      without the automaton, for testing it against.
+      """
+      return _algebraic_pass_template.render(reference=reference,
+                                             pass_name=self.pass_name,
+                                             xforms=self.xforms,
+                                             state_xforms=self.state_xforms,
+                                             state_xform_lists=self.state_xform_lists,
+                                             automaton=self.automaton,
                                              condition_list=condition_list)
@@ -25,6 +25,7 @@
 #    Jason Ekstrand (jason@jlekstrand.net)
 
 import nir_algebraic
+import sys
 
 # Convenience variables
 a = 'a'
@@ -254,6 +255,11 @@ late_optimizations = [
    (('fdph', a, b), ('fdph_replicated', a, b), 'options->fdot_replicates'),
 ]
 
-print nir_algebraic.AlgebraicPass("nir_opt_algebraic", optimizations).render()
+# With --reference, generate the passes without the matching automaton, to
+# test it against.  Only the NIR tests are built with these.
+reference = '--reference' in sys.argv[1:]
+
+print nir_algebraic.AlgebraicPass("nir_opt_algebraic",
+                                  optimizations).render(reference)
 print nir_algebraic.AlgebraicPass("nir_opt_algebraic_late",
-                                  late_optimizations).render()
+                                  late_optimizations).render(reference)
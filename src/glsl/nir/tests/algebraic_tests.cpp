@@ -0,0 +1,338 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include <time.h>
+#include "nir.h"
+#include "nir_builder.h"
+
+/* nir_opt_algebraic without the matching automaton, generated into
+ * nir_opt_algebraic_reference.c for this test only.
+ */
+extern "C" bool nir_opt_algebraic_reference(nir_shader *shader);
+
+class nir_algebraic_test : public ::testing::Test {
+protected:
+   nir_algebraic_test();
+   ~nir_algebraic_test();
+
+   void create_shader();
+   nir_ssa_def *load_input(unsigned index);
+   void store_output(nir_ssa_def *def, unsigned index);
+   nir_ssa_def *stored_value(unsigned index);
+   void make_random_shader(unsigned seed, unsigned size);
+   bool optimize(bool (*opt_algebraic)(nir_shader *) = nir_opt_algebraic);
+   std::string print_shader();
+
+   nir_builder b;
+   nir_shader *shader;
+   nir_function_impl *impl;
+};
+
+nir_algebraic_test::nir_algebraic_test()
+{
+   create_shader();
+}
+
+nir_algebraic_test::~nir_algebraic_test()
+{
+   ralloc_free(shader);
+}
+
+void
+nir_algebraic_test::create_shader()
+{
+   static const nir_shader_compiler_options options = { };
+   shader = nir_shader_create(NULL, MESA_SHADER_FRAGMENT, &options);
+   nir_function *func = nir_function_create(shader, "main");
+   nir_function_overload *overload = nir_function_overload_create(func);
+   impl = nir_function_impl_create(overload);
+
+   nir_builder_init(&b, impl);
+   b.cursor = nir_after_cf_list(&impl->body);
+}
+
+nir_ssa_def *
+nir_algebraic_test::load_input(unsigned index)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(shader, nir_intrinsic_load_input);
+   load->num_components = 4;
+   load->const_index[0] = index;
+   nir_ssa_dest_init(&load->instr, &load->dest, 4, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+void
+nir_algebraic_test::store_output(nir_ssa_def *def, unsigned index)
+{
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(shader, nir_intrinsic_store_output);
+   store->num_components = def->num_components;
+   store->const_index[0] = index;
+   store->src[0] = nir_src_for_ssa(def);
+   nir_builder_instr_insert(&b, &store->instr);
+}
+
+/**
+ * Returns the value stored to the given output, looking through the moves
+ * which nir_replace_instr() leaves behind.
+ */
+nir_ssa_def *
+nir_algebraic_test::stored_value(unsigned index)
+{
+   nir_foreach_instr(nir_start_block(impl), instr) {
+      if (instr->type != nir_instr_type_intrinsic)
+         continue;
+
+      nir_intrinsic_instr *store = nir_instr_as_intrinsic(instr);
+      if (store->intrinsic != nir_intrinsic_store_output ||
+          store->const_index[0] != (int) index)
+         continue;
+
+      nir_ssa_def *def = store->src[0].ssa;
+      while (def->parent_instr->type == nir_instr_type_alu) {
+         nir_alu_instr *mov = nir_instr_as_alu(def->parent_instr);
+         if (mov->op != nir_op_imov && mov->op != nir_op_fmov)
+            break;
+         def = mov->src[0].src.ssa;
+      }
+      return def;
+   }
+
+   return NULL;
+}
+
+/**
+ * Fills the shader with random ALU instructions, on inputs and on constants
+ * which the transforms look for, in blocks of straight-line code with an if
+ * between them.
+ */
+void
+nir_algebraic_test::make_random_shader(unsigned seed, unsigned size)
+{
+   static const nir_op ops[] = {
+      nir_op_fadd, nir_op_fmul, nir_op_fneg, nir_op_fabs, nir_op_ffma,
+      nir_op_flrp, nir_op_fmax, nir_op_fmin, nir_op_fsat, nir_op_frcp,
+      nir_op_fsqrt, nir_op_frsq, nir_op_fexp2, nir_op_flog2, nir_op_fpow,
+      nir_op_flt, nir_op_fge, nir_op_feq, nir_op_fne, nir_op_bcsel,
+      nir_op_iadd, nir_op_imul, nir_op_ineg, nir_op_iand, nir_op_ior,
+      nir_op_inot, nir_op_ishl, nir_op_ushr, nir_op_b2f, nir_op_fdot4,
+   };
+   static const float consts[] = { 0.0f, 1.0f, -1.0f, 0.5f, 2.0f };
+   nir_ssa_def *values[64];
+   unsigned num_values = 0, num_outputs = 0;
+
+   for (unsigned i = 0; i < 4; i++)
+      values[num_values++] = load_input(i);
+
+   for (unsigned i = 0; i < size; i++) {
+      nir_ssa_def *srcs[3];
+
+      seed = seed * 1103515245 + 12345;
+      nir_op op = ops[(seed >> 8) % ARRAY_SIZE(ops)];
+
+      for (unsigned j = 0; j < nir_op_infos[op].num_inputs; j++) {
+         seed = seed * 1103515245 + 12345;
+         unsigned r = (seed >> 8) % 16;
+         if (r < ARRAY_SIZE(consts))
+            srcs[j] = nir_imm_float(&b, consts[r]);
+         else
+            srcs[j] = values[num_values - 1 - r % MIN2(num_values, 8)];
+      }
+
+      nir_ssa_def *def =
+         nir_build_alu(&b, op, srcs[0],
+                       nir_op_infos[op].num_inputs > 1 ? srcs[1] : NULL,
+                       nir_op_infos[op].num_inputs > 2 ? srcs[2] : NULL,
+                       NULL);
+
+      if (num_values == ARRAY_SIZE(values)) {
+         store_output(values[0], num_outputs++);
+         memmove(values, values + 1, --num_values * sizeof(values[0]));
+      }
+      values[num_values++] = def;
+
+      if (i % 64 == 63) {
+         nir_if *nif = nir_if_create(shader);
+         nif->condition = nir_src_for_ssa(nir_channel(&b, def, 0));
+         nir_builder_cf_insert(&b, &nif->cf_node);
+
+         b.cursor = nir_after_cf_list(&nif->then_list);
+         store_output(nir_fneg(&b, nir_fneg(&b, def)), num_outputs++);
+
+         b.cursor = nir_after_cf_node(&nif->cf_node);
+      }
+   }
+
+   for (unsigned i = 0; i < num_values; i++)
+      store_output(values[i], num_outputs++);
+
+   nir_validate_shader(shader);
+}
+
+bool
+nir_algebraic_test::optimize(bool (*opt_algebraic)(nir_shader *))
+{
+   bool progress, any_progress = false;
+
+   do {
+      progress = false;
+      progress |= opt_algebraic(shader);
+      nir_validate_shader(shader);
+      progress |= nir_opt_constant_folding(shader);
+      progress |= nir_copy_prop(shader);
+      progress |= nir_opt_dce(shader);
+      any_progress |= progress;
+   } while (progress);
+
+   return any_progress;
+}
+
+std::string
+nir_algebraic_test::print_shader()
+{
+   std::string text;
+   char buf[4096];
+   size_t size;
+
+   FILE *fp = tmpfile();
+   nir_print_shader(shader, fp);
+   rewind(fp);
+   while ((size = fread(buf, 1, sizeof(buf), fp)) > 0)
+      text.append(buf, size);
+   fclose(fp);
+
+   return text;
+}
+
+TEST_F(nir_algebraic_test, nested_expression)
+{
+   nir_ssa_def *a = load_input(0);
+   store_output(nir_fneg(&b, nir_fneg(&b, a)), 0);
+
+   EXPECT_TRUE(nir_opt_algebraic(shader));
+   nir_validate_shader(shader);
+   EXPECT_EQ(a, stored_value(0));
+}
+
+TEST_F(nir_algebraic_test, commuted_sources)
+{
+   nir_ssa_def *a = load_input(0);
+   store_output(nir_fmul(&b, nir_imm_float(&b, 1.0f), a), 0);
+
+   EXPECT_TRUE(nir_opt_algebraic(shader));
+   nir_validate_shader(shader);
+   EXPECT_EQ(a, stored_value(0));
+}
+
+TEST_F(nir_algebraic_test, constant_source_not_constant)
+{
+   /* fmul(a, 1.0) must not match when the second source isn't a
+    * load_const, even if it could be one after other passes.
+    */
+   nir_ssa_def *a = load_input(0);
+   nir_ssa_def *one = nir_fmov(&b, nir_imm_float(&b, 1.0f));
+   store_output(nir_fmul(&b, a, one), 0);
+
+   EXPECT_FALSE(nir_opt_algebraic(shader));
+}
+
+TEST_F(nir_algebraic_test, different_constant)
+{
+   nir_ssa_def *a = load_input(0);
+   store_output(nir_fmul(&b, a, nir_imm_float(&b, 3.0f)), 0);
+
+   EXPECT_FALSE(nir_opt_algebraic(shader));
+}
+
+TEST_F(nir_algebraic_test, replacement_feeds_later_match)
+{
+   /* The inner pair is replaced by a move of a, which makes the outer pair
+    * fneg(fneg(mov)), matched in the same run through instructions added by
+    * the pass.
+    */
+   nir_ssa_def *a = load_input(0);
+   nir_ssa_def *def = a;
+   for (unsigned i = 0; i < 4; i++)
+      def = nir_fneg(&b, def);
+   store_output(def, 0);
+
+   EXPECT_TRUE(nir_opt_algebraic(shader));
+   nir_validate_shader(shader);
+   EXPECT_EQ(a, stored_value(0));
+}
+
+TEST_F(nir_algebraic_test, random_shaders)
+{
+   /* The automaton only skips transforms which can't match, so the result
+    * must be the same as trying every transform of the opcode.
+    */
+   for (unsigned seed = 1; seed <= 20; seed++) {
+      make_random_shader(seed, 256);
+      EXPECT_TRUE(optimize(nir_opt_algebraic_reference));
+      std::string expected = print_shader();
+
+      ralloc_free(shader);
+      create_shader();
+
+      make_random_shader(seed, 256);
+      EXPECT_TRUE(optimize());
+      EXPECT_EQ(expected, print_shader()) << "seed " << seed;
+
+      ralloc_free(shader);
+      create_shader();
+   }
+}
+
+/**
+ * Times nir_opt_algebraic on random shaders of 4k instructions, on the
+ * first run when most of the transforms apply and on later runs when none
+ * do.  Run with --gtest_also_run_disabled_tests.
+ */
+TEST_F(nir_algebraic_test, DISABLED_benchmark)
+{
+   double first = 0.0, later = 0.0;
+
+   for (unsigned seed = 1; seed <= 100; seed++) {
+      make_random_shader(seed, 4096);
+
+      clock_t t0 = clock();
+      nir_opt_algebraic(shader);
+      clock_t t1 = clock();
+      for (unsigned i = 0; i < 10; i++)
+         nir_opt_algebraic(shader);
+      clock_t t2 = clock();
+
+      first += (t1 - t0) * 1000.0 / CLOCKS_PER_SEC;
+      later += (t2 - t1) * 1000.0 / CLOCKS_PER_SEC / 10;
+
+      ralloc_free(shader);
+      create_shader();
+   }
+
+   printf("nir_opt_algebraic: %.1f ms on the first run, %.1f ms later\n",
+          first, later);
+}
@@ -318,7 +318,7 @@ dead_code_local_basic_block(ir_instruction *first,
       if (ir == last)
 	 break;
    }
-   *out_progress = progress;
+   *out_progress = progress || *out_progress;
    ralloc_free(ctx);
 }
 
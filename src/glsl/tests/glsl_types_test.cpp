@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "c11/threads.h"
+#include "util/ralloc.h"
+#include "glsl_types.h"
+
+/**
+ * \file glsl_types_test.cpp
+ *
+ * Test that glsl_type's instance getters return one pointer per type when
+ * they are called from several threads at once, as when shader stages are
+ * compiled in parallel.
+ */
+
+#define NUM_THREADS 8
+#define NUM_TYPES 200
+
+namespace {
+
+struct type_set {
+   const glsl_type *arrays[NUM_TYPES];
+   const glsl_type *records[NUM_TYPES];
+   const glsl_type *interfaces[NUM_TYPES];
+};
+
+mtx_t start_mutex;
+cnd_t start_cond;
+unsigned num_started;
+
+/**
+ * Waits for all threads to start, so that they race on the same types, then
+ * gets types which nothing else in the process uses.
+ */
+int
+get_types(void *data)
+{
+   type_set *types = (type_set *) data;
+   char name[32];
+
+   mtx_lock(&start_mutex);
+   if (++num_started == NUM_THREADS)
+      cnd_broadcast(&start_cond);
+   while (num_started < NUM_THREADS)
+      cnd_wait(&start_cond, &start_mutex);
+   mtx_unlock(&start_mutex);
+
+   for (unsigned i = 0; i < NUM_TYPES; i++) {
+      const glsl_struct_field fields[] = {
+         glsl_struct_field(glsl_type::vec4_type, "v"),
+         glsl_struct_field(glsl_type::get_array_instance(glsl_type::float_type,
+                                                         i + 1), "a"),
+      };
+
+      types->arrays[i] = glsl_type::get_array_instance(glsl_type::vec3_type,
+                                                       1000 + i);
+
+      snprintf(name, sizeof(name), "glsl_types_test_s%u", i);
+      types->records[i] = glsl_type::get_record_instance(fields, 2, name);
+
+      snprintf(name, sizeof(name), "glsl_types_test_b%u", i);
+      types->interfaces[i] =
+         glsl_type::get_interface_instance(fields, 2,
+                                           GLSL_INTERFACE_PACKING_STD140,
+                                           name);
+   }
+
+   return 0;
+}
+
+} /* anonymous namespace */
+
+TEST(glsl_types, concurrent_instances)
+{
+   type_set *types = new type_set[NUM_THREADS];
+   thrd_t threads[NUM_THREADS];
+
+   mtx_init(&start_mutex, mtx_plain);
+   cnd_init(&start_cond);
+   num_started = 0;
+
+   for (unsigned i = 0; i < NUM_THREADS; i++) {
+      ASSERT_EQ(thrd_success, thrd_create(&threads[i], get_types, &types[i]));
+   }
+   for (unsigned i = 0; i < NUM_THREADS; i++)
+      thrd_join(threads[i], NULL);
+
+   const type_set *first = &types[0];
+   for (unsigned i = 0; i < NUM_TYPES; i++) {
+      EXPECT_TRUE(first->arrays[i]->is_array());
+      EXPECT_EQ(1000 + i, first->arrays[i]->length);
+      EXPECT_TRUE(first->records[i]->is_record());
+      EXPECT_TRUE(first->interfaces[i]->is_interface());
+
+      for (unsigned t = 1; t < NUM_THREADS; t++) {
+         EXPECT_EQ(first->arrays[i], types[t].arrays[i]);
+         EXPECT_EQ(first->records[i], types[t].records[i]);
+         EXPECT_EQ(first->interfaces[i], types[t].interfaces[i]);
+      }
+   }
+
+   /* Types got after the race are the ones every thread got. */
+   EXPECT_EQ(first->arrays[0],
+             glsl_type::get_array_instance(glsl_type::vec3_type, 1000));
+
+   cnd_destroy(&start_cond);
+   mtx_destroy(&start_mutex);
+   delete [] types;
+}
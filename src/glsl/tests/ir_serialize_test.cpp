@@ -0,0 +1,292 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "main/macros.h"
+#include "program/prog_instruction.h"
+#include "util/ralloc.h"
+#include "blob.h"
+#include "ir.h"
+#include "ir_builder.h"
+#include "ir_serialize.h"
+
+using namespace ir_builder;
+
+class ir_serialize_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   char *print(exec_list *instructions);
+   void round_trip();
+
+   void *mem_ctx;
+   exec_list ir;
+   exec_list out;
+   struct blob *blob;
+};
+
+void
+ir_serialize_test::SetUp()
+{
+   mem_ctx = ralloc_context(NULL);
+   ir.make_empty();
+   out.make_empty();
+   blob = blob_create(mem_ctx);
+}
+
+void
+ir_serialize_test::TearDown()
+{
+   ralloc_free(mem_ctx);
+   mem_ctx = NULL;
+}
+
+char *
+ir_serialize_test::print(exec_list *instructions)
+{
+   FILE *f = tmpfile();
+   _mesa_print_ir(f, instructions, NULL);
+
+   const long size = ftell(f);
+   char *str = (char *) ralloc_size(mem_ctx, size + 1);
+
+   rewind(f);
+   str[fread(str, 1, size, f)] = '\0';
+   fclose(f);
+   return str;
+}
+
+/**
+ * Serialize \c ir, read it back into \c out and check that both print the
+ * same.  Record types print with their address, so this also checks that
+ * types are re-interned.
+ */
+void
+ir_serialize_test::round_trip()
+{
+   struct blob_reader reader;
+
+   ASSERT_TRUE(serialize_ir_list(blob, &ir));
+
+   blob_reader_init(&reader, blob->data, blob->size);
+   ASSERT_TRUE(deserialize_ir_list(&reader, mem_ctx, &out));
+   EXPECT_EQ(reader.end, reader.current);
+
+   EXPECT_STREQ(print(&ir), print(&out));
+}
+
+TEST_F(ir_serialize_test, control_flow)
+{
+   ir_variable *in = new(mem_ctx) ir_variable(glsl_type::vec4_type, "in_color",
+                                              ir_var_shader_in);
+   ir_variable *color = new(mem_ctx) ir_variable(glsl_type::vec4_type,
+                                                 "out_color",
+                                                 ir_var_shader_out);
+   in->data.location = 3;
+   color->data.explicit_location = true;
+   ir.push_tail(in);
+   ir.push_tail(color);
+
+   ir_function *f = new(mem_ctx) ir_function("main");
+   ir_function_signature *sig =
+      new(mem_ctx) ir_function_signature(glsl_type::void_type);
+   sig->is_defined = true;
+   f->add_signature(sig);
+   ir.push_tail(f);
+
+   ir_factory body(&sig->body, mem_ctx);
+   ir_variable *t = body.make_temp(glsl_type::vec4_type, "t");
+
+   body.emit(assign(t, mul(in, body.constant(2.0f))));
+
+   ir_if *branch = new(mem_ctx) ir_if(less(swizzle_x(t), body.constant(0.5f)));
+   branch->then_instructions.push_tail(assign(t, neg(swizzle_for_size(t, 2)),
+                                              WRITEMASK_X | WRITEMASK_Y));
+   branch->else_instructions.push_tail(new(mem_ctx) ir_discard());
+   body.emit(branch);
+
+   ir_loop *loop = new(mem_ctx) ir_loop();
+   loop->body_instructions.push_tail(
+      new(mem_ctx) ir_loop_jump(ir_loop_jump::jump_break));
+   body.emit(loop);
+
+   body.emit(assign(color, swizzle(t, MAKE_SWIZZLE4(SWIZZLE_W, SWIZZLE_Z,
+                                                    SWIZZLE_Y, SWIZZLE_X), 4)));
+
+   round_trip();
+
+   /* Variables keep their data and are shared by all their references. */
+   ir_variable *const out_in = ((ir_instruction *) out.get_head())->as_variable();
+   ASSERT_TRUE(out_in != NULL);
+   EXPECT_EQ(3, out_in->data.location);
+   EXPECT_EQ(ir_var_shader_in, out_in->data.mode);
+
+   ir_function *const out_f =
+      ((ir_instruction *) out.get_tail())->as_function();
+   ASSERT_TRUE(out_f != NULL);
+   ir_function_signature *const out_sig =
+      (ir_function_signature *) out_f->signatures.get_head();
+   ir_assignment *const first =
+      ((ir_instruction *) out_sig->body.get_head()->next)->as_assignment();
+   ASSERT_TRUE(first != NULL);
+
+   ir_expression *const product = first->rhs->as_expression();
+   ASSERT_TRUE(product != NULL);
+   EXPECT_EQ(out_in, product->operands[0]->variable_referenced());
+}
+
+TEST_F(ir_serialize_test, calls_and_records)
+{
+   static const glsl_struct_field fields[] = {
+      glsl_struct_field(glsl_type::vec3_type, "position"),
+      glsl_struct_field(glsl_type::float_type, "weight"),
+   };
+   const glsl_type *const record =
+      glsl_type::get_record_instance(fields, ARRAY_SIZE(fields), "vertex");
+   const glsl_type *const record_array =
+      glsl_type::get_array_instance(record, 4);
+
+   ir_variable *vertices = new(mem_ctx) ir_variable(record_array, "vertices",
+                                                    ir_var_uniform);
+   ir.push_tail(vertices);
+
+   /* float weight_of(in int i) { return vertices[i].weight; } */
+   ir_function *helper = new(mem_ctx) ir_function("weight_of");
+   ir_function_signature *helper_sig =
+      new(mem_ctx) ir_function_signature(glsl_type::float_type);
+   ir_variable *index = new(mem_ctx) ir_variable(glsl_type::int_type, "i",
+                                                 ir_var_function_in);
+   helper_sig->parameters.push_tail(index);
+   helper_sig->is_defined = true;
+   helper->add_signature(helper_sig);
+   ir.push_tail(helper);
+
+   ir_dereference *element =
+      new(mem_ctx) ir_dereference_array(vertices,
+                                        new(mem_ctx) ir_dereference_variable(index));
+   helper_sig->body.push_tail(
+      ret(new(mem_ctx) ir_dereference_record(element, "weight")));
+
+   /* void main() { float w = weight_of(2); } */
+   ir_function *f = new(mem_ctx) ir_function("main");
+   ir_function_signature *sig =
+      new(mem_ctx) ir_function_signature(glsl_type::void_type);
+   sig->is_defined = true;
+   f->add_signature(sig);
+   ir.push_tail(f);
+
+   ir_factory body(&sig->body, mem_ctx);
+   ir_variable *w = body.make_temp(glsl_type::float_type, "w");
+   exec_list params;
+   params.push_tail(body.constant(2));
+   body.emit(new(mem_ctx) ir_call(helper_sig,
+                                  new(mem_ctx) ir_dereference_variable(w),
+                                  &params));
+
+   ir_constant_data data;
+   memset(&data, 0, sizeof(data));
+   data.f[0] = 1.0f;
+   data.f[3] = -4.0f;
+   body.emit(assign(new(mem_ctx) ir_dereference_record(
+                       new(mem_ctx) ir_dereference_array(vertices,
+                                                         body.constant(0)),
+                       "position"),
+                    new(mem_ctx) ir_constant(glsl_type::vec3_type, &data)));
+
+   round_trip();
+
+   /* The call must point at the deserialized signature, not a copy. */
+   ir_function *const out_helper =
+      ((ir_instruction *) out.get_head()->next)->as_function();
+   ASSERT_TRUE(out_helper != NULL);
+   ir_function_signature *const out_helper_sig =
+      (ir_function_signature *) out_helper->signatures.get_head();
+
+   ir_function *const out_main =
+      ((ir_instruction *) out.get_tail())->as_function();
+   ASSERT_TRUE(out_main != NULL);
+   ir_function_signature *const out_sig =
+      (ir_function_signature *) out_main->signatures.get_head();
+   ir_call *const call =
+      ((ir_instruction *) out_sig->body.get_head()->next)->as_call();
+   ASSERT_TRUE(call != NULL);
+   EXPECT_EQ(out_helper_sig, call->callee);
+}
+
+TEST_F(ir_serialize_test, types)
+{
+   static const glsl_struct_field fields[] = {
+      glsl_struct_field(glsl_type::mat4_type, "mvp"),
+      glsl_struct_field(glsl_type::ivec2_type, "size"),
+   };
+   const glsl_type *const types[] = {
+      glsl_type::sampler2DShadow_type,
+      glsl_type::get_array_instance(glsl_type::dvec4_type, 7),
+      glsl_type::get_interface_instance(fields, ARRAY_SIZE(fields),
+                                        GLSL_INTERFACE_PACKING_STD140,
+                                        "transforms"),
+      glsl_type::get_array_instance(
+         glsl_type::get_record_instance(fields, ARRAY_SIZE(fields), "xf"), 2),
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(types); i++)
+      ASSERT_TRUE(serialize_glsl_type(blob, types[i]));
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob->data, blob->size);
+   for (unsigned i = 0; i < ARRAY_SIZE(types); i++)
+      EXPECT_EQ(types[i], deserialize_glsl_type(&reader));
+   EXPECT_EQ(reader.end, reader.current);
+}
+
+TEST_F(ir_serialize_test, truncated_data_is_rejected)
+{
+   ir_variable *color = new(mem_ctx) ir_variable(glsl_type::vec4_type,
+                                                 "color", ir_var_shader_out);
+   ir.push_tail(color);
+
+   ir_function *f = new(mem_ctx) ir_function("main");
+   ir_function_signature *sig =
+      new(mem_ctx) ir_function_signature(glsl_type::void_type);
+   sig->is_defined = true;
+   f->add_signature(sig);
+   ir.push_tail(f);
+
+   ir_factory body(&sig->body, mem_ctx);
+   body.emit(assign(color, body.constant(0.25f), WRITEMASK_W));
+
+   ASSERT_TRUE(serialize_ir_list(blob, &ir));
+
+   for (size_t size = 0; size < blob->size; size++) {
+      struct blob_reader reader;
+      exec_list partial;
+
+      blob_reader_init(&reader, blob->data, size);
+      EXPECT_FALSE(deserialize_ir_list(&reader, mem_ctx, &partial) &&
+                   reader.current == reader.end)
+         << "accepted " << size << " of " << blob->size << " bytes";
+   }
+}
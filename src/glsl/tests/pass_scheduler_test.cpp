@@ -0,0 +1,301 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "ir.h"
+#include "ir_optimization.h"
+#include "ir_pass_scheduler.h"
+#include "ir_print_visitor.h"
+#include "glsl_symbol_table.h"
+#include "loop_analysis.h"
+#include "program/hash_table.h"
+#include "standalone_scaffolding.h"
+
+/**
+ * \file pass_scheduler_test.cpp
+ *
+ * Runs \c ir_pass_scheduler and the old loop on \c do_common_optimization
+ * over copies of the built-in functions with real bodies, and checks that
+ * every function comes out the same.
+ *
+ * The scheduler skips a pass when no pass has reported progress since the
+ * pass last found nothing to do, so a pass that changes the IR without
+ * saying so can make it stop early.  The progress tests check that none of
+ * the passes do that on the built-in functions.
+ */
+
+class pass_scheduler_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   void compare(bool aos);
+   void check_progress(bool aos);
+
+   void *mem_ctx;
+   struct gl_context ctx;
+   exec_list old_ir;
+   exec_list new_ir;
+};
+
+/**
+ * Built-in functions implemented with more than a single expression, so
+ * that the passes have something to do.
+ */
+static const char *const builtin_names[] = {
+   "radians", "degrees", "sin", "cos", "tan", "asin", "acos", "atan",
+   "sinh", "cosh", "tanh", "asinh", "acosh", "atanh",
+   "pow", "exp", "log", "exp2", "log2", "sqrt", "inversesqrt",
+   "abs", "sign", "floor", "trunc", "round", "roundEven", "ceil", "fract",
+   "mod", "modf", "min", "max", "clamp", "mix", "step", "smoothstep",
+   "isnan", "isinf", "floatBitsToInt", "intBitsToFloat", "fma", "frexp",
+   "ldexp", "min3", "max3", "mid3",
+   "packUnorm2x16", "packSnorm2x16", "packUnorm4x8", "packSnorm4x8",
+   "unpackUnorm2x16", "unpackSnorm2x16", "unpackUnorm4x8", "unpackSnorm4x8",
+   "packHalf2x16", "unpackHalf2x16",
+   "length", "distance", "dot", "cross", "normalize", "ftransform",
+   "faceforward", "reflect", "refract",
+   "matrixCompMult", "outerProduct", "transpose", "determinant", "inverse",
+   "lessThan", "equal", "any", "all", "not",
+   "bitfieldExtract", "bitfieldInsert", "bitfieldReverse", "bitCount",
+   "findLSB", "findMSB", "uaddCarry", "usubBorrow", "umulExtended",
+   "imulExtended", "dFdx", "fwidth",
+};
+
+void
+pass_scheduler_test::SetUp()
+{
+   mem_ctx = ralloc_context(NULL);
+   initialize_context_to_defaults(&ctx, API_OPENGL_CORE);
+
+   _mesa_glsl_initialize_builtin_functions();
+   gl_shader *builtins = _mesa_glsl_get_builtin_function_shader();
+
+   for (unsigned i = 0; i < ARRAY_SIZE(builtin_names); i++) {
+      ir_function *f = builtins->symbols->get_function(builtin_names[i]);
+      ASSERT_TRUE(f != NULL) << builtin_names[i];
+
+      /* Calls to other built-ins keep pointing at the originals, which the
+       * passes don't change.
+       */
+      struct hash_table *ht =
+         hash_table_ctor(0, hash_table_pointer_hash,
+                         hash_table_pointer_compare);
+      old_ir.push_tail(f->clone(mem_ctx, ht));
+      hash_table_clear(ht);
+      new_ir.push_tail(f->clone(mem_ctx, ht));
+      hash_table_dtor(ht);
+   }
+}
+
+void
+pass_scheduler_test::TearDown()
+{
+   ralloc_free(mem_ctx);
+   mem_ctx = NULL;
+
+   _mesa_glsl_release_builtin_functions();
+}
+
+/**
+ * Prints \p ir, dropping the "@N" suffixes which \c ir_print_visitor numbers
+ * clashing names with, as the numbering is global.
+ */
+static std::string
+print(ir_instruction *ir)
+{
+   FILE *f = tmpfile();
+   ir_print_visitor v(f);
+   ir->accept(&v);
+
+   std::string s;
+   bool skip_digits = false;
+   rewind(f);
+   for (int c = fgetc(f); c != EOF; c = fgetc(f)) {
+      if (skip_digits && c >= '0' && c <= '9')
+         continue;
+      skip_digits = c == '@';
+      s += (char) c;
+   }
+   fclose(f);
+
+   return s;
+}
+
+/**
+ * The function that \c common_optimization is checking the passes on, and
+ * how it looked after the last pass.
+ */
+struct progress_check {
+   ir_function *f;
+   std::string before;
+};
+
+/**
+ * Fails the test if \p pass changed \c check->f but returned false.
+ */
+static bool
+checked(progress_check *check, const char *pass, bool progress)
+{
+   if (check == NULL)
+      return progress;
+
+   const std::string after = print(check->f);
+   EXPECT_TRUE(progress || after == check->before)
+      << pass << " changed " << check->f->name << " without reporting it:\n"
+      << "--- before\n" << check->before << "--- after\n" << after;
+   check->before = after;
+
+   return progress;
+}
+
+#define PASS(call) checked(check, #call, call)
+
+/**
+ * The passes of \c do_common_optimization for unlinked shaders, run over the
+ * whole IR without skipping any.
+ */
+static bool
+common_optimization(exec_list *ir,
+                    const struct gl_shader_compiler_options *options,
+                    progress_check *check = NULL)
+{
+   bool progress = false;
+
+   if (check != NULL)
+      check->before = print(check->f);
+
+   progress = PASS(lower_instructions(ir, SUB_TO_ADD_NEG)) || progress;
+   progress = PASS(do_if_simplification(ir)) || progress;
+   progress = PASS(opt_flatten_nested_if_blocks(ir)) || progress;
+   progress = PASS(opt_conditional_discard(ir)) || progress;
+   progress = PASS(do_copy_propagation(ir)) || progress;
+   progress = PASS(do_copy_propagation_elements(ir)) || progress;
+   if (options->OptimizeForAOS)
+      progress = PASS(opt_flip_matrices(ir)) || progress;
+   progress = PASS(do_dead_code_unlinked(ir)) || progress;
+   progress = PASS(do_dead_code_local(ir)) || progress;
+   progress = PASS(do_tree_grafting(ir)) || progress;
+   progress = PASS(do_constant_propagation(ir)) || progress;
+   progress = PASS(do_constant_variable_unlinked(ir)) || progress;
+   progress = PASS(do_constant_folding(ir)) || progress;
+   progress = PASS(do_minmax_prune(ir)) || progress;
+   progress = PASS(do_rebalance_tree(ir)) || progress;
+   progress = PASS(do_algebraic(ir, true, options)) || progress;
+   progress = PASS(do_lower_jumps(ir)) || progress;
+   progress = PASS(do_vec_index_to_swizzle(ir)) || progress;
+   progress = PASS(lower_vector_insert(ir, false)) || progress;
+   progress = PASS(do_swizzle_swizzle(ir)) || progress;
+   progress = PASS(do_noop_swizzle(ir)) || progress;
+   progress = PASS(optimize_split_arrays(ir, false)) || progress;
+   progress = PASS(optimize_redundant_jumps(ir)) || progress;
+
+   loop_state *ls = analyze_loop_variables(ir);
+   if (ls->loop_found) {
+      progress = PASS(set_loop_controls(ir, ls)) || progress;
+      progress = PASS(unroll_loops(ir, ls, options)) || progress;
+   }
+   delete ls;
+
+   return progress;
+}
+
+#undef PASS
+
+void
+pass_scheduler_test::compare(bool aos)
+{
+   struct gl_shader_compiler_options options =
+      ctx.Const.ShaderCompilerOptions[MESA_SHADER_VERTEX];
+   options.OptimizeForAOS = aos;
+
+   while (common_optimization(&old_ir, &options))
+      ;
+
+   ir_pass_scheduler passes(false, false, &options, true);
+   passes.run(&new_ir);
+
+   exec_node *new_node = new_ir.head;
+   foreach_in_list(ir_instruction, old_node, &old_ir) {
+      ASSERT_FALSE(new_node->is_tail_sentinel());
+
+      EXPECT_EQ(print(old_node), print((ir_instruction *) new_node))
+         << "in " << old_node->as_function()->name;
+
+      new_node = new_node->get_next();
+   }
+   EXPECT_TRUE(new_node->is_tail_sentinel());
+}
+
+/**
+ * Optimizes each function on its own, as the scheduler does, checking after
+ * every pass that it reported the changes it made.
+ */
+void
+pass_scheduler_test::check_progress(bool aos)
+{
+   struct gl_shader_compiler_options options =
+      ctx.Const.ShaderCompilerOptions[MESA_SHADER_VERTEX];
+   options.OptimizeForAOS = aos;
+
+   foreach_in_list(ir_instruction, node, &old_ir) {
+      ir_function *f = node->as_function();
+      if (f == NULL)
+         continue;
+
+      exec_node *prev = f->prev;
+      exec_list single;
+      f->remove();
+      single.push_tail(f);
+
+      progress_check check;
+      check.f = f;
+      while (common_optimization(&single, &options, &check))
+         ;
+
+      f->remove();
+      prev->insert_after(f);
+   }
+}
+
+TEST_F(pass_scheduler_test, unlinked)
+{
+   compare(false);
+}
+
+TEST_F(pass_scheduler_test, unlinked_aos)
+{
+   compare(true);
+}
+
+TEST_F(pass_scheduler_test, progress)
+{
+   check_progress(false);
+}
+
+TEST_F(pass_scheduler_test, progress_aos)
+{
+   check_progress(true);
+}
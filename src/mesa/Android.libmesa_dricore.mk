@@ -49,8 +49,7 @@ endif # MESA_ENABLE_ASM
 
 ifeq ($(ARCH_X86_HAVE_SSE4_1),true)
 LOCAL_SRC_FILES += \
-	main/streaming-load-memcpy.c \
-	main/sse_minmax.c
+	main/streaming-load-memcpy.c
 LOCAL_CFLAGS := \
 	-msse4.1 \
        -DUSE_SSE41
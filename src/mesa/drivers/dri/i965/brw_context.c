@@ -69,6 +69,7 @@
 #include "tnl/tnl.h"
 #include "tnl/t_pipeline.h"
 #include "util/ralloc.h"
+#include "util/thread_pool.h"
 
 /***************************************
  * Mesa's Driver Functions
@@ -922,6 +923,12 @@ brwCreateContext(gl_api api,
       (brw_env_var_as_boolean("INTEL_USE_HW_BT", false) ||
        brw_env_var_as_boolean("INTEL_USE_GATHER", false));
 
+   const char *link_threads = getenv("INTEL_LINK_THREADS");
+   unsigned num_link_threads =
+      link_threads ? strtoul(link_threads, NULL, 10) : 0;
+   if (num_link_threads > 0)
+      brw->link_pool = thread_pool_create(num_link_threads);
+
    ctx->VertexProgram._MaintainTnlProgram = true;
    ctx->FragmentProgram._MaintainTexEnvProgram = true;
 
@@ -1011,6 +1018,8 @@ intelDestroyContext(__DRIcontext * driContextPriv)
    brw->throttle_batch[1] = NULL;
    brw->throttle_batch[0] = NULL;
 
+   thread_pool_destroy(brw->link_pool);
+
    driDestroyOptionCache(&brw->optionCache);
 
    /* free the Mesa context */
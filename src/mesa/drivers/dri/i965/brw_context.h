@@ -806,6 +806,12 @@ struct brw_context
    driOptionCache optionCache;
    /** @} */
 
+   /**
+    * Threads compiling the stages of a program to NIR at link time, or NULL
+    * to compile them one after another (see INTEL_LINK_THREADS).
+    */
+   struct thread_pool *link_pool;
+
    GLuint primitive; /**< Hardware primitive, such as _3DPRIM_TRILIST. */
 
    GLenum reduced_primitive;
@@ -29,8 +29,10 @@
 #include "brw_cfg.h"
 #include "brw_nir.h"
 #include "glsl/ir_optimization.h"
+#include "glsl/ir_pass_scheduler.h"
 #include "glsl/glsl_parser_extras.h"
 #include "main/shaderapi.h"
+#include "util/thread_pool.h"
 
 /**
  * Performs a compile of the shader stages even when we don't know
@@ -160,13 +162,22 @@ process_glsl_ir(gl_shader_stage stage,
                  _mesa_shader_stage_to_abbrev(shader->Stage));
    }
 
+   ir_pass_scheduler passes(true, true, options, ctx->Const.NativeIntegers);
+   if (ctx->_Shader->Flags & GLSL_PASS_STATS) {
+      char *name = ralloc_asprintf(mem_ctx, "i965 %s shader of program %u",
+                                   _mesa_shader_stage_to_string(shader->Stage),
+                                   shader_prog->Name);
+      passes.enable_stats(name);
+   }
+
    bool progress;
    do {
       progress = false;
+      bool changed = false;
 
       if (compiler->scalar_stage[shader->Stage]) {
-         brw_do_channel_expressions(shader->ir);
-         brw_do_vector_splitting(shader->ir);
+         changed = brw_do_channel_expressions(shader->ir) || changed;
+         changed = brw_do_vector_splitting(shader->ir) || changed;
       }
 
       progress = do_lower_jumps(shader->ir, true, true,
@@ -175,8 +186,11 @@ process_glsl_ir(gl_shader_stage stage,
                                 false /* loops */
                                 ) || progress;
 
-      progress = do_common_optimization(shader->ir, true, true,
-                                        options, ctx->Const.NativeIntegers) || progress;
+      /* Tell the scheduler about what the other passes changed. */
+      if (changed || progress)
+         passes.invalidate();
+
+      progress = passes.run_once(shader->ir) || progress;
    } while (progress);
 
    validate_ir_tree(shader->ir);
@@ -198,11 +212,31 @@ process_glsl_ir(gl_shader_stage stage,
    }
 }
 
+struct create_nir_job {
+   struct brw_context *brw;
+   struct gl_shader_program *shProg;
+   struct gl_program *prog;
+   gl_shader_stage stage;
+};
+
+static void
+create_nir(void *data, unsigned index)
+{
+   struct create_nir_job *job = &((struct create_nir_job *) data)[index];
+   const struct brw_compiler *compiler = job->brw->intelScreen->compiler;
+
+   job->prog->nir = brw_create_nir(job->brw, job->shProg, job->prog,
+                                   job->stage,
+                                   compiler->scalar_stage[job->stage]);
+}
+
 GLboolean
 brw_link_shader(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
    struct brw_context *brw = brw_context(ctx);
-   const struct brw_compiler *compiler = brw->intelScreen->compiler;
+   struct create_nir_job jobs[MESA_SHADER_STAGES];
+   struct thread_pool *pool = brw->link_pool;
+   unsigned int num_jobs = 0;
    unsigned int stage;
 
    for (stage = 0; stage < ARRAY_SIZE(shProg->_LinkedShaders); stage++) {
@@ -213,8 +247,11 @@ brw_link_shader(struct gl_context *ctx, struct gl_shader_program *shProg)
       struct gl_program *prog =
 	 ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(stage),
                                 shader->Name);
-      if (!prog)
-	return false;
+      if (!prog) {
+         for (unsigned i = 0; i < num_jobs; i++)
+            _mesa_reference_program(ctx, &jobs[i].prog, NULL);
+	 return false;
+      }
       prog->Parameters = _mesa_new_parameter_list();
 
       _mesa_copy_linked_program_data((gl_shader_stage) stage, shProg, prog);
@@ -254,12 +291,26 @@ brw_link_shader(struct gl_context *ctx, struct gl_shader_program *shProg)
 
       brw_add_texrect_params(prog);
 
-      prog->nir = brw_create_nir(brw, shProg, prog, (gl_shader_stage) stage,
-                                 compiler->scalar_stage[stage]);
+      /* Keep NIR debug output of different stages from interleaving. */
+      if (INTEL_DEBUG &
+          intel_debug_flag_for_shader_stage((gl_shader_stage) stage))
+         pool = NULL;
 
-      _mesa_reference_program(ctx, &prog, NULL);
+      jobs[num_jobs].brw = brw;
+      jobs[num_jobs].shProg = shProg;
+      jobs[num_jobs].prog = prog;
+      jobs[num_jobs].stage = (gl_shader_stage) stage;
+      num_jobs++;
    }
 
+   /* Lowering the stages to NIR and optimizing them only reads the GL state
+    * set up above, so the stages can be compiled in parallel.
+    */
+   thread_pool_run(pool, create_nir, jobs, num_jobs);
+
+   for (unsigned i = 0; i < num_jobs; i++)
+      _mesa_reference_program(ctx, &jobs[i].prog, NULL);
+
    if ((ctx->_Shader->Flags & GLSL_DUMP) && shProg->Name != 0) {
       for (unsigned i = 0; i < shProg->NumShaders; i++) {
          const struct gl_shader *sh = shProg->Shaders[i];
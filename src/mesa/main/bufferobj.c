@@ -43,6 +43,7 @@
 #include "glformats.h"
 #include "texstore.h"
 #include "transformfeedback.h"
+#include "util/index_range.h"
 
 
 /* Debug flags */
@@ -454,6 +455,22 @@ _mesa_reference_buffer_object_(struct gl_context *ctx,
       mtx_unlock(&oldObj->Mutex);
 
       if (deleteFlag) {
+         /* Drivers override DeleteBuffer, so release the state that is
+          * private to core Mesa here.
+          */
+         if (oldObj->MinMaxCache) {
+            const struct index_range_cache *cache = oldObj->MinMaxCache;
+
+            if (MESA_VERBOSE & VERBOSE_DRAW)
+               _mesa_debug(ctx, "buffer %u: min/max index cache hit %" PRIu64
+                           " of %" PRIu64 " indices\n", oldObj->Name,
+                           cache->hit_indices,
+                           cache->hit_indices + cache->miss_indices);
+
+            _mesa_index_range_cache_destroy(oldObj->MinMaxCache);
+            oldObj->MinMaxCache = NULL;
+         }
+
 	 assert(ctx->Driver.DeleteBuffer);
          ctx->Driver.DeleteBuffer(ctx, oldObj);
       }
@@ -970,6 +987,12 @@ bind_buffer_object(struct gl_context *ctx, GLenum target, GLuint buffer)
          return;
    }
 
+   /* glReadPixels and friends write to pixel pack buffers without going
+    * through this file, so index ranges in such buffers can't be cached.
+    */
+   if (target == GL_PIXEL_PACK_BUFFER)
+      newBufObj->UsageHistory |= USAGE_PIXEL_PACK_BUFFER;
+
    /* bind new buffer */
    _mesa_reference_buffer_object(ctx, bindTarget, newBufObj);
 }
@@ -1469,6 +1492,7 @@ _mesa_buffer_storage(struct gl_context *ctx, struct gl_buffer_object *bufObj,
 
    bufObj->Written = GL_TRUE;
    bufObj->Immutable = GL_TRUE;
+   bufObj->MinMaxCacheDirty = true;
 
    assert(ctx->Driver.BufferData);
    if (!ctx->Driver.BufferData(ctx, target, size, data, GL_DYNAMIC_DRAW,
@@ -1581,6 +1605,7 @@ _mesa_buffer_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    FLUSH_VERTICES(ctx, _NEW_BUFFER_OBJECT);
 
    bufObj->Written = GL_TRUE;
+   bufObj->MinMaxCacheDirty = true;
 
 #ifdef VBO_DEBUG
    printf("glBufferDataARB(%u, sz %ld, from %p, usage 0x%x)\n",
@@ -1678,6 +1703,7 @@ _mesa_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
       return;
 
    bufObj->Written = GL_TRUE;
+   bufObj->MinMaxCacheDirty = true;
 
    assert(ctx->Driver.BufferSubData);
    ctx->Driver.BufferSubData(ctx, offset, size, data, bufObj);
@@ -1793,6 +1819,9 @@ _mesa_clear_buffer_sub_data(struct gl_context *ctx,
       return;
    }
 
+   if (size > 0)
+      bufObj->MinMaxCacheDirty = true;
+
    if (data == NULL) {
       /* clear to zeros, per the spec */
       if (size > 0) {
@@ -2210,6 +2239,8 @@ _mesa_copy_buffer_sub_data(struct gl_context *ctx,
       }
    }
 
+   dst->MinMaxCacheDirty = true;
+
    ctx->Driver.CopyBufferSubData(ctx, src, dst, readOffset, writeOffset, size);
 }
 
@@ -2402,8 +2433,10 @@ _mesa_map_buffer_range(struct gl_context *ctx,
       assert(bufObj->Mappings[MAP_USER].AccessFlags == access);
    }
 
-   if (access & GL_MAP_WRITE_BIT)
+   if (access & GL_MAP_WRITE_BIT) {
       bufObj->Written = GL_TRUE;
+      bufObj->MinMaxCacheDirty = true;
+   }
 
 #ifdef VBO_DEBUG
    if (strstr(func, "Range") == NULL) { /* If not MapRange */
@@ -38,6 +38,7 @@
 #include "main/uniforms.h"
 #include "glsl/ir_builder.h"
 #include "glsl/ir_optimization.h"
+#include "glsl/ir_pass_scheduler.h"
 #include "glsl/glsl_parser_extras.h"
 #include "glsl/glsl_symbol_table.h"
 #include "glsl/nir/glsl_types.h"
@@ -1249,9 +1250,10 @@ create_new_program(struct gl_context *ctx, struct state_key *key)
    const struct gl_shader_compiler_options *options =
       &ctx->Const.ShaderCompilerOptions[MESA_SHADER_FRAGMENT];
 
-   while (do_common_optimization(p.shader->ir, false, false, options,
-                                 ctx->Const.NativeIntegers))
-      ;
+   ir_pass_scheduler passes(false, false, options, ctx->Const.NativeIntegers);
+   if (ctx->_Shader->Flags & GLSL_PASS_STATS)
+      passes.enable_stats("fixed-function fragment shader");
+   passes.run(p.shader->ir);
    reparent_ir(p.shader->ir, p.shader->ir);
 
    p.shader->CompileStatus = true;
@@ -86,6 +86,7 @@ struct gl_program_parameter_list;
 struct set;
 struct set_entry;
 struct vbo_context;
+struct index_range_cache;
 /*@}*/
 
 
@@ -1253,6 +1254,9 @@ typedef enum {
    USAGE_TEXTURE_BUFFER = 0x2,
    USAGE_ATOMIC_COUNTER_BUFFER = 0x4,
    USAGE_SHADER_STORAGE_BUFFER = 0x8,
+   USAGE_TRANSFORM_FEEDBACK_BUFFER = 0x10,
+   USAGE_PIXEL_PACK_BUFFER = 0x20,
+   USAGE_DISABLE_MINMAX_CACHE = 0x40,
 } gl_buffer_usage;
 
 
@@ -1275,6 +1279,10 @@ struct gl_buffer_object
    GLboolean Immutable; /**< GL_ARB_buffer_storage */
    gl_buffer_usage UsageHistory; /**< How has this buffer been used so far? */
 
+   /** Memoization of min/max index computations for static index buffers */
+   struct index_range_cache *MinMaxCache;
+   bool MinMaxCacheDirty;
+
    struct gl_buffer_mapping Mappings[MAP_COUNT];
 };
 
@@ -2214,6 +2222,11 @@ struct gl_shader
    GLchar *Label;   /**< GL_KHR_debug */
    GLboolean DeletePending;
    GLboolean CompileStatus;
+   /**
+    * CompileStatus came from the GLSL program cache and the shader has not
+    * actually been compiled yet; see program/glsl_cache.h.
+    */
+   bool CompileDeferred;
    bool IsES;              /**< True if this shader uses GLSL ES */
 
    GLuint SourceChecksum;       /**< for debug/logging purposes */
@@ -2778,6 +2791,7 @@ struct gl_shader_program
 #define GLSL_USE_PROG 0x80  /**< Log glUseProgram calls */
 #define GLSL_REPORT_ERRORS 0x100  /**< Print compilation errors */
 #define GLSL_DUMP_ON_ERROR 0x200 /**< Dump shaders to stderr on compile error */
+#define GLSL_PASS_STATS 0x400  /**< Print optimization pass statistics */
 
 
 /**
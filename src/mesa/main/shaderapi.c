@@ -53,6 +53,7 @@
 #include "glsl/ir.h"
 #include "glsl/ir_uniform.h"
 #include "glsl/program.h"
+#include "program/glsl_cache.h"
 #include "program/program.h"
 #include "program/prog_print.h"
 #include "program/prog_parameter.h"
@@ -91,6 +92,8 @@ _mesa_get_shader_flags(void)
          flags |= GLSL_USE_PROG;
       if (strstr(env, "errors"))
          flags |= GLSL_REPORT_ERRORS;
+      if (strstr(env, "passes"))
+         flags |= GLSL_PASS_STATS;
    }
 
    return flags;
@@ -949,6 +952,7 @@ shader_source(struct gl_shader *sh, const GLchar *source)
    free((void *)sh->Source);
    sh->Source = source;
    sh->CompileStatus = GL_FALSE;
+   sh->CompileDeferred = false;
 #ifdef DEBUG
    sh->SourceChecksum = _mesa_str_checksum(sh->Source);
 #endif
@@ -982,7 +986,11 @@ compile_shader(struct gl_context *ctx, GLuint shaderObj)
       /* this call will set the shader->CompileStatus field to indicate if
        * compilation was successful.
        */
-      _mesa_glsl_compile_shader(ctx, sh, false, false);
+      if (!_mesa_glsl_cache_skip_compile(ctx, sh)) {
+         sh->CompileDeferred = false;
+         _mesa_glsl_compile_shader(ctx, sh, false, false);
+         _mesa_glsl_cache_store_shader(ctx, sh);
+      }
 
       if (ctx->_Shader->Flags & GLSL_LOG) {
          _mesa_write_shader_to_file(sh);
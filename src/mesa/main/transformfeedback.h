@@ -142,6 +142,8 @@ _mesa_set_transform_feedback_binding(struct gl_context *ctx,
 {
    _mesa_reference_buffer_object(ctx, &tfObj->Buffers[index], bufObj);
 
+   bufObj->UsageHistory |= USAGE_TRANSFORM_FEEDBACK_BUFFER;
+
    tfObj->BufferNames[index]   = bufObj->Name;
    tfObj->Offset[index]        = offset;
    tfObj->RequestedSize[index] = size;
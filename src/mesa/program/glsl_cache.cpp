@@ -0,0 +1,1281 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file glsl_cache.cpp
+ *
+ * Each cache entry is a file named after the hex SHA-1 of its key.  The file
+ * starts with a small header holding the SHA-1 of the payload, so truncated
+ * or otherwise damaged files are rejected before they are parsed.  Entries
+ * are written to a temporary file and renamed into place, which makes the
+ * cache safe to share between processes.
+ *
+ * The payload of a program entry mirrors what \c link_shaders leaves behind
+ * in \c gl_shader_program and its linked \c gl_shader objects.  Anything
+ * derived from that state (the program resource list, driver storage, the
+ * driver's own compiled code) is rebuilt by the normal post-link path.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#if defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#endif
+
+#include "main/mtypes.h"
+#include "main/shaderobj.h"
+#include "glsl/blob.h"
+#include "glsl/ir.h"
+#include "glsl/ir_serialize.h"
+#include "glsl/ir_uniform.h"
+#include "glsl/linker.h"
+#include "glsl/program.h"
+#include "program/glsl_cache.h"
+#include "program/hash_table.h"
+#include "util/mesa-sha1.h"
+#include "util/ralloc.h"
+
+
+void
+_mesa_glsl_cache_compile_deferred(struct gl_context *ctx,
+                                  struct gl_shader_program *prog)
+{
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      struct gl_shader *sh = prog->Shaders[i];
+
+      if (!sh->CompileDeferred)
+         continue;
+
+      sh->CompileDeferred = false;
+      _mesa_glsl_compile_shader(ctx, sh, false, false);
+
+      if (!sh->CompileStatus)
+         linker_error(prog, "linking with uncompiled shader");
+   }
+}
+
+
+#if defined(HAVE_SHA1) && !defined(_WIN32)
+
+#define CACHE_MAGIC   0x4843534d /* "MSCH" */
+#define CACHE_VERSION 1
+
+struct cache_header {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t size;
+   unsigned char sha1[20];
+};
+
+
+/**
+ * Return the cache directory, or NULL if the cache is disabled.
+ */
+static const char *
+get_cache_dir(void)
+{
+   static bool first = true;
+   static const char *dir;
+
+   if (first) {
+      first = false;
+      dir = getenv("MESA_GLSL_CACHE_DIR");
+      /* Failure (most likely EEXIST) shows up on first store anyway. */
+      if (dir)
+         mkdir(dir, 0755);
+   }
+   return dir;
+}
+
+
+static bool
+cache_enabled(const struct gl_context *ctx)
+{
+   /* Dumping and logging expect to see the compiler run. */
+   return get_cache_dir() != NULL &&
+          !(ctx->_Shader->Flags & (GLSL_DUMP | GLSL_LOG));
+}
+
+
+static void
+hash_string(struct mesa_sha1 *key, const char *str)
+{
+   const uint32_t len = strlen(str);
+
+   _mesa_sha1_update(key, &len, sizeof len);
+   _mesa_sha1_update(key, str, len);
+}
+
+
+/**
+ * Hash everything outside of the shader sources which may change the
+ * outcome of compiling and linking them: the build itself, and the
+ * context's API, limits, extensions and debug flags.
+ */
+static void
+hash_build_and_context(struct mesa_sha1 *key, const struct gl_context *ctx)
+{
+   const unsigned version = CACHE_VERSION;
+   struct gl_constants consts;
+   struct gl_extensions exts;
+
+#ifdef PACKAGE_VERSION
+   _mesa_sha1_update(key, PACKAGE_VERSION, sizeof PACKAGE_VERSION);
+#endif
+
+#if defined(HAVE_DLADDR)
+   {
+      /* Compiler changes don't bump any version, so use the timestamp of
+       * the library we were loaded from.
+       */
+      Dl_info info;
+      struct stat st;
+
+      if (dladdr((void *) hash_build_and_context, &info) &&
+          info.dli_fname && stat(info.dli_fname, &st) == 0) {
+         _mesa_sha1_update(key, &st.st_mtime, sizeof st.st_mtime);
+         _mesa_sha1_update(key, &st.st_size, sizeof st.st_size);
+      }
+   }
+#endif
+
+   _mesa_sha1_update(key, &version, sizeof version);
+   _mesa_sha1_update(key, &ctx->API, sizeof ctx->API);
+   _mesa_sha1_update(key, &ctx->Version, sizeof ctx->Version);
+
+   /* Copy with memcpy so that padding is hashed as it is in the context,
+    * which is calloc'ed.  Pointers differ from run to run, so clear them.
+    */
+   memcpy(&consts, &ctx->Const, sizeof consts);
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      consts.ShaderCompilerOptions[i].NirOptions = NULL;
+   _mesa_sha1_update(key, &consts, sizeof consts);
+
+   memcpy(&exts, &ctx->Extensions, sizeof exts);
+   exts.String = NULL;
+   _mesa_sha1_update(key, &exts, sizeof exts);
+
+   _mesa_sha1_update(key, &ctx->_Shader->Flags, sizeof ctx->_Shader->Flags);
+}
+
+
+static struct mesa_sha1 *
+key_create(const struct gl_context *ctx, const char *kind)
+{
+   struct mesa_sha1 *key = _mesa_sha1_init();
+
+   if (key) {
+      hash_build_and_context(key, ctx);
+      hash_string(key, kind);
+   }
+   return key;
+}
+
+
+/**
+ * Finalize (and free) the key, and build the path of its cache file.
+ */
+static bool
+key_path(struct mesa_sha1 *key, char *path, size_t size)
+{
+   unsigned char sha1[20];
+   char sha1_str[41];
+   int len;
+
+   if (!_mesa_sha1_final(key, sha1))
+      return false;
+
+   _mesa_sha1_format(sha1_str, sha1);
+   len = snprintf(path, size, "%s/%s", get_cache_dir(), sha1_str);
+   return len > 0 && (size_t) len < size;
+}
+
+
+static bool
+shader_key_path(const struct gl_context *ctx, const struct gl_shader *sh,
+                char *path, size_t size)
+{
+   struct mesa_sha1 *key = key_create(ctx, "shader");
+
+   if (!key)
+      return false;
+
+   _mesa_sha1_update(key, &sh->Stage, sizeof sh->Stage);
+   hash_string(key, sh->Source);
+   return key_path(key, path, size);
+}
+
+
+struct binding {
+   const char *name;
+   unsigned value;
+};
+
+struct binding_list {
+   struct binding *bindings;
+   unsigned count;
+};
+
+static void
+collect_binding(const char *name, unsigned value, void *closure)
+{
+   struct binding_list *list = (struct binding_list *) closure;
+
+   list->bindings = reralloc(NULL, list->bindings, struct binding,
+                             list->count + 1);
+   list->bindings[list->count].name = name;
+   list->bindings[list->count].value = value;
+   list->count++;
+}
+
+static int
+compare_binding(const void *a, const void *b)
+{
+   return strcmp(((const struct binding *) a)->name,
+                 ((const struct binding *) b)->name);
+}
+
+/**
+ * Hash a binding map in a stable order; the hash table's iteration order
+ * depends on the insertion order.
+ */
+static void
+hash_bindings(struct mesa_sha1 *key, struct string_to_uint_map *map)
+{
+   struct binding_list list = { NULL, 0 };
+
+   map->iterate(collect_binding, &list);
+   if (list.count > 0)
+      qsort(list.bindings, list.count, sizeof(*list.bindings),
+            compare_binding);
+
+   _mesa_sha1_update(key, &list.count, sizeof list.count);
+   for (unsigned i = 0; i < list.count; i++) {
+      hash_string(key, list.bindings[i].name);
+      _mesa_sha1_update(key, &list.bindings[i].value,
+                        sizeof list.bindings[i].value);
+   }
+   ralloc_free(list.bindings);
+}
+
+
+static bool
+program_key_path(const struct gl_context *ctx,
+                 struct gl_shader_program *prog,
+                 char *path, size_t size)
+{
+   /* Shaders built from IR (fixed-function) have nothing to key on. */
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      if (prog->Shaders[i]->Source == NULL)
+         return false;
+   }
+
+   struct mesa_sha1 *key = key_create(ctx, "program");
+
+   if (!key)
+      return false;
+
+   _mesa_sha1_update(key, &prog->NumShaders, sizeof prog->NumShaders);
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      _mesa_sha1_update(key, &prog->Shaders[i]->Stage,
+                        sizeof prog->Shaders[i]->Stage);
+      hash_string(key, prog->Shaders[i]->Source);
+   }
+
+   _mesa_sha1_update(key, &prog->SeparateShader, sizeof prog->SeparateShader);
+   hash_bindings(key, prog->AttributeBindings);
+   hash_bindings(key, prog->FragDataBindings);
+   hash_bindings(key, prog->FragDataIndexBindings);
+
+   _mesa_sha1_update(key, &prog->TransformFeedback.BufferMode,
+                     sizeof prog->TransformFeedback.BufferMode);
+   _mesa_sha1_update(key, &prog->TransformFeedback.NumVarying,
+                     sizeof prog->TransformFeedback.NumVarying);
+   for (unsigned i = 0; i < prog->TransformFeedback.NumVarying; i++)
+      hash_string(key, prog->TransformFeedback.VaryingNames[i]);
+
+   return key_path(key, path, size);
+}
+
+
+/**
+ * Read and check a cache file.
+ *
+ * \return the payload, to be released with free(), or NULL on a miss.
+ */
+static uint8_t *
+read_entry(const char *path, size_t *size)
+{
+   struct cache_header header;
+   unsigned char sha1[20];
+   uint8_t *data = NULL;
+   struct stat st;
+   FILE *fp;
+
+   fp = fopen(path, "rb");
+   if (!fp)
+      return NULL;
+
+   if (fstat(fileno(fp), &st) != 0 ||
+       fread(&header, sizeof header, 1, fp) != 1 ||
+       header.magic != CACHE_MAGIC ||
+       header.version != CACHE_VERSION ||
+       (off_t) (sizeof header + header.size) != st.st_size)
+      goto fail;
+
+   data = (uint8_t *) malloc(header.size ? header.size : 1);
+   if (!data || fread(data, 1, header.size, fp) != header.size)
+      goto fail;
+
+   _mesa_sha1_compute(data, header.size, sha1);
+   if (memcmp(sha1, header.sha1, sizeof sha1) != 0)
+      goto fail;
+
+   fclose(fp);
+   *size = header.size;
+   return data;
+
+fail:
+   free(data);
+   fclose(fp);
+   return NULL;
+}
+
+
+static void
+write_entry(const char *path, const struct blob *payload)
+{
+   struct cache_header header;
+   char tmp_path[PATH_MAX];
+   FILE *fp;
+   bool ok;
+
+   if (payload->size > UINT32_MAX)
+      return;
+
+   memset(&header, 0, sizeof header);
+   header.magic = CACHE_MAGIC;
+   header.version = CACHE_VERSION;
+   header.size = payload->size;
+   _mesa_sha1_compute(payload->data, payload->size, header.sha1);
+
+   snprintf(tmp_path, sizeof tmp_path, "%s.%u.tmp", path, (unsigned) getpid());
+
+   fp = fopen(tmp_path, "wb");
+   if (!fp)
+      return;
+
+   ok = fwrite(&header, sizeof header, 1, fp) == 1 &&
+        fwrite(payload->data, 1, payload->size, fp) == payload->size;
+   ok = fclose(fp) == 0 && ok;
+
+   if (!ok || rename(tmp_path, path) != 0)
+      unlink(tmp_path);
+}
+
+
+namespace {
+
+/**
+ * Thin wrapper around \c blob which remembers whether any write failed, so
+ * a partially written payload is never stored.
+ */
+class program_writer {
+public:
+   program_writer()
+      : blob(blob_create(NULL)), ok(blob != NULL)
+   {
+   }
+
+   ~program_writer()
+   {
+      ralloc_free(blob);
+   }
+
+   void u32(uint32_t value)
+   {
+      ok = ok && blob_write_uint32(blob, value);
+   }
+
+   void bytes(const void *data, size_t size)
+   {
+      ok = ok && blob_write_bytes(blob, data, size);
+   }
+
+   void str(const char *s)
+   {
+      u32(s != NULL);
+      if (s != NULL)
+         ok = ok && blob_write_string(blob, s);
+   }
+
+   void type(const glsl_type *t)
+   {
+      ok = ok && serialize_glsl_type(blob, t);
+   }
+
+   void ir(exec_list *list)
+   {
+      u32(list != NULL);
+      if (list != NULL)
+         ok = ok && serialize_ir_list(blob, list);
+   }
+
+   struct blob *blob;
+   bool ok;
+};
+
+
+class program_reader {
+public:
+   program_reader(uint8_t *data, size_t size)
+      : error(false)
+   {
+      blob_reader_init(&blob, data, size);
+   }
+
+   bool failed() const
+   {
+      return error || blob.overrun;
+   }
+
+   bool done() const
+   {
+      return !failed() && blob.current == blob.end;
+   }
+
+   uint32_t u32()
+   {
+      return blob_read_uint32(&blob);
+   }
+
+   /**
+    * Read an element count, rejecting counts that cannot possibly fit in
+    * the rest of the payload before anything gets allocated for them.
+    */
+   uint32_t count()
+   {
+      const uint32_t n = u32();
+
+      if (n > (size_t) (blob.end - blob.current)) {
+         error = true;
+         return 0;
+      }
+      return n;
+   }
+
+   void bytes(void *dest, size_t size)
+   {
+      blob_copy_bytes(&blob, (uint8_t *) dest, size);
+   }
+
+   char *str(void *mem_ctx)
+   {
+      if (!u32())
+         return NULL;
+
+      const char *s = blob_read_string(&blob);
+      return s ? ralloc_strdup(mem_ctx, s) : NULL;
+   }
+
+   const glsl_type *type()
+   {
+      const glsl_type *t = deserialize_glsl_type(&blob);
+
+      if (t == NULL)
+         error = true;
+      return t;
+   }
+
+   exec_list *ir(void *mem_ctx)
+   {
+      if (!u32())
+         return NULL;
+
+      exec_list *list = new(mem_ctx) exec_list;
+      if (!deserialize_ir_list(&blob, mem_ctx, list))
+         error = true;
+      return list;
+   }
+
+   struct blob_reader blob;
+   bool error;
+};
+
+} /* anonymous namespace */
+
+
+/* Plain fields of gl_shader_program and gl_shader set by the linker.  They
+ * are stored as raw bytes, which is fine since the cache is keyed on the
+ * build.
+ */
+#define PROGRAM_FIELDS(F)                        \
+   F(Version)                                    \
+   F(IsES)                                       \
+   F(ARB_fragment_coord_conventions_enable)      \
+   F(LastClipDistanceArraySize)                  \
+   F(FragDepthLayout)                            \
+   F(TessCtrl)                                   \
+   F(TessEval)                                   \
+   F(Geom)                                       \
+   F(Vert)                                       \
+   F(Comp)                                       \
+   F(NumHiddenUniforms)
+
+#define SHADER_FIELDS(F)                         \
+   F(Version)                                    \
+   F(IsES)                                       \
+   F(num_samplers)                               \
+   F(active_samplers)                            \
+   F(shadow_samplers)                            \
+   F(SamplerUnits)                               \
+   F(SamplerTargets)                             \
+   F(num_uniform_components)                     \
+   F(num_combined_uniform_components)            \
+   F(uses_builtin_functions)                     \
+   F(uses_gl_fragcoord)                          \
+   F(redeclares_gl_fragcoord)                    \
+   F(ARB_fragment_coord_conventions_enable)      \
+   F(origin_upper_left)                          \
+   F(pixel_center_integer)                       \
+   F(TessCtrl)                                   \
+   F(TessEval)                                   \
+   F(Geom)                                       \
+   F(ImageUnits)                                 \
+   F(ImageAccess)                                \
+   F(NumImages)                                  \
+   F(EarlyFragmentTests)                         \
+   F(Comp)                                       \
+   F(NumSubroutineUniformTypes)
+
+static const GLenum stage_type[MESA_SHADER_STAGES] = {
+   GL_VERTEX_SHADER,
+   GL_TESS_CONTROL_SHADER,
+   GL_TESS_EVALUATION_SHADER,
+   GL_GEOMETRY_SHADER,
+   GL_FRAGMENT_SHADER,
+   GL_COMPUTE_SHADER,
+};
+
+
+/**
+ * Number of gl_constant_value slots backing a uniform, as counted by
+ * values_for_type() in link_uniforms.cpp.
+ */
+static unsigned
+uniform_slots(const struct gl_uniform_storage *uni)
+{
+   const unsigned elements = uni->array_elements ? uni->array_elements : 1;
+
+   if (uni->type->is_sampler())
+      return elements;
+   return uni->type->component_slots() * elements;
+}
+
+
+/* References to gl_uniform_storage from the remap tables. */
+#define UNIFORM_REF_NULL     0
+#define UNIFORM_REF_INACTIVE 1
+#define UNIFORM_REF_BASE     2
+
+static void
+write_uniform_refs(program_writer &w, const struct gl_shader_program *prog,
+                   struct gl_uniform_storage **table, unsigned n)
+{
+   w.u32(n);
+   for (unsigned i = 0; i < n; i++) {
+      if (table[i] == NULL) {
+         w.u32(UNIFORM_REF_NULL);
+      } else if (table[i] == INACTIVE_UNIFORM_EXPLICIT_LOCATION) {
+         w.u32(UNIFORM_REF_INACTIVE);
+      } else {
+         const ptrdiff_t index = table[i] - prog->UniformStorage;
+
+         if (index < 0 || index >= (ptrdiff_t) prog->NumUniformStorage)
+            w.ok = false;
+         w.u32(UNIFORM_REF_BASE + index);
+      }
+   }
+}
+
+static struct gl_uniform_storage **
+read_uniform_refs(program_reader &r, const struct gl_shader_program *prog,
+                  void *mem_ctx, unsigned *n)
+{
+   *n = r.count();
+   if (*n == 0)
+      return NULL;
+
+   struct gl_uniform_storage **table =
+      ralloc_array(mem_ctx, struct gl_uniform_storage *, *n);
+
+   for (unsigned i = 0; i < *n; i++) {
+      const uint32_t ref = r.u32();
+
+      if (ref == UNIFORM_REF_NULL) {
+         table[i] = NULL;
+      } else if (ref == UNIFORM_REF_INACTIVE) {
+         table[i] = INACTIVE_UNIFORM_EXPLICIT_LOCATION;
+      } else if (ref - UNIFORM_REF_BASE < prog->NumUniformStorage) {
+         table[i] = &prog->UniformStorage[ref - UNIFORM_REF_BASE];
+      } else {
+         table[i] = NULL;
+         r.error = true;
+      }
+   }
+   return table;
+}
+
+
+static void
+write_uniform_storage(program_writer &w, const struct gl_shader_program *prog)
+{
+   const union gl_constant_value *data = NULL;
+   unsigned num_slots = 0;
+
+   /* The linker parcels out one contiguous block of values, in uniform
+    * order.  Built-ins take slots but get no storage.
+    */
+   for (unsigned i = 0; i < prog->NumUniformStorage; i++) {
+      const struct gl_uniform_storage *uni = &prog->UniformStorage[i];
+
+      if (uni->storage != NULL) {
+         if (data == NULL)
+            data = uni->storage - num_slots;
+         else if (uni->storage != data + num_slots)
+            w.ok = false;
+      }
+      num_slots += uniform_slots(uni);
+   }
+
+   w.u32(prog->NumUniformStorage);
+   w.u32(num_slots);
+   w.u32(data != NULL);
+   if (data != NULL)
+      w.bytes(data, num_slots * sizeof(*data));
+
+   for (unsigned i = 0; i < prog->NumUniformStorage; i++) {
+      struct gl_uniform_storage uni = prog->UniformStorage[i];
+
+      w.str(uni.name);
+      w.type(uni.type);
+      w.u32(uni.storage != NULL);
+
+      uni.name = NULL;
+      uni.type = NULL;
+      uni.storage = NULL;
+      uni.num_driver_storage = 0;
+      uni.driver_storage = NULL;
+      w.bytes(&uni, sizeof(uni));
+   }
+
+   write_uniform_refs(w, prog, prog->UniformRemapTable,
+                      prog->NumUniformRemapTable);
+}
+
+static void
+read_uniform_storage(program_reader &r, struct gl_shader_program *prog)
+{
+   const unsigned num_uniforms = r.count();
+   const unsigned num_slots = r.count();
+   const bool has_data = r.u32();
+
+   if (num_uniforms > 0 && !r.failed()) {
+      struct gl_uniform_storage *uniforms =
+         rzalloc_array(prog, struct gl_uniform_storage, num_uniforms);
+      union gl_constant_value *data =
+         rzalloc_array(uniforms, union gl_constant_value, num_slots);
+
+      prog->UniformStorage = uniforms;
+      prog->NumUniformStorage = num_uniforms;
+
+      if (has_data)
+         r.bytes(data, num_slots * sizeof(*data));
+
+      unsigned slot = 0;
+      for (unsigned i = 0; i < num_uniforms && !r.failed(); i++) {
+         char *name = r.str(uniforms);
+         const glsl_type *type = r.type();
+         const bool has_storage = r.u32();
+
+         r.bytes(&uniforms[i], sizeof(uniforms[i]));
+         uniforms[i].name = name;
+         uniforms[i].type = type;
+         if (type == NULL)
+            break;
+
+         const unsigned slots = uniform_slots(&uniforms[i]);
+         if (slot + slots > num_slots || (has_storage && !has_data)) {
+            r.error = true;
+            break;
+         }
+         if (has_storage)
+            uniforms[i].storage = &data[slot];
+         slot += slots;
+      }
+   }
+
+   prog->UniformRemapTable =
+      read_uniform_refs(r, prog, prog, &prog->NumUniformRemapTable);
+}
+
+
+static void
+write_uniform_hash_entry(const char *name, unsigned value, void *closure)
+{
+   program_writer *w = (program_writer *) closure;
+
+   w->u32(1);
+   w->str(name);
+   w->u32(value);
+}
+
+static void
+write_uniform_hash(program_writer &w, struct string_to_uint_map *map)
+{
+   if (map != NULL)
+      map->iterate(write_uniform_hash_entry, &w);
+   w.u32(0);
+}
+
+static void
+read_uniform_hash(program_reader &r, struct gl_shader_program *prog)
+{
+   prog->UniformHash = new string_to_uint_map;
+
+   while (r.u32() && !r.failed()) {
+      char *name = r.str(NULL);
+      const unsigned value = r.u32();
+
+      if (name == NULL || value == UINT_MAX) {
+         r.error = true;
+      } else {
+         /* The map makes its own copy of the key. */
+         prog->UniformHash->put(value, name);
+      }
+      ralloc_free(name);
+   }
+}
+
+
+static void
+write_blocks(program_writer &w, const struct gl_uniform_block *blocks,
+             unsigned n)
+{
+   w.u32(n);
+   for (unsigned i = 0; i < n; i++) {
+      const struct gl_uniform_block *b = &blocks[i];
+
+      w.str(b->Name);
+      w.u32(b->Binding);
+      w.u32(b->UniformBufferSize);
+      w.u32(b->IsShaderStorage);
+      w.u32(b->_Packing);
+      w.u32(b->NumUniforms);
+      for (unsigned j = 0; j < b->NumUniforms; j++) {
+         const struct gl_uniform_buffer_variable *v = &b->Uniforms[j];
+
+         w.str(v->Name);
+         w.u32(v->IndexName == v->Name);
+         if (v->IndexName != v->Name)
+            w.str(v->IndexName);
+         w.type(v->Type);
+         w.u32(v->Offset);
+         w.u32(v->RowMajor);
+      }
+   }
+}
+
+static struct gl_uniform_block *
+read_blocks(program_reader &r, void *mem_ctx, unsigned *n)
+{
+   *n = r.count();
+   if (*n == 0)
+      return NULL;
+
+   struct gl_uniform_block *blocks =
+      rzalloc_array(mem_ctx, struct gl_uniform_block, *n);
+
+   for (unsigned i = 0; i < *n && !r.failed(); i++) {
+      struct gl_uniform_block *b = &blocks[i];
+
+      b->Name = r.str(blocks);
+      b->Binding = r.u32();
+      b->UniformBufferSize = r.u32();
+      b->IsShaderStorage = r.u32();
+      b->_Packing = (enum gl_uniform_block_packing) r.u32();
+      b->NumUniforms = r.count();
+      b->Uniforms = rzalloc_array(blocks, struct gl_uniform_buffer_variable,
+                                  b->NumUniforms);
+      for (unsigned j = 0; j < b->NumUniforms && !r.failed(); j++) {
+         struct gl_uniform_buffer_variable *v = &b->Uniforms[j];
+
+         v->Name = r.str(blocks);
+         v->IndexName = r.u32() ? v->Name : r.str(blocks);
+         v->Type = r.type();
+         v->Offset = r.u32();
+         v->RowMajor = r.u32();
+      }
+   }
+   return blocks;
+}
+
+
+static void
+write_transform_feedback(program_writer &w,
+                         const struct gl_transform_feedback_info *info)
+{
+   w.u32(info->NumOutputs);
+   w.u32(info->NumBuffers);
+   w.bytes(info->BufferStride, sizeof(info->BufferStride));
+   w.bytes(info->BufferStream, sizeof(info->BufferStream));
+   w.bytes(info->Outputs, info->NumOutputs * sizeof(*info->Outputs));
+
+   w.u32(info->NumVarying);
+   for (int i = 0; i < info->NumVarying; i++) {
+      w.str(info->Varyings[i].Name);
+      w.u32(info->Varyings[i].Type);
+      w.u32(info->Varyings[i].Size);
+   }
+}
+
+static void
+read_transform_feedback(program_reader &r, struct gl_shader_program *prog)
+{
+   struct gl_transform_feedback_info *info = &prog->LinkedTransformFeedback;
+
+   /* As in store_tfeedback_info(). */
+   ralloc_free(info->Varyings);
+   ralloc_free(info->Outputs);
+   memset(info, 0, sizeof(*info));
+
+   info->NumOutputs = r.count();
+   info->NumBuffers = r.u32();
+   r.bytes(info->BufferStride, sizeof(info->BufferStride));
+   r.bytes(info->BufferStream, sizeof(info->BufferStream));
+   info->Outputs = rzalloc_array(prog, struct gl_transform_feedback_output,
+                                 info->NumOutputs);
+   r.bytes(info->Outputs, info->NumOutputs * sizeof(*info->Outputs));
+
+   info->NumVarying = r.count();
+   info->Varyings = rzalloc_array(prog,
+                                  struct gl_transform_feedback_varying_info,
+                                  info->NumVarying);
+   for (int i = 0; i < info->NumVarying && !r.failed(); i++) {
+      info->Varyings[i].Name = r.str(prog);
+      info->Varyings[i].Type = r.u32();
+      info->Varyings[i].Size = r.u32();
+   }
+}
+
+
+static void
+write_atomic_buffers(program_writer &w, const struct gl_shader_program *prog)
+{
+   w.u32(prog->NumAtomicBuffers);
+   for (unsigned i = 0; i < prog->NumAtomicBuffers; i++) {
+      const struct gl_active_atomic_buffer *ab = &prog->AtomicBuffers[i];
+
+      w.u32(ab->NumUniforms);
+      w.bytes(ab->Uniforms, ab->NumUniforms * sizeof(*ab->Uniforms));
+      w.u32(ab->Binding);
+      w.u32(ab->MinimumSize);
+      w.bytes(ab->StageReferences, sizeof(ab->StageReferences));
+   }
+}
+
+static void
+read_atomic_buffers(program_reader &r, struct gl_shader_program *prog)
+{
+   prog->NumAtomicBuffers = r.count();
+   prog->AtomicBuffers = rzalloc_array(prog, struct gl_active_atomic_buffer,
+                                       prog->NumAtomicBuffers);
+   for (unsigned i = 0; i < prog->NumAtomicBuffers && !r.failed(); i++) {
+      struct gl_active_atomic_buffer *ab = &prog->AtomicBuffers[i];
+
+      ab->NumUniforms = r.count();
+      ab->Uniforms = rzalloc_array(prog->AtomicBuffers, GLuint,
+                                   ab->NumUniforms);
+      r.bytes(ab->Uniforms, ab->NumUniforms * sizeof(*ab->Uniforms));
+      ab->Binding = r.u32();
+      ab->MinimumSize = r.u32();
+      r.bytes(ab->StageReferences, sizeof(ab->StageReferences));
+   }
+}
+
+
+static void
+write_linked_shader(program_writer &w, const struct gl_shader_program *prog,
+                    struct gl_shader *sh)
+{
+#define WRITE_FIELD(f) w.bytes(&sh->f, sizeof(sh->f));
+   SHADER_FIELDS(WRITE_FIELD)
+#undef WRITE_FIELD
+
+   write_blocks(w, sh->BufferInterfaceBlocks, sh->NumBufferInterfaceBlocks);
+
+   w.ir(sh->ir);
+   w.ir(sh->packed_varyings);
+   w.ir(sh->fragdata_arrays);
+
+   w.u32(sh->NumAtomicBuffers);
+   for (unsigned i = 0; i < sh->NumAtomicBuffers; i++)
+      w.u32(sh->AtomicBuffers[i] - prog->AtomicBuffers);
+
+   write_uniform_refs(w, prog, sh->SubroutineUniformRemapTable,
+                      sh->NumSubroutineUniformRemapTable);
+
+   w.u32(sh->NumSubroutineFunctions);
+   for (unsigned i = 0; i < sh->NumSubroutineFunctions; i++) {
+      const struct gl_subroutine_function *fn = &sh->SubroutineFunctions[i];
+
+      w.str(fn->name);
+      w.u32(fn->index);
+      w.u32(fn->num_compat_types);
+      for (int j = 0; j < fn->num_compat_types; j++)
+         w.type(fn->types[j]);
+   }
+}
+
+static struct gl_shader *
+read_linked_shader(program_reader &r, struct gl_context *ctx,
+                   const struct gl_shader_program *prog, gl_shader_stage stage)
+{
+   struct gl_shader *sh = ctx->Driver.NewShader(NULL, 0, stage_type[stage]);
+
+   if (sh == NULL) {
+      r.error = true;
+      return NULL;
+   }
+
+#define READ_FIELD(f) r.bytes(&sh->f, sizeof(sh->f));
+   SHADER_FIELDS(READ_FIELD)
+#undef READ_FIELD
+
+   sh->BufferInterfaceBlocks =
+      read_blocks(r, sh, &sh->NumBufferInterfaceBlocks);
+
+   sh->ir = r.ir(sh);
+   sh->packed_varyings = r.ir(sh);
+   sh->fragdata_arrays = r.ir(sh);
+   if (sh->ir == NULL)
+      r.error = true;
+
+   sh->NumAtomicBuffers = r.count();
+   if (sh->NumAtomicBuffers > 0) {
+      sh->AtomicBuffers = rzalloc_array(prog, gl_active_atomic_buffer *,
+                                        sh->NumAtomicBuffers);
+      for (unsigned i = 0; i < sh->NumAtomicBuffers; i++) {
+         const unsigned index = r.u32();
+
+         if (index < prog->NumAtomicBuffers)
+            sh->AtomicBuffers[i] = &prog->AtomicBuffers[index];
+         else
+            r.error = true;
+      }
+   }
+
+   sh->SubroutineUniformRemapTable =
+      read_uniform_refs(r, prog, sh, &sh->NumSubroutineUniformRemapTable);
+
+   sh->NumSubroutineFunctions = r.count();
+   sh->SubroutineFunctions = rzalloc_array(sh, struct gl_subroutine_function,
+                                           sh->NumSubroutineFunctions);
+   for (unsigned i = 0; i < sh->NumSubroutineFunctions && !r.failed(); i++) {
+      struct gl_subroutine_function *fn = &sh->SubroutineFunctions[i];
+
+      fn->name = r.str(sh);
+      fn->index = r.u32();
+      fn->num_compat_types = r.count();
+      fn->types = ralloc_array(sh, const struct glsl_type *,
+                               fn->num_compat_types);
+      for (int j = 0; j < fn->num_compat_types; j++)
+         fn->types[j] = r.type();
+   }
+
+   if (!r.failed()) {
+      validate_ir_tree(sh->ir);
+
+      split_ubos_and_ssbos(sh,
+                           sh->BufferInterfaceBlocks,
+                           sh->NumBufferInterfaceBlocks,
+                           &sh->UniformBlocks,
+                           &sh->NumUniformBlocks,
+                           &sh->ShaderStorageBlocks,
+                           &sh->NumShaderStorageBlocks);
+   }
+
+   return sh;
+}
+
+
+static bool
+write_program(program_writer &w, struct gl_shader_program *prog)
+{
+#define WRITE_FIELD(f) w.bytes(&prog->f, sizeof(prog->f));
+   PROGRAM_FIELDS(WRITE_FIELD)
+#undef WRITE_FIELD
+
+   write_transform_feedback(w, &prog->LinkedTransformFeedback);
+   write_uniform_storage(w, prog);
+   write_uniform_hash(w, prog->UniformHash);
+   write_blocks(w, prog->BufferInterfaceBlocks,
+                prog->NumBufferInterfaceBlocks);
+
+   /* Sized by interstage_cross_validate_uniform_blocks(). */
+   unsigned num_stage_blocks = 0;
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i])
+         num_stage_blocks += prog->_LinkedShaders[i]->NumBufferInterfaceBlocks;
+   }
+
+   w.u32(num_stage_blocks);
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      const int *index = prog->InterfaceBlockStageIndex[i];
+
+      w.u32(index != NULL);
+      if (index != NULL)
+         w.bytes(index, num_stage_blocks * sizeof(*index));
+   }
+
+   write_atomic_buffers(w, prog);
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      w.u32(prog->_LinkedShaders[i] != NULL);
+      if (prog->_LinkedShaders[i])
+         write_linked_shader(w, prog, prog->_LinkedShaders[i]);
+   }
+
+   w.str(prog->InfoLog);
+   return w.ok;
+}
+
+static bool
+read_program(program_reader &r, struct gl_context *ctx,
+             struct gl_shader_program *prog)
+{
+#define READ_FIELD(f) r.bytes(&prog->f, sizeof(prog->f));
+   PROGRAM_FIELDS(READ_FIELD)
+#undef READ_FIELD
+
+   read_transform_feedback(r, prog);
+   read_uniform_storage(r, prog);
+   read_uniform_hash(r, prog);
+   prog->BufferInterfaceBlocks =
+      read_blocks(r, prog, &prog->NumBufferInterfaceBlocks);
+
+   const unsigned num_stage_blocks = r.count();
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (r.u32()) {
+         prog->InterfaceBlockStageIndex[i] =
+            ralloc_array(prog, int, num_stage_blocks);
+         r.bytes(prog->InterfaceBlockStageIndex[i],
+                 num_stage_blocks * sizeof(int));
+      }
+   }
+
+   read_atomic_buffers(r, prog);
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES && !r.failed(); i++) {
+      if (r.u32()) {
+         prog->_LinkedShaders[i] =
+            read_linked_shader(r, ctx, prog, (gl_shader_stage) i);
+      }
+   }
+
+   char *log = r.str(prog);
+   if (!r.done()) {
+      ralloc_free(log);
+      return false;
+   }
+
+   ralloc_free(prog->InfoLog);
+   prog->InfoLog = log ? log : ralloc_strdup(prog, "");
+
+   split_ubos_and_ssbos(prog,
+                        prog->BufferInterfaceBlocks,
+                        prog->NumBufferInterfaceBlocks,
+                        &prog->UniformBlocks,
+                        &prog->NumUniformBlocks,
+                        &prog->ShaderStorageBlocks,
+                        &prog->NumShaderStorageBlocks);
+   return true;
+}
+
+
+static void
+delete_linked_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
+{
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i] != NULL)
+         _mesa_delete_shader(ctx, prog->_LinkedShaders[i]);
+
+      prog->_LinkedShaders[i] = NULL;
+   }
+}
+
+
+bool
+_mesa_glsl_cache_skip_compile(struct gl_context *ctx, struct gl_shader *sh)
+{
+   char path[PATH_MAX];
+   uint8_t *data;
+   size_t size;
+   bool hit = false;
+
+   if (!cache_enabled(ctx) || !shader_key_path(ctx, sh, path, sizeof path))
+      return false;
+
+   data = read_entry(path, &size);
+   if (data == NULL)
+      return false;
+
+   /* Only successful compiles are recorded, along with their info log. */
+   program_reader r(data, size);
+   const char *log = blob_read_string(&r.blob);
+
+   if (log != NULL && r.done()) {
+      ralloc_free(sh->InfoLog);
+      sh->InfoLog = ralloc_strdup(sh, log);
+      sh->CompileStatus = GL_TRUE;
+      sh->CompileDeferred = true;
+      hit = true;
+   }
+
+   free(data);
+   return hit;
+}
+
+
+void
+_mesa_glsl_cache_store_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+   char path[PATH_MAX];
+
+   if (!sh->CompileStatus || !cache_enabled(ctx) ||
+       !shader_key_path(ctx, sh, path, sizeof path))
+      return;
+
+   program_writer w;
+   if (w.ok && blob_write_string(w.blob, sh->InfoLog ? sh->InfoLog : ""))
+      write_entry(path, w.blob);
+}
+
+
+bool
+_mesa_glsl_cache_load_program(struct gl_context *ctx,
+                              struct gl_shader_program *prog)
+{
+   char path[PATH_MAX];
+   uint8_t *data;
+   size_t size;
+
+   if (!cache_enabled(ctx) ||
+       !program_key_path(ctx, prog, path, sizeof path))
+      return false;
+
+   data = read_entry(path, &size);
+   if (data == NULL)
+      return false;
+
+   /* As at the start of link_shaders(). */
+   prog->LinkStatus = true;
+   prog->Validated = false;
+   prog->_Used = false;
+   delete_linked_shaders(ctx, prog);
+
+   program_reader r(data, size);
+   const bool hit = read_program(r, ctx, prog);
+
+   free(data);
+
+   if (!hit) {
+      delete_linked_shaders(ctx, prog);
+      _mesa_clear_shader_program_data(prog);
+
+      ralloc_free(prog->LinkedTransformFeedback.Varyings);
+      ralloc_free(prog->LinkedTransformFeedback.Outputs);
+      memset(&prog->LinkedTransformFeedback, 0,
+             sizeof(prog->LinkedTransformFeedback));
+   }
+
+   return hit;
+}
+
+
+void
+_mesa_glsl_cache_store_program(struct gl_context *ctx,
+                               struct gl_shader_program *prog)
+{
+   char path[PATH_MAX];
+
+   if (!prog->LinkStatus || !cache_enabled(ctx) ||
+       !program_key_path(ctx, prog, path, sizeof path))
+      return;
+
+   program_writer w;
+   if (write_program(w, prog))
+      write_entry(path, w.blob);
+}
+
+
+#else /* !HAVE_SHA1 || _WIN32 */
+
+
+bool
+_mesa_glsl_cache_skip_compile(struct gl_context *ctx, struct gl_shader *sh)
+{
+   return false;
+}
+
+
+void
+_mesa_glsl_cache_store_shader(struct gl_context *ctx, struct gl_shader *sh)
+{
+}
+
+
+bool
+_mesa_glsl_cache_load_program(struct gl_context *ctx,
+                              struct gl_shader_program *prog)
+{
+   return false;
+}
+
+
+void
+_mesa_glsl_cache_store_program(struct gl_context *ctx,
+                               struct gl_shader_program *prog)
+{
+}
+
+
+#endif /* HAVE_SHA1 && !_WIN32 */
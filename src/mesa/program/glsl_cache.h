@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef GLSL_CACHE_H
+#define GLSL_CACHE_H
+
+/**
+ * \file glsl_cache.h
+ *
+ * On-disk cache of linked GLSL programs.
+ *
+ * The cache is enabled by pointing \c MESA_GLSL_CACHE_DIR at a writable
+ * directory.  Programs are keyed by the SHA-1 of their shader sources, the
+ * link-time API state (attribute and frag data bindings, transform feedback
+ * varyings) and the context constants and extensions that affect
+ * compilation.  A hit restores the state \c link_shaders would have
+ * produced, so the driver's LinkShader hook still runs as usual.
+ *
+ * To let a hit skip compilation as well, glCompileShader only checks that
+ * the shader is known to compile and defers the real work.  Deferred shaders
+ * are compiled on demand if a program using them misses the cache.
+ */
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct gl_context;
+struct gl_shader;
+struct gl_shader_program;
+
+/**
+ * Try to satisfy glCompileShader from the cache.
+ *
+ * \return true if \c sh is known to compile; it is then marked as compiled,
+ *         with its compilation deferred until it is needed.
+ */
+extern bool
+_mesa_glsl_cache_skip_compile(struct gl_context *ctx, struct gl_shader *sh);
+
+/**
+ * Record that \c sh compiled successfully.
+ */
+extern void
+_mesa_glsl_cache_store_shader(struct gl_context *ctx, struct gl_shader *sh);
+
+/**
+ * Compile any attached shaders whose compilation was deferred.
+ *
+ * Sets a link error on \c prog if one of them fails.
+ */
+extern void
+_mesa_glsl_cache_compile_deferred(struct gl_context *ctx,
+                                  struct gl_shader_program *prog);
+
+/**
+ * Replace \c link_shaders by a cached result.
+ *
+ * \return true on a hit.  On a miss \c prog is left as it was.
+ */
+extern bool
+_mesa_glsl_cache_load_program(struct gl_context *ctx,
+                              struct gl_shader_program *prog);
+
+/**
+ * Store the result of a successful \c link_shaders.
+ *
+ * Must be called before the driver's LinkShader hook, which lowers the
+ * linked IR in driver-specific ways.
+ */
+extern void
+_mesa_glsl_cache_store_program(struct gl_context *ctx,
+                               struct gl_shader_program *prog);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* GLSL_CACHE_H */
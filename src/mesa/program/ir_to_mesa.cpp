@@ -40,11 +40,13 @@
 #include "glsl/ir_expression_flattening.h"
 #include "glsl/ir_visitor.h"
 #include "glsl/ir_optimization.h"
+#include "glsl/ir_pass_scheduler.h"
 #include "glsl/ir_uniform.h"
 #include "glsl/glsl_parser_extras.h"
 #include "glsl/nir/glsl_types.h"
 #include "glsl/linker.h"
 #include "glsl/program.h"
+#include "program/glsl_cache.h"
 #include "program/hash_table.h"
 #include "program/prog_instruction.h"
 #include "program/prog_optimize.h"
@@ -2887,46 +2889,65 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       const struct gl_shader_compiler_options *options =
             &ctx->Const.ShaderCompilerOptions[prog->_LinkedShaders[i]->Stage];
 
+      ir_pass_scheduler passes(true, true, options, ctx->Const.NativeIntegers);
+      if (ctx->_Shader->Flags & GLSL_PASS_STATS) {
+         char *name = ralloc_asprintf(NULL, "ir_to_mesa %s shader of program %u",
+                                      _mesa_shader_stage_to_string(i),
+                                      prog->Name);
+         passes.enable_stats(name);
+         ralloc_free(name);
+      }
+      bool changed = false;
+
       do {
 	 progress = false;
 
-	 /* Lowering */
-	 do_mat_op_to_vec(ir);
-	 lower_instructions(ir, (MOD_TO_FLOOR | DIV_TO_MUL_RCP | EXP_TO_EXP2
-				 | LOG_TO_LOG2 | INT_DIV_TO_MUL_RCP
-				 | ((options->EmitNoPow) ? POW_TO_EXP2 : 0)));
+	 /* Lowering.  As before, these don't count as progress on their own;
+	  * what they change only goes to the scheduler below, and \c changed
+	  * is cleared before it's folded into \c progress.
+	  */
+	 changed = do_mat_op_to_vec(ir) || changed;
+	 changed = lower_instructions(ir, (MOD_TO_FLOOR | DIV_TO_MUL_RCP | EXP_TO_EXP2
+					   | LOG_TO_LOG2 | INT_DIV_TO_MUL_RCP
+					   | ((options->EmitNoPow) ? POW_TO_EXP2 : 0)))
+	   || changed;
 
 	 progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops) || progress;
 
-	 progress = do_common_optimization(ir, true, true,
-                                           options, ctx->Const.NativeIntegers)
-	   || progress;
+	 /* Tell the scheduler about what the other passes changed. */
+	 if (changed || progress)
+	    passes.invalidate();
+	 changed = false;
 
-	 progress = lower_quadop_vector(ir, true) || progress;
+	 progress = passes.run_once(ir) || progress;
+
+	 changed = lower_quadop_vector(ir, true) || changed;
 
 	 if (options->MaxIfDepth == 0)
-	    progress = lower_discard(ir) || progress;
+	    changed = lower_discard(ir) || changed;
 
-	 progress = lower_if_to_cond_assign(ir, options->MaxIfDepth) || progress;
+	 changed = lower_if_to_cond_assign(ir, options->MaxIfDepth) || changed;
 
 	 if (options->EmitNoNoise)
-	    progress = lower_noise(ir) || progress;
+	    changed = lower_noise(ir) || changed;
 
 	 /* If there are forms of indirect addressing that the driver
 	  * cannot handle, perform the lowering pass.
 	  */
 	 if (options->EmitNoIndirectInput || options->EmitNoIndirectOutput
 	     || options->EmitNoIndirectTemp || options->EmitNoIndirectUniform)
-	   progress =
+	   changed =
 	     lower_variable_index_to_cond_assign(prog->_LinkedShaders[i]->Stage, ir,
 						 options->EmitNoIndirectInput,
 						 options->EmitNoIndirectOutput,
 						 options->EmitNoIndirectTemp,
 						 options->EmitNoIndirectUniform)
-	     || progress;
+	     || changed;
+
+	 changed = do_vec_index_to_cond_assign(ir) || changed;
+         changed = lower_vector_insert(ir, true) || changed;
 
-	 progress = do_vec_index_to_cond_assign(ir) || progress;
-         progress = lower_vector_insert(ir, true) || progress;
+	 progress = changed || progress;
       } while (progress);
 
       validate_ir_tree(ir);
@@ -2976,8 +2997,15 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       }
    }
 
-   if (prog->LinkStatus) {
-      link_shaders(ctx, prog);
+   if (prog->LinkStatus && !_mesa_glsl_cache_load_program(ctx, prog)) {
+      _mesa_glsl_cache_compile_deferred(ctx, prog);
+
+      if (prog->LinkStatus) {
+         link_shaders(ctx, prog);
+
+         /* Before the driver gets to lower the linked IR. */
+         _mesa_glsl_cache_store_program(ctx, prog);
+      }
    }
 
    if (prog->LinkStatus) {
@@ -34,6 +34,7 @@
 
 #include "glsl_parser_extras.h"
 #include "ir_optimization.h"
+#include "ir_pass_scheduler.h"
 
 #include "main/errors.h"
 #include "main/shaderobj.h"
@@ -5841,17 +5842,31 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
          lower_discard(ir);
       }
 
+      ir_pass_scheduler passes(true, true, options, ctx->Const.NativeIntegers);
+      if (ctx->_Shader->Flags & GLSL_PASS_STATS) {
+         char *name = ralloc_asprintf(NULL, "st %s shader of program %u",
+                                      _mesa_shader_stage_to_string(stage),
+                                      prog->Name);
+         passes.enable_stats(name);
+         ralloc_free(name);
+      }
+      bool changed = false;
+
       do {
          progress = false;
 
          progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops) || progress;
 
-         progress = do_common_optimization(ir, true, true, options,
-                                           ctx->Const.NativeIntegers)
-           || progress;
+         /* Tell the scheduler about what the other passes changed. */
+         if (changed || progress)
+            passes.invalidate();
+         changed = false;
+
+         progress = passes.run_once(ir) || progress;
 
-         progress = lower_if_to_cond_assign(ir, options->MaxIfDepth) || progress;
+         changed = lower_if_to_cond_assign(ir, options->MaxIfDepth) || changed;
 
+         progress = changed || progress;
       } while (progress);
 
       validate_ir_tree(ir);
@@ -27,6 +27,7 @@
  **************************************************************************/
 
 #include <stdio.h>
+#include <inttypes.h>
 #include "main/glheader.h"
 #include "main/context.h"
 #include "main/state.h"
@@ -37,8 +38,7 @@
 #include "main/enums.h"
 #include "main/macros.h"
 #include "main/transformfeedback.h"
-#include "main/sse_minmax.h"
-#include "x86/common_x86_asm.h"
+#include "util/index_range.h"
 
 #include "vbo_context.h"
 
@@ -81,11 +81,113 @@ vbo_check_buffers_are_unmapped(struct gl_context *ctx)
 
 
 
+/**
+ * Whether the index ranges computed for \p bufObj may be remembered.
+ *
+ * The cache is only invalidated by the buffer functions in bufferobj.c, so
+ * skip buffers that the GPU may write to, and buffers the application may be
+ * writing to through a persistent mapping.
+ */
+static bool
+vbo_use_minmax_cache(const struct gl_buffer_object *bufObj)
+{
+   const GLbitfield persistent_write = GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT;
+
+   if (bufObj->UsageHistory & (USAGE_TEXTURE_BUFFER |
+                               USAGE_ATOMIC_COUNTER_BUFFER |
+                               USAGE_SHADER_STORAGE_BUFFER |
+                               USAGE_TRANSFORM_FEEDBACK_BUFFER |
+                               USAGE_PIXEL_PACK_BUFFER |
+                               USAGE_DISABLE_MINMAX_CACHE))
+      return false;
+
+   if ((bufObj->Mappings[MAP_USER].AccessFlags & persistent_write) ==
+       persistent_write)
+      return false;
+
+   return true;
+}
+
+
+static bool
+vbo_get_minmax_cached(struct gl_buffer_object *bufObj,
+                      unsigned index_size, GLintptr offset, GLuint count,
+                      bool restart, GLuint restartIndex,
+                      GLuint *min_index, GLuint *max_index)
+{
+   bool found = false;
+
+   if (!vbo_use_minmax_cache(bufObj) || offset > UINT32_MAX)
+      return false;
+
+   mtx_lock(&bufObj->Mutex);
+   if (bufObj->MinMaxCacheDirty) {
+      if (bufObj->MinMaxCache)
+         _mesa_index_range_cache_clear(bufObj->MinMaxCache);
+      bufObj->MinMaxCacheDirty = false;
+   }
+   if (bufObj->MinMaxCache) {
+      found = _mesa_index_range_cache_lookup(bufObj->MinMaxCache,
+                                             offset, count, index_size,
+                                             restart, restartIndex,
+                                             min_index, max_index);
+   }
+   mtx_unlock(&bufObj->Mutex);
+
+   return found;
+}
+
+
+static void
+vbo_minmax_cache_store(struct gl_context *ctx,
+                       struct gl_buffer_object *bufObj,
+                       unsigned index_size, GLintptr offset, GLuint count,
+                       bool restart, GLuint restartIndex,
+                       GLuint min_index, GLuint max_index)
+{
+   struct index_range_cache *cache;
+
+   if (!vbo_use_minmax_cache(bufObj) || offset > UINT32_MAX)
+      return;
+
+   mtx_lock(&bufObj->Mutex);
+
+   cache = bufObj->MinMaxCache;
+   if (!cache) {
+      cache = bufObj->MinMaxCache = _mesa_index_range_cache_create();
+      if (!cache)
+         goto out;
+   }
+
+   _mesa_index_range_cache_add(cache, offset, count, index_size,
+                               restart, restartIndex, min_index, max_index);
+
+   /* Buffers that are rewritten between most draws only ever miss. */
+   if (!_mesa_index_range_cache_is_useful(cache)) {
+      if (MESA_VERBOSE & VERBOSE_DRAW)
+         _mesa_debug(ctx, "disabling min/max index cache of buffer %u "
+                     "(%" PRIu64 " of %" PRIu64 " indices hit)\n",
+                     bufObj->Name, cache->hit_indices,
+                     cache->hit_indices + cache->miss_indices);
+
+      _mesa_index_range_cache_destroy(cache);
+      bufObj->MinMaxCache = NULL;
+      bufObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
+   }
+
+out:
+   mtx_unlock(&bufObj->Mutex);
+}
+
+
 /**
  * Compute min and max elements by scanning the index buffer for
  * glDraw[Range]Elements() calls.
  * If primitive restart is enabled, we need to ignore restart
  * indexes when computing min/max.
+ *
+ * Results for buffer objects are cached per buffer until its contents
+ * change, so static index buffers are only scanned once.
  */
 static void
 vbo_get_minmax_index(struct gl_context *ctx,
@@ -98,95 +200,30 @@ vbo_get_minmax_index(struct gl_context *ctx,
    const GLuint restartIndex = _mesa_primitive_restart_index(ctx, ib->type);
    const int index_size = vbo_sizeof_ib_type(ib->type);
    const char *indices;
-   GLuint i;
 
    indices = (char *) ib->ptr + prim->start * index_size;
    if (_mesa_is_bufferobj(ib->obj)) {
+      const GLintptr offset = (GLintptr) indices;
       GLsizeiptr size = MIN2(count * index_size, ib->obj->Size);
-      indices = ctx->Driver.MapBufferRange(ctx, (GLintptr) indices, size,
+
+      if (vbo_get_minmax_cached(ib->obj, index_size, offset, count,
+                                restart, restartIndex, min_index, max_index))
+         return;
+
+      indices = ctx->Driver.MapBufferRange(ctx, offset, size,
                                            GL_MAP_READ_BIT, ib->obj,
                                            MAP_INTERNAL);
-   }
 
-   switch (ib->type) {
-   case GL_UNSIGNED_INT: {
-      const GLuint *ui_indices = (const GLuint *)indices;
-      GLuint max_ui = 0;
-      GLuint min_ui = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (ui_indices[i] != restartIndex) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-         }
-      }
-      else {
-#if defined(USE_SSE41)
-         if (cpu_has_sse4_1) {
-            _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
-         }
-         else
-#endif
-            for (i = 0; i < count; i++) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
-      }
-      *min_index = min_ui;
-      *max_index = max_ui;
-      break;
-   }
-   case GL_UNSIGNED_SHORT: {
-      const GLushort *us_indices = (const GLushort *)indices;
-      GLuint max_us = 0;
-      GLuint min_us = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] != restartIndex) {
-               if (us_indices[i] > max_us) max_us = us_indices[i];
-               if (us_indices[i] < min_us) min_us = us_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (us_indices[i] > max_us) max_us = us_indices[i];
-            if (us_indices[i] < min_us) min_us = us_indices[i];
-         }
-      }
-      *min_index = min_us;
-      *max_index = max_us;
-      break;
-   }
-   case GL_UNSIGNED_BYTE: {
-      const GLubyte *ub_indices = (const GLubyte *)indices;
-      GLuint max_ub = 0;
-      GLuint min_ub = ~0U;
-      if (restart) {
-         for (i = 0; i < count; i++) {
-            if (ub_indices[i] != restartIndex) {
-               if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-               if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-            }
-         }
-      }
-      else {
-         for (i = 0; i < count; i++) {
-            if (ub_indices[i] > max_ub) max_ub = ub_indices[i];
-            if (ub_indices[i] < min_ub) min_ub = ub_indices[i];
-         }
-      }
-      *min_index = min_ub;
-      *max_index = max_ub;
-      break;
-   }
-   default:
-      unreachable("not reached");
-   }
+      _mesa_index_range(indices, index_size, count, restart, restartIndex,
+                        min_index, max_index);
 
-   if (_mesa_is_bufferobj(ib->obj)) {
       ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+
+      vbo_minmax_cache_store(ctx, ib->obj, index_size, offset, count,
+                             restart, restartIndex, *min_index, *max_index);
+   } else {
+      _mesa_index_range(indices, index_size, count, restart, restartIndex,
+                        min_index, max_index);
    }
 }
 
@@ -0,0 +1,347 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "index_range.h"
+#include "macros.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * The scanners below are written for plain SSE2, which every x86-64 CPU has,
+ * so no runtime dispatch is needed.  Primitive restart is handled without
+ * branches: lanes holding the restart index are replaced by the identity of
+ * the reduction (all ones for min, zero for max) before they are combined.
+ *
+ * An accumulator that never saw a real index ends up with min > max; that is
+ * mapped to the ~0 / 0 result callers expect for an empty range.
+ */
+
+static void
+range_ubyte(const uint8_t *indices, unsigned count,
+            bool restart, unsigned restart_index,
+            unsigned *min_index, unsigned *max_index)
+{
+   uint8_t lo = 0xff, hi = 0;
+   unsigned i = 0;
+
+   if (restart_index > 0xff)
+      restart = false;
+
+#ifdef __SSE2__
+   if (count >= 16) {
+      const __m128i ri = _mm_set1_epi8((char) restart_index);
+      __m128i vlo = _mm_set1_epi8((char) 0xff);
+      __m128i vhi = _mm_setzero_si128();
+      uint8_t l[16], h[16];
+      unsigned j;
+
+      if (restart) {
+         for (; i + 16 <= count; i += 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &indices[i]);
+            const __m128i r = _mm_cmpeq_epi8(v, ri);
+            vlo = _mm_min_epu8(vlo, _mm_or_si128(v, r));
+            vhi = _mm_max_epu8(vhi, _mm_andnot_si128(r, v));
+         }
+      } else {
+         for (; i + 16 <= count; i += 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &indices[i]);
+            vlo = _mm_min_epu8(vlo, v);
+            vhi = _mm_max_epu8(vhi, v);
+         }
+      }
+
+      _mm_storeu_si128((__m128i *) l, vlo);
+      _mm_storeu_si128((__m128i *) h, vhi);
+      for (j = 0; j < 16; j++) {
+         if (l[j] < lo) lo = l[j];
+         if (h[j] > hi) hi = h[j];
+      }
+   }
+#endif
+
+   for (; i < count; i++) {
+      if (restart && indices[i] == restart_index)
+         continue;
+      if (indices[i] < lo) lo = indices[i];
+      if (indices[i] > hi) hi = indices[i];
+   }
+
+   *min_index = lo <= hi ? lo : ~0u;
+   *max_index = lo <= hi ? hi : 0;
+}
+
+static void
+range_ushort(const uint16_t *indices, unsigned count,
+             bool restart, unsigned restart_index,
+             unsigned *min_index, unsigned *max_index)
+{
+   uint16_t lo = 0xffff, hi = 0;
+   unsigned i = 0;
+
+   if (restart_index > 0xffff)
+      restart = false;
+
+#ifdef __SSE2__
+   if (count >= 8) {
+      /* SSE2 only has signed 16-bit min/max; flipping the sign bit maps
+       * unsigned order onto signed order.
+       */
+      const __m128i bias = _mm_set1_epi16((short) 0x8000);
+      const __m128i ri = _mm_set1_epi16((short) restart_index);
+      __m128i vlo = _mm_set1_epi16(0x7fff);
+      __m128i vhi = bias;
+      uint16_t l[8], h[8];
+      unsigned j;
+
+      if (restart) {
+         for (; i + 8 <= count; i += 8) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &indices[i]);
+            const __m128i r = _mm_cmpeq_epi16(v, ri);
+            vlo = _mm_min_epi16(vlo, _mm_xor_si128(_mm_or_si128(v, r), bias));
+            vhi = _mm_max_epi16(vhi, _mm_xor_si128(_mm_andnot_si128(r, v),
+                                                   bias));
+         }
+      } else {
+         for (; i + 8 <= count; i += 8) {
+            const __m128i v =
+               _mm_xor_si128(_mm_loadu_si128((const __m128i *) &indices[i]),
+                             bias);
+            vlo = _mm_min_epi16(vlo, v);
+            vhi = _mm_max_epi16(vhi, v);
+         }
+      }
+
+      _mm_storeu_si128((__m128i *) l, _mm_xor_si128(vlo, bias));
+      _mm_storeu_si128((__m128i *) h, _mm_xor_si128(vhi, bias));
+      for (j = 0; j < 8; j++) {
+         if (l[j] < lo) lo = l[j];
+         if (h[j] > hi) hi = h[j];
+      }
+   }
+#endif
+
+   for (; i < count; i++) {
+      if (restart && indices[i] == restart_index)
+         continue;
+      if (indices[i] < lo) lo = indices[i];
+      if (indices[i] > hi) hi = indices[i];
+   }
+
+   *min_index = lo <= hi ? lo : ~0u;
+   *max_index = lo <= hi ? hi : 0;
+}
+
+#ifdef __SSE2__
+/* Min and max of sign-biased 32-bit lanes, SSE2 has no pminud/pmaxud. */
+static inline __m128i
+min_epi32_sse2(__m128i a, __m128i b)
+{
+   const __m128i gt = _mm_cmpgt_epi32(a, b);
+   return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline __m128i
+max_epi32_sse2(__m128i a, __m128i b)
+{
+   const __m128i gt = _mm_cmpgt_epi32(a, b);
+   return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+#endif
+
+static void
+range_uint(const uint32_t *indices, unsigned count,
+           bool restart, unsigned restart_index,
+           unsigned *min_index, unsigned *max_index)
+{
+   uint32_t lo = 0xffffffff, hi = 0;
+   unsigned i = 0;
+
+#ifdef __SSE2__
+   if (count >= 4) {
+      const __m128i bias = _mm_set1_epi32((int) 0x80000000);
+      const __m128i ri = _mm_set1_epi32((int) restart_index);
+      __m128i vlo = _mm_set1_epi32(0x7fffffff);
+      __m128i vhi = bias;
+      uint32_t l[4], h[4];
+      unsigned j;
+
+      if (restart) {
+         for (; i + 4 <= count; i += 4) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &indices[i]);
+            const __m128i r = _mm_cmpeq_epi32(v, ri);
+            vlo = min_epi32_sse2(vlo, _mm_xor_si128(_mm_or_si128(v, r), bias));
+            vhi = max_epi32_sse2(vhi, _mm_xor_si128(_mm_andnot_si128(r, v),
+                                                    bias));
+         }
+      } else {
+         for (; i + 4 <= count; i += 4) {
+            const __m128i v =
+               _mm_xor_si128(_mm_loadu_si128((const __m128i *) &indices[i]),
+                             bias);
+            vlo = min_epi32_sse2(vlo, v);
+            vhi = max_epi32_sse2(vhi, v);
+         }
+      }
+
+      _mm_storeu_si128((__m128i *) l, _mm_xor_si128(vlo, bias));
+      _mm_storeu_si128((__m128i *) h, _mm_xor_si128(vhi, bias));
+      for (j = 0; j < 4; j++) {
+         if (l[j] < lo) lo = l[j];
+         if (h[j] > hi) hi = h[j];
+      }
+   }
+#endif
+
+   for (; i < count; i++) {
+      if (restart && indices[i] == restart_index)
+         continue;
+      if (indices[i] < lo) lo = indices[i];
+      if (indices[i] > hi) hi = indices[i];
+   }
+
+   *min_index = lo <= hi ? lo : ~0u;
+   *max_index = lo <= hi ? hi : 0;
+}
+
+void
+_mesa_index_range(const void *indices, unsigned index_size, unsigned count,
+                  bool restart, unsigned restart_index,
+                  unsigned *min_index, unsigned *max_index)
+{
+   switch (index_size) {
+   case 4:
+      range_uint(indices, count, restart, restart_index, min_index, max_index);
+      break;
+   case 2:
+      range_ushort(indices, count, restart, restart_index,
+                   min_index, max_index);
+      break;
+   case 1:
+      range_ubyte(indices, count, restart, restart_index,
+                  min_index, max_index);
+      break;
+   default:
+      assert(!"bad index size");
+      *min_index = ~0u;
+      *max_index = 0;
+   }
+}
+
+
+struct index_range_cache *
+_mesa_index_range_cache_create(void)
+{
+   return calloc(1, sizeof(struct index_range_cache));
+}
+
+void
+_mesa_index_range_cache_destroy(struct index_range_cache *cache)
+{
+   free(cache);
+}
+
+void
+_mesa_index_range_cache_clear(struct index_range_cache *cache)
+{
+   unsigned i;
+
+   for (i = 0; i < INDEX_RANGE_CACHE_SIZE; i++)
+      cache->entries[i].valid = false;
+   cache->clears++;
+}
+
+static struct index_range_cache_entry *
+cache_slot(struct index_range_cache *cache, unsigned offset, unsigned count,
+           unsigned index_size)
+{
+   /* Multiplicative hash, the top bits pick the slot. */
+   const uint32_t h = (offset * 0x9e3779b1u) ^ (count * 0x85ebca6bu) ^
+                      index_size;
+   const uint32_t slot = (h * 0x9e3779b1u) >> 26;
+
+   STATIC_ASSERT(INDEX_RANGE_CACHE_SIZE == 1 << (32 - 26));
+   return &cache->entries[slot];
+}
+
+bool
+_mesa_index_range_cache_lookup(struct index_range_cache *cache,
+                               unsigned offset, unsigned count,
+                               unsigned index_size,
+                               bool restart, unsigned restart_index,
+                               unsigned *min_index, unsigned *max_index)
+{
+   const struct index_range_cache_entry *entry =
+      cache_slot(cache, offset, count, index_size);
+
+   if (entry->valid &&
+       entry->offset == offset &&
+       entry->count == count &&
+       entry->index_size == index_size &&
+       entry->restart == restart &&
+       (!restart || entry->restart_index == restart_index)) {
+      *min_index = entry->min_index;
+      *max_index = entry->max_index;
+      cache->hit_indices += count;
+      return true;
+   }
+
+   cache->miss_indices += count;
+   return false;
+}
+
+void
+_mesa_index_range_cache_add(struct index_range_cache *cache,
+                            unsigned offset, unsigned count,
+                            unsigned index_size,
+                            bool restart, unsigned restart_index,
+                            unsigned min_index, unsigned max_index)
+{
+   struct index_range_cache_entry *entry =
+      cache_slot(cache, offset, count, index_size);
+
+   entry->offset = offset;
+   entry->count = count;
+   entry->index_size = index_size;
+   entry->restart = restart;
+   entry->restart_index = restart ? restart_index : 0;
+   entry->min_index = min_index;
+   entry->max_index = max_index;
+   entry->valid = true;
+}
+
+bool
+_mesa_index_range_cache_is_useful(const struct index_range_cache *cache)
+{
+   /* Give freshly written buffers a chance: only judge a cache once its
+    * buffer has been rewritten a number of times, and then require at least
+    * one hit for every sixteen indices scanned.
+    */
+   return cache->clears < 32 ||
+          cache->hit_indices * 16 >= cache->miss_indices;
+}
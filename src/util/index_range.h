@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file index_range.h
+ *
+ * Computing the range of vertices referenced by an index buffer, and
+ * remembering it for buffers that are drawn from repeatedly.
+ *
+ * Both the GL frontend (vbo) and gallium's u_vbuf need the smallest and
+ * largest index of a draw to know which part of the vertex buffers to
+ * translate or upload.  For static index buffers the answer never changes,
+ * so the cache below lets the caller skip mapping and scanning entirely.
+ */
+
+#ifndef INDEX_RANGE_H
+#define INDEX_RANGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Find the smallest and largest of \c count indices of \c index_size bytes
+ * (1, 2 or 4).
+ *
+ * If \c restart is set, indices equal to \c restart_index are ignored.  When
+ * no index is left \c *min_index is ~0 and \c *max_index is 0.
+ */
+void
+_mesa_index_range(const void *indices, unsigned index_size, unsigned count,
+                  bool restart, unsigned restart_index,
+                  unsigned *min_index, unsigned *max_index);
+
+/**
+ * Number of ranges remembered per buffer.  The cache is direct mapped, so a
+ * buffer drawn from with more distinct ranges than this keeps working, it
+ * just misses more often.
+ */
+#define INDEX_RANGE_CACHE_SIZE 64
+
+struct index_range_cache_entry {
+   uint32_t offset;
+   uint32_t count;
+   uint32_t restart_index;
+   uint8_t index_size;
+   bool restart;
+   bool valid;
+   uint32_t min_index;
+   uint32_t max_index;
+};
+
+struct index_range_cache {
+   struct index_range_cache_entry entries[INDEX_RANGE_CACHE_SIZE];
+
+   /** Number of indices whose range was found in / missing from the cache */
+   uint64_t hit_indices;
+   uint64_t miss_indices;
+
+   /** Number of times the buffer contents changed under the cache */
+   uint32_t clears;
+};
+
+struct index_range_cache *
+_mesa_index_range_cache_create(void);
+
+void
+_mesa_index_range_cache_destroy(struct index_range_cache *cache);
+
+/**
+ * Forget every range, e.g. because the buffer contents changed.  The hit and
+ * miss counters are kept.
+ */
+void
+_mesa_index_range_cache_clear(struct index_range_cache *cache);
+
+/**
+ * Look up the range of the \c count indices starting \c offset bytes into the
+ * buffer.  Updates the hit/miss counters.
+ *
+ * \return true and fills \c *min_index / \c *max_index on a hit.
+ */
+bool
+_mesa_index_range_cache_lookup(struct index_range_cache *cache,
+                               unsigned offset, unsigned count,
+                               unsigned index_size,
+                               bool restart, unsigned restart_index,
+                               unsigned *min_index, unsigned *max_index);
+
+void
+_mesa_index_range_cache_add(struct index_range_cache *cache,
+                            unsigned offset, unsigned count,
+                            unsigned index_size,
+                            bool restart, unsigned restart_index,
+                            unsigned min_index, unsigned max_index);
+
+/**
+ * Whether the cache is paying for itself.  Buffers whose contents change
+ * between nearly every draw only ever miss; callers should stop caching for
+ * those.
+ */
+bool
+_mesa_index_range_cache_is_useful(const struct index_range_cache *cache);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+#endif /* INDEX_RANGE_H */
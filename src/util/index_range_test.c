@@ -0,0 +1,195 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "index_range.h"
+
+#define MAX_COUNT 67
+
+static unsigned
+get_index(const void *indices, unsigned index_size, unsigned i)
+{
+   switch (index_size) {
+   case 4: return ((const uint32_t *) indices)[i];
+   case 2: return ((const uint16_t *) indices)[i];
+   default: return ((const uint8_t *) indices)[i];
+   }
+}
+
+static void
+set_index(void *indices, unsigned index_size, unsigned i, unsigned value)
+{
+   switch (index_size) {
+   case 4: ((uint32_t *) indices)[i] = value; break;
+   case 2: ((uint16_t *) indices)[i] = value; break;
+   default: ((uint8_t *) indices)[i] = value; break;
+   }
+}
+
+/* The obvious loop the vectorized scanners have to agree with. */
+static void
+reference_range(const void *indices, unsigned index_size, unsigned count,
+                bool restart, unsigned restart_index,
+                unsigned *min_index, unsigned *max_index)
+{
+   unsigned i;
+
+   *min_index = ~0u;
+   *max_index = 0;
+   for (i = 0; i < count; i++) {
+      const unsigned index = get_index(indices, index_size, i);
+
+      if (restart && index == restart_index)
+         continue;
+      if (index < *min_index) *min_index = index;
+      if (index > *max_index) *max_index = index;
+   }
+}
+
+static uint32_t seed = 1;
+
+static uint32_t
+next_random(void)
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+static bool
+test_scan(unsigned index_size)
+{
+   const unsigned mask = index_size == 4 ? ~0u : (1u << (8 * index_size)) - 1;
+   /* Extra room so that scans can start at an unaligned element. */
+   uint32_t storage[MAX_COUNT + 4];
+   bool failed = false;
+   unsigned iter;
+
+   for (iter = 0; iter < 4000; iter++) {
+      const unsigned count = next_random() % MAX_COUNT;
+      const unsigned start = next_random() % 4;
+      const bool restart = next_random() & 1;
+      unsigned restart_index;
+      void *indices = (uint8_t *) storage + start * index_size;
+      unsigned i, min_index, max_index, ref_min, ref_max;
+
+      /* Mostly the fixed restart index, sometimes an arbitrary one, which
+       * may not even fit the index type.
+       */
+      switch (next_random() % 3) {
+      case 0: restart_index = mask; break;
+      case 1: restart_index = next_random() & mask; break;
+      default: restart_index = next_random() | 0x10000; break;
+      }
+
+      for (i = 0; i < count; i++) {
+         unsigned value;
+
+         switch (next_random() % 4) {
+         case 0: value = restart_index; break;
+         case 1: value = (next_random() & 1) ? mask : 0; break;
+         case 2: value = mask ^ (next_random() & 0xff); break;
+         default: value = next_random() ^ (next_random() << 16); break;
+         }
+         set_index(indices, index_size, i, value & mask);
+      }
+
+      _mesa_index_range(indices, index_size, count, restart, restart_index,
+                        &min_index, &max_index);
+      reference_range(indices, index_size, count, restart, restart_index,
+                      &ref_min, &ref_max);
+
+      if (min_index != ref_min || max_index != ref_max) {
+         fprintf(stderr, "%u-byte indices, count %u, restart %d (0x%x): "
+                         "expected [0x%x, 0x%x] but got [0x%x, 0x%x]\n",
+                 index_size, count, restart, restart_index,
+                 ref_min, ref_max, min_index, max_index);
+         failed = true;
+      }
+   }
+
+   return failed;
+}
+
+static bool
+test_cache(void)
+{
+   struct index_range_cache *cache = _mesa_index_range_cache_create();
+   unsigned min_index, max_index;
+   bool failed = false;
+
+   if (_mesa_index_range_cache_lookup(cache, 0, 6, 2, false, 0,
+                                      &min_index, &max_index))
+      failed = true;
+
+   _mesa_index_range_cache_add(cache, 0, 6, 2, false, 0, 3, 9);
+   if (!_mesa_index_range_cache_lookup(cache, 0, 6, 2, false, 0,
+                                       &min_index, &max_index) ||
+       min_index != 3 || max_index != 9)
+      failed = true;
+
+   /* Any difference in the key is a different range. */
+   if (_mesa_index_range_cache_lookup(cache, 2, 6, 2, false, 0,
+                                      &min_index, &max_index) ||
+       _mesa_index_range_cache_lookup(cache, 0, 5, 2, false, 0,
+                                      &min_index, &max_index) ||
+       _mesa_index_range_cache_lookup(cache, 0, 6, 4, false, 0,
+                                      &min_index, &max_index) ||
+       _mesa_index_range_cache_lookup(cache, 0, 6, 2, true, 0xffff,
+                                      &min_index, &max_index))
+      failed = true;
+
+   _mesa_index_range_cache_add(cache, 0, 6, 2, true, 0xffff, 4, 9);
+   if (_mesa_index_range_cache_lookup(cache, 0, 6, 2, true, 7,
+                                      &min_index, &max_index))
+      failed = true;
+
+   _mesa_index_range_cache_clear(cache);
+   if (_mesa_index_range_cache_lookup(cache, 0, 6, 2, false, 0,
+                                      &min_index, &max_index))
+      failed = true;
+
+   if (cache->hit_indices != 6 || cache->miss_indices != 6 * 6 + 5)
+      failed = true;
+
+   if (failed)
+      fprintf(stderr, "index range cache: unexpected lookup result\n");
+
+   _mesa_index_range_cache_destroy(cache);
+   return failed;
+}
+
+int
+main(int argc, char *argv[])
+{
+   bool failed = false;
+
+   failed |= test_scan(1);
+   failed |= test_scan(2);
+   failed |= test_scan(4);
+   failed |= test_cache();
+
+   return failed;
+}
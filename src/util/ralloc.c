@@ -515,3 +515,373 @@ ralloc_vasprintf_rewrite_tail(char **str, size_t *start, const char *fmt,
    *start += new_length;
    return true;
 }
+
+/*
+ * Linear allocator for short-lived allocations.
+ *
+ * A linear parent owns a list of buffers, each of which is an ordinary
+ * ralloc allocation under the parent's ralloc context.  Children are carved
+ * out of the latest buffer, preceded only by their size, which is needed by
+ * linear_realloc and the string helpers.  Children can't be freed
+ * individually: they go away with linear_free_parent or with the ralloc
+ * context owning the buffers.
+ */
+
+#define LINEAR_MAGIC 0x87b9c7d3
+#define MIN_LINEAR_BUFSIZE 2048
+#define SUBALLOC_ALIGNMENT 8
+
+#define ALIGN_POT(x, pot_align) (((x) + (pot_align) - 1) & ~((pot_align) - 1))
+
+struct linear_header {
+#ifdef DEBUG
+   unsigned magic;
+#endif
+   /* The first unused byte in the buffer */
+   unsigned offset;
+
+   /* The size of the buffer */
+   unsigned size;
+
+   /* New buffers are allocated from this ralloc context */
+   void *ralloc_parent;
+
+   /* The next buffer, if any */
+   struct linear_header *next;
+
+   /* The latest buffer, the only one which may have free space.  Only
+    * valid in the first buffer.
+    */
+   struct linear_header *latest;
+
+   /* The buffer follows, made of linear_size_chunks each followed by the
+    * allocation they describe.
+    */
+};
+
+struct linear_size_chunk {
+   unsigned size;
+   unsigned _padding;
+};
+
+typedef struct linear_header linear_header;
+typedef struct linear_size_chunk linear_size_chunk;
+
+#define LINEAR_HEADER_SIZE \
+   ALIGN_POT(sizeof(linear_header), SUBALLOC_ALIGNMENT)
+
+#define LINEAR_BUFFER(node) ((char *) (node) + LINEAR_HEADER_SIZE)
+
+/* The parent handle is the first allocation of the first buffer. */
+#define LINEAR_PARENT_TO_HEADER(parent) \
+   ((linear_header *) ((char *) (parent) - sizeof(linear_size_chunk) - \
+                       LINEAR_HEADER_SIZE))
+
+static linear_header *
+create_linear_node(void *ralloc_ctx, unsigned min_size)
+{
+   linear_header *node;
+
+   min_size += sizeof(linear_size_chunk);
+
+   if (likely(min_size < MIN_LINEAR_BUFSIZE))
+      min_size = MIN_LINEAR_BUFSIZE;
+
+   node = ralloc_size(ralloc_ctx, LINEAR_HEADER_SIZE + min_size);
+   if (unlikely(node == NULL))
+      return NULL;
+
+#ifdef DEBUG
+   node->magic = LINEAR_MAGIC;
+#endif
+   node->offset = 0;
+   node->size = min_size;
+   node->ralloc_parent = ralloc_ctx;
+   node->next = NULL;
+   node->latest = node;
+   return node;
+}
+
+void *
+linear_alloc_child(void *parent, unsigned size)
+{
+   linear_header *first = LINEAR_PARENT_TO_HEADER(parent);
+   linear_header *latest = first->latest;
+   linear_header *new_node;
+   linear_size_chunk *ptr;
+   unsigned full_size;
+
+#ifdef DEBUG
+   assert(first->magic == LINEAR_MAGIC);
+#endif
+   assert(!latest->next);
+
+   size = ALIGN_POT(size, SUBALLOC_ALIGNMENT);
+   full_size = sizeof(linear_size_chunk) + size;
+
+   if (unlikely(latest->offset + full_size > latest->size)) {
+      /* The rest of the latest buffer is wasted. */
+      new_node = create_linear_node(latest->ralloc_parent, size);
+      if (unlikely(new_node == NULL))
+         return NULL;
+
+      first->latest = new_node;
+      latest->next = new_node;
+      latest = new_node;
+   }
+
+   ptr = (linear_size_chunk *) (LINEAR_BUFFER(latest) + latest->offset);
+   ptr->size = size;
+   latest->offset += full_size;
+   return &ptr[1];
+}
+
+void *
+linear_alloc_parent(void *ralloc_ctx, unsigned size)
+{
+   linear_header *node;
+
+   if (unlikely(ralloc_ctx == NULL))
+      return NULL;
+
+   size = ALIGN_POT(size, SUBALLOC_ALIGNMENT);
+
+   node = create_linear_node(ralloc_ctx, size);
+   if (unlikely(node == NULL))
+      return NULL;
+
+   return linear_alloc_child((char *) LINEAR_BUFFER(node) +
+                             sizeof(linear_size_chunk), size);
+}
+
+void *
+linear_zalloc_child(void *parent, unsigned size)
+{
+   void *ptr = linear_alloc_child(parent, size);
+
+   if (likely(ptr != NULL))
+      memset(ptr, 0, size);
+   return ptr;
+}
+
+void *
+linear_zalloc_parent(void *parent, unsigned size)
+{
+   void *ptr = linear_alloc_parent(parent, size);
+
+   if (likely(ptr != NULL))
+      memset(ptr, 0, size);
+   return ptr;
+}
+
+void
+linear_free_parent(void *ptr)
+{
+   linear_header *node;
+
+   if (unlikely(ptr == NULL))
+      return;
+
+   node = LINEAR_PARENT_TO_HEADER(ptr);
+#ifdef DEBUG
+   assert(node->magic == LINEAR_MAGIC);
+#endif
+
+   while (node) {
+      void *next = node->next;
+      ralloc_free(node);
+      node = next;
+   }
+}
+
+void
+ralloc_steal_linear_parent(void *new_ralloc_ctx, void *ptr)
+{
+   linear_header *node;
+
+   if (unlikely(ptr == NULL))
+      return;
+
+   node = LINEAR_PARENT_TO_HEADER(ptr);
+#ifdef DEBUG
+   assert(node->magic == LINEAR_MAGIC);
+#endif
+
+   while (node) {
+      ralloc_steal(new_ralloc_ctx, node);
+      node->ralloc_parent = new_ralloc_ctx;
+      node = node->next;
+   }
+}
+
+void *
+ralloc_parent_of_linear_parent(void *ptr)
+{
+   linear_header *node = LINEAR_PARENT_TO_HEADER(ptr);
+#ifdef DEBUG
+   assert(node->magic == LINEAR_MAGIC);
+#endif
+   return node->ralloc_parent;
+}
+
+void *
+linear_realloc(void *parent, void *old, unsigned new_size)
+{
+   unsigned old_size = 0;
+   void *new_ptr;
+
+   new_ptr = linear_alloc_child(parent, new_size);
+
+   if (likely(old != NULL))
+      old_size = ((linear_size_chunk *) old)[-1].size;
+
+   if (likely(new_ptr != NULL && old_size != 0))
+      memcpy(new_ptr, old, old_size < new_size ? old_size : new_size);
+
+   return new_ptr;
+}
+
+void *
+linear_alloc_child_array(void *parent, size_t size, unsigned count)
+{
+   if (count > SIZE_MAX/size)
+      return NULL;
+
+   return linear_alloc_child(parent, size * count);
+}
+
+void *
+linear_zalloc_child_array(void *parent, size_t size, unsigned count)
+{
+   if (count > SIZE_MAX/size)
+      return NULL;
+
+   return linear_zalloc_child(parent, size * count);
+}
+
+char *
+linear_strdup(void *parent, const char *str)
+{
+   unsigned n;
+   char *ptr;
+
+   if (unlikely(str == NULL))
+      return NULL;
+
+   n = strlen(str);
+   ptr = linear_alloc_child(parent, n + 1);
+   if (unlikely(ptr == NULL))
+      return NULL;
+
+   memcpy(ptr, str, n);
+   ptr[n] = '\0';
+   return ptr;
+}
+
+char *
+linear_asprintf(void *parent, const char *fmt, ...)
+{
+   char *ptr;
+   va_list args;
+   va_start(args, fmt);
+   ptr = linear_vasprintf(parent, fmt, args);
+   va_end(args);
+   return ptr;
+}
+
+char *
+linear_vasprintf(void *parent, const char *fmt, va_list args)
+{
+   unsigned size = printf_length(fmt, args) + 1;
+
+   char *ptr = linear_alloc_child(parent, size);
+   if (ptr != NULL)
+      vsnprintf(ptr, size, fmt, args);
+
+   return ptr;
+}
+
+bool
+linear_asprintf_append(void *parent, char **str, const char *fmt, ...)
+{
+   bool success;
+   va_list args;
+   va_start(args, fmt);
+   success = linear_vasprintf_append(parent, str, fmt, args);
+   va_end(args);
+   return success;
+}
+
+bool
+linear_vasprintf_append(void *parent, char **str, const char *fmt, va_list args)
+{
+   size_t existing_length;
+   assert(str != NULL);
+   existing_length = *str ? strlen(*str) : 0;
+   return linear_vasprintf_rewrite_tail(parent, str, &existing_length, fmt, args);
+}
+
+bool
+linear_asprintf_rewrite_tail(void *parent, char **str, size_t *start,
+                             const char *fmt, ...)
+{
+   bool success;
+   va_list args;
+   va_start(args, fmt);
+   success = linear_vasprintf_rewrite_tail(parent, str, start, fmt, args);
+   va_end(args);
+   return success;
+}
+
+bool
+linear_vasprintf_rewrite_tail(void *parent, char **str, size_t *start,
+                              const char *fmt, va_list args)
+{
+   size_t new_length;
+   char *ptr;
+
+   assert(str != NULL);
+
+   if (unlikely(*str == NULL)) {
+      *str = linear_vasprintf(parent, fmt, args);
+      *start = strlen(*str);
+      return true;
+   }
+
+   new_length = printf_length(fmt, args);
+
+   ptr = linear_realloc(parent, *str, *start + new_length + 1);
+   if (unlikely(ptr == NULL))
+      return false;
+
+   vsnprintf(ptr + *start, new_length + 1, fmt, args);
+   *str = ptr;
+   *start += new_length;
+   return true;
+}
+
+/* helper routine for strcat/strncat - n is the exact amount to copy */
+static bool
+linear_cat(void *parent, char **dest, const char *str, unsigned n)
+{
+   char *both;
+   unsigned existing_length;
+   assert(dest != NULL && *dest != NULL);
+
+   existing_length = strlen(*dest);
+   both = linear_realloc(parent, *dest, existing_length + n + 1);
+   if (unlikely(both == NULL))
+      return false;
+
+   memcpy(both + existing_length, str, n);
+   both[existing_length + n] = '\0';
+
+   *dest = both;
+   return true;
+}
+
+bool
+linear_strcat(void *parent, char **dest, const char *str)
+{
+   return linear_cat(parent, dest, str, strlen(str));
+}
@@ -407,6 +407,99 @@ bool ralloc_asprintf_append (char **str, const char *fmt, ...)
 bool ralloc_vasprintf_append(char **str, const char *fmt, va_list args);
 /// @}
 
+/**
+ * \name Linear allocator
+ *
+ * A linear allocator for the many small, short-lived allocations of a
+ * compile, such as AST nodes, token strings and the bookkeeping of
+ * optimization passes.
+ *
+ * A linear parent hands out children from large buffers owned by a ralloc
+ * context, so a child costs a pointer bump instead of a \c malloc and a
+ * ralloc header.  Children can't be freed, stolen or used as ralloc
+ * contexts: all of them are freed at once with linear_free_parent(), or
+ * when the ralloc context owning the parent is freed.
+ *
+ * Destructors are never called for children.
+ */
+/// @{
+
+/**
+ * Create a linear parent, and allocate \p size bytes from it.
+ *
+ * The returned pointer is both the allocation and the handle to pass to the
+ * other linear_* functions.
+ *
+ * \param ralloc_ctx  The ralloc context owning the buffers.  Must not be
+ *                    NULL.
+ */
+void *linear_alloc_parent(void *ralloc_ctx, unsigned size);
+
+/**
+ * Allocate \p size bytes from a linear parent.
+ */
+void *linear_alloc_child(void *parent, unsigned size);
+
+/**
+ * Like linear_alloc_parent, but the allocation is zeroed.
+ */
+void *linear_zalloc_parent(void *ralloc_ctx, unsigned size);
+
+/**
+ * Like linear_alloc_child, but the allocation is zeroed.
+ */
+void *linear_zalloc_child(void *parent, unsigned size);
+
+/**
+ * Free a linear parent and all of its children.
+ */
+void linear_free_parent(void *ptr);
+
+/**
+ * Move a linear parent and all of its children to another ralloc context.
+ */
+void ralloc_steal_linear_parent(void *new_ralloc_ctx, void *ptr);
+
+/**
+ * Return the ralloc context owning a linear parent.
+ */
+void *ralloc_parent_of_linear_parent(void *ptr);
+
+/**
+ * Allocate a new child of \p parent and copy the contents of \p old to it.
+ *
+ * \p old is not freed, its memory is only reclaimed with the parent.
+ */
+void *linear_realloc(void *parent, void *old, unsigned new_size);
+
+/**
+ * Allocate an array of \p count elements of \p size bytes from a linear
+ * parent, checking for integer overflow.
+ */
+void *linear_alloc_child_array(void *parent, size_t size, unsigned count);
+
+/**
+ * Like linear_alloc_child_array, but the array is zeroed.
+ */
+void *linear_zalloc_child_array(void *parent, size_t size, unsigned count);
+
+/**
+ * The linear counterparts of ralloc_strdup, ralloc_asprintf and friends.
+ */
+char *linear_strdup(void *parent, const char *str);
+char *linear_asprintf(void *parent, const char *fmt, ...) PRINTFLIKE(2, 3);
+char *linear_vasprintf(void *parent, const char *fmt, va_list args);
+bool linear_asprintf_append(void *parent, char **str, const char *fmt, ...)
+                            PRINTFLIKE(3, 4);
+bool linear_vasprintf_append(void *parent, char **str, const char *fmt,
+                             va_list args);
+bool linear_asprintf_rewrite_tail(void *parent, char **str, size_t *start,
+                                  const char *fmt, ...) PRINTFLIKE(4, 5);
+bool linear_vasprintf_rewrite_tail(void *parent, char **str, size_t *start,
+                                   const char *fmt, va_list args);
+bool linear_strcat(void *parent, char **dest, const char *str);
+/// @}
+
 #ifdef __cplusplus
 } /* end of extern "C" */
 #endif
@@ -448,5 +541,31 @@ public:                                                                  \
       ralloc_free(p);                                                    \
    }
 
+/**
+ * Declare C++ new and delete operators which use the linear allocator.
+ *
+ * The memory context passed to new must be a linear parent.  delete runs
+ * the destructor but doesn't free anything, the memory is reclaimed with
+ * the parent.  Destructors are not run when the parent is freed.
+ */
+#define DECLARE_LINEAR_ALLOC_CXX_OPERATORS_TEMPLATE(TYPE, ALLOC_FUNC)     \
+public:                                                                  \
+   static void* operator new(size_t size, void *mem_ctx)                 \
+   {                                                                     \
+      void *p = ALLOC_FUNC(mem_ctx, size);                               \
+      assert(p != NULL);                                                 \
+      return p;                                                          \
+   }                                                                     \
+                                                                         \
+   static void operator delete(void *p)                                  \
+   {                                                                     \
+   }
+
+#define DECLARE_LINEAR_ALLOC_CXX_OPERATORS(TYPE) \
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS_TEMPLATE(TYPE, linear_alloc_child)
+
+#define DECLARE_LINEAR_ZALLOC_CXX_OPERATORS(TYPE) \
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS_TEMPLATE(TYPE, linear_zalloc_child)
+
 
 #endif
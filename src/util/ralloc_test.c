@@ -0,0 +1,148 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ralloc.h"
+
+#define NUM_CHILDREN 10000
+
+static bool
+test_children(void)
+{
+   void *ctx = ralloc_context(NULL);
+   void *lin = linear_alloc_parent(ctx, 0);
+   unsigned char *children[NUM_CHILDREN];
+   bool failed = false;
+
+   /* Enough children of varying sizes, a few of them larger than a buffer,
+    * to need many buffers.
+    */
+   for (unsigned i = 0; i < NUM_CHILDREN; i++) {
+      unsigned size = i % 97 == 0 ? 5000 + i : 1 + i % 61;
+
+      children[i] = linear_alloc_child(lin, size);
+      if (((uintptr_t) children[i]) % 8 != 0) {
+         fprintf(stderr, "linear child %u is misaligned\n", i);
+         failed = true;
+      }
+      memset(children[i], i & 0xff, size);
+   }
+
+   for (unsigned i = 0; i < NUM_CHILDREN; i++) {
+      unsigned size = i % 97 == 0 ? 5000 + i : 1 + i % 61;
+
+      for (unsigned j = 0; j < size; j++) {
+         if (children[i][j] != (i & 0xff)) {
+            fprintf(stderr, "linear child %u was overwritten\n", i);
+            failed = true;
+            break;
+         }
+      }
+   }
+
+   unsigned char *zeroed = linear_zalloc_child(lin, 100);
+   for (unsigned j = 0; j < 100; j++) {
+      if (zeroed[j] != 0) {
+         fprintf(stderr, "linear_zalloc_child returned dirty memory\n");
+         failed = true;
+         break;
+      }
+   }
+
+   if (ralloc_parent_of_linear_parent(lin) != ctx) {
+      fprintf(stderr, "ralloc_parent_of_linear_parent is wrong\n");
+      failed = true;
+   }
+
+   /* Freeing the ralloc context frees the buffers as well. */
+   ralloc_free(ctx);
+   return failed;
+}
+
+static bool
+test_strings(void)
+{
+   void *ctx = ralloc_context(NULL);
+   void *lin = linear_alloc_parent(ctx, 0);
+   bool failed = false;
+
+   char *str = linear_strdup(lin, "vec4");
+   linear_strcat(lin, &str, " color");
+   linear_asprintf_append(lin, &str, "[%d]", 3);
+   if (strcmp(str, "vec4 color[3]") != 0) {
+      fprintf(stderr, "linear string helpers: got \"%s\"\n", str);
+      failed = true;
+   }
+
+   char *fmt = linear_asprintf(lin, "%s_%u", "tmp", 42u);
+   if (strcmp(fmt, "tmp_42") != 0) {
+      fprintf(stderr, "linear_asprintf: got \"%s\"\n", fmt);
+      failed = true;
+   }
+
+   int *array = linear_alloc_child_array(lin, sizeof(int), 4);
+   for (int i = 0; i < 4; i++)
+      array[i] = i;
+   array = linear_realloc(lin, array, 8 * sizeof(int));
+   for (int i = 0; i < 4; i++) {
+      if (array[i] != i) {
+         fprintf(stderr, "linear_realloc lost the contents\n");
+         failed = true;
+         break;
+      }
+   }
+
+   /* Move the parent to another context and free the first one. */
+   void *other = ralloc_context(NULL);
+   ralloc_steal_linear_parent(other, lin);
+   ralloc_free(ctx);
+
+   if (strcmp(str, "vec4 color[3]") != 0 ||
+       ralloc_parent_of_linear_parent(lin) != other) {
+      fprintf(stderr, "ralloc_steal_linear_parent didn't move the parent\n");
+      failed = true;
+   }
+
+   /* More children go to the new context. */
+   for (unsigned i = 0; i < 1000; i++)
+      linear_strdup(lin, "a string long enough to fill some buffers");
+
+   linear_free_parent(lin);
+   ralloc_free(other);
+   return failed;
+}
+
+int
+main(int argc, char *argv[])
+{
+   bool failed = false;
+
+   failed |= test_children();
+   failed |= test_strings();
+
+   return failed;
+}
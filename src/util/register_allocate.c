@@ -68,6 +68,15 @@
  * up front and stored in a 2-dimensional array, so that the cost of
  * coloring a node is constant with the number of registers.  We do
  * this during ra_set_finalize().
+ *
+ * Simplification doesn't rescan the whole graph for each node it pushes.
+ * It keeps a bitset of the nodes passing the pq test and, once optimistic
+ * coloring is needed, a heap of the remaining nodes ordered by q total.
+ * These give the same stack, in the same order, as repeatedly scanning all
+ * the nodes would.  Large graphs also don't get a dense adjacency bitset
+ * for each node, which would be quadratic in the number of nodes.  Their
+ * interferences are deduplicated by searching the adjacency lists instead,
+ * with a hash set for the nodes with many neighbors.
  */
 
 #include <stdbool.h>
@@ -80,6 +89,22 @@
 #include "register_allocate.h"
 
 #define NO_REG ~0U
+#define NO_NODE ~0U
+
+/**
+ * Graphs with more nodes than this don't get an adjacency bitset per node,
+ * which would take count^2 / 8 bytes.  register_allocate_test overrides it
+ * to run the same graphs with and without the bitsets.
+ */
+#ifndef RA_MAX_DENSE_ADJACENCY_NODES
+#define RA_MAX_DENSE_ADJACENCY_NODES 4096
+#endif
+
+/**
+ * Without adjacency bitsets, adjacency lists up to this long are searched
+ * linearly, and longer ones get a hash set.
+ */
+#define RA_MAX_ADJACENCY_SCAN 32
 
 struct ra_reg {
    BITSET_WORD *conflicts;
@@ -126,11 +151,18 @@ struct ra_node {
     *
     * List of which nodes this node interferes with.  This should be
     * symmetric with the other node.
+    *
+    * The adjacency bitset is NULL for graphs with more than
+    * RA_MAX_DENSE_ADJACENCY_NODES nodes.  Those have instead, once the
+    * adjacency list is longer than RA_MAX_ADJACENCY_SCAN, an open-addressed
+    * hash set of the nodes in it, with NO_NODE in the empty slots.
     */
    BITSET_WORD *adjacency;
    unsigned int *adjacency_list;
    unsigned int adjacency_list_size;
    unsigned int adjacency_count;
+   unsigned int *adjacency_set;
+   unsigned int adjacency_set_size;
    /** @} */
 
    unsigned int class;
@@ -174,6 +206,24 @@ struct ra_graph {
     * stack.
     */
    unsigned int stack_optimistic_start;
+
+   /** @{
+    *
+    * Scratch state of ra_simplify().
+    *
+    * pq is the set of nodes left in the graph which pass the pq test, and
+    * pq_words has a bit set for each word of pq with any bit set, to find
+    * the next one quickly.  The heap holds the nodes left in the graph,
+    * lowest q total first, for choosing an optimistic node.  It's only
+    * built when the first optimistic node is needed, since graphs which
+    * are trivially colorable don't need it.
+    */
+   BITSET_WORD *pq;
+   BITSET_WORD *pq_words;
+   unsigned int *heap;
+   unsigned int *heap_index;
+   unsigned int heap_count;
+   /** @} */
 };
 
 /**
@@ -387,10 +437,64 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
    }
 }
 
+static unsigned int
+ra_adjacency_set_hash(unsigned int n, unsigned int size)
+{
+   /* size is a power of two. */
+   return (n * 2654435761u) & (size - 1);
+}
+
+static void
+ra_adjacency_set_insert(struct ra_node *node, unsigned int n)
+{
+   unsigned int i = ra_adjacency_set_hash(n, node->adjacency_set_size);
+
+   while (node->adjacency_set[i] != NO_NODE)
+      i = (i + 1) & (node->adjacency_set_size - 1);
+   node->adjacency_set[i] = n;
+}
+
+static bool
+ra_adjacency_set_contains(const struct ra_node *node, unsigned int n)
+{
+   unsigned int i;
+
+   for (i = ra_adjacency_set_hash(n, node->adjacency_set_size);
+        node->adjacency_set[i] != NO_NODE;
+        i = (i + 1) & (node->adjacency_set_size - 1)) {
+      if (node->adjacency_set[i] == n)
+         return true;
+   }
+
+   return false;
+}
+
+/**
+ * (Re)builds the adjacency set of a node from its adjacency list, with a
+ * load factor of at most 1/2.
+ */
+static void
+ra_build_adjacency_set(struct ra_graph *g, struct ra_node *node)
+{
+   unsigned int i;
+
+   ralloc_free(node->adjacency_set);
+
+   node->adjacency_set_size = _mesa_next_pow_two_32(node->adjacency_count * 2);
+   node->adjacency_set = ralloc_array(g, unsigned int,
+                                      node->adjacency_set_size);
+   memset(node->adjacency_set, 0xff,
+          node->adjacency_set_size * sizeof(unsigned int));
+
+   for (i = 0; i < node->adjacency_count; i++)
+      ra_adjacency_set_insert(node, node->adjacency_list[i]);
+}
+
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
+   if (g->nodes[n1].adjacency)
+      BITSET_SET(g->nodes[n1].adjacency, n2);
 
    if (n1 != n2) {
       int n1_class = g->nodes[n1].class;
@@ -408,6 +512,16 @@ ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 
    g->nodes[n1].adjacency_list[g->nodes[n1].adjacency_count] = n2;
    g->nodes[n1].adjacency_count++;
+
+   if (!g->nodes[n1].adjacency) {
+      struct ra_node *node = &g->nodes[n1];
+
+      if (node->adjacency_set &&
+          node->adjacency_count * 2 <= node->adjacency_set_size)
+         ra_adjacency_set_insert(node, n2);
+      else if (node->adjacency_count > RA_MAX_ADJACENCY_SCAN)
+         ra_build_adjacency_set(g, node);
+   }
 }
 
 struct ra_graph *
@@ -424,8 +538,10 @@ ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
    g->stack = rzalloc_array(g, unsigned int, count);
 
    for (i = 0; i < count; i++) {
-      int bitset_count = BITSET_WORDS(count);
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      if (count <= RA_MAX_DENSE_ADJACENCY_NODES) {
+         int bitset_count = BITSET_WORDS(count);
+         g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      }
 
       g->nodes[i].adjacency_list_size = 4;
       g->nodes[i].adjacency_list =
@@ -447,11 +563,41 @@ ra_set_node_class(struct ra_graph *g,
    g->nodes[n].class = class;
 }
 
+/**
+ * Returns whether an interference between n1 and n2 was already added.
+ */
+static bool
+ra_nodes_interfere(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   const struct ra_node *node = &g->nodes[n1];
+   unsigned int n = n2;
+   unsigned int i;
+
+   if (node->adjacency)
+      return BITSET_TEST(node->adjacency, n2);
+
+   /* Look for the node with fewer neighbors in the other's adjacency. */
+   if (g->nodes[n2].adjacency_count < node->adjacency_count) {
+      node = &g->nodes[n2];
+      n = n1;
+   }
+
+   if (node->adjacency_set)
+      return ra_adjacency_set_contains(node, n);
+
+   for (i = 0; i < node->adjacency_count; i++) {
+      if (node->adjacency_list[i] == n)
+         return true;
+   }
+
+   return false;
+}
+
 void
 ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
-   if (!BITSET_TEST(g->nodes[n1].adjacency, n2)) {
+   if (!ra_nodes_interfere(g, n1, n2)) {
       ra_add_node_adjacency(g, n1, n2);
       ra_add_node_adjacency(g, n2, n1);
    }
@@ -465,6 +611,150 @@ pq_test(struct ra_graph *g, unsigned int n)
    return g->nodes[n].q_total < g->regs->classes[n_class]->p;
 }
 
+static void
+ra_pq_set(struct ra_graph *g, unsigned int n)
+{
+   BITSET_SET(g->pq, n);
+   BITSET_SET(g->pq_words, BITSET_BITWORD(n));
+}
+
+static void
+ra_pq_clear(struct ra_graph *g, unsigned int n)
+{
+   BITSET_CLEAR(g->pq, n);
+   if (!g->pq[BITSET_BITWORD(n)])
+      BITSET_CLEAR(g->pq_words, BITSET_BITWORD(n));
+}
+
+/**
+ * Returns the last word of the bitset before the given limit with any bit
+ * set, or -1.
+ */
+static int
+ra_find_last_word_below(const BITSET_WORD *set, unsigned int limit)
+{
+   unsigned int w, b;
+   BITSET_WORD bits;
+
+   if (limit == 0)
+      return -1;
+
+   w = BITSET_BITWORD(limit - 1);
+   b = (limit - 1) % BITSET_WORDBITS;
+   bits = set[w] & (~0u >> (BITSET_WORDBITS - 1 - b));
+
+   while (!bits) {
+      if (w == 0)
+         return -1;
+      bits = set[--w];
+   }
+
+   return w * BITSET_WORDBITS + _mesa_fls(bits) - 1;
+}
+
+/**
+ * Returns the highest-numbered node below limit which is left in the graph
+ * and passes the pq test, or -1.
+ */
+static int
+ra_pq_find_last_below(struct ra_graph *g, unsigned int limit)
+{
+   unsigned int w, b;
+   BITSET_WORD bits;
+   int word;
+
+   if (limit == 0)
+      return -1;
+
+   w = BITSET_BITWORD(limit - 1);
+   b = (limit - 1) % BITSET_WORDBITS;
+   bits = g->pq[w] & (~0u >> (BITSET_WORDBITS - 1 - b));
+   if (bits)
+      return w * BITSET_WORDBITS + _mesa_fls(bits) - 1;
+
+   word = ra_find_last_word_below(g->pq_words, w);
+   if (word < 0)
+      return -1;
+
+   return word * BITSET_WORDBITS + _mesa_fls(g->pq[word]) - 1;
+}
+
+/**
+ * Whether n1 is a better choice than n2 for optimistic coloring: the node
+ * with the lowest q total, and among those the highest-numbered one.
+ */
+static bool
+ra_heap_before(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   if (g->nodes[n1].q_total != g->nodes[n2].q_total)
+      return g->nodes[n1].q_total < g->nodes[n2].q_total;
+   return n1 > n2;
+}
+
+static void
+ra_heap_move(struct ra_graph *g, unsigned int i, unsigned int n)
+{
+   g->heap[i] = n;
+   g->heap_index[n] = i;
+}
+
+static void
+ra_heap_sift_up(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->heap[i];
+
+   while (i > 0) {
+      unsigned int parent = (i - 1) / 2;
+
+      if (!ra_heap_before(g, n, g->heap[parent]))
+         break;
+
+      ra_heap_move(g, i, g->heap[parent]);
+      i = parent;
+   }
+
+   ra_heap_move(g, i, n);
+}
+
+static void
+ra_heap_sift_down(struct ra_graph *g, unsigned int i)
+{
+   unsigned int n = g->heap[i];
+
+   for (;;) {
+      unsigned int child = 2 * i + 1;
+
+      if (child >= g->heap_count)
+         break;
+
+      if (child + 1 < g->heap_count &&
+          ra_heap_before(g, g->heap[child + 1], g->heap[child]))
+         child++;
+
+      if (!ra_heap_before(g, g->heap[child], n))
+         break;
+
+      ra_heap_move(g, i, g->heap[child]);
+      i = child;
+   }
+
+   ra_heap_move(g, i, n);
+}
+
+static void
+ra_heap_remove(struct ra_graph *g, unsigned int n)
+{
+   unsigned int i = g->heap_index[n];
+   unsigned int last = g->heap[--g->heap_count];
+
+   if (last == n)
+      return;
+
+   ra_heap_move(g, i, last);
+   ra_heap_sift_up(g, i);
+   ra_heap_sift_down(g, g->heap_index[last]);
+}
+
 static void
 decrement_q(struct ra_graph *g, unsigned int n)
 {
@@ -478,10 +768,47 @@ decrement_q(struct ra_graph *g, unsigned int n)
       if (n != n2 && !g->nodes[n2].in_stack) {
          assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
          g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+
+         if (g->nodes[n2].reg == NO_REG) {
+            if (pq_test(g, n2))
+               ra_pq_set(g, n2);
+            if (g->heap)
+               ra_heap_sift_up(g, g->heap_index[n2]);
+         }
       }
    }
 }
 
+static void
+ra_simplify_push(struct ra_graph *g, unsigned int n)
+{
+   decrement_q(g, n);
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+   g->nodes[n].in_stack = true;
+   ra_pq_clear(g, n);
+   if (g->heap)
+      ra_heap_remove(g, n);
+}
+
+static void
+ra_build_heap(struct ra_graph *g)
+{
+   unsigned int i;
+
+   g->heap = ralloc_array(g, unsigned int, g->count);
+   g->heap_index = ralloc_array(g, unsigned int, g->count);
+   g->heap_count = 0;
+
+   for (i = 0; i < g->count; i++) {
+      if (!g->nodes[i].in_stack && g->nodes[i].reg == NO_REG)
+         ra_heap_move(g, g->heap_count++, i);
+   }
+
+   for (i = g->heap_count / 2; i > 0; i--)
+      ra_heap_sift_down(g, i - 1);
+}
+
 /**
  * Simplifies the interference graph by pushing all
  * trivially-colorable nodes into a stack of nodes to be colored,
@@ -491,52 +818,70 @@ decrement_q(struct ra_graph *g, unsigned int n)
  * we optimistically choose a node and push it on the stack. We heuristically
  * push the node with the lowest total q value, since it has the fewest
  * neighbors and therefore is most likely to be allocated.
+ *
+ * The nodes are pushed in the order of passes over the graph from the last
+ * node down, each pushing the nodes which pass the pq test when it gets to
+ * them.  So after pushing a node, the next one is the highest-numbered node
+ * below it which passes the test, and nodes above it which the push made
+ * colorable wait for the next pass.  Only a pass which pushes nothing
+ * chooses an optimistic node.  Rather than actually scanning the nodes,
+ * the passes look up the next node in the pq bitset, and the optimistic node
+ * at the top of the heap.
  */
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
    unsigned int stack_optimistic_start = UINT_MAX;
-   int i;
+   unsigned int words = BITSET_WORDS(g->count);
+   unsigned int remaining = 0;
+   unsigned int limit;
+   unsigned int i;
+
+   g->pq = rzalloc_array(g, BITSET_WORD, words);
+   g->pq_words = rzalloc_array(g, BITSET_WORD, BITSET_WORDS(words));
 
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
+   for (i = 0; i < g->count; i++) {
+      if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
+         continue;
 
-      progress = false;
+      if (pq_test(g, i))
+         ra_pq_set(g, i);
+      remaining++;
+   }
 
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
+   limit = g->count;
+   while (remaining != 0) {
+      int n = ra_pq_find_last_below(g, limit);
 
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
+      if (n >= 0) {
+         ra_simplify_push(g, n);
+         remaining--;
+         limit = n;
+         continue;
       }
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
+      if (limit == g->count) {
+         /* A whole pass without progress. */
+         if (stack_optimistic_start == UINT_MAX) {
             stack_optimistic_start = g->stack_count;
+            ra_build_heap(g);
+         }
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
+         ra_simplify_push(g, g->heap[0]);
+         remaining--;
       }
+
+      limit = g->count;
    }
 
    g->stack_optimistic_start = stack_optimistic_start;
+
+   ralloc_free(g->pq);
+   ralloc_free(g->pq_words);
+   ralloc_free(g->heap);
+   ralloc_free(g->heap_index);
+   g->pq = g->pq_words = NULL;
+   g->heap = g->heap_index = NULL;
 }
 
 /**
@@ -0,0 +1,429 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Allocates registers for synthetic interference graphs, built from random
+ * live ranges of single registers and register pairs, and checks that no
+ * interfering nodes got conflicting registers.  Each graph is allocated both
+ * with and without dense adjacency bitsets, which must give the same
+ * registers and the same spill choices.
+ *
+ * With --bench, allocates graphs of 1k to 50k nodes and prints the time
+ * spent building each graph and allocating its registers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+/* Build the allocator into the test with a dense adjacency cutoff which can
+ * be changed at run time.
+ */
+static unsigned int max_dense_adjacency_nodes = 4096;
+#define RA_MAX_DENSE_ADJACENCY_NODES max_dense_adjacency_nodes
+#include "register_allocate.c"
+
+#define NUM_BASE_REGS 64
+#define NUM_PAIR_REGS (NUM_BASE_REGS / 2)
+
+struct edge {
+   unsigned int n1, n2;
+};
+
+struct graph {
+   unsigned int count;
+   unsigned int *start;
+   unsigned int *end;
+   unsigned int *class;
+   struct edge *edges;
+   unsigned int num_edges;
+};
+
+static unsigned int seed;
+
+static unsigned int
+random_uint(unsigned int max)
+{
+   seed = seed * 1103515245 + 12345;
+   return (seed >> 8) % max;
+}
+
+/**
+ * Registers 0..63 are single registers in class 0.  Registers 64..95 are the
+ * aligned pairs of those in class 1.
+ */
+static struct ra_regs *
+make_reg_set(void *mem_ctx, unsigned int *classes)
+{
+   struct ra_regs *regs =
+      ra_alloc_reg_set(mem_ctx, NUM_BASE_REGS + NUM_PAIR_REGS, true);
+   unsigned int i;
+
+   classes[0] = ra_alloc_reg_class(regs);
+   classes[1] = ra_alloc_reg_class(regs);
+
+   for (i = 0; i < NUM_BASE_REGS; i++)
+      ra_class_add_reg(regs, classes[0], i);
+
+   for (i = 0; i < NUM_PAIR_REGS; i++) {
+      unsigned int pair = NUM_BASE_REGS + i;
+
+      ra_class_add_reg(regs, classes[1], pair);
+      ra_add_transitive_reg_conflict(regs, 2 * i, pair);
+      ra_add_transitive_reg_conflict(regs, 2 * i + 1, pair);
+   }
+
+   ra_set_finalize(regs, NULL);
+
+   return regs;
+}
+
+static bool
+regs_conflict(unsigned int r1, unsigned int r2)
+{
+   unsigned int lo1 = r1 < NUM_BASE_REGS ? r1 : 2 * (r1 - NUM_BASE_REGS);
+   unsigned int hi1 = r1 < NUM_BASE_REGS ? r1 : lo1 + 1;
+   unsigned int lo2 = r2 < NUM_BASE_REGS ? r2 : 2 * (r2 - NUM_BASE_REGS);
+   unsigned int hi2 = r2 < NUM_BASE_REGS ? r2 : lo2 + 1;
+
+   return lo1 <= hi2 && lo2 <= hi1;
+}
+
+/**
+ * Makes count live ranges, one starting at each instruction, with lengths
+ * up to max_length instructions.  Every fourth one is a register pair.
+ */
+static void
+make_graph(void *mem_ctx, struct graph *graph, unsigned int count,
+           unsigned int max_length)
+{
+   unsigned int *live = ralloc_array(mem_ctx, unsigned int, count);
+   unsigned int num_live = 0;
+   unsigned int edges_size = count;
+   unsigned int i, j;
+
+   graph->count = count;
+   graph->start = ralloc_array(mem_ctx, unsigned int, count);
+   graph->end = ralloc_array(mem_ctx, unsigned int, count);
+   graph->class = ralloc_array(mem_ctx, unsigned int, count);
+   graph->edges = ralloc_array(mem_ctx, struct edge, edges_size);
+   graph->num_edges = 0;
+
+   for (i = 0; i < count; i++) {
+      graph->start[i] = i;
+      graph->end[i] = i + 1 + random_uint(max_length);
+      graph->class[i] = i % 4 == 0;
+
+      for (j = 0; j < num_live; ) {
+         unsigned int n = live[j];
+
+         if (graph->end[n] <= i) {
+            live[j] = live[--num_live];
+            continue;
+         }
+
+         if (graph->num_edges == edges_size) {
+            edges_size *= 2;
+            graph->edges = reralloc(mem_ctx, graph->edges, struct edge,
+                                    edges_size);
+         }
+         graph->edges[graph->num_edges].n1 = n;
+         graph->edges[graph->num_edges].n2 = i;
+         graph->num_edges++;
+         j++;
+      }
+
+      live[num_live++] = i;
+   }
+}
+
+static struct ra_graph *
+build_ra_graph(struct ra_regs *regs, const unsigned int *classes,
+               const struct graph *graph)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, graph->count);
+   unsigned int i;
+
+   for (i = 0; i < graph->count; i++) {
+      ra_set_node_class(g, i, classes[graph->class[i]]);
+      ra_set_node_spill_cost(g, i, graph->end[i] - graph->start[i] - 1);
+   }
+
+   /* Add every interference twice, the second time reversed, as the
+    * backends do when they walk both nodes' uses.
+    */
+   for (i = 0; i < graph->num_edges; i++) {
+      ra_add_node_interference(g, graph->edges[i].n1, graph->edges[i].n2);
+      ra_add_node_interference(g, graph->edges[i].n2, graph->edges[i].n1);
+   }
+
+   return g;
+}
+
+static bool
+check_coloring(struct ra_graph *g, const struct graph *graph)
+{
+   unsigned int i;
+
+   for (i = 0; i < graph->count; i++) {
+      unsigned int r = ra_get_node_reg(g, i);
+      bool pair = r >= NUM_BASE_REGS;
+
+      if (r >= NUM_BASE_REGS + NUM_PAIR_REGS || pair != graph->class[i]) {
+         fprintf(stderr, "node %u got register %u of the wrong class\n",
+                 i, r);
+         return false;
+      }
+   }
+
+   for (i = 0; i < graph->num_edges; i++) {
+      unsigned int n1 = graph->edges[i].n1, n2 = graph->edges[i].n2;
+      unsigned int r1 = ra_get_node_reg(g, n1), r2 = ra_get_node_reg(g, n2);
+
+      if (regs_conflict(r1, r2)) {
+         fprintf(stderr, "interfering nodes %u and %u got registers "
+                 "%u and %u\n", n1, n2, r1, r2);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Builds the graph once with dense adjacency bitsets and once without.
+ */
+static void
+build_ra_graphs(struct ra_regs *regs, const unsigned int *classes,
+                const struct graph *graph,
+                struct ra_graph **dense, struct ra_graph **sparse)
+{
+   unsigned int default_max = max_dense_adjacency_nodes;
+
+   max_dense_adjacency_nodes = ~0u;
+   *dense = build_ra_graph(regs, classes, graph);
+   max_dense_adjacency_nodes = 0;
+   *sparse = build_ra_graph(regs, classes, graph);
+   max_dense_adjacency_nodes = default_max;
+}
+
+static bool
+check_same_coloring(struct ra_graph *dense, struct ra_graph *sparse,
+                    const struct graph *graph)
+{
+   unsigned int i;
+
+   for (i = 0; i < graph->count; i++) {
+      unsigned int r1 = ra_get_node_reg(dense, i);
+      unsigned int r2 = ra_get_node_reg(sparse, i);
+
+      if (r1 != r2) {
+         fprintf(stderr, "node %u got register %u with dense adjacency "
+                 "and %u without\n", i, r1, r2);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Allocates a graph, which must succeed, and checks the result.
+ */
+static bool
+test_graph(struct ra_regs *regs, const unsigned int *classes,
+           unsigned int count, unsigned int max_length)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   struct graph graph;
+   struct ra_graph *dense, *sparse;
+   bool ok;
+
+   make_graph(mem_ctx, &graph, count, max_length);
+   build_ra_graphs(regs, classes, &graph, &dense, &sparse);
+
+   ok = ra_allocate(dense) && ra_allocate(sparse);
+   if (!ok)
+      fprintf(stderr, "failed to allocate %u nodes\n", count);
+   else
+      ok = check_coloring(dense, &graph) &&
+           check_same_coloring(dense, sparse, &graph);
+
+   ralloc_free(sparse);
+   ralloc_free(dense);
+   ralloc_free(mem_ctx);
+   return ok;
+}
+
+/**
+ * Allocates a graph needing spills, spilling the node suggested by
+ * ra_get_best_spill_node() by dropping its interferences until allocation
+ * succeeds.
+ */
+static bool
+test_spilling(struct ra_regs *regs, const unsigned int *classes,
+              unsigned int count, unsigned int max_length)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   struct graph graph;
+   unsigned int spills = 0;
+   bool ok = false;
+
+   make_graph(mem_ctx, &graph, count, max_length);
+
+   for (;;) {
+      struct ra_graph *dense, *sparse;
+      bool allocated;
+      int spill;
+      unsigned int i, j;
+
+      build_ra_graphs(regs, classes, &graph, &dense, &sparse);
+
+      allocated = ra_allocate(dense);
+      if (ra_allocate(sparse) != allocated) {
+         fprintf(stderr, "allocation %s only with dense adjacency after "
+                 "%u spills\n", allocated ? "succeeded" : "failed", spills);
+         ralloc_free(sparse);
+         ralloc_free(dense);
+         break;
+      }
+
+      if (allocated) {
+         ok = check_coloring(dense, &graph) &&
+              check_same_coloring(dense, sparse, &graph);
+         ralloc_free(sparse);
+         ralloc_free(dense);
+         break;
+      }
+
+      spill = ra_get_best_spill_node(dense);
+      if (ra_get_best_spill_node(sparse) != spill) {
+         fprintf(stderr, "spill %u picked node %d with dense adjacency "
+                 "and %d without\n", spills, spill,
+                 ra_get_best_spill_node(sparse));
+         ralloc_free(sparse);
+         ralloc_free(dense);
+         break;
+      }
+      ralloc_free(sparse);
+      ralloc_free(dense);
+
+      if (spill < 0) {
+         fprintf(stderr, "no node to spill after %u spills\n", spills);
+         break;
+      }
+
+      /* Spill it to a live range of a single instruction. */
+      graph.end[spill] = graph.start[spill] + 1;
+      for (i = j = 0; i < graph.num_edges; i++) {
+         unsigned int n1 = graph.edges[i].n1, n2 = graph.edges[i].n2;
+
+         if ((n1 == (unsigned int) spill || n2 == (unsigned int) spill) &&
+             (graph.end[n1] <= graph.start[n2] ||
+              graph.end[n2] <= graph.start[n1]))
+            continue;
+         graph.edges[j].n1 = n1;
+         graph.edges[j].n2 = n2;
+         j++;
+      }
+      graph.num_edges = j;
+      spills++;
+   }
+
+   ralloc_free(mem_ctx);
+   return ok;
+}
+
+/**
+ * Times graphs of live ranges up to 64 instructions long, which are mostly
+ * trivially colorable, and up to 160 long, which need optimistic coloring.
+ */
+static void
+bench(struct ra_regs *regs, const unsigned int *classes)
+{
+   static const unsigned int sizes[] = { 1000, 2000, 5000, 10000, 20000, 50000 };
+   static const unsigned int lengths[] = { 64, 160 };
+   unsigned int i, j;
+
+   printf("%8s %8s %8s %10s %10s\n",
+          "length", "nodes", "edges", "build ms", "alloc ms");
+
+   for (j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++) {
+      for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+         void *mem_ctx = ralloc_context(NULL);
+         struct graph graph;
+         struct ra_graph *g;
+         clock_t t0, t1, t2;
+
+         make_graph(mem_ctx, &graph, sizes[i], lengths[j]);
+
+         t0 = clock();
+         g = build_ra_graph(regs, classes, &graph);
+         t1 = clock();
+         ra_allocate(g);
+         t2 = clock();
+
+         printf("%8u %8u %8u %10.1f %10.1f\n",
+                lengths[j], graph.count, graph.num_edges,
+                (t1 - t0) * 1000.0 / CLOCKS_PER_SEC,
+                (t2 - t1) * 1000.0 / CLOCKS_PER_SEC);
+
+         ralloc_free(g);
+         ralloc_free(mem_ctx);
+      }
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   unsigned int classes[2];
+   struct ra_regs *regs = make_reg_set(mem_ctx, classes);
+   bool ok = true;
+
+   if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+      bench(regs, classes);
+      ralloc_free(mem_ctx);
+      return 0;
+   }
+
+   /* Low enough register pressure to color every node.  Without adjacency
+    * bitsets, the nodes of the longer live ranges have enough neighbors to
+    * get a hash set of them.
+    */
+   ok &= test_graph(regs, classes, 100, 16);
+   ok &= test_graph(regs, classes, 1000, 32);
+   ok &= test_graph(regs, classes, 6000, 32);
+
+   /* More live ranges than registers, needing optimistic coloring and
+    * spilling.
+    */
+   ok &= test_spilling(regs, classes, 500, 96);
+   ok &= test_spilling(regs, classes, 6000, 80);
+
+   ralloc_free(mem_ctx);
+   return ok ? 0 : 1;
+}
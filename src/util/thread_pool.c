@@ -0,0 +1,172 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "c11/threads.h"
+#include "thread_pool.h"
+
+struct thread_pool {
+   /** Protects everything below. */
+   mtx_t mutex;
+
+   /** Signaled when a batch starts and when the pool is destroyed. */
+   cnd_t work_cond;
+
+   /** Signaled when the last job of a batch is done. */
+   cnd_t done_cond;
+
+   /** Held by thread_pool_run() for the whole batch. */
+   mtx_t run_mutex;
+
+   thrd_t *threads;
+   unsigned num_threads;
+   bool shutdown;
+
+   thread_pool_job_func func;
+   void *data;
+   unsigned num_jobs;
+   unsigned next_job;
+   unsigned jobs_done;
+};
+
+/**
+ * Runs jobs of the current batch until there are none left to start.
+ *
+ * Called and returns with the mutex held.
+ */
+static void
+run_jobs(struct thread_pool *pool)
+{
+   while (pool->next_job < pool->num_jobs) {
+      unsigned index = pool->next_job++;
+
+      mtx_unlock(&pool->mutex);
+      pool->func(pool->data, index);
+      mtx_lock(&pool->mutex);
+
+      if (++pool->jobs_done == pool->num_jobs)
+         cnd_broadcast(&pool->done_cond);
+   }
+}
+
+static int
+worker(void *data)
+{
+   struct thread_pool *pool = data;
+
+   mtx_lock(&pool->mutex);
+   for (;;) {
+      while (!pool->shutdown && pool->next_job == pool->num_jobs)
+         cnd_wait(&pool->work_cond, &pool->mutex);
+
+      if (pool->shutdown)
+         break;
+
+      run_jobs(pool);
+   }
+   mtx_unlock(&pool->mutex);
+
+   return 0;
+}
+
+struct thread_pool *
+thread_pool_create(unsigned num_threads)
+{
+   struct thread_pool *pool = calloc(1, sizeof(*pool));
+   if (pool == NULL)
+      return NULL;
+
+   pool->threads = calloc(num_threads ? num_threads : 1, sizeof(thrd_t));
+   if (pool->threads == NULL) {
+      free(pool);
+      return NULL;
+   }
+
+   mtx_init(&pool->mutex, mtx_plain);
+   mtx_init(&pool->run_mutex, mtx_plain);
+   cnd_init(&pool->work_cond);
+   cnd_init(&pool->done_cond);
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      if (thrd_create(&pool->threads[i], worker, pool) != thrd_success) {
+         thread_pool_destroy(pool);
+         return NULL;
+      }
+      pool->num_threads++;
+   }
+
+   return pool;
+}
+
+void
+thread_pool_destroy(struct thread_pool *pool)
+{
+   if (pool == NULL)
+      return;
+
+   mtx_lock(&pool->mutex);
+   pool->shutdown = true;
+   cnd_broadcast(&pool->work_cond);
+   mtx_unlock(&pool->mutex);
+
+   for (unsigned i = 0; i < pool->num_threads; i++)
+      thrd_join(pool->threads[i], NULL);
+
+   cnd_destroy(&pool->done_cond);
+   cnd_destroy(&pool->work_cond);
+   mtx_destroy(&pool->run_mutex);
+   mtx_destroy(&pool->mutex);
+   free(pool->threads);
+   free(pool);
+}
+
+void
+thread_pool_run(struct thread_pool *pool, thread_pool_job_func func,
+                void *data, unsigned num_jobs)
+{
+   if (pool == NULL || pool->num_threads == 0 || num_jobs <= 1) {
+      for (unsigned i = 0; i < num_jobs; i++)
+         func(data, i);
+      return;
+   }
+
+   mtx_lock(&pool->run_mutex);
+   mtx_lock(&pool->mutex);
+
+   pool->func = func;
+   pool->data = data;
+   pool->num_jobs = num_jobs;
+   pool->next_job = 0;
+   pool->jobs_done = 0;
+   cnd_broadcast(&pool->work_cond);
+
+   run_jobs(pool);
+
+   while (pool->jobs_done < pool->num_jobs)
+      cnd_wait(&pool->done_cond, &pool->mutex);
+
+   mtx_unlock(&pool->mutex);
+   mtx_unlock(&pool->run_mutex);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file thread_pool.h
+ *
+ * A fixed set of worker threads running batches of independent jobs, such
+ * as compiling the stages of a shader program.
+ *
+ * thread_pool_run() hands the jobs of a batch out to the workers and to the
+ * calling thread, and returns once all of them are done.  A pool runs one
+ * batch at a time; callers on other threads wait for their turn.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct thread_pool;
+
+/**
+ * Runs job number \c index of a batch.
+ */
+typedef void (*thread_pool_job_func)(void *data, unsigned index);
+
+/**
+ * Starts \c num_threads workers.  Returns NULL if the pool or any of its
+ * threads can't be created.
+ */
+struct thread_pool *
+thread_pool_create(unsigned num_threads);
+
+/**
+ * Stops the workers, waiting for them to exit, and frees the pool.
+ */
+void
+thread_pool_destroy(struct thread_pool *pool);
+
+/**
+ * Calls \c func(data, i) for each i below \c num_jobs, in any order and on
+ * any of the threads, and returns when all calls have returned.
+ *
+ * With a NULL pool the jobs run in order on the calling thread.
+ */
+void
+thread_pool_run(struct thread_pool *pool, thread_pool_job_func func,
+                void *data, unsigned num_jobs);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,124 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Runs batches of jobs on pools of different sizes, and on concurrent
+ * callers sharing a pool, and checks that every job of every batch ran
+ * exactly once before thread_pool_run() returned.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "c11/threads.h"
+#include "u_atomic.h"
+#include "thread_pool.h"
+
+#define MAX_JOBS 256
+
+struct batch {
+   int runs[MAX_JOBS];
+};
+
+static void
+count_job(void *data, unsigned index)
+{
+   struct batch *batch = data;
+
+   /* Give the other threads a chance to pick up jobs. */
+   if (index % 8 == 0)
+      thrd_yield();
+
+   p_atomic_inc(&batch->runs[index]);
+}
+
+static bool
+run_batches(struct thread_pool *pool, unsigned num_batches)
+{
+   struct batch batch;
+   unsigned i, j;
+
+   for (i = 0; i < num_batches; i++) {
+      unsigned num_jobs = i % (MAX_JOBS + 1);
+
+      memset(&batch, 0, sizeof(batch));
+      thread_pool_run(pool, count_job, &batch, num_jobs);
+
+      for (j = 0; j < MAX_JOBS; j++) {
+         if (batch.runs[j] != (j < num_jobs)) {
+            fprintf(stderr, "job %u of %u ran %d times\n",
+                    j, num_jobs, batch.runs[j]);
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+static struct thread_pool *shared_pool;
+static int shared_ok;
+
+static int
+caller(void *data)
+{
+   if (!run_batches(shared_pool, 200))
+      p_atomic_set(&shared_ok, 0);
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned num_threads[] = { 0, 1, 3, 8 };
+   thrd_t callers[4];
+   bool ok = true;
+   unsigned i;
+
+   ok &= run_batches(NULL, 20);
+
+   for (i = 0; i < sizeof(num_threads) / sizeof(num_threads[0]); i++) {
+      struct thread_pool *pool = thread_pool_create(num_threads[i]);
+      if (pool == NULL) {
+         fprintf(stderr, "failed to create a pool of %u threads\n",
+                 num_threads[i]);
+         return 1;
+      }
+
+      ok &= run_batches(pool, 1000);
+      thread_pool_destroy(pool);
+   }
+
+   /* Batches from several threads at once take turns on the pool. */
+   shared_pool = thread_pool_create(4);
+   shared_ok = 1;
+   for (i = 0; i < 4; i++)
+      thrd_create(&callers[i], caller, NULL);
+   for (i = 0; i < 4; i++)
+      thrd_join(callers[i], NULL);
+   thread_pool_destroy(shared_pool);
+   ok &= shared_ok;
+
+   return ok ? 0 : 1;
+}